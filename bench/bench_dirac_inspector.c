@@ -0,0 +1,540 @@
+/*
+ * Inspector of DIRAC files containing transformed molecular integrals.
+ *
+ * Benchmarks for libunf and the readers of DIRAC files.
+ * Synthetic files can be prepared by gen_dirac_files.x.
+ *
+ * 2024 Alexander Oleynichenko
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "libunf.h"
+#include "mdcint.h"
+#include "mdprop.h"
+#include "mrconee.h"
+#include "util.h"
+
+#define BATCH_SIZE (4 * 1024 * 1024)
+#define BATCH_MAX_RECORDS 4096
+
+typedef struct {
+    char *dir;
+    int repeat;
+    int cold_cache;
+    unf_read_engine_t engine;
+} bench_options_t;
+
+static void print_usage();
+
+static int parse_args(int argc, char **argv, bench_options_t *opt);
+
+static char *option_value(char *arg, const char *name);
+
+static void make_path(bench_options_t *opt, char *name, char *path);
+
+static int64_t file_size(char *path);
+
+static void drop_file_cache(char *path);
+
+static void report(char *name, double time, int64_t n_bytes, int64_t n_records);
+
+static int64_t scan_unf_read(char *path, mrconee_data_t *mrconee_data, int64_t *n_bytes);
+
+static int64_t scan_batch(char *path, mrconee_data_t *mrconee_data, int64_t *n_bytes);
+
+static int64_t walk_forward(char *path, mrconee_data_t *mrconee_data);
+
+static int64_t walk_backward(char *path, mrconee_data_t *mrconee_data);
+
+static int64_t seek_random(char *path, mrconee_data_t *mrconee_data, int64_t n_records, int n_seeks);
+
+static int64_t build_index(char *path, mrconee_data_t *mrconee_data, int num_threads);
+
+
+int main(int argc, char **argv)
+{
+    bench_options_t opt;
+    char mrconee_path[1024];
+    char mdcint_path[1024];
+    char mdprop_path[1024];
+
+    if (parse_args(argc, argv, &opt) == EXIT_FAILURE) {
+        print_usage();
+        return EXIT_FAILURE;
+    }
+
+    unf_set_default_read_engine(opt.engine);
+
+    make_path(&opt, "MRCONEE", mrconee_path);
+    make_path(&opt, "MDCINT", mdcint_path);
+    make_path(&opt, "MDPROP", mdprop_path);
+
+    mrconee_data_t *mrconee_data = read_mrconee(mrconee_path);
+    if (mrconee_data == NULL) {
+        printf(" MRCONEE file not found or corrupted\n");
+        return EXIT_FAILURE;
+    }
+
+    int64_t mrconee_size = file_size(mrconee_path);
+    int64_t mdcint_size = file_size(mdcint_path);
+    int64_t mdprop_size = file_size(mdprop_path);
+
+    printf("\n");
+    printf(" MRCONEE  %14lld bytes\n", (long long) mrconee_size);
+    printf(" MDCINT   %14lld bytes\n", (long long) mdcint_size);
+    printf(" MDPROP   %14lld bytes\n", (long long) mdprop_size);
+    printf(" repeat   %14d\n", opt.repeat);
+    printf(" cache    %14s\n", opt.cold_cache ? "cold" : "warm");
+    unf_file_t *probe = unf_open(mdcint_path, "r", UNF_ACCESS_SEQUENTIAL);
+    printf(" engine   %14s\n", probe ? unf_get_read_engine_name(probe) : "-");
+    if (probe) {
+        unf_close(probe);
+    }
+    printf("\n");
+    printf(" %-34s%12s%12s%16s\n", "benchmark", "time, sec", "GB/s", "records/s");
+    printf(" --------------------------------------------------------------------------\n");
+
+    /*
+     * open + close
+     */
+    const int n_open = 1000;
+    double t0 = abs_time();
+    for (int i = 0; i < n_open; i++) {
+        unf_file_t *file = unf_open(mdcint_path, "r", UNF_ACCESS_SEQUENTIAL);
+        if (file) {
+            unf_close(file);
+        }
+    }
+    report("open + close (x1000)", abs_time() - t0, 0, 0);
+
+    /*
+     * header parse
+     */
+    t0 = abs_time();
+    for (int i = 0; i < opt.repeat; i++) {
+        if (opt.cold_cache) {
+            drop_file_cache(mrconee_path);
+        }
+        mrconee_data_t *data = read_mrconee(mrconee_path);
+        if (data) {
+            free_mrconee_data(data);
+        }
+    }
+    report("MRCONEE parse", (abs_time() - t0) / opt.repeat, mrconee_size, 6);
+
+    /*
+     * full scans of MDCINT
+     */
+    int64_t n_records = 0;
+    int64_t n_bytes = 0;
+
+    t0 = abs_time();
+    for (int i = 0; i < opt.repeat; i++) {
+        if (opt.cold_cache) {
+            drop_file_cache(mdcint_path);
+        }
+        n_records = scan_unf_read(mdcint_path, mrconee_data, &n_bytes);
+    }
+    report("MDCINT scan, unf_read", (abs_time() - t0) / opt.repeat, mdcint_size, n_records);
+
+    t0 = abs_time();
+    for (int i = 0; i < opt.repeat; i++) {
+        if (opt.cold_cache) {
+            drop_file_cache(mdcint_path);
+        }
+        n_records = scan_batch(mdcint_path, mrconee_data, &n_bytes);
+    }
+    report("MDCINT scan, unf_read_batch", (abs_time() - t0) / opt.repeat, mdcint_size, n_records);
+
+    t0 = abs_time();
+    for (int i = 0; i < opt.repeat; i++) {
+        if (opt.cold_cache) {
+            drop_file_cache(mdcint_path);
+        }
+        free_mdcint_data(read_mdcint(mdcint_path, mrconee_data));
+    }
+    report("MDCINT read_mdcint", (abs_time() - t0) / opt.repeat, mdcint_size, n_records);
+
+    /*
+     * MDPROP analysis
+     */
+    t0 = abs_time();
+    for (int i = 0; i < opt.repeat; i++) {
+        if (opt.cold_cache) {
+            drop_file_cache(mdprop_path);
+        }
+        free_mdprop_data(read_mdprop(mdprop_path, mrconee_data));
+    }
+    report("MDPROP read_mdprop", (abs_time() - t0) / opt.repeat, mdprop_size, 0);
+
+    /*
+     * seek patterns
+     */
+    t0 = abs_time();
+    for (int i = 0; i < opt.repeat; i++) {
+        n_records = walk_forward(mdcint_path, mrconee_data);
+    }
+    report("MDCINT unf_skip, forward", (abs_time() - t0) / opt.repeat, 0, n_records);
+
+    t0 = abs_time();
+    for (int i = 0; i < opt.repeat; i++) {
+        walk_backward(mdcint_path, mrconee_data);
+    }
+    report("MDCINT unf_backspace, backward", (abs_time() - t0) / opt.repeat, 0, n_records);
+
+    const int n_seeks = 100;
+    int64_t n_walked = 0;
+    t0 = abs_time();
+    for (int i = 0; i < opt.repeat; i++) {
+        n_walked = seek_random(mdcint_path, mrconee_data, n_records, n_seeks);
+    }
+    report("MDCINT unf_seek, random (x100)", (abs_time() - t0) / opt.repeat, 0, n_walked);
+
+    /*
+     * parallel discovery of record boundaries
+     */
+    int64_t n_indexed = 0;
+    t0 = abs_time();
+    for (int i = 0; i < opt.repeat; i++) {
+        if (opt.cold_cache) {
+            drop_file_cache(mdcint_path);
+        }
+        n_indexed = build_index(mdcint_path, mrconee_data, 1);
+    }
+    report("MDCINT unf_build_index, 1 thread", (abs_time() - t0) / opt.repeat, 0, n_indexed);
+
+    t0 = abs_time();
+    for (int i = 0; i < opt.repeat; i++) {
+        if (opt.cold_cache) {
+            drop_file_cache(mdcint_path);
+        }
+        n_indexed = build_index(mdcint_path, mrconee_data, 0);
+    }
+    report("MDCINT unf_build_index, parallel", (abs_time() - t0) / opt.repeat, 0, n_indexed);
+    if (n_indexed != n_records) {
+        printf(" warning: %lld records indexed, %lld records walked\n", (long long) n_indexed,
+               (long long) n_records);
+    }
+
+    printf(" --------------------------------------------------------------------------\n");
+    printf("\n");
+
+    free_mrconee_data(mrconee_data);
+
+    return EXIT_SUCCESS;
+}
+
+
+static void print_usage()
+{
+    printf("usage: bench_dirac_inspector.x [options]\n");
+    printf("  --dir=<path>     directory with MRCONEE, MDCINT and MDPROP files (default: current directory)\n");
+    printf("  --repeat=<n>     number of repetitions of each benchmark (default: 3)\n");
+    printf("  --cold           evict files from the page cache before each run\n");
+    printf("  --io=<name>      read engine: stdio or async (io_uring/pread read-ahead) (default: stdio)\n");
+}
+
+
+static int parse_args(int argc, char **argv, bench_options_t *opt)
+{
+    opt->dir = ".";
+    opt->repeat = 3;
+    opt->cold_cache = 0;
+    opt->engine = UNF_READ_ENGINE_STDIO;
+
+    for (int i = 1; i < argc; i++) {
+        char *arg = argv[i];
+        char *value = NULL;
+
+        if ((value = option_value(arg, "--dir"))) {
+            opt->dir = value;
+        }
+        else if ((value = option_value(arg, "--repeat"))) {
+            opt->repeat = atoi(value);
+        }
+        else if (strcmp(arg, "--cold") == 0) {
+            opt->cold_cache = 1;
+        }
+        else if ((value = option_value(arg, "--io"))) {
+            if (strcmp(value, "stdio") == 0) {
+                opt->engine = UNF_READ_ENGINE_STDIO;
+            }
+            else if (strcmp(value, "async") == 0) {
+                opt->engine = UNF_READ_ENGINE_ASYNC;
+            }
+            else {
+                return EXIT_FAILURE;
+            }
+        }
+        else {
+            return EXIT_FAILURE;
+        }
+    }
+
+    return opt->repeat > 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+/*
+ * returns the value of the option given as "--name=value", NULL if the argument is another option
+ */
+static char *option_value(char *arg, const char *name)
+{
+    size_t len = strlen(name);
+    if (strncmp(arg, name, len) == 0 && arg[len] == '=') {
+        return arg + len + 1;
+    }
+    return NULL;
+}
+
+
+static void make_path(bench_options_t *opt, char *name, char *path)
+{
+    snprintf(path, 1024, "%s/%s", opt->dir, name);
+}
+
+
+static int64_t file_size(char *path)
+{
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        return 0;
+    }
+    return (int64_t) st.st_size;
+}
+
+
+/**
+ * Asks the OS to evict (clean) pages of the file from the page cache.
+ */
+static void drop_file_cache(char *path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+    fdatasync(fd);
+#ifdef POSIX_FADV_DONTNEED
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+#endif
+    close(fd);
+}
+
+
+static void report(char *name, double time, int64_t n_bytes, int64_t n_records)
+{
+    printf(" %-34s%12.4f", name, time);
+
+    if (n_bytes > 0 && time > 0.0) {
+        printf("%12.3f", n_bytes / time / 1e9);
+    }
+    else {
+        printf("%12s", "-");
+    }
+
+    if (n_records > 0 && time > 0.0) {
+        printf("%16.0f", n_records / time);
+    }
+    else {
+        printf("%16s", "-");
+    }
+
+    printf("\n");
+}
+
+
+static unf_file_t *open_mdcint(char *path, mrconee_data_t *mrconee_data)
+{
+    unf_file_t *file = unf_open(path, "r", UNF_ACCESS_SEQUENTIAL);
+    if (file) {
+        unf_set_byte_order(file, mrconee_data->swap_bytes ? UNF_BYTE_ORDER_SWAPPED : UNF_BYTE_ORDER_NATIVE);
+    }
+    return file;
+}
+
+
+/**
+ * Record-by-record scan using the generic unf_read() interface.
+ */
+static int64_t scan_unf_read(char *path, mrconee_data_t *mrconee_data, int64_t *n_bytes)
+{
+    unf_file_t *file = open_mdcint(path, mrconee_data);
+    if (file == NULL) {
+        return 0;
+    }
+
+    int64_t n_records = 0;
+    char *buf = NULL;
+    int32_t buf_size = 0;
+    *n_bytes = 0;
+
+    while (1) {
+        int32_t rec_size = unf_next_rec_size(file);
+        if (rec_size <= 0) {
+            break;
+        }
+        if (rec_size > buf_size) {
+            free(buf);
+            buf_size = rec_size;
+            buf = (char *) malloc(buf_size);
+        }
+
+        int nread = unf_read(file, "c[i4]", buf, &rec_size);
+        if (nread != 1 || unf_error(file)) {
+            break;
+        }
+
+        n_records++;
+        *n_bytes += rec_size;
+    }
+
+    unf_close(file);
+    free(buf);
+
+    return n_records;
+}
+
+
+/**
+ * Scan by large batches of records.
+ */
+static int64_t scan_batch(char *path, mrconee_data_t *mrconee_data, int64_t *n_bytes)
+{
+    unf_file_t *file = open_mdcint(path, mrconee_data);
+    if (file == NULL) {
+        return 0;
+    }
+
+    size_t batch_size = BATCH_SIZE;
+    size_t n_carry = 0;
+    char *batch_buf = (char *) malloc(batch_size);
+    size_t *offsets = (size_t *) malloc(BATCH_MAX_RECORDS * sizeof(size_t));
+    int32_t *lengths = (int32_t *) malloc(BATCH_MAX_RECORDS * sizeof(int32_t));
+    int64_t n_records = 0;
+    *n_bytes = 0;
+
+    while (1) {
+        errno = 0;
+        int n_read = unf_read_batch(file, batch_buf, batch_size, &n_carry, BATCH_MAX_RECORDS, offsets, lengths);
+        if (n_read == 0 && errno == ENOBUFS) {
+            size_t new_size = (size_t) lengths[0] + 2 * sizeof(int32_t);
+            char *new_buf = (char *) malloc(new_size);
+            memcpy(new_buf + new_size - n_carry, batch_buf + batch_size - n_carry, n_carry);
+            free(batch_buf);
+            batch_buf = new_buf;
+            batch_size = new_size;
+            continue;
+        }
+        if (n_read == 0) {
+            break;
+        }
+
+        for (int i = 0; i < n_read; i++) {
+            *n_bytes += lengths[i];
+        }
+        n_records += n_read;
+    }
+
+    unf_close(file);
+    free(batch_buf);
+    free(offsets);
+    free(lengths);
+
+    return n_records;
+}
+
+
+static int64_t walk_forward(char *path, mrconee_data_t *mrconee_data)
+{
+    unf_file_t *file = open_mdcint(path, mrconee_data);
+    if (file == NULL) {
+        return 0;
+    }
+
+    int64_t n_records = 0;
+    while (unf_skip(file) == UNF_SUCCESS) {
+        n_records++;
+    }
+
+    unf_close(file);
+
+    return n_records;
+}
+
+
+static int64_t walk_backward(char *path, mrconee_data_t *mrconee_data)
+{
+    unf_file_t *file = open_mdcint(path, mrconee_data);
+    if (file == NULL) {
+        return 0;
+    }
+
+    int64_t n_records = 0;
+    unf_seek(file, UNF_POS_END, 0);
+    while (unf_backspace(file) == UNF_SUCCESS) {
+        n_records++;
+    }
+
+    unf_close(file);
+
+    return n_records;
+}
+
+
+/**
+ * Positions to random records; each seek walks from the beginning of the file.
+ * Returns the total number of records passed.
+ */
+static int64_t seek_random(char *path, mrconee_data_t *mrconee_data, int64_t n_records, int n_seeks)
+{
+    unf_file_t *file = open_mdcint(path, mrconee_data);
+    if (file == NULL || n_records <= 0) {
+        if (file) {
+            unf_close(file);
+        }
+        return 0;
+    }
+
+    int64_t n_walked = 0;
+    srand(12345);
+    for (int i = 0; i < n_seeks; i++) {
+        int rec = rand() % n_records;
+        unf_seek(file, UNF_POS_BEGIN, rec);
+        n_walked += rec;
+    }
+
+    unf_close(file);
+
+    return n_walked;
+}
+
+
+/**
+ * Returns the number of records found by unf_build_index().
+ */
+static int64_t build_index(char *path, mrconee_data_t *mrconee_data, int num_threads)
+{
+    unf_file_t *file = open_mdcint(path, mrconee_data);
+    if (file == NULL) {
+        return 0;
+    }
+
+    int64_t n_records = 0;
+    unf_rec_index_t *index = unf_build_index(file, num_threads);
+    if (index) {
+        n_records = index->num_records;
+        unf_free_index(index);
+    }
+
+    unf_close(file);
+
+    return n_records;
+}
@@ -0,0 +1,467 @@
+/*
+ * Inspector of DIRAC files containing transformed molecular integrals.
+ *
+ * Generator of synthetic MRCONEE, MDCINT and MDPROP files
+ * with the same layout as produced by DIRAC.
+ * To be used for testing and benchmarking.
+ *
+ * 2024 Alexander Oleynichenko
+ */
+
+#include <complex.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libunf.h"
+
+typedef struct {
+    char *dir;           // output directory
+    int nkr;             // number of Kramers pairs
+    int int_size;        // 4 or 8
+    int group_arith;     // 1 real, 2 complex
+    double fill;         // fraction of non-zero integrals in each (ikr, jkr) block
+    int num_props;       // number of property operators
+    int swap_bytes;      // write files with non-native byte order
+} gen_options_t;
+
+// operator number is written in 4 characters of the label
+#define GEN_MAX_PROPS 9999
+
+static uint64_t rng_state = 88172645463325252ull;
+
+static uint64_t rng_next();
+
+static double rng_uniform(double a, double b);
+
+static void print_usage();
+
+static int parse_args(int argc, char **argv, gen_options_t *opt);
+
+static char *option_value(char *arg, const char *name);
+
+static unf_file_t *open_output(gen_options_t *opt, char *name);
+
+static int write_mrconee(gen_options_t *opt);
+
+static int write_mdcint(gen_options_t *opt);
+
+static int write_mdprop(gen_options_t *opt);
+
+
+int main(int argc, char **argv)
+{
+    gen_options_t opt;
+
+    if (parse_args(argc, argv, &opt) == EXIT_FAILURE) {
+        print_usage();
+        return EXIT_FAILURE;
+    }
+
+    if (write_mrconee(&opt) == EXIT_FAILURE ||
+        write_mdcint(&opt) == EXIT_FAILURE ||
+        write_mdprop(&opt) == EXIT_FAILURE) {
+        perror(" error while writing files");
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+
+static void print_usage()
+{
+    printf("usage: gen_dirac_files.x [options]\n");
+    printf("  --dir=<path>        output directory (default: current directory)\n");
+    printf("  --nkr=<n>           number of Kramers pairs (default: 16)\n");
+    printf("  --int-size=<4|8>    size of integers in DIRAC (default: 4)\n");
+    printf("  --complex           complex group arithmetic (default: real)\n");
+    printf("  --fill=<f>          fraction of non-zero integrals in (ikr, jkr) blocks (default: 0.1)\n");
+    printf("  --props=<n>         number of property operators in MDPROP, at most %d (default: 3)\n", GEN_MAX_PROPS);
+    printf("  --swap-bytes        write files with non-native byte order\n");
+}
+
+
+static int parse_args(int argc, char **argv, gen_options_t *opt)
+{
+    opt->dir = ".";
+    opt->nkr = 16;
+    opt->int_size = 4;
+    opt->group_arith = 1;
+    opt->fill = 0.1;
+    opt->num_props = 3;
+    opt->swap_bytes = 0;
+
+    for (int i = 1; i < argc; i++) {
+        char *arg = argv[i];
+        char *value = NULL;
+
+        if ((value = option_value(arg, "--dir"))) {
+            opt->dir = value;
+        }
+        else if ((value = option_value(arg, "--nkr"))) {
+            opt->nkr = atoi(value);
+        }
+        else if ((value = option_value(arg, "--int-size"))) {
+            opt->int_size = atoi(value);
+        }
+        else if (strcmp(arg, "--complex") == 0) {
+            opt->group_arith = 2;
+        }
+        else if ((value = option_value(arg, "--fill"))) {
+            opt->fill = atof(value);
+        }
+        else if ((value = option_value(arg, "--props"))) {
+            opt->num_props = atoi(value);
+        }
+        else if (strcmp(arg, "--swap-bytes") == 0) {
+            opt->swap_bytes = 1;
+        }
+        else {
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (opt->nkr <= 0 ||
+        (opt->int_size != 4 && opt->int_size != 8) ||
+        opt->fill < 0.0 || opt->fill > 1.0 ||
+        opt->num_props < 0 || opt->num_props > GEN_MAX_PROPS) {
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+
+/*
+ * returns the value of the option given as "--name=value", NULL if the argument is another option
+ */
+static char *option_value(char *arg, const char *name)
+{
+    size_t len = strlen(name);
+    if (strncmp(arg, name, len) == 0 && arg[len] == '=') {
+        return arg + len + 1;
+    }
+    return NULL;
+}
+
+
+static unf_file_t *open_output(gen_options_t *opt, char *name)
+{
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/%s", opt->dir, name);
+
+    unf_file_t *file = unf_open(path, "w", UNF_ACCESS_SEQUENTIAL);
+    if (file != NULL) {
+        unf_set_byte_order(file, opt->swap_bytes ? UNF_BYTE_ORDER_SWAPPED : UNF_BYTE_ORDER_NATIVE);
+    }
+
+    return file;
+}
+
+
+/**
+ * MRCONEE: C1 double group (irreps "A" and "a"), half of the spinors occupied,
+ * canonical Fock matrix with small off-diagonal elements within irreps.
+ */
+static int write_mrconee(gen_options_t *opt)
+{
+    unf_file_t *file = open_output(opt, "MRCONEE");
+    if (file == NULL) {
+        return EXIT_FAILURE;
+    }
+
+    int num_spinors = 2 * opt->nkr;
+    int num_irreps = 2;
+    int num_occ = 2 * (opt->nkr / 2);
+    double enuc = 9.123456789;
+    double scf_energy = -100.987654321;
+    char repnames[14];
+    char repanames[8];
+    memset(repnames, ' ', sizeof(repnames));
+    repnames[0] = 'A';
+    memcpy(repanames, "   A   a", 8);
+
+    /*
+     * records 1-4: header, fermion irreps, irreps of the Abelian subgroup, multiplication table
+     */
+    if (opt->int_size == 4) {
+        int32_t multb[4] = {2, 1, 1, 2};
+        int32_t nactive[1] = {num_occ};
+        int32_t nstr[1] = {num_spinors};
+        int32_t zero[1] = {0};
+
+        unf_write(file, "2i4,r8,4i4,r8", (int32_t) num_spinors, (int32_t) 0, enuc, (int32_t) 1,
+                  (int32_t) opt->group_arith, (int32_t) 0, (int32_t) num_spinors, scf_energy);
+        unf_write(file, "i4,c14[i4],6i4[i4]", (int32_t) 1, repnames, (int32_t) 1, nactive, (int32_t) 1,
+                  nstr, (int32_t) 1, zero, (int32_t) 1, zero, (int32_t) 1, zero, (int32_t) 1, zero, (int32_t) 1);
+        unf_write(file, "i4,c4[i4]", (int32_t) 1, repanames, (int32_t) num_irreps);
+        unf_write(file, "i4[i4]", multb, (int32_t) (num_irreps * num_irreps));
+    }
+    else {
+        int64_t multb[4] = {2, 1, 1, 2};
+        int64_t nactive[1] = {num_occ};
+        int64_t nstr[1] = {num_spinors};
+        int64_t zero[1] = {0};
+
+        unf_write(file, "2i8,r8,4i8,r8", (int64_t) num_spinors, (int64_t) 0, enuc, (int64_t) 1,
+                  (int64_t) opt->group_arith, (int64_t) 0, (int64_t) num_spinors, scf_energy);
+        unf_write(file, "i8,c14[i4],6i8[i4]", (int64_t) 1, repnames, (int32_t) 1, nactive, (int32_t) 1,
+                  nstr, (int32_t) 1, zero, (int32_t) 1, zero, (int32_t) 1, zero, (int32_t) 1, zero, (int32_t) 1);
+        unf_write(file, "i8,c4[i4]", (int64_t) 1, repanames, (int32_t) num_irreps);
+        unf_write(file, "i8[i4]", multb, (int32_t) (num_irreps * num_irreps));
+    }
+
+    /*
+     * record 5: spinor info (fermion irrep, Abelian irrep, energy), raw bytes
+     */
+    int element_size = 2 * opt->int_size + sizeof(double);
+    char *spinor_info = (char *) malloc((size_t) num_spinors * element_size);
+    double *energies = (double *) malloc(num_spinors * sizeof(double));
+    double _Complex *fock = (double _Complex *) calloc((size_t) num_spinors * num_spinors, sizeof(double _Complex));
+    if (spinor_info == NULL || energies == NULL || fock == NULL) {
+        unf_close(file);
+        free(spinor_info);
+        free(energies);
+        free(fock);
+        errno = ENOMEM;
+        return EXIT_FAILURE;
+    }
+    for (int i = 0; i < num_spinors; i++) {
+        char *p = spinor_info + (size_t) element_size * i;
+        energies[i] = -10.0 + 20.0 * i / num_spinors;
+        if (opt->int_size == 4) {
+            int32_t irreps[2] = {1, 1 + i % 2};
+            if (opt->swap_bytes) {
+                unf_byte_swap(irreps, 2, sizeof(int32_t));
+            }
+            memcpy(p, irreps, sizeof(irreps));
+        }
+        else {
+            int64_t irreps[2] = {1, 1 + i % 2};
+            if (opt->swap_bytes) {
+                unf_byte_swap(irreps, 2, sizeof(int64_t));
+            }
+            memcpy(p, irreps, sizeof(irreps));
+        }
+        double energy = energies[i];
+        if (opt->swap_bytes) {
+            unf_byte_swap(&energy, 1, sizeof(double));
+        }
+        memcpy(p + 2 * opt->int_size, &energy, sizeof(double));
+    }
+    unf_write(file, "c[i4]", spinor_info, (int32_t) (num_spinors * element_size));
+
+    /*
+     * record 6: Fock matrix
+     */
+    for (int i = 0; i < num_spinors; i++) {
+        for (int j = 0; j < num_spinors; j++) {
+            if (i == j) {
+                fock[(size_t) i * num_spinors + j] = energies[i];
+            }
+            else if (i % 2 == j % 2) {
+                fock[(size_t) i * num_spinors + j] = 1e-10 * ((i + j) % 7);
+            }
+        }
+    }
+    unf_write(file, "z8[i4]", fock, (int32_t) (num_spinors * num_spinors));
+
+    int status = unf_error(file) ? EXIT_FAILURE : EXIT_SUCCESS;
+
+    unf_close(file);
+    free(spinor_info);
+    free(energies);
+    free(fock);
+
+    return status;
+}
+
+
+/**
+ * MDCINT: date, Kramers pairs, then records (ikr, jkr, nonzr, indices, values)
+ * for ikr = 1..nkr, jkr = -ikr..ikr (jkr != 0), terminated by the (0, 0, 0) record.
+ * All indices are Kramers pair indices, negative for the barred spinors.
+ */
+static int write_mdcint(gen_options_t *opt)
+{
+    unf_file_t *file = open_output(opt, "MDCINT");
+    if (file == NULL) {
+        return EXIT_FAILURE;
+    }
+
+    int nkr = opt->nkr;
+    int num_spinors = 2 * nkr;
+    int64_t max_nonzr = (int64_t) num_spinors * num_spinors;
+    int is_real = opt->group_arith == 1;
+    char *date_time = "01Jan2024 12:00:00";
+
+    int64_t *kr = (int64_t *) malloc(num_spinors * sizeof(int64_t));
+    int32_t *kr_4 = (int32_t *) malloc(num_spinors * sizeof(int32_t));
+    int32_t *ind = (int32_t *) malloc(2 * max_nonzr * sizeof(int32_t));
+    int64_t *ind_8 = (int64_t *) malloc(2 * max_nonzr * sizeof(int64_t));
+    double _Complex *val = (double _Complex *) malloc(max_nonzr * sizeof(double _Complex));
+    if (kr == NULL || kr_4 == NULL || ind == NULL || ind_8 == NULL || val == NULL) {
+        unf_close(file);
+        free(kr);
+        free(kr_4);
+        free(ind);
+        free(ind_8);
+        free(val);
+        errno = ENOMEM;
+        return EXIT_FAILURE;
+    }
+    for (int i = 0; i < num_spinors; i++) {
+        kr[i] = i + 1;
+        kr_4[i] = i + 1;
+    }
+
+    if (opt->int_size == 4) {
+        unf_write(file, "c18,i4,i4[i4]", date_time, (int32_t) nkr, kr_4, (int32_t) num_spinors);
+    }
+    else {
+        unf_write(file, "c18,i8,i8[i4]", date_time, (int64_t) nkr, kr, (int32_t) num_spinors);
+    }
+
+    for (int ikr = 1; ikr <= nkr; ikr++) {
+        for (int jkr = -ikr; jkr <= ikr; jkr++) {
+            if (jkr == 0) {
+                continue;
+            }
+
+            int32_t nonzr = 0;
+            for (int k = -nkr; k <= nkr; k++) {
+                for (int l = -nkr; l <= nkr; l++) {
+                    if (k == 0 || l == 0 || rng_uniform(0.0, 1.0) >= opt->fill) {
+                        continue;
+                    }
+                    ind[2 * nonzr] = k;
+                    ind[2 * nonzr + 1] = l;
+                    ind_8[2 * nonzr] = k;
+                    ind_8[2 * nonzr + 1] = l;
+                    double re = rng_uniform(-1.0, 1.0);
+                    double im = is_real ? 0.0 : rng_uniform(-1.0, 1.0);
+                    if (is_real) {
+                        ((double *) val)[nonzr] = re;
+                    }
+                    else {
+                        val[nonzr] = re + im * _Complex_I;
+                    }
+                    nonzr++;
+                }
+            }
+            if (nonzr == 0) {
+                continue;
+            }
+
+            if (opt->int_size == 4 && is_real) {
+                unf_write(file, "3i4,i4[i4],r8[i4]", (int32_t) ikr, (int32_t) jkr, nonzr,
+                          ind, 2 * nonzr, (double *) val, nonzr);
+            }
+            else if (opt->int_size == 4) {
+                unf_write(file, "3i4,i4[i4],z8[i4]", (int32_t) ikr, (int32_t) jkr, nonzr,
+                          ind, 2 * nonzr, val, nonzr);
+            }
+            else if (is_real) {
+                unf_write(file, "3i8,i8[i4],r8[i4]", (int64_t) ikr, (int64_t) jkr, (int64_t) nonzr,
+                          ind_8, 2 * nonzr, (double *) val, nonzr);
+            }
+            else {
+                unf_write(file, "3i8,i8[i4],z8[i4]", (int64_t) ikr, (int64_t) jkr, (int64_t) nonzr,
+                          ind_8, 2 * nonzr, val, nonzr);
+            }
+        }
+    }
+
+    // end of file
+    if (opt->int_size == 4) {
+        unf_write(file, "3i4", (int32_t) 0, (int32_t) 0, (int32_t) 0);
+    }
+    else {
+        unf_write(file, "3i8", (int64_t) 0, (int64_t) 0, (int64_t) 0);
+    }
+
+    int status = unf_error(file) ? EXIT_FAILURE : EXIT_SUCCESS;
+
+    unf_close(file);
+    free(kr);
+    free(kr_4);
+    free(ind);
+    free(ind_8);
+    free(val);
+
+    return status;
+}
+
+
+/**
+ * MDPROP: for each operator, 32-byte label (name in the last 8 characters)
+ * and the complex matrix; terminated by the EOFLABEL label.
+ */
+static int write_mdprop(gen_options_t *opt)
+{
+    unf_file_t *file = open_output(opt, "MDPROP");
+    if (file == NULL) {
+        return EXIT_FAILURE;
+    }
+
+    int num_spinors = 2 * opt->nkr;
+    double _Complex *matrix = (double _Complex *) malloc((size_t) num_spinors * num_spinors * sizeof(double _Complex));
+    if (matrix == NULL) {
+        unf_close(file);
+        errno = ENOMEM;
+        return EXIT_FAILURE;
+    }
+
+    for (int iprop = 0; iprop < opt->num_props; iprop++) {
+        char label[33];
+        snprintf(label, sizeof(label), "%24sPROP%-4u", "", (unsigned) (iprop + 1) % (GEN_MAX_PROPS + 1));
+
+        // real symmetric operators coupling different irreps, imaginary antisymmetric ones otherwise
+        for (int i = 0; i < num_spinors; i++) {
+            for (int j = 0; j < num_spinors; j++) {
+                double x = 0.01 * (i + j + 1) / (iprop + 1);
+                if (iprop % 2 == 0) {
+                    matrix[(size_t) i * num_spinors + j] = (i + j) % 2 ? x : 0.0;
+                }
+                else {
+                    matrix[(size_t) i * num_spinors + j] = (i % 2 == j % 2) ? (i - j) * x * _Complex_I : 0.0;
+                }
+            }
+        }
+
+        unf_write(file, "c32", label);
+        unf_write(file, "z8[i4]", matrix, (int32_t) (num_spinors * num_spinors));
+    }
+
+    char eof_label[33];
+    snprintf(eof_label, sizeof(eof_label), "%24sEOFLABEL", "");
+    unf_write(file, "c32", eof_label);
+
+    int status = unf_error(file) ? EXIT_FAILURE : EXIT_SUCCESS;
+
+    unf_close(file);
+    free(matrix);
+
+    return status;
+}
+
+
+/**
+ * xorshift64 pseudorandom number generator: fast and reproducible.
+ */
+static uint64_t rng_next()
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+
+static double rng_uniform(double a, double b)
+{
+    return a + (b - a) * ((rng_next() >> 11) * (1.0 / 9007199254740992.0));
+}
@@ -0,0 +1,282 @@
+/*
+ * Inspector of DIRAC files containing transformed molecular integrals.
+ *
+ * 2024 Alexander Oleynichenko
+ */
+
+#include "arena.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <unistd.h>
+#define ARENA_USE_MMAP
+#endif
+
+// size of blocks for small objects
+#define ARENA_BLOCK_SIZE (256 * 1024)
+// huge pages are tried for buffers of this size and larger
+#define ARENA_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+struct arena_chunk {
+    arena_chunk_t *next;
+    char *data;      // beginning of the usable memory
+    size_t size;     // size of the usable memory
+    size_t used;     // for blocks of small objects only
+    int is_mapped;   // memory was obtained by mmap() rather than malloc()
+};
+
+static arena_chunk_t *new_small_chunk(size_t size);
+
+static arena_chunk_t *new_large_chunk(size_t size);
+
+static void free_chunk(arena_chunk_t *chunk);
+
+static size_t align_up(size_t size, size_t alignment);
+
+
+/**
+ * Creates an empty arena.
+ * Returns NULL if the memory cannot be allocated.
+ */
+arena_t *arena_new()
+{
+    return (arena_t *) calloc(1, sizeof(arena_t));
+}
+
+
+/**
+ * Releases all memory allocated in the arena and the arena itself.
+ */
+void arena_free(arena_t *arena)
+{
+    if (arena == NULL) {
+        return;
+    }
+
+    arena_chunk_t *chunk = arena->small_chunks;
+    while (chunk) {
+        arena_chunk_t *next = chunk->next;
+        free_chunk(chunk);
+        chunk = next;
+    }
+
+    chunk = arena->large_chunks;
+    while (chunk) {
+        arena_chunk_t *next = chunk->next;
+        free_chunk(chunk);
+        chunk = next;
+    }
+
+    free(arena);
+}
+
+
+/**
+ * Allocates 'size' bytes in the arena. The memory is not initialized;
+ * this is to be used for buffers which are fully overwritten (for example,
+ * by reading from files).
+ * Returns NULL if the memory cannot be allocated.
+ */
+void *arena_alloc(arena_t *arena, size_t size)
+{
+    if (arena == NULL) {
+        return NULL;
+    }
+
+    if (size == 0) {
+        size = 1;
+    }
+    // rounding up to huge pages must not wrap around
+    if (size > SIZE_MAX - ARENA_HUGE_PAGE_SIZE) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    // large buffers are mapped separately
+    if (size >= ARENA_LARGE_SIZE) {
+        arena_chunk_t *chunk = new_large_chunk(size);
+        if (chunk == NULL) {
+            return NULL;
+        }
+        chunk->next = arena->large_chunks;
+        arena->large_chunks = chunk;
+        arena->bytes_allocated += chunk->size;
+        return chunk->data;
+    }
+
+    // small objects: bump allocation in the current block
+    size = align_up(size, ARENA_ALIGNMENT);
+    arena_chunk_t *current = arena->small_chunks;
+    if (current == NULL || current->used + size > current->size) {
+        current = new_small_chunk(size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE);
+        if (current == NULL) {
+            return NULL;
+        }
+        current->next = arena->small_chunks;
+        arena->small_chunks = current;
+        arena->bytes_allocated += current->size;
+    }
+
+    void *ptr = current->data + current->used;
+    current->used += size;
+
+    return ptr;
+}
+
+
+/**
+ * Allocates zero-initialized memory for an array of n elements of size 'size'.
+ * Freshly mapped large buffers are already zeroed by the OS and are not touched.
+ * Returns NULL if the memory cannot be allocated.
+ */
+void *arena_calloc(arena_t *arena, size_t n, size_t size)
+{
+    if (size != 0 && n > SIZE_MAX / size) {
+        return NULL;
+    }
+
+    size_t n_bytes = n * size;
+    void *ptr = arena_alloc(arena, n_bytes);
+    if (ptr == NULL) {
+        return NULL;
+    }
+
+    int is_mapped = n_bytes >= ARENA_LARGE_SIZE && arena->large_chunks->is_mapped;
+    if (!is_mapped) {
+        memset(ptr, 0, n_bytes);
+    }
+
+    return ptr;
+}
+
+
+/**
+ * Returns the large buffer to the system before the whole arena is released.
+ * Small objects cannot be released separately; the call is ignored for them.
+ */
+void arena_release(arena_t *arena, void *ptr)
+{
+    if (arena == NULL || ptr == NULL) {
+        return;
+    }
+
+    arena_chunk_t **link = &arena->large_chunks;
+    while (*link) {
+        arena_chunk_t *chunk = *link;
+        if (chunk->data == ptr) {
+            *link = chunk->next;
+            arena->bytes_allocated -= chunk->size;
+            free_chunk(chunk);
+            return;
+        }
+        link = &chunk->next;
+    }
+}
+
+
+static arena_chunk_t *new_small_chunk(size_t size)
+{
+    arena_chunk_t *chunk = (arena_chunk_t *) malloc(sizeof(arena_chunk_t));
+    if (chunk == NULL) {
+        return NULL;
+    }
+
+    void *data = NULL;
+    if (posix_memalign(&data, ARENA_ALIGNMENT, size) != 0) {
+        free(chunk);
+        return NULL;
+    }
+
+    chunk->next = NULL;
+    chunk->data = (char *) data;
+    chunk->size = size;
+    chunk->used = 0;
+    chunk->is_mapped = 0;
+
+    return chunk;
+}
+
+
+/**
+ * Large buffers: explicit huge pages are tried first (if reserved by the administrator),
+ * then regular pages with the transparent huge pages hint, then malloc().
+ */
+static arena_chunk_t *new_large_chunk(size_t size)
+{
+    arena_chunk_t *chunk = (arena_chunk_t *) malloc(sizeof(arena_chunk_t));
+    if (chunk == NULL) {
+        return NULL;
+    }
+
+    chunk->next = NULL;
+    chunk->used = 0;
+    chunk->data = NULL;
+
+#ifdef ARENA_USE_MMAP
+    void *data = MAP_FAILED;
+
+#ifdef MAP_HUGETLB
+    if (size >= ARENA_HUGE_PAGE_SIZE) {
+        size_t huge_size = align_up(size, ARENA_HUGE_PAGE_SIZE);
+        data = mmap(NULL, huge_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (data != MAP_FAILED) {
+            size = huge_size;
+        }
+    }
+#endif
+
+    if (data == MAP_FAILED) {
+        size = align_up(size, (size_t) sysconf(_SC_PAGESIZE));
+        data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+#ifdef MADV_HUGEPAGE
+        if (data != MAP_FAILED && size >= ARENA_HUGE_PAGE_SIZE) {
+            madvise(data, size, MADV_HUGEPAGE);
+        }
+#endif
+    }
+
+    if (data != MAP_FAILED) {
+        chunk->data = (char *) data;
+        chunk->size = size;
+        chunk->is_mapped = 1;
+        return chunk;
+    }
+#endif
+
+    void *heap_data = NULL;
+    if (posix_memalign(&heap_data, ARENA_ALIGNMENT, size) != 0) {
+        free(chunk);
+        return NULL;
+    }
+    chunk->data = (char *) heap_data;
+    chunk->size = size;
+    chunk->is_mapped = 0;
+
+    return chunk;
+}
+
+
+static void free_chunk(arena_chunk_t *chunk)
+{
+#ifdef ARENA_USE_MMAP
+    if (chunk->is_mapped) {
+        munmap(chunk->data, chunk->size);
+        free(chunk);
+        return;
+    }
+#endif
+
+    free(chunk->data);
+    free(chunk);
+}
+
+
+static size_t align_up(size_t size, size_t alignment)
+{
+    return (size + alignment - 1) / alignment * alignment;
+}
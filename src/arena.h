@@ -0,0 +1,54 @@
+/*
+ * Inspector of DIRAC files containing transformed molecular integrals.
+ *
+ * 2024 Alexander Oleynichenko
+ */
+
+#ifndef DIRAC_INSPECTOR_ARENA_H
+#define DIRAC_INSPECTOR_ARENA_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+
+/*
+ * Arena (region-based) allocator for per-run buffers.
+ *
+ * Small objects are placed one after another into large blocks, so that allocation
+ * is just a pointer increment. Large buffers (>= ARENA_LARGE_SIZE) are mapped
+ * separately and backed by huge pages when possible; they can be returned to the
+ * system before the whole arena is released (see arena_release()).
+ * Everything is freed at once by arena_free().
+ *
+ * All pointers returned are aligned to ARENA_ALIGNMENT bytes.
+ * The arena is not thread-safe.
+ */
+
+#define ARENA_ALIGNMENT 64
+#define ARENA_LARGE_SIZE (1024 * 1024)
+
+typedef struct arena_chunk arena_chunk_t;
+
+typedef struct {
+    arena_chunk_t *small_chunks;  // blocks for small objects, the current one goes first
+    arena_chunk_t *large_chunks;  // separately mapped large buffers
+    size_t bytes_allocated;       // total size of memory requested from the system
+} arena_t;
+
+arena_t *arena_new();
+
+void arena_free(arena_t *arena);
+
+void *arena_alloc(arena_t *arena, size_t size);
+
+void *arena_calloc(arena_t *arena, size_t n, size_t size);
+
+void arena_release(arena_t *arena, void *ptr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DIRAC_INSPECTOR_ARENA_H
@@ -0,0 +1,531 @@
+/*
+ * Inspector of DIRAC files containing transformed molecular integrals.
+ *
+ * Partitioning of two-electron integrals into hole/particle classes.
+ *
+ * 2024 Alexander Oleynichenko
+ */
+
+#include "classes.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "libunf.h"
+#include "mdcint.h"
+#include "mrconee.h"
+#include "util.h"
+
+// number of integrals collected before they are classified
+#define CLASSES_CHUNK_SIZE (1024 * 1024)
+// records collected before they are classified
+#define CLASSES_CHUNK_RECORDS 16384
+#define CLASSES_MAX_PATH_LEN 1024
+// error messages quote at most this many characters of a path
+#define CLASSES_ERROR_PATH_LEN 192
+
+/*
+ * Integral (ij|kl) of MDCINT is <ik|jl> in the Dirac notation. Its class follows
+ * from the occupations of i, j, k, l (bits 3, 2, 1, 0 of the index, 1: occupied).
+ * With two occupied indices: (ov|ov) and (vo|vo) are <oo|vv>; (oo|vv), (vv|oo),
+ * (ov|vo) and (vo|ov) are <ov|ov> and <ov|vo>, which form the ovov class of
+ * antisymmetrized integrals.
+ */
+static const unsigned char class_table[16] = {
+    CLASS_VVVV, CLASS_OVVV, CLASS_OVVV, CLASS_OVOV,
+    CLASS_OVVV, CLASS_OOVV, CLASS_OVOV, CLASS_OOOV,
+    CLASS_OVVV, CLASS_OVOV, CLASS_OOVV, CLASS_OOOV,
+    CLASS_OVOV, CLASS_OOOV, CLASS_OOOV, CLASS_OOOO
+};
+
+static const char *class_names[NUM_INTEGRAL_CLASSES] = {
+    "oooo", "ooov", "oovv", "ovov", "ovvv", "vvvv"
+};
+
+/*
+ * records waiting to be classified (and written)
+ */
+typedef struct {
+    int64_t num_records;
+    int64_t rec_capacity;
+    int32_t *ikr;
+    int32_t *jkr;
+    int32_t *nonzr;
+    int64_t *start;           // position of the first integral of the record
+    int64_t size;             // number of integrals
+    int64_t capacity;
+    int32_t *indk;
+    int32_t *indl;
+    double *values;           // NULL if no files are written
+    unsigned char *classes;
+} classes_chunk_t;
+
+/*
+ * per-class MDCINT files
+ */
+typedef struct {
+    FILE *files[NUM_INTEGRAL_CLASSES];
+    int int_size;
+    int swap_bytes;
+    int n_values;             // 1 for real integrals, 2 for complex ones
+} class_files_t;
+
+static int classify_all(mdcint_iter_t *iter, mrconee_data_t *mrconee_data, classes_chunk_t *chunk,
+                        class_files_t *out, classes_result_t *result);
+
+static int flush_chunk(classes_chunk_t *chunk, const signed char *occ, int nkr, class_files_t *out,
+                       classes_result_t *result);
+
+static int write_class(FILE *file, classes_chunk_t *chunk, int c, class_files_t *out, int64_t *bytes_written);
+
+static int reserve_chunk(classes_chunk_t *chunk, int64_t capacity, int with_values);
+
+static void free_chunk(classes_chunk_t *chunk);
+
+static int open_class_files(char *dir, const mdcint_header_t *header, class_files_t *out, classes_result_t *result);
+
+static int write_record(FILE *file, class_files_t *out, const char *payload, size_t len);
+
+static char *put_int(char *p, int64_t x, class_files_t *out);
+
+
+const char *integral_class_name(integral_class_t c)
+{
+    return c >= 0 && c < NUM_INTEGRAL_CLASSES ? class_names[c] : "unknown";
+}
+
+
+/**
+ * Classifies all integrals of the MDCINT file by occupations of their spinors
+ * (occ_numbers of MRCONEE; Kramers pair indices are mapped to spinors by the
+ * MDCINT header) and counts integrals and bytes of their values per class.
+ * Records are collected by chunks; each chunk is classified by OpenMP threads.
+ *
+ * If 'dir' is not NULL, integrals of each class are also written to the
+ * MDCINT file 'dir/MDCINT_<class>' of the same format (integer size, byte order,
+ * header); records keep their (ikr, jkr) and get only the integrals of the class.
+ * Classes are written by different threads.
+ *
+ * Returns EXIT_SUCCESS or EXIT_FAILURE (with the message in result->error).
+ */
+int classify_integrals(char *mdcint_path, mrconee_data_t *mrconee_data, char *dir, classes_result_t *result)
+{
+    memset(result, 0, sizeof(classes_result_t));
+    double time_start = abs_time();
+
+    mdcint_iter_t *iter = mdcint_iter_open(mdcint_path, mrconee_data);
+    if (iter == NULL) {
+        snprintf(result->error, sizeof(result->error), "cannot open MDCINT file: %s", strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    class_files_t out;
+    memset(&out, 0, sizeof(class_files_t));
+    out.int_size = mrconee_data->dirac_int_size;
+    out.swap_bytes = mrconee_data->swap_bytes;
+    out.n_values = (mrconee_data->group_arith == 1 || mrconee_data->is_spinfree == 1) ? 1 : 2;
+
+    classes_chunk_t chunk;
+    memset(&chunk, 0, sizeof(classes_chunk_t));
+
+    if (reserve_chunk(&chunk, CLASSES_CHUNK_SIZE, dir != NULL) == EXIT_FAILURE) {
+        snprintf(result->error, sizeof(result->error), "%s", strerror(ENOMEM));
+    }
+    else if (dir == NULL || open_class_files(dir, mdcint_iter_header(iter), &out, result) == EXIT_SUCCESS) {
+        classify_all(iter, mrconee_data, &chunk, &out, result);
+    }
+
+    for (int c = 0; c < NUM_INTEGRAL_CLASSES; c++) {
+        if (out.files[c] && fclose(out.files[c]) != 0 && result->error[0] == '\0') {
+            snprintf(result->error, sizeof(result->error), "error while writing MDCINT_%s: %s",
+                     class_names[c], strerror(errno));
+        }
+    }
+
+    mdcint_iter_close(iter);
+    free_chunk(&chunk);
+
+    for (int c = 0; c < NUM_INTEGRAL_CLASSES; c++) {
+        result->value_bytes[c] = result->num_integrals[c] * out.n_values * (int64_t) sizeof(double);
+        result->total_integrals += result->num_integrals[c];
+    }
+    result->time = abs_time() - time_start;
+
+    return result->error[0] == '\0' ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+/*
+ * reads all records by chunks, then writes end marks to the class files
+ */
+static int classify_all(mdcint_iter_t *iter, mrconee_data_t *mrconee_data, classes_chunk_t *chunk,
+                        class_files_t *out, classes_result_t *result)
+{
+    const mdcint_header_t *header = mdcint_iter_header(iter);
+    int nkr = header->nkr;
+
+    // occupation of the spinor by its Kramers pair index kr (-nkr..nkr): 1, 0, or -1 if wrong
+    signed char *occ = (signed char *) malloc(2 * (size_t) nkr + 1);
+    if (occ == NULL) {
+        snprintf(result->error, sizeof(result->error), "%s", strerror(ENOMEM));
+        return EXIT_FAILURE;
+    }
+    occ[nkr] = -1;
+    for (int k = 0; k < nkr; k++) {
+        for (int bar = 0; bar < 2; bar++) {
+            int32_t spinor = header->kramers_pairs[2 * k + bar];
+            signed char o = -1;
+            if (spinor >= 1 && spinor <= mrconee_data->num_spinors) {
+                o = mrconee_data->occ_numbers[spinor - 1] > 0;
+            }
+            occ[nkr + (bar ? -(k + 1) : k + 1)] = o;
+        }
+    }
+
+    mdcint_record_t rec;
+    int status = 0;
+    int err = EXIT_SUCCESS;
+    while (err == EXIT_SUCCESS && (status = mdcint_iter_next(iter, &rec)) == 1) {
+        if (chunk->size + rec.nonzr > chunk->capacity || chunk->num_records == chunk->rec_capacity) {
+            err = flush_chunk(chunk, occ, nkr, out, result);
+            if (err == EXIT_SUCCESS && rec.nonzr > chunk->capacity &&
+                reserve_chunk(chunk, rec.nonzr, chunk->values != NULL) == EXIT_FAILURE) {
+                snprintf(result->error, sizeof(result->error), "%s", strerror(ENOMEM));
+                err = EXIT_FAILURE;
+            }
+            if (err == EXIT_FAILURE) {
+                break;
+            }
+        }
+
+        int64_t n = chunk->num_records++;
+        chunk->ikr[n] = rec.ikr;
+        chunk->jkr[n] = rec.jkr;
+        chunk->nonzr[n] = rec.nonzr;
+        chunk->start[n] = chunk->size;
+        memcpy(chunk->indk + chunk->size, rec.indk, (size_t) rec.nonzr * sizeof(int32_t));
+        memcpy(chunk->indl + chunk->size, rec.indl, (size_t) rec.nonzr * sizeof(int32_t));
+        if (chunk->values) {
+            memcpy(chunk->values + out->n_values * chunk->size, rec.values,
+                   out->n_values * (size_t) rec.nonzr * sizeof(double));
+        }
+        chunk->size += rec.nonzr;
+    }
+
+    if (err == EXIT_SUCCESS && status < 0) {
+        snprintf(result->error, sizeof(result->error), "%s", mdcint_iter_error(iter));
+        err = EXIT_FAILURE;
+    }
+    if (err == EXIT_SUCCESS) {
+        err = flush_chunk(chunk, occ, nkr, out, result);
+    }
+
+    // end marks: ikr = jkr = nonzr = 0
+    char end_mark[3 * sizeof(int64_t)] = {0};
+    for (int c = 0; err == EXIT_SUCCESS && c < NUM_INTEGRAL_CLASSES && out->files[0]; c++) {
+        if (write_record(out->files[c], out, end_mark, 3 * (size_t) out->int_size) == EXIT_FAILURE) {
+            snprintf(result->error, sizeof(result->error), "error while writing MDCINT_%s: %s",
+                     class_names[c], strerror(errno));
+            err = EXIT_FAILURE;
+            break;
+        }
+        result->bytes_written += 3 * out->int_size + 2 * sizeof(int32_t);
+    }
+
+    free(occ);
+
+    return err;
+}
+
+
+/*
+ * classifies integrals of the chunk in parallel, then writes them to the class files
+ * (one thread per class) and empties the chunk
+ */
+static int flush_chunk(classes_chunk_t *chunk, const signed char *occ, int nkr, class_files_t *out,
+                       classes_result_t *result)
+{
+    int64_t counts[NUM_INTEGRAL_CLASSES] = {0};
+    int64_t first_wrong = -1;
+    const signed char *occ_kr = occ + nkr;
+
+    #pragma omp parallel for schedule(dynamic, 16) reduction(+:counts[:NUM_INTEGRAL_CLASSES])
+    for (int64_t r = 0; r < chunk->num_records; r++) {
+        int32_t ikr = chunk->ikr[r];
+        int32_t jkr = chunk->jkr[r];
+        int wrong = ikr < -nkr || ikr > nkr || jkr < -nkr || jkr > nkr;
+        int oi = wrong ? -1 : occ_kr[ikr];
+        int oj = wrong ? -1 : occ_kr[jkr];
+        wrong = oi < 0 || oj < 0;
+
+        const int32_t *indk = chunk->indk + chunk->start[r];
+        const int32_t *indl = chunk->indl + chunk->start[r];
+        unsigned char *classes = chunk->classes + chunk->start[r];
+        int ij = (oi << 3) | (oj << 2);
+
+        for (int32_t inz = 0; inz < chunk->nonzr[r] && !wrong; inz++) {
+            int32_t k = indk[inz];
+            int32_t l = indl[inz];
+            if (k < -nkr || k > nkr || l < -nkr || l > nkr || occ_kr[k] < 0 || occ_kr[l] < 0) {
+                wrong = 1;
+                break;
+            }
+            unsigned char c = class_table[ij | (occ_kr[k] << 1) | occ_kr[l]];
+            classes[inz] = c;
+            counts[c]++;
+        }
+
+        if (wrong) {
+            #pragma omp critical(classes_first_wrong)
+            if (first_wrong < 0 || r < first_wrong) {
+                first_wrong = r;
+            }
+        }
+    }
+
+    if (first_wrong >= 0) {
+        snprintf(result->error, sizeof(result->error), "wrong Kramers pair index in MDCINT record (%d, %d)",
+                 chunk->ikr[first_wrong], chunk->jkr[first_wrong]);
+        return EXIT_FAILURE;
+    }
+
+    for (int c = 0; c < NUM_INTEGRAL_CLASSES; c++) {
+        result->num_integrals[c] += counts[c];
+    }
+
+    if (out->files[0]) {
+        int64_t bytes_written = 0;
+        int failed_class = -1;
+        int write_errno = 0;
+
+        #pragma omp parallel for schedule(dynamic) reduction(+:bytes_written)
+        for (int c = 0; c < NUM_INTEGRAL_CLASSES; c++) {
+            errno = 0;
+            if (counts[c] > 0 && write_class(out->files[c], chunk, c, out, &bytes_written) == EXIT_FAILURE) {
+                #pragma omp critical(classes_write_error)
+                {
+                    failed_class = c;
+                    write_errno = errno;
+                }
+            }
+        }
+
+        result->bytes_written += bytes_written;
+        if (failed_class >= 0) {
+            snprintf(result->error, sizeof(result->error), "error while writing MDCINT_%s: %s",
+                     class_names[failed_class], strerror(write_errno ? write_errno : ENOMEM));
+            return EXIT_FAILURE;
+        }
+    }
+
+    chunk->num_records = 0;
+    chunk->size = 0;
+
+    return EXIT_SUCCESS;
+}
+
+
+/*
+ * writes a record with the integrals of class c for each record of the chunk having them
+ */
+static int write_class(FILE *file, classes_chunk_t *chunk, int c, class_files_t *out, int64_t *bytes_written)
+{
+    int int_size = out->int_size;
+    size_t value_size = out->n_values * sizeof(double);
+
+    // records of the class are not larger than the input ones
+    int32_t max_nonzr = 0;
+    for (int64_t r = 0; r < chunk->num_records; r++) {
+        max_nonzr = chunk->nonzr[r] > max_nonzr ? chunk->nonzr[r] : max_nonzr;
+    }
+    char *payload = (char *) malloc(3 * int_size + (size_t) max_nonzr * (2 * int_size + value_size));
+    if (payload == NULL) {
+        return EXIT_FAILURE;
+    }
+
+    int err = EXIT_SUCCESS;
+    for (int64_t r = 0; r < chunk->num_records && err == EXIT_SUCCESS; r++) {
+        int64_t start = chunk->start[r];
+        const unsigned char *classes = chunk->classes + start;
+
+        int32_t n = 0;
+        for (int32_t inz = 0; inz < chunk->nonzr[r]; inz++) {
+            n += classes[inz] == c;
+        }
+        if (n == 0) {
+            continue;
+        }
+
+        char *p = put_int(payload, chunk->ikr[r], out);
+        p = put_int(p, chunk->jkr[r], out);
+        p = put_int(p, n, out);
+        for (int32_t inz = 0; inz < chunk->nonzr[r]; inz++) {
+            if (classes[inz] == c) {
+                p = put_int(p, chunk->indk[start + inz], out);
+                p = put_int(p, chunk->indl[start + inz], out);
+            }
+        }
+        char *values = p;
+        for (int32_t inz = 0; inz < chunk->nonzr[r]; inz++) {
+            if (classes[inz] == c) {
+                memcpy(p, chunk->values + out->n_values * (start + inz), value_size);
+                p += value_size;
+            }
+        }
+        if (out->swap_bytes) {
+            unf_byte_swap(values, (size_t) n * out->n_values, sizeof(double));
+        }
+
+        size_t len = (size_t) (p - payload);
+        err = write_record(file, out, payload, len);
+        *bytes_written += len + 2 * sizeof(int32_t);
+    }
+
+    free(payload);
+
+    return err;
+}
+
+
+static int reserve_chunk(classes_chunk_t *chunk, int64_t capacity, int with_values)
+{
+    free(chunk->indk);
+    free(chunk->indl);
+    free(chunk->values);
+    free(chunk->classes);
+    chunk->indk = (int32_t *) malloc((size_t) capacity * sizeof(int32_t));
+    chunk->indl = (int32_t *) malloc((size_t) capacity * sizeof(int32_t));
+    chunk->values = with_values ? (double *) malloc(2 * (size_t) capacity * sizeof(double)) : NULL;
+    chunk->classes = (unsigned char *) malloc((size_t) capacity);
+    chunk->capacity = capacity;
+
+    if (chunk->ikr == NULL) {
+        chunk->rec_capacity = CLASSES_CHUNK_RECORDS;
+        chunk->ikr = (int32_t *) malloc(chunk->rec_capacity * sizeof(int32_t));
+        chunk->jkr = (int32_t *) malloc(chunk->rec_capacity * sizeof(int32_t));
+        chunk->nonzr = (int32_t *) malloc(chunk->rec_capacity * sizeof(int32_t));
+        chunk->start = (int64_t *) malloc(chunk->rec_capacity * sizeof(int64_t));
+    }
+
+    if (chunk->indk == NULL || chunk->indl == NULL || (with_values && chunk->values == NULL) ||
+        chunk->classes == NULL || chunk->ikr == NULL || chunk->jkr == NULL || chunk->nonzr == NULL ||
+        chunk->start == NULL) {
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+
+static void free_chunk(classes_chunk_t *chunk)
+{
+    free(chunk->ikr);
+    free(chunk->jkr);
+    free(chunk->nonzr);
+    free(chunk->start);
+    free(chunk->indk);
+    free(chunk->indl);
+    free(chunk->values);
+    free(chunk->classes);
+}
+
+
+/*
+ * creates the files MDCINT_<class> and writes the header of MDCINT to each of them
+ */
+static int open_class_files(char *dir, const mdcint_header_t *header, class_files_t *out, classes_result_t *result)
+{
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+        snprintf(result->error, sizeof(result->error), "cannot create directory %s: %s", dir, strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    // date and time, nkr, Kramers pairs
+    size_t len = 18 + (1 + 2 * (size_t) header->nkr) * out->int_size;
+    char *payload = (char *) malloc(len);
+    if (payload == NULL) {
+        snprintf(result->error, sizeof(result->error), "%s", strerror(ENOMEM));
+        return EXIT_FAILURE;
+    }
+    memcpy(payload, header->date_time, 18);
+    char *p = put_int(payload + 18, header->nkr, out);
+    for (int i = 0; i < 2 * header->nkr; i++) {
+        p = put_int(p, header->kramers_pairs[i], out);
+    }
+
+    for (int c = 0; c < NUM_INTEGRAL_CLASSES; c++) {
+        char path[CLASSES_MAX_PATH_LEN];
+        snprintf(path, sizeof(path), "%s/MDCINT_%s", dir, class_names[c]);
+        out->files[c] = fopen(path, "wb");
+        if (out->files[c] == NULL) {
+            snprintf(result->error, sizeof(result->error), "cannot open %.*s: %s",
+                     CLASSES_ERROR_PATH_LEN, path, strerror(errno));
+            break;
+        }
+        if (write_record(out->files[c], out, payload, len) == EXIT_FAILURE) {
+            snprintf(result->error, sizeof(result->error), "error while writing %.*s: %s",
+                     CLASSES_ERROR_PATH_LEN, path, strerror(errno));
+            break;
+        }
+        result->bytes_written += len + 2 * sizeof(int32_t);
+    }
+
+    free(payload);
+
+    if (result->error[0] != '\0') {
+        for (int c = 0; c < NUM_INTEGRAL_CLASSES; c++) {
+            if (out->files[c]) {
+                fclose(out->files[c]);
+                out->files[c] = NULL;
+            }
+        }
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+
+/*
+ * writes the record with markers in the byte order of the file
+ */
+static int write_record(FILE *file, class_files_t *out, const char *payload, size_t len)
+{
+    int32_t marker = (int32_t) len;
+    if (out->swap_bytes) {
+        unf_byte_swap(&marker, 1, sizeof(int32_t));
+    }
+
+    if (fwrite(&marker, sizeof(int32_t), 1, file) != 1 ||
+        fwrite(payload, 1, len, file) != len ||
+        fwrite(&marker, sizeof(int32_t), 1, file) != 1) {
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+
+/*
+ * stores the integer of the file (4 or 8 bytes, byte order of the file), returns the next position
+ */
+static char *put_int(char *p, int64_t x, class_files_t *out)
+{
+    if (out->int_size == 4) {
+        int32_t x_4 = (int32_t) x;
+        if (out->swap_bytes) {
+            unf_byte_swap(&x_4, 1, sizeof(int32_t));
+        }
+        memcpy(p, &x_4, sizeof(int32_t));
+        return p + sizeof(int32_t);
+    }
+
+    if (out->swap_bytes) {
+        unf_byte_swap(&x, 1, sizeof(int64_t));
+    }
+    memcpy(p, &x, sizeof(int64_t));
+    return p + sizeof(int64_t);
+}
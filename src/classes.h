@@ -0,0 +1,52 @@
+/*
+ * Inspector of DIRAC files containing transformed molecular integrals.
+ *
+ * 2024 Alexander Oleynichenko
+ */
+
+#ifndef DIRAC_INSPECTOR_CLASSES_H
+#define DIRAC_INSPECTOR_CLASSES_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "mrconee.h"
+
+/*
+ * hole/particle classes of two-electron integrals <pq|rs> = (pr|qs),
+ * o: occupied spinor, v: virtual spinor
+ */
+typedef enum {
+    CLASS_OOOO,
+    CLASS_OOOV,
+    CLASS_OOVV,
+    CLASS_OVOV,
+    CLASS_OVVV,
+    CLASS_VVVV,
+    NUM_INTEGRAL_CLASSES
+} integral_class_t;
+
+/*
+ * summary of the classification, see classify_integrals()
+ */
+typedef struct {
+    int64_t num_integrals[NUM_INTEGRAL_CLASSES];
+    int64_t value_bytes[NUM_INTEGRAL_CLASSES];  // memory for the values of integrals
+    int64_t total_integrals;
+    int64_t bytes_written;      // zero if no files are written
+    double time;                // seconds
+    char error[256];            // empty string if succeeded
+} classes_result_t;
+
+const char *integral_class_name(integral_class_t c);
+
+int classify_integrals(char *mdcint_path, mrconee_data_t *mrconee_data, char *dir, classes_result_t *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DIRAC_INSPECTOR_CLASSES_H
@@ -0,0 +1,769 @@
+/*
+ * Inspector of DIRAC files containing transformed molecular integrals.
+ *
+ * Conversion of DIRAC files between 4-byte and 8-byte integers
+ * and from complex to real arithmetic.
+ *
+ * 2024 Alexander Oleynichenko
+ */
+
+#include "convert.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "libunf.h"
+#include "mdcint.h"
+#include "mrconee.h"
+#include "util.h"
+
+// size of the buffer for records read at once, in bytes
+#define CONVERT_BUFFER_SIZE (64 * 1024 * 1024)
+// max number of records read at once
+#define CONVERT_MAX_RECORDS 65536
+// integers are converted by pieces of this length
+#define CONVERT_CHUNK_LEN 1024
+#define CONVERT_MAX_PATH_LEN 1024
+// paths quoted in error messages are cut to this length (to a half of it next to
+// another path or a long text) to fit result->error
+#define CONVERT_ERROR_PATH_LEN 192
+#define CONVERT_MAX_SPANS 2
+// MRCONEE, MDPROP and MDCINT
+#define CONVERT_MAX_FILES 3
+
+/*
+ * Layout of the record: the sequence of spans is repeated num_repeats times,
+ * each span consists of n_ints DIRAC integers followed by n_raw bytes
+ * (characters and real numbers) which are copied as they are and by
+ * n_complex complex integrals (converted to real ones if requested).
+ */
+typedef struct {
+    int32_t n_ints;
+    int32_t n_raw;
+    int32_t n_complex;
+} span_t;
+
+typedef struct {
+    int num_spans;
+    int32_t num_repeats;
+    span_t spans[CONVERT_MAX_SPANS];
+} record_layout_t;
+
+typedef struct converter converter_t;
+
+typedef int (*layout_func_t)(converter_t *conv, int64_t rec, const char *payload, int32_t len,
+                             record_layout_t *layout);
+
+// modifies the converted record
+typedef void (*patch_func_t)(converter_t *conv, int64_t rec, char *payload);
+
+struct converter {
+    int from_size;
+    int to_size;
+    int swap_bytes;
+    int is_real;            // integrals in MDCINT are real
+    int to_real;            // complex integrals are converted to real ones
+    double imag_threshold;  // max imaginary part allowed for conversion to real
+    layout_func_t layout;
+    patch_func_t patch;     // NULL if not needed
+};
+
+static int convert_files(char *dir, int int_size, int to_real, double imag_threshold,
+                         mrconee_data_t *mrconee_data, char *mrconee_path, char *mdprop_path,
+                         char *mdcint_path, convert_result_t *result);
+
+static int convert_file(converter_t *conv, char *in_path, char *dir, char *out_path, convert_result_t *result);
+
+static int convert_batch(converter_t *conv, char *in_buf, int n_records, size_t *offsets, int32_t *lengths,
+                         record_layout_t *layouts, char **out_buf, size_t *out_capacity, size_t *out_size,
+                         int64_t first_rec, char *path, convert_result_t *result);
+
+static int64_t convert_record(converter_t *conv, const record_layout_t *layout, char *src, char *dst,
+                              int64_t *n_imag, double *max_imag);
+
+static int64_t convert_ints(converter_t *conv, char *src, int64_t n, char *dst);
+
+static int64_t convert_complex(converter_t *conv, char *src, int64_t n, char *dst, double *max_imag);
+
+static int64_t output_length(converter_t *conv, const record_layout_t *layout, int32_t len);
+
+static int64_t read_int(converter_t *conv, const char *p);
+
+static void set_layout(record_layout_t *layout, int32_t num_repeats, int32_t n_ints_1, int32_t n_raw_1,
+                       int32_t n_ints_2, int32_t n_raw_2);
+
+static int mrconee_layout(converter_t *conv, int64_t rec, const char *payload, int32_t len, record_layout_t *layout);
+
+static int mdcint_layout(converter_t *conv, int64_t rec, const char *payload, int32_t len, record_layout_t *layout);
+
+static int mdprop_layout(converter_t *conv, int64_t rec, const char *payload, int32_t len, record_layout_t *layout);
+
+static void mrconee_set_real_arith(converter_t *conv, int64_t rec, char *payload);
+
+
+
+/**
+ * Rewrites MRCONEE, MDPROP and MDCINT files with integers of the given size
+ * (4 or 8 bytes) into the directory 'dir'; file names are kept, so that MDCINTXX
+ * fragments can be converted one by one. The byte order is not changed.
+ *
+ * Every integer is range-checked when converted to 4 bytes. Files are streamed
+ * by large batches of records; records of each batch are converted by OpenMP
+ * threads in parallel and written at once.
+ * MDPROP contains no integers and is copied record by record.
+ * MDPROP or MDCINT is not converted if its path is NULL.
+ * If any file fails to convert, the files already written are removed.
+ *
+ * Returns EXIT_SUCCESS or EXIT_FAILURE (with the message in result->error).
+ */
+int convert_int_size(char *dir, int int_size, mrconee_data_t *mrconee_data, char *mrconee_path,
+                     char *mdprop_path, char *mdcint_path, convert_result_t *result)
+{
+    if (int_size == mrconee_data->dirac_int_size) {
+        memset(result, 0, sizeof(convert_result_t));
+        snprintf(result->error, sizeof(result->error), "files already contain %d-byte integers", int_size);
+        return EXIT_FAILURE;
+    }
+
+    return convert_files(dir, int_size, 0, 0.0, mrconee_data, mrconee_path, mdprop_path, mdcint_path, result);
+}
+
+
+/**
+ * Rewrites the files as convert_int_size() does (int_size may be equal to the
+ * current size), with complex two-electron integrals replaced by their real parts.
+ * The conversion fails if any imaginary part exceeds imag_threshold in absolute
+ * value; the largest one is returned in result->max_imag.
+ * The group arithmetic in MRCONEE is set to real, so that MDCINT is read
+ * as the file of real integrals; MDPROP and the Fock matrix stay complex,
+ * as DIRAC writes them for any group. MDCINT is converted first, and the other
+ * files are not written if the conversion fails.
+ */
+int convert_to_real(char *dir, int int_size, double imag_threshold, mrconee_data_t *mrconee_data,
+                    char *mrconee_path, char *mdprop_path, char *mdcint_path, convert_result_t *result)
+{
+    if (mrconee_data->group_arith == 1 || mrconee_data->is_spinfree == 1) {
+        memset(result, 0, sizeof(convert_result_t));
+        snprintf(result->error, sizeof(result->error), "integrals are already real");
+        return EXIT_FAILURE;
+    }
+
+    return convert_files(dir, int_size, 1, imag_threshold, mrconee_data, mrconee_path, mdprop_path,
+                         mdcint_path, result);
+}
+
+
+static int convert_files(char *dir, int int_size, int to_real, double imag_threshold,
+                         mrconee_data_t *mrconee_data, char *mrconee_path, char *mdprop_path,
+                         char *mdcint_path, convert_result_t *result)
+{
+    memset(result, 0, sizeof(convert_result_t));
+    double time_start = abs_time();
+
+    result->from_int_size = mrconee_data->dirac_int_size;
+    result->to_int_size = int_size;
+    result->to_real = to_real;
+
+    if (int_size != 4 && int_size != 8) {
+        snprintf(result->error, sizeof(result->error), "wrong size of integers: %d", int_size);
+        return EXIT_FAILURE;
+    }
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+        snprintf(result->error, sizeof(result->error), "cannot create directory %.*s: %s",
+                 CONVERT_ERROR_PATH_LEN, dir, strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    converter_t conv;
+    conv.from_size = mrconee_data->dirac_int_size;
+    conv.to_size = int_size;
+    conv.swap_bytes = mrconee_data->swap_bytes;
+    conv.is_real = mrconee_data->group_arith == 1 || mrconee_data->is_spinfree == 1;
+    conv.to_real = to_real;
+    conv.imag_threshold = imag_threshold;
+
+    char out_paths[CONVERT_MAX_FILES][CONVERT_MAX_PATH_LEN];
+    int num_written = 0;
+    int status = EXIT_SUCCESS;
+
+    // imaginary parts are checked while MDCINT is converted: it goes first,
+    // so that nothing else is written if they are too large
+    int mdcint_first = to_real && mdcint_path;
+    if (mdcint_first) {
+        conv.layout = mdcint_layout;
+        conv.patch = NULL;
+        status = convert_file(&conv, mdcint_path, dir, out_paths[num_written], result);
+        num_written += status == EXIT_SUCCESS;
+    }
+    if (status == EXIT_SUCCESS) {
+        conv.layout = mrconee_layout;
+        conv.patch = to_real ? mrconee_set_real_arith : NULL;
+        status = convert_file(&conv, mrconee_path, dir, out_paths[num_written], result);
+        num_written += status == EXIT_SUCCESS;
+        conv.patch = NULL;
+    }
+    if (status == EXIT_SUCCESS && mdprop_path) {
+        conv.layout = mdprop_layout;
+        status = convert_file(&conv, mdprop_path, dir, out_paths[num_written], result);
+        num_written += status == EXIT_SUCCESS;
+    }
+    if (status == EXIT_SUCCESS && mdcint_path && !mdcint_first) {
+        conv.layout = mdcint_layout;
+        status = convert_file(&conv, mdcint_path, dir, out_paths[num_written], result);
+        num_written += status == EXIT_SUCCESS;
+    }
+
+    // the output directory must not be left with a mix of converted and missing or truncated files
+    if (status == EXIT_FAILURE) {
+        for (int i = 0; i < num_written; i++) {
+            remove(out_paths[i]);
+        }
+    }
+
+    result->time = abs_time() - time_start;
+
+    return status;
+}
+
+
+/*
+ * converts the file record by record, batch by batch;
+ * the output file of the same name is placed in 'dir', its path is returned in out_path
+ * (of CONVERT_MAX_PATH_LEN characters). The output is removed if the conversion fails.
+ */
+static int convert_file(converter_t *conv, char *in_path, char *dir, char *out_path, convert_result_t *result)
+{
+    char *name = strrchr(in_path, '/');
+    name = name ? name + 1 : in_path;
+    if (snprintf(out_path, CONVERT_MAX_PATH_LEN, "%s/%s", dir, name) >= CONVERT_MAX_PATH_LEN) {
+        snprintf(result->error, sizeof(result->error), "path is too long: %.*s/%.*s",
+                 CONVERT_ERROR_PATH_LEN / 2, dir, CONVERT_ERROR_PATH_LEN / 2, name);
+        return EXIT_FAILURE;
+    }
+    if (unf_same_file(in_path, out_path)) {
+        snprintf(result->error, sizeof(result->error), "%.*s would be overwritten",
+                 CONVERT_ERROR_PATH_LEN, in_path);
+        return EXIT_FAILURE;
+    }
+
+    unf_file_t *in = unf_open(in_path, "r", UNF_ACCESS_SEQUENTIAL);
+    if (in == NULL) {
+        snprintf(result->error, sizeof(result->error), "cannot open %.*s: %s",
+                 CONVERT_ERROR_PATH_LEN, in_path, strerror(errno));
+        return EXIT_FAILURE;
+    }
+    unf_set_byte_order(in, conv->swap_bytes ? UNF_BYTE_ORDER_SWAPPED : UNF_BYTE_ORDER_NATIVE);
+
+    FILE *out = fopen(out_path, "wb");
+    if (out == NULL) {
+        snprintf(result->error, sizeof(result->error), "cannot open %.*s: %s",
+                 CONVERT_ERROR_PATH_LEN, out_path, strerror(errno));
+        unf_close(in);
+        return EXIT_FAILURE;
+    }
+
+    size_t in_size = CONVERT_BUFFER_SIZE;
+    size_t n_carry = 0;
+    char *in_buf = (char *) malloc(in_size);
+    size_t *offsets = (size_t *) malloc(CONVERT_MAX_RECORDS * sizeof(size_t));
+    int32_t *lengths = (int32_t *) malloc(CONVERT_MAX_RECORDS * sizeof(int32_t));
+    record_layout_t *layouts = (record_layout_t *) malloc(CONVERT_MAX_RECORDS * sizeof(record_layout_t));
+    char *out_buf = NULL;
+    size_t out_capacity = 0;
+    int64_t n_records = 0;
+
+    if (in_buf == NULL || offsets == NULL || lengths == NULL || layouts == NULL) {
+        snprintf(result->error, sizeof(result->error), "%s", strerror(ENOMEM));
+    }
+
+    while (result->error[0] == '\0') {
+        errno = 0;
+        int n_batch = unf_read_batch(in, in_buf, in_size, &n_carry, CONVERT_MAX_RECORDS, offsets, lengths);
+
+        if (n_batch == 0 && errno == ENOBUFS && !unf_error(in)) {
+            // the next record does not fit into the buffer; its beginning is moved to the new buffer
+            size_t new_size = (size_t) lengths[0] + 2 * sizeof(int32_t);
+            char *new_buf = (char *) malloc(new_size);
+            if (new_buf == NULL) {
+                snprintf(result->error, sizeof(result->error), "%s", strerror(ENOMEM));
+                continue;
+            }
+            memcpy(new_buf + new_size - n_carry, in_buf + in_size - n_carry, n_carry);
+            free(in_buf);
+            in_buf = new_buf;
+            in_size = new_size;
+            continue;
+        }
+        if (unf_error(in)) {
+            snprintf(result->error, sizeof(result->error), "error while reading %.*s: %s",
+                     CONVERT_ERROR_PATH_LEN, in_path, errno ? strerror(errno) : "unexpected end of file");
+            break;
+        }
+        if (n_batch == 0) {
+            break;
+        }
+
+        for (int i = 0; i < n_batch; i++) {
+            result->bytes_read += (int64_t) lengths[i] + 2 * (int64_t) sizeof(int32_t);
+        }
+
+        size_t out_size = 0;
+        if (convert_batch(conv, in_buf, n_batch, offsets, lengths, layouts, &out_buf, &out_capacity, &out_size,
+                          n_records, in_path, result) == EXIT_FAILURE) {
+            break;
+        }
+        if (fwrite(out_buf, 1, out_size, out) != out_size) {
+            snprintf(result->error, sizeof(result->error), "error while writing %.*s: %s",
+                     CONVERT_ERROR_PATH_LEN, out_path, strerror(errno));
+            break;
+        }
+
+        n_records += n_batch;
+        result->num_records += n_batch;
+        result->bytes_written += (int64_t) out_size;
+    }
+
+    if (fclose(out) != 0 && result->error[0] == '\0') {
+        snprintf(result->error, sizeof(result->error), "error while writing %.*s: %s",
+                 CONVERT_ERROR_PATH_LEN, out_path, strerror(errno));
+    }
+    unf_close(in);
+    free(in_buf);
+    free(offsets);
+    free(lengths);
+    free(layouts);
+    free(out_buf);
+
+    if (result->error[0] != '\0') {
+        remove(out_path);
+        return EXIT_FAILURE;
+    }
+
+    result->num_files++;
+
+    return EXIT_SUCCESS;
+}
+
+
+/*
+ * Finds layouts and output positions of the records of the batch (serially),
+ * then converts the records in parallel. The output (with record markers) is
+ * assembled in out_buf, which grows as needed.
+ */
+static int convert_batch(converter_t *conv, char *in_buf, int n_records, size_t *offsets, int32_t *lengths,
+                         record_layout_t *layouts, char **out_buf, size_t *out_capacity, size_t *out_size,
+                         int64_t first_rec, char *path, convert_result_t *result)
+{
+    // 'offsets' and 'lengths' are overwritten with those of the output records
+    size_t *in_offsets = (size_t *) malloc(n_records * sizeof(size_t));
+    if (in_offsets == NULL) {
+        snprintf(result->error, sizeof(result->error), "%s", strerror(ENOMEM));
+        return EXIT_FAILURE;
+    }
+
+    size_t total = 0;
+    for (int i = 0; i < n_records; i++) {
+        in_offsets[i] = offsets[i];
+        if (conv->layout(conv, first_rec + i, in_buf + offsets[i], lengths[i], &layouts[i]) == EXIT_FAILURE) {
+            snprintf(result->error, sizeof(result->error), "unexpected layout of record %lld of %.*s",
+                     (long long) (first_rec + i + 1), CONVERT_ERROR_PATH_LEN, path);
+            free(in_offsets);
+            return EXIT_FAILURE;
+        }
+        int64_t out_len = output_length(conv, &layouts[i], lengths[i]);
+        if (out_len > INT32_MAX) {
+            snprintf(result->error, sizeof(result->error), "record %lld of %.*s is too large",
+                     (long long) (first_rec + i + 1), CONVERT_ERROR_PATH_LEN, path);
+            free(in_offsets);
+            return EXIT_FAILURE;
+        }
+        offsets[i] = total;
+        lengths[i] = (int32_t) out_len;
+        total += (size_t) out_len + 2 * sizeof(int32_t);
+    }
+
+    if (total > *out_capacity) {
+        free(*out_buf);
+        *out_capacity = total > 2 * *out_capacity ? total : 2 * *out_capacity;
+        *out_buf = (char *) malloc(*out_capacity);
+        if (*out_buf == NULL) {
+            *out_capacity = 0;
+            snprintf(result->error, sizeof(result->error), "%s", strerror(ENOMEM));
+            free(in_offsets);
+            return EXIT_FAILURE;
+        }
+    }
+
+    char *out = *out_buf;
+    int64_t n_overflow = 0;
+    int64_t n_imag = 0;
+    double max_imag = 0.0;
+    int64_t first_bad = -1;
+
+    #pragma omp parallel for schedule(dynamic) reduction(+:n_overflow,n_imag) reduction(max:max_imag)
+    for (int i = 0; i < n_records; i++) {
+        char *dst = out + offsets[i];
+
+        int32_t marker = lengths[i];
+        if (conv->swap_bytes) {
+            unf_byte_swap(&marker, 1, sizeof(int32_t));
+        }
+        memcpy(dst, &marker, sizeof(int32_t));
+        memcpy(dst + sizeof(int32_t) + lengths[i], &marker, sizeof(int32_t));
+
+        int64_t n_rec_imag = 0;
+        double rec_max_imag = 0.0;
+        int64_t n = convert_record(conv, &layouts[i], in_buf + in_offsets[i], dst + sizeof(int32_t),
+                                   &n_rec_imag, &rec_max_imag);
+        if (conv->patch) {
+            conv->patch(conv, first_rec + i, dst + sizeof(int32_t));
+        }
+        if (n > 0 || n_rec_imag > 0) {
+            #pragma omp critical(convert_first_bad)
+            if (first_bad < 0 || i < first_bad) {
+                first_bad = i;
+            }
+        }
+        n_overflow += n;
+        n_imag += n_rec_imag;
+        if (rec_max_imag > max_imag) {
+            max_imag = rec_max_imag;
+        }
+    }
+
+    if (max_imag > result->max_imag) {
+        result->max_imag = max_imag;
+    }
+
+    free(in_offsets);
+
+    if (n_overflow > 0) {
+        snprintf(result->error, sizeof(result->error),
+                 "%lld integers out of the range of 4-byte integers, the first one in record %lld of %.*s",
+                 (long long) n_overflow, (long long) (first_rec + first_bad + 1), CONVERT_ERROR_PATH_LEN / 2, path);
+        return EXIT_FAILURE;
+    }
+
+    if (n_imag > 0) {
+        snprintf(result->error, sizeof(result->error),
+                 "%lld integrals with |Im| above %g (max %.3e), the first one in record %lld of %.*s",
+                 (long long) n_imag, conv->imag_threshold, max_imag, (long long) (first_rec + first_bad + 1),
+                 CONVERT_ERROR_PATH_LEN / 2, path);
+        return EXIT_FAILURE;
+    }
+
+    *out_size = total;
+
+    return EXIT_SUCCESS;
+}
+
+
+/*
+ * converts the payload of the record, returns the number of integers out of range;
+ * n_imag: number of imaginary parts above the threshold (if converted to real)
+ */
+static int64_t convert_record(converter_t *conv, const record_layout_t *layout, char *src, char *dst,
+                              int64_t *n_imag, double *max_imag)
+{
+    int64_t n_overflow = 0;
+
+    for (int32_t r = 0; r < layout->num_repeats; r++) {
+        for (int k = 0; k < layout->num_spans; k++) {
+            const span_t *span = &layout->spans[k];
+
+            n_overflow += convert_ints(conv, src, span->n_ints, dst);
+            src += (size_t) span->n_ints * conv->from_size;
+            dst += (size_t) span->n_ints * conv->to_size;
+
+            memcpy(dst, src, span->n_raw);
+            src += span->n_raw;
+            dst += span->n_raw;
+
+            if (conv->to_real) {
+                double span_max_imag = 0.0;
+                *n_imag += convert_complex(conv, src, span->n_complex, dst, &span_max_imag);
+                if (span_max_imag > *max_imag) {
+                    *max_imag = span_max_imag;
+                }
+                dst += (size_t) span->n_complex * sizeof(double);
+            }
+            else {
+                memcpy(dst, src, (size_t) span->n_complex * 2 * sizeof(double));
+                dst += (size_t) span->n_complex * 2 * sizeof(double);
+            }
+            src += (size_t) span->n_complex * 2 * sizeof(double);
+        }
+    }
+
+    return n_overflow;
+}
+
+
+/*
+ * Converts n integers of the file from 'src' to 'dst' (both in the byte order of
+ * the file, any alignment). The source may be byte-swapped in place.
+ * Returns the number of integers which do not fit into 4 bytes.
+ */
+static int64_t convert_ints(converter_t *conv, char *src, int64_t n, char *dst)
+{
+    int64_t n_overflow = 0;
+
+    if (conv->from_size == conv->to_size) {
+        memcpy(dst, src, (size_t) n * conv->from_size);
+    }
+    else if (conv->from_size == 8) {
+        int32_t chunk[CONVERT_CHUNK_LEN];
+        if (conv->swap_bytes) {
+            unf_byte_swap(src, (size_t) n, sizeof(int64_t));
+        }
+        for (int64_t i = 0; i < n; i += CONVERT_CHUNK_LEN) {
+            int64_t len = n - i < CONVERT_CHUNK_LEN ? n - i : CONVERT_CHUNK_LEN;
+            if (unf_narrow_int64(src + i * sizeof(int64_t), (size_t) len, chunk) == UNF_ERROR) {
+                for (int64_t j = 0; j < len; j++) {
+                    int64_t x;
+                    memcpy(&x, src + (i + j) * sizeof(int64_t), sizeof(int64_t));
+                    n_overflow += (x != chunk[j]);
+                }
+            }
+            if (conv->swap_bytes) {
+                unf_byte_swap(chunk, (size_t) len, sizeof(int32_t));
+            }
+            memcpy(dst + i * sizeof(int32_t), chunk, len * sizeof(int32_t));
+        }
+    }
+    else {
+        int32_t chunk[CONVERT_CHUNK_LEN];
+        int64_t wide[CONVERT_CHUNK_LEN];
+        for (int64_t i = 0; i < n; i += CONVERT_CHUNK_LEN) {
+            int64_t len = n - i < CONVERT_CHUNK_LEN ? n - i : CONVERT_CHUNK_LEN;
+            memcpy(chunk, src + i * sizeof(int32_t), len * sizeof(int32_t));
+            if (conv->swap_bytes) {
+                unf_byte_swap(chunk, (size_t) len, sizeof(int32_t));
+            }
+            for (int64_t j = 0; j < len; j++) {
+                wide[j] = chunk[j];
+            }
+            if (conv->swap_bytes) {
+                unf_byte_swap(wide, (size_t) len, sizeof(int64_t));
+            }
+            memcpy(dst + i * sizeof(int64_t), wide, len * sizeof(int64_t));
+        }
+    }
+
+    return n_overflow;
+}
+
+
+/*
+ * Replaces n complex numbers of the file with their real parts (any alignment).
+ * The source may be byte-swapped in place. Returns the number of imaginary
+ * parts above the threshold, max_imag is set to the largest one.
+ */
+static int64_t convert_complex(converter_t *conv, char *src, int64_t n, char *dst, double *max_imag)
+{
+    if (conv->swap_bytes) {
+        unf_byte_swap(src, (size_t) (2 * n), sizeof(double));
+    }
+
+    int64_t n_imag = 0;
+    *max_imag = mdcint_max_imag(src, n);
+    if (*max_imag > conv->imag_threshold) {
+        for (int64_t i = 0; i < n; i++) {
+            double im;
+            memcpy(&im, src + (2 * i + 1) * sizeof(double), sizeof(double));
+            n_imag += (im > conv->imag_threshold || im < -conv->imag_threshold);
+        }
+    }
+
+    for (int64_t i = 0; i < n; i++) {
+        memcpy(dst + i * sizeof(double), src + 2 * i * sizeof(double), sizeof(double));
+    }
+    if (conv->swap_bytes) {
+        unf_byte_swap(dst, (size_t) n, sizeof(double));
+    }
+
+    return n_imag;
+}
+
+
+/*
+ * length of the converted record
+ */
+static int64_t output_length(converter_t *conv, const record_layout_t *layout, int32_t len)
+{
+    int64_t n_ints = 0;
+    int64_t n_complex = 0;
+    for (int k = 0; k < layout->num_spans; k++) {
+        n_ints += layout->spans[k].n_ints;
+        n_complex += layout->spans[k].n_complex;
+    }
+
+    int64_t delta = (int64_t) (conv->to_size - conv->from_size) * n_ints;
+    if (conv->to_real) {
+        delta -= n_complex * (int64_t) sizeof(double);
+    }
+
+    return len + delta * layout->num_repeats;
+}
+
+
+/*
+ * integer of the file at the given position
+ */
+static int64_t read_int(converter_t *conv, const char *p)
+{
+    if (conv->from_size == 4) {
+        int32_t x;
+        memcpy(&x, p, sizeof(int32_t));
+        if (conv->swap_bytes) {
+            unf_byte_swap(&x, 1, sizeof(int32_t));
+        }
+        return x;
+    }
+
+    int64_t x;
+    memcpy(&x, p, sizeof(int64_t));
+    if (conv->swap_bytes) {
+        unf_byte_swap(&x, 1, sizeof(int64_t));
+    }
+    return x;
+}
+
+
+static void set_layout(record_layout_t *layout, int32_t num_repeats, int32_t n_ints_1, int32_t n_raw_1,
+                       int32_t n_ints_2, int32_t n_raw_2)
+{
+    layout->num_repeats = num_repeats;
+    layout->num_spans = 2;
+    layout->spans[0].n_ints = n_ints_1;
+    layout->spans[0].n_raw = n_raw_1;
+    layout->spans[0].n_complex = 0;
+    layout->spans[1].n_ints = n_ints_2;
+    layout->spans[1].n_raw = n_raw_2;
+    layout->spans[1].n_complex = 0;
+}
+
+
+/*
+ * Records of MRCONEE (see mrconee.c):
+ * 1: num_spinors, breit, enuc, invsym, nz_arith, is_spinfree, norb_total, scf_energy
+ * 2: nsymrp, repnames (c14 each), nactive, nstr, nfrozen, ndelete
+ * 3: nsymrpa, repanames
+ * 4: multiplication table
+ * 5: (irrep, abelian irrep, energy) of each spinor
+ * 6: Fock matrix
+ */
+static int mrconee_layout(converter_t *conv, int64_t rec, const char *payload, int32_t len, record_layout_t *layout)
+{
+    int32_t n = conv->from_size;
+
+    if (rec == 0 && len == 6 * n + 2 * (int32_t) sizeof(double)) {
+        set_layout(layout, 1, 2, sizeof(double), 4, sizeof(double));
+    }
+    else if (rec == 1 && len >= n) {
+        int64_t nsymrp = read_int(conv, payload);
+        int64_t rest = len - n - 14 * nsymrp;
+        if (nsymrp < 0 || nsymrp > 8 || rest < 0 || rest % n != 0) {
+            return EXIT_FAILURE;
+        }
+        set_layout(layout, 1, 1, (int32_t) (14 * nsymrp), (int32_t) (rest / n), 0);
+    }
+    else if (rec == 2 && len >= n) {
+        set_layout(layout, 1, 1, len - n, 0, 0);
+    }
+    else if (rec == 3 && len % n == 0) {
+        set_layout(layout, 1, len / n, 0, 0, 0);
+    }
+    else if (rec == 4 && len % (2 * n + (int32_t) sizeof(double)) == 0) {
+        set_layout(layout, len / (2 * n + (int32_t) sizeof(double)), 2, sizeof(double), 0, 0);
+    }
+    else if (rec == 5) {
+        set_layout(layout, 1, 0, len, 0, 0);
+    }
+    else {
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+
+/*
+ * Records of MDCINT (see mdcint.c):
+ * header: date and time (c18), nkr, indices of Kramers pairs;
+ * then ikr, jkr, nonzr, pairs of indices (indk, indl), values
+ */
+static int mdcint_layout(converter_t *conv, int64_t rec, const char *payload, int32_t len, record_layout_t *layout)
+{
+    (void) payload;
+    int32_t n = conv->from_size;
+
+    if (rec == 0) {
+        if (len < 18 + n || (len - 18) % n != 0) {
+            return EXIT_FAILURE;
+        }
+        set_layout(layout, 1, 0, 18, (len - 18) / n, 0);
+        return EXIT_SUCCESS;
+    }
+
+    int64_t value_size = conv->is_real ? sizeof(double) : 2 * sizeof(double);
+    int64_t integral_size = 2 * n + value_size;
+    int64_t nonzr = (len - 3 * n) / integral_size;
+    if (len < 3 * n || len != 3 * n + nonzr * integral_size) {
+        return EXIT_FAILURE;
+    }
+    if (conv->is_real) {
+        set_layout(layout, 1, (int32_t) (3 + 2 * nonzr), (int32_t) (nonzr * value_size), 0, 0);
+    }
+    else {
+        set_layout(layout, 1, (int32_t) (3 + 2 * nonzr), 0, 0, 0);
+        layout->spans[0].n_complex = (int32_t) nonzr;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+
+/*
+ * MDPROP contains no integers
+ */
+static int mdprop_layout(converter_t *conv, int64_t rec, const char *payload, int32_t len, record_layout_t *layout)
+{
+    (void) conv;
+    (void) rec;
+    (void) payload;
+    set_layout(layout, 1, 0, len, 0, 0);
+    return EXIT_SUCCESS;
+}
+
+
+/*
+ * sets nz_arith in the header of MRCONEE to 1 (real arithmetic)
+ */
+static void mrconee_set_real_arith(converter_t *conv, int64_t rec, char *payload)
+{
+    if (rec != 0) {
+        return;
+    }
+
+    // num_spinors, breit, enuc, invsym, nz_arith
+    char *p = payload + 3 * conv->to_size + sizeof(double);
+    if (conv->to_size == 4) {
+        int32_t x = 1;
+        if (conv->swap_bytes) {
+            unf_byte_swap(&x, 1, sizeof(int32_t));
+        }
+        memcpy(p, &x, sizeof(int32_t));
+    }
+    else {
+        int64_t x = 1;
+        if (conv->swap_bytes) {
+            unf_byte_swap(&x, 1, sizeof(int64_t));
+        }
+        memcpy(p, &x, sizeof(int64_t));
+    }
+}
+
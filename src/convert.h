@@ -0,0 +1,44 @@
+/*
+ * Inspector of DIRAC files containing transformed molecular integrals.
+ *
+ * 2024 Alexander Oleynichenko
+ */
+
+#ifndef DIRAC_INSPECTOR_CONVERT_H
+#define DIRAC_INSPECTOR_CONVERT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "mrconee.h"
+
+/*
+ * summary of the conversion, see convert_int_size()
+ */
+typedef struct {
+    int from_int_size;
+    int to_int_size;
+    int to_real;                // complex integrals converted to real ones
+    double max_imag;            // largest imaginary part found if to_real
+    int num_files;
+    int64_t num_records;
+    int64_t bytes_read;
+    int64_t bytes_written;
+    double time;                // seconds
+    char error[256];            // empty string if the conversion succeeded
+} convert_result_t;
+
+int convert_int_size(char *dir, int int_size, mrconee_data_t *mrconee_data, char *mrconee_path,
+                     char *mdprop_path, char *mdcint_path, convert_result_t *result);
+
+int convert_to_real(char *dir, int int_size, double imag_threshold, mrconee_data_t *mrconee_data,
+                    char *mrconee_path, char *mdprop_path, char *mdcint_path, convert_result_t *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DIRAC_INSPECTOR_CONVERT_H
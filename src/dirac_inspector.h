@@ -0,0 +1,29 @@
+/*
+ * Inspector of DIRAC files containing transformed molecular integrals.
+ *
+ * Public interface of the dirac_inspector library:
+ * readers of MRCONEE, MDPROP and MDCINT files returning structured data,
+ * iterators over property operators and records of two-electron integrals,
+ * analysis of matrices, export to FCIDUMP and NumPy .npy files and the LIBUNF
+ * library for Fortran unformatted files.
+ *
+ * 2024 Alexander Oleynichenko
+ */
+
+#ifndef DIRAC_INSPECTOR_H_INCLUDED
+#define DIRAC_INSPECTOR_H_INCLUDED
+
+#include "libunf.h"
+#include "mrconee.h"
+#include "fock_analysis.h"
+#include "matrix_analysis.h"
+#include "mdprop.h"
+#include "mdcint.h"
+#include "fcidump.h"
+#include "dtoa.h"
+#include "npy.h"
+#include "convert.h"
+#include "fragments.h"
+#include "classes.h"
+
+#endif // DIRAC_INSPECTOR_H_INCLUDED
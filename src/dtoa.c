@@ -0,0 +1,542 @@
+/*
+ * Inspector of DIRAC files containing transformed molecular integrals.
+ *
+ * Fast conversion of numbers to text without printf().
+ *
+ * Doubles are converted with the Grisu3 algorithm (F. Loitsch, "Printing
+ * floating-point numbers quickly and accurately with integers", PLDI 2010):
+ * it produces the shortest string which is read back to the same double
+ * (the closest to the double if there are several), or detects that it cannot
+ * guarantee that. In the latter case (about 0.5% of doubles) the shortest
+ * string is found by printf() with increasing precision and checked by strtod().
+ *
+ * 2024 Alexander Oleynichenko
+ */
+
+#include "dtoa.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * "do-it-yourself" floating-point number f * 2^e
+ */
+typedef struct {
+    uint64_t f;
+    int e;
+} diy_fp_t;
+
+typedef struct {
+    uint64_t f;
+    int e;
+    int k;
+} cached_power_t;
+
+/*
+ * the product of the scaled number and the cached power of ten
+ * is kept with the binary exponent in [ALPHA, GAMMA]
+ */
+#define ALPHA (-60)
+#define GAMMA (-32)
+
+#define CACHED_POWERS_MIN_DEC_EXP (-348)
+#define CACHED_POWERS_DEC_STEP 8
+
+/*
+ * normalized 10^k = f * 2^e, k = -348, -340, ..., 340
+ */
+static const cached_power_t cached_powers[] = {
+    {0xFA8FD5A0081C0288, -1220,  -348},
+    {0xBAAEE17FA23EBF76, -1193,  -340},
+    {0x8B16FB203055AC76, -1166,  -332},
+    {0xCF42894A5DCE35EA, -1140,  -324},
+    {0x9A6BB0AA55653B2D, -1113,  -316},
+    {0xE61ACF033D1A45DF, -1087,  -308},
+    {0xAB70FE17C79AC6CA, -1060,  -300},
+    {0xFF77B1FCBEBCDC4F, -1034,  -292},
+    {0xBE5691EF416BD60C, -1007,  -284},
+    {0x8DD01FAD907FFC3C,  -980,  -276},
+    {0xD3515C2831559A83,  -954,  -268},
+    {0x9D71AC8FADA6C9B5,  -927,  -260},
+    {0xEA9C227723EE8BCB,  -901,  -252},
+    {0xAECC49914078536D,  -874,  -244},
+    {0x823C12795DB6CE57,  -847,  -236},
+    {0xC21094364DFB5637,  -821,  -228},
+    {0x9096EA6F3848984F,  -794,  -220},
+    {0xD77485CB25823AC7,  -768,  -212},
+    {0xA086CFCD97BF97F4,  -741,  -204},
+    {0xEF340A98172AACE5,  -715,  -196},
+    {0xB23867FB2A35B28E,  -688,  -188},
+    {0x84C8D4DFD2C63F3B,  -661,  -180},
+    {0xC5DD44271AD3CDBA,  -635,  -172},
+    {0x936B9FCEBB25C996,  -608,  -164},
+    {0xDBAC6C247D62A584,  -582,  -156},
+    {0xA3AB66580D5FDAF6,  -555,  -148},
+    {0xF3E2F893DEC3F126,  -529,  -140},
+    {0xB5B5ADA8AAFF80B8,  -502,  -132},
+    {0x87625F056C7C4A8B,  -475,  -124},
+    {0xC9BCFF6034C13053,  -449,  -116},
+    {0x964E858C91BA2655,  -422,  -108},
+    {0xDFF9772470297EBD,  -396,  -100},
+    {0xA6DFBD9FB8E5B88F,  -369,   -92},
+    {0xF8A95FCF88747D94,  -343,   -84},
+    {0xB94470938FA89BCF,  -316,   -76},
+    {0x8A08F0F8BF0F156B,  -289,   -68},
+    {0xCDB02555653131B6,  -263,   -60},
+    {0x993FE2C6D07B7FAC,  -236,   -52},
+    {0xE45C10C42A2B3B06,  -210,   -44},
+    {0xAA242499697392D3,  -183,   -36},
+    {0xFD87B5F28300CA0E,  -157,   -28},
+    {0xBCE5086492111AEB,  -130,   -20},
+    {0x8CBCCC096F5088CC,  -103,   -12},
+    {0xD1B71758E219652C,   -77,    -4},
+    {0x9C40000000000000,   -50,     4},
+    {0xE8D4A51000000000,   -24,    12},
+    {0xAD78EBC5AC620000,     3,    20},
+    {0x813F3978F8940984,    30,    28},
+    {0xC097CE7BC90715B3,    56,    36},
+    {0x8F7E32CE7BEA5C70,    83,    44},
+    {0xD5D238A4ABE98068,   109,    52},
+    {0x9F4F2726179A2245,   136,    60},
+    {0xED63A231D4C4FB27,   162,    68},
+    {0xB0DE65388CC8ADA8,   189,    76},
+    {0x83C7088E1AAB65DB,   216,    84},
+    {0xC45D1DF942711D9A,   242,    92},
+    {0x924D692CA61BE758,   269,   100},
+    {0xDA01EE641A708DEA,   295,   108},
+    {0xA26DA3999AEF774A,   322,   116},
+    {0xF209787BB47D6B85,   348,   124},
+    {0xB454E4A179DD1877,   375,   132},
+    {0x865B86925B9BC5C2,   402,   140},
+    {0xC83553C5C8965D3D,   428,   148},
+    {0x952AB45CFA97A0B3,   455,   156},
+    {0xDE469FBD99A05FE3,   481,   164},
+    {0xA59BC234DB398C25,   508,   172},
+    {0xF6C69A72A3989F5C,   534,   180},
+    {0xB7DCBF5354E9BECE,   561,   188},
+    {0x88FCF317F22241E2,   588,   196},
+    {0xCC20CE9BD35C78A5,   614,   204},
+    {0x98165AF37B2153DF,   641,   212},
+    {0xE2A0B5DC971F303A,   667,   220},
+    {0xA8D9D1535CE3B396,   694,   228},
+    {0xFB9B7CD9A4A7443C,   720,   236},
+    {0xBB764C4CA7A44410,   747,   244},
+    {0x8BAB8EEFB6409C1A,   774,   252},
+    {0xD01FEF10A657842C,   800,   260},
+    {0x9B10A4E5E9913129,   827,   268},
+    {0xE7109BFBA19C0C9D,   853,   276},
+    {0xAC2820D9623BF429,   880,   284},
+    {0x80444B5E7AA7CF85,   907,   292},
+    {0xBF21E44003ACDD2D,   933,   300},
+    {0x8E679C2F5E44FF8F,   960,   308},
+    {0xD433179D9C8CB841,   986,   316},
+    {0x9E19DB92B4E31BA9,  1013,   324},
+    {0xEB96BF6EBADF77D9,  1039,   332},
+    {0xAF87023B9BF0EE6B,  1066,   340}
+};
+
+static diy_fp_t diy_fp_sub(diy_fp_t x, diy_fp_t y);
+
+static diy_fp_t diy_fp_mul(diy_fp_t x, diy_fp_t y);
+
+static diy_fp_t diy_fp_normalize(diy_fp_t x);
+
+static void compute_boundaries(double value, diy_fp_t *w, diy_fp_t *m_minus, diy_fp_t *m_plus);
+
+static cached_power_t get_cached_power(int e);
+
+static int grisu3(char *digits, int *len, int *decimal_exponent, double value);
+
+static int digit_gen(char *digits, int *len, int *kappa, diy_fp_t m_minus, diy_fp_t w, diy_fp_t m_plus);
+
+static int round_weed(char *digits, int len, uint64_t dist_high, uint64_t unsafe_interval, uint64_t rest,
+                      uint64_t ten_kappa, uint64_t unit);
+
+static int shortest_digits_printf(char *digits, int min_len, int *decimal_exponent, double value);
+
+static int format_digits(char *buf, char *digits, int len, int decimal_exponent);
+
+static int write_uint(char *buf, uint64_t value);
+
+
+/**
+ * Writes the decimal representation of a finite double to buf (at least
+ * FORMAT_DOUBLE_MAX_LEN + 1 bytes), followed by the null character.
+ * Numbers in [1e-4, 1e15) are written in the fixed notation ("-0.25", "12.0"),
+ * the others in the exponential one ("1.5e-10").
+ * Returns the length of the string.
+ */
+int format_double(char *buf, double value)
+{
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    char *p = buf;
+    if (bits >> 63) {
+        *p++ = '-';
+        value = -value;
+    }
+
+    if (value == 0.0) {
+        memcpy(p, "0.0", 4);
+        return (int) (p - buf) + 3;
+    }
+
+    char digits[20];
+    int len = 0;
+    int decimal_exponent = 0;
+    if (!grisu3(digits, &len, &decimal_exponent, value)) {
+        len = shortest_digits_printf(digits, len, &decimal_exponent, value);
+    }
+
+    p += format_digits(p, digits, len, decimal_exponent);
+    *p = '\0';
+
+    return (int) (p - buf);
+}
+
+
+/**
+ * Writes a decimal integer to buf (at least FORMAT_INT_MAX_LEN + 1 bytes),
+ * followed by the null character. Returns the length of the string.
+ */
+int format_int(char *buf, int64_t value)
+{
+    if (value < 0) {
+        buf[0] = '-';
+        int len = write_uint(buf + 1, (uint64_t) 0 - (uint64_t) value);
+        buf[len + 1] = '\0';
+        return len + 1;
+    }
+
+    int len = write_uint(buf, (uint64_t) value);
+    buf[len] = '\0';
+    return len;
+}
+
+
+static diy_fp_t diy_fp_sub(diy_fp_t x, diy_fp_t y)
+{
+    diy_fp_t r = {x.f - y.f, x.e};
+    return r;
+}
+
+
+/*
+ * upper 64 bits of the 128-bit product, rounded
+ */
+static diy_fp_t diy_fp_mul(diy_fp_t x, diy_fp_t y)
+{
+    const uint64_t mask = 0xFFFFFFFFu;
+
+    uint64_t a = x.f >> 32;
+    uint64_t b = x.f & mask;
+    uint64_t c = y.f >> 32;
+    uint64_t d = y.f & mask;
+
+    uint64_t ac = a * c;
+    uint64_t bc = b * c;
+    uint64_t ad = a * d;
+    uint64_t bd = b * d;
+
+    uint64_t tmp = (bd >> 32) + (ad & mask) + (bc & mask);
+    tmp += 1u << 31;
+
+    diy_fp_t r = {ac + (ad >> 32) + (bc >> 32) + (tmp >> 32), x.e + y.e + 64};
+    return r;
+}
+
+
+static diy_fp_t diy_fp_normalize(diy_fp_t x)
+{
+    while ((x.f >> 63) == 0) {
+        x.f <<= 1;
+        x.e--;
+    }
+    return x;
+}
+
+
+/*
+ * normalized value w and the boundaries m- and m+ (halfway to the neighbouring doubles),
+ * the latter two with the same exponent as that of m+
+ */
+static void compute_boundaries(double value, diy_fp_t *w, diy_fp_t *m_minus, diy_fp_t *m_plus)
+{
+    const uint64_t hidden_bit = (uint64_t) 1 << 52;
+    const int exponent_bias = 1023 + 52;
+
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint64_t fraction = bits & (hidden_bit - 1);
+    int biased_exponent = (int) (bits >> 52);
+
+    diy_fp_t v;
+    if (biased_exponent == 0) {
+        v.f = fraction;
+        v.e = 1 - exponent_bias;
+    }
+    else {
+        v.f = fraction + hidden_bit;
+        v.e = biased_exponent - exponent_bias;
+    }
+
+    // the lower boundary is closer if the fraction is zero (except the smallest normal)
+    int lower_boundary_is_closer = fraction == 0 && biased_exponent > 1;
+
+    diy_fp_t plus = {2 * v.f + 1, v.e - 1};
+    diy_fp_t minus;
+    if (lower_boundary_is_closer) {
+        minus.f = 4 * v.f - 1;
+        minus.e = v.e - 2;
+    }
+    else {
+        minus.f = 2 * v.f - 1;
+        minus.e = v.e - 1;
+    }
+
+    *m_plus = diy_fp_normalize(plus);
+    minus.f <<= minus.e - m_plus->e;
+    minus.e = m_plus->e;
+    *m_minus = minus;
+    *w = diy_fp_normalize(v);
+}
+
+
+/*
+ * cached power c = 10^-k such that the exponent of c * 2^e is in [ALPHA, GAMMA]
+ */
+static cached_power_t get_cached_power(int e)
+{
+    // k = ceil((ALPHA - e - 1) * log10(2))
+    int f = ALPHA - e - 1;
+    int k = (f * 78913) / (1 << 18) + (f > 0);
+    int index = (-CACHED_POWERS_MIN_DEC_EXP + k + (CACHED_POWERS_DEC_STEP - 1)) / CACHED_POWERS_DEC_STEP;
+
+    return cached_powers[index];
+}
+
+
+/*
+ * value = digits * 10^decimal_exponent; returns 0 if the digits are not guaranteed
+ * to be the shortest and the closest representation (then they are to be discarded)
+ */
+static int grisu3(char *digits, int *len, int *decimal_exponent, double value)
+{
+    diy_fp_t w, m_minus, m_plus;
+    compute_boundaries(value, &w, &m_minus, &m_plus);
+
+    cached_power_t cached = get_cached_power(m_plus.e);
+    diy_fp_t c_minus_k = {cached.f, cached.e};
+
+    diy_fp_t w_scaled = diy_fp_mul(w, c_minus_k);
+    diy_fp_t w_minus = diy_fp_mul(m_minus, c_minus_k);
+    diy_fp_t w_plus = diy_fp_mul(m_plus, c_minus_k);
+
+    int kappa = 0;
+    int ok = digit_gen(digits, len, &kappa, w_minus, w_scaled, w_plus);
+    *decimal_exponent = -cached.k + kappa;
+
+    return ok;
+}
+
+
+/*
+ * Generates the shortest digit string in the unsafe interval (m_minus - 1 ulp, m_plus + 1 ulp),
+ * which contains all the numbers that may read back to the double because of the errors
+ * of multiplication, and then moves it as close to w as possible (see round_weed()).
+ * value = digits * 10^kappa.
+ */
+static int digit_gen(char *digits, int *len, int *kappa, diy_fp_t m_minus, diy_fp_t w, diy_fp_t m_plus)
+{
+    uint64_t unit = 1;
+    diy_fp_t too_low = {m_minus.f - unit, m_minus.e};
+    diy_fp_t too_high = {m_plus.f + unit, m_plus.e};
+    uint64_t unsafe_interval = diy_fp_sub(too_high, too_low).f;
+
+    diy_fp_t one = {(uint64_t) 1 << -w.e, w.e};
+
+    uint32_t p1 = (uint32_t) (too_high.f >> -one.e);  // integral part
+    uint64_t p2 = too_high.f & (one.f - 1);           // fractional part
+
+    // number of digits in p1
+    uint32_t pow10 = 1000000000;
+    int n = 10;
+    while (n > 1 && p1 < pow10) {
+        pow10 /= 10;
+        n--;
+    }
+
+    *len = 0;
+    *kappa = n;
+    while (*kappa > 0) {
+        uint32_t d = p1 / pow10;
+        p1 %= pow10;
+        digits[(*len)++] = (char) ('0' + d);
+        (*kappa)--;
+
+        uint64_t rest = ((uint64_t) p1 << -one.e) + p2;
+        if (rest < unsafe_interval) {
+            return round_weed(digits, *len, diy_fp_sub(too_high, w).f, unsafe_interval, rest,
+                              (uint64_t) pow10 << -one.e, unit);
+        }
+        pow10 /= 10;
+    }
+
+    while (1) {
+        p2 *= 10;
+        unit *= 10;
+        unsafe_interval *= 10;
+        digits[(*len)++] = (char) ('0' + (p2 >> -one.e));
+        p2 &= one.f - 1;
+        (*kappa)--;
+
+        if (p2 < unsafe_interval) {
+            return round_weed(digits, *len, diy_fp_sub(too_high, w).f * unit, unsafe_interval, p2, one.f, unit);
+        }
+    }
+}
+
+
+/*
+ * Moves the last digit towards w while the result stays inside the unsafe interval.
+ * dist_high is the distance from the upper end of the interval to w, rest is the distance
+ * from the upper end to the digits, 'unit' is the error of both in the same scale.
+ * Returns 1 if the digits are provably the closest to w and inside the safe interval.
+ */
+static int round_weed(char *digits, int len, uint64_t dist_high, uint64_t unsafe_interval, uint64_t rest,
+                      uint64_t ten_kappa, uint64_t unit)
+{
+    uint64_t small_distance = dist_high - unit;  // to the largest possible w
+    uint64_t big_distance = dist_high + unit;    // to the smallest possible w
+
+    while (rest < small_distance && unsafe_interval - rest >= ten_kappa &&
+           (rest + ten_kappa < small_distance ||
+            small_distance - rest >= rest + ten_kappa - small_distance)) {
+        digits[len - 1]--;
+        rest += ten_kappa;
+    }
+
+    // the digits would have been moved further for the smallest possible w: cannot decide
+    if (rest < big_distance && unsafe_interval - rest >= ten_kappa &&
+        (rest + ten_kappa < big_distance ||
+         big_distance - rest > rest + ten_kappa - big_distance)) {
+        return 0;
+    }
+
+    // the digits must be inside the safe interval, i.e. read back to the double
+    return 2 * unit <= rest && rest <= unsafe_interval - 4 * unit;
+}
+
+
+/*
+ * Fallback for the doubles rejected by grisu3(): the fewest significant digits
+ * printed by printf("%.*e") which are read back to the same double by strtod().
+ * The search starts from min_len digits: grisu3() has found the shortest string
+ * in an interval wider than the exact one, so no shorter string exists.
+ * value = digits * 10^decimal_exponent, returns the number of digits.
+ */
+static int shortest_digits_printf(char *digits, int min_len, int *decimal_exponent, double value)
+{
+    char buf[32];
+
+    for (int precision = min_len - 1; precision < 17; precision++) {
+        snprintf(buf, sizeof(buf), "%.*e", precision, value);
+        if (strtod(buf, NULL) == value) {
+            break;
+        }
+    }
+
+    // d.ddde[+-]xx: the decimal point may depend on the locale
+    int len = 0;
+    char *p = buf;
+    for (; *p != 'e'; p++) {
+        if ('0' <= *p && *p <= '9') {
+            digits[len++] = *p;
+        }
+    }
+    while (len > 1 && digits[len - 1] == '0') {
+        len--;
+    }
+    *decimal_exponent = (int) strtol(p + 1, NULL, 10) - (len - 1);
+
+    return len;
+}
+
+
+/*
+ * value = 0.d1d2...dn * 10^point
+ */
+static int format_digits(char *buf, char *digits, int len, int decimal_exponent)
+{
+    const int min_point = -4;
+    const int max_point = 15;
+
+    int point = len + decimal_exponent;
+    char *p = buf;
+
+    if (len <= point && point <= max_point) {
+        // integral value: 1234000.0
+        memcpy(p, digits, len);
+        p += len;
+        memset(p, '0', point - len);
+        p += point - len;
+        *p++ = '.';
+        *p++ = '0';
+    }
+    else if (0 < point && point <= max_point) {
+        // 1234.5678
+        memcpy(p, digits, point);
+        p += point;
+        *p++ = '.';
+        memcpy(p, digits + point, len - point);
+        p += len - point;
+    }
+    else if (min_point < point && point <= 0) {
+        // 0.0001234
+        *p++ = '0';
+        *p++ = '.';
+        memset(p, '0', -point);
+        p += -point;
+        memcpy(p, digits, len);
+        p += len;
+    }
+    else {
+        // 1.234e-10
+        *p++ = digits[0];
+        if (len > 1) {
+            *p++ = '.';
+            memcpy(p, digits + 1, len - 1);
+            p += len - 1;
+        }
+        *p++ = 'e';
+        int exponent = point - 1;
+        if (exponent < 0) {
+            *p++ = '-';
+            exponent = -exponent;
+        }
+        else {
+            *p++ = '+';
+        }
+        p += write_uint(p, (uint64_t) exponent);
+    }
+
+    return (int) (p - buf);
+}
+
+
+static int write_uint(char *buf, uint64_t value)
+{
+    char tmp[FORMAT_INT_MAX_LEN];
+    int n = 0;
+    do {
+        tmp[n++] = (char) ('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+
+    for (int i = 0; i < n; i++) {
+        buf[i] = tmp[n - 1 - i];
+    }
+    return n;
+}
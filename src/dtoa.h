@@ -0,0 +1,31 @@
+/*
+ * Inspector of DIRAC files containing transformed molecular integrals.
+ *
+ * 2024 Alexander Oleynichenko
+ */
+
+#ifndef DIRAC_INSPECTOR_DTOA_H
+#define DIRAC_INSPECTOR_DTOA_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/*
+ * max length of the strings written by format_double() and format_int(),
+ * without the terminating null character
+ */
+#define FORMAT_DOUBLE_MAX_LEN 25
+#define FORMAT_INT_MAX_LEN 20
+
+int format_double(char *buf, double value);
+
+int format_int(char *buf, int64_t value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DIRAC_INSPECTOR_DTOA_H
@@ -0,0 +1,408 @@
+/*
+ * Inspector of DIRAC files containing transformed molecular integrals.
+ *
+ * Export of integrals to the FCIDUMP text format.
+ *
+ * 2024 Alexander Oleynichenko
+ */
+
+#include "fcidump.h"
+
+#include <complex.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "dtoa.h"
+#include "mdcint.h"
+#include "mrconee.h"
+#include "util.h"
+
+// number of integrals collected before they are formatted and written
+#define FCIDUMP_CHUNK_SIZE (1024 * 1024)
+
+// max length of a line: two numbers, four indices, separators
+#define FCIDUMP_MAX_LINE_LEN (2 * FORMAT_DOUBLE_MAX_LEN + 4 * FORMAT_INT_MAX_LEN + 6)
+
+/*
+ * integrals waiting to be written: spinor indices i, j, k, l of each integral
+ * and its value (one or two numbers)
+ */
+typedef struct {
+    int64_t size;
+    int64_t capacity;
+    int32_t *indices;
+    double *values;
+} fcidump_chunk_t;
+
+/*
+ * per-thread text buffers
+ */
+typedef struct {
+    int num_threads;
+    char **text;
+    size_t *text_capacity;
+    size_t *text_len;
+} fcidump_buffers_t;
+
+static int write_integrals(FILE *out, mdcint_iter_t *iter, mrconee_data_t *mrconee_data,
+                           fcidump_chunk_t *chunk, fcidump_buffers_t *buffers, fcidump_result_t *result);
+
+static int write_header(FILE *out, mrconee_data_t *mrconee_data, int is_real, int64_t *bytes_written);
+
+static int reserve_chunk(fcidump_chunk_t *chunk, int64_t capacity);
+
+static int kramers_to_spinor(const mdcint_header_t *header, int32_t kr);
+
+static int flush_chunk(FILE *out, fcidump_chunk_t *chunk, int is_real, fcidump_buffers_t *buffers,
+                       int64_t *bytes_written);
+
+static size_t format_line(char *buf, const double *value, int is_real, int32_t i, int32_t j, int32_t k, int32_t l);
+
+
+/**
+ * Writes the FCIDUMP file: the &FCI namelist, two-electron integrals
+ * (as stored in the MDCINT file, i.e. unique with respect to the Kramers symmetry),
+ * non-zero elements of the Fock matrix from the MRCONEE file (i >= j) as
+ * the one-electron part and the core energy.
+ *
+ * Each line holds the value (the real and imaginary parts for complex integrals)
+ * followed by the spinor indices. Kramers pair indices of MDCINT are converted
+ * to spinor indices using the Kramers pairs listed in its header.
+ *
+ * Integrals are converted to text by chunks; each chunk is split between
+ * OpenMP threads formatting into their own buffers, which are then written
+ * in order. Numbers are written with the shortest decimal
+ * representation that reads back to the same double.
+ *
+ * Returns EXIT_SUCCESS or EXIT_FAILURE (with the message in result->error).
+ */
+int write_fcidump(char *path, mrconee_data_t *mrconee_data, char *mdcint_path, fcidump_result_t *result)
+{
+    memset(result, 0, sizeof(fcidump_result_t));
+    double time_start = abs_time();
+
+    mdcint_iter_t *iter = mdcint_iter_open(mdcint_path, mrconee_data);
+    if (iter == NULL) {
+        snprintf(result->error, sizeof(result->error), "cannot open MDCINT file: %s", strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    FILE *out = fopen(path, "w");
+    if (out == NULL) {
+        snprintf(result->error, sizeof(result->error), "cannot open %s: %s", path, strerror(errno));
+        mdcint_iter_close(iter);
+        return EXIT_FAILURE;
+    }
+
+    fcidump_chunk_t chunk = {0, 0, NULL, NULL};
+    fcidump_buffers_t buffers;
+#ifdef _OPENMP
+    buffers.num_threads = omp_get_max_threads();
+#else
+    buffers.num_threads = 1;
+#endif
+    buffers.text = (char **) calloc(buffers.num_threads, sizeof(char *));
+    buffers.text_capacity = (size_t *) calloc(buffers.num_threads, sizeof(size_t));
+    buffers.text_len = (size_t *) calloc(buffers.num_threads, sizeof(size_t));
+
+    if (buffers.text == NULL || buffers.text_capacity == NULL || buffers.text_len == NULL ||
+        reserve_chunk(&chunk, FCIDUMP_CHUNK_SIZE) == EXIT_FAILURE) {
+        snprintf(result->error, sizeof(result->error), "%s", strerror(ENOMEM));
+    }
+    else if (write_integrals(out, iter, mrconee_data, &chunk, &buffers, result) == EXIT_FAILURE &&
+             result->error[0] == '\0') {
+        snprintf(result->error, sizeof(result->error), "error while writing %s: %s", path, strerror(errno));
+    }
+
+    if (fclose(out) != 0 && result->error[0] == '\0') {
+        snprintf(result->error, sizeof(result->error), "error while writing %s: %s", path, strerror(errno));
+    }
+    mdcint_iter_close(iter);
+    free(chunk.indices);
+    free(chunk.values);
+    for (int ith = 0; buffers.text && ith < buffers.num_threads; ith++) {
+        free(buffers.text[ith]);
+    }
+    free(buffers.text);
+    free(buffers.text_capacity);
+    free(buffers.text_len);
+
+    result->time = abs_time() - time_start;
+
+    return result->error[0] == '\0' ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+/*
+ * writes the header, the integrals and the core energy;
+ * errors of reading are reported in result->error, errors of writing in errno
+ */
+static int write_integrals(FILE *out, mdcint_iter_t *iter, mrconee_data_t *mrconee_data,
+                           fcidump_chunk_t *chunk, fcidump_buffers_t *buffers, fcidump_result_t *result)
+{
+    const mdcint_header_t *header = mdcint_iter_header(iter);
+    int is_real = mrconee_data->group_arith == 1 || mrconee_data->is_spinfree == 1;
+    int n_values = is_real ? 1 : 2;
+
+    if (write_header(out, mrconee_data, is_real, &result->bytes_written) == EXIT_FAILURE) {
+        return EXIT_FAILURE;
+    }
+
+    /*
+     * two-electron integrals
+     */
+    mdcint_record_t rec;
+    int status;
+    while ((status = mdcint_iter_next(iter, &rec)) == 1) {
+        if (chunk->size + rec.nonzr > chunk->capacity) {
+            if (flush_chunk(out, chunk, is_real, buffers, &result->bytes_written) == EXIT_FAILURE) {
+                return EXIT_FAILURE;
+            }
+            if (rec.nonzr > chunk->capacity && reserve_chunk(chunk, rec.nonzr) == EXIT_FAILURE) {
+                snprintf(result->error, sizeof(result->error), "%s", strerror(ENOMEM));
+                return EXIT_FAILURE;
+            }
+        }
+
+        int32_t i = kramers_to_spinor(header, rec.ikr);
+        int32_t j = kramers_to_spinor(header, rec.jkr);
+        int32_t *indices = chunk->indices + 4 * chunk->size;
+        int wrong_index = i == 0 || j == 0;
+        for (int32_t inz = 0; inz < rec.nonzr; inz++) {
+            int32_t k = kramers_to_spinor(header, rec.indk[inz]);
+            int32_t l = kramers_to_spinor(header, rec.indl[inz]);
+            wrong_index |= k == 0 || l == 0;
+            indices[4 * inz] = i;
+            indices[4 * inz + 1] = j;
+            indices[4 * inz + 2] = k;
+            indices[4 * inz + 3] = l;
+        }
+        if (wrong_index) {
+            snprintf(result->error, sizeof(result->error),
+                     "wrong Kramers pair index in MDCINT record (%d, %d)", rec.ikr, rec.jkr);
+            return EXIT_FAILURE;
+        }
+
+        memcpy(chunk->values + n_values * chunk->size, rec.values, n_values * (size_t) rec.nonzr * sizeof(double));
+        chunk->size += rec.nonzr;
+        result->num_two_electron += rec.nonzr;
+    }
+
+    if (status < 0) {
+        snprintf(result->error, sizeof(result->error), "%s", mdcint_iter_error(iter));
+        return EXIT_FAILURE;
+    }
+
+    /*
+     * Fock matrix as the one-electron part
+     */
+    int dim = mrconee_data->num_spinors;
+    for (int i = 0; mrconee_data->fock && i < dim; i++) {
+        for (int j = 0; j <= i; j++) {
+            // the matrix is stored in the Fortran (column-major) order
+            double _Complex f_ij = mrconee_data->fock[(size_t) j * dim + i];
+            if (f_ij == 0.0) {
+                continue;
+            }
+            if (chunk->size == chunk->capacity &&
+                flush_chunk(out, chunk, is_real, buffers, &result->bytes_written) == EXIT_FAILURE) {
+                return EXIT_FAILURE;
+            }
+            int32_t *indices = chunk->indices + 4 * chunk->size;
+            indices[0] = i + 1;
+            indices[1] = j + 1;
+            indices[2] = 0;
+            indices[3] = 0;
+            chunk->values[n_values * chunk->size] = creal(f_ij);
+            if (!is_real) {
+                chunk->values[n_values * chunk->size + 1] = cimag(f_ij);
+            }
+            chunk->size++;
+            result->num_one_electron++;
+        }
+    }
+
+    if (flush_chunk(out, chunk, is_real, buffers, &result->bytes_written) == EXIT_FAILURE) {
+        return EXIT_FAILURE;
+    }
+
+    /*
+     * core energy
+     */
+    char line[FCIDUMP_MAX_LINE_LEN];
+    double core_energy[2] = {mrconee_data->nuc_rep_energy, 0.0};
+    size_t len = format_line(line, core_energy, is_real, 0, 0, 0, 0);
+    if (fwrite(line, 1, len, out) != len) {
+        return EXIT_FAILURE;
+    }
+    result->bytes_written += len;
+
+    return EXIT_SUCCESS;
+}
+
+
+/*
+ * &FCI namelist: number of spinors and electrons, irreps of spinors (1-based),
+ * symmetry of the wavefunction (totally symmetric irrep), TREL=.TRUE. for spinors
+ */
+static int write_header(FILE *out, mrconee_data_t *mrconee_data, int is_real, int64_t *bytes_written)
+{
+    int num_spinors = mrconee_data->num_spinors;
+    int num_electrons = 0;
+    for (int i = 0; i < num_spinors; i++) {
+        num_electrons += mrconee_data->occ_numbers[i];
+    }
+
+    int len = 0;
+    len += fprintf(out, " &FCI NORB=%d,NELEC=%d,MS2=0,\n", num_spinors, num_electrons);
+    len += fprintf(out, "  ORBSYM=");
+    for (int i = 0; i < num_spinors; i++) {
+        len += fprintf(out, "%d,", mrconee_data->spinor_irreps[i] + 1);
+    }
+    len += fprintf(out, "\n");
+    len += fprintf(out, "  ISYM=%d,\n", mrconee_data->totally_sym_irrep + 1);
+    len += fprintf(out, "  TREL=.TRUE.,\n");
+    if (!is_real) {
+        len += fprintf(out, "  COMPLEX=.TRUE.,\n");
+    }
+    len += fprintf(out, " &END\n");
+
+    if (ferror(out)) {
+        return EXIT_FAILURE;
+    }
+    *bytes_written += len;
+    return EXIT_SUCCESS;
+}
+
+
+static int reserve_chunk(fcidump_chunk_t *chunk, int64_t capacity)
+{
+    int32_t *indices = (int32_t *) realloc(chunk->indices, 4 * (size_t) capacity * sizeof(int32_t));
+    if (indices == NULL) {
+        return EXIT_FAILURE;
+    }
+    chunk->indices = indices;
+
+    double *values = (double *) realloc(chunk->values, 2 * (size_t) capacity * sizeof(double));
+    if (values == NULL) {
+        return EXIT_FAILURE;
+    }
+    chunk->values = values;
+
+    chunk->capacity = capacity;
+    return EXIT_SUCCESS;
+}
+
+
+/*
+ * Kramers pair index (negative for the barred spinor) -> spinor index (1-based),
+ * zero for a wrong index
+ */
+static int kramers_to_spinor(const mdcint_header_t *header, int32_t kr)
+{
+    if (kr > 0 && kr <= header->nkr) {
+        return header->kramers_pairs[2 * (kr - 1)];
+    }
+    else if (kr < 0 && -kr <= header->nkr) {
+        return header->kramers_pairs[2 * (-kr - 1) + 1];
+    }
+    return 0;
+}
+
+
+/*
+ * formats the integrals of the chunk in parallel and writes them in order;
+ * the chunk is emptied
+ */
+static int flush_chunk(FILE *out, fcidump_chunk_t *chunk, int is_real, fcidump_buffers_t *buffers,
+                       int64_t *bytes_written)
+{
+    int num_threads = buffers->num_threads;
+    int64_t n = chunk->size;
+    int n_values = is_real ? 1 : 2;
+    int error = 0;
+
+    if (n == 0) {
+        return EXIT_SUCCESS;
+    }
+
+    memset(buffers->text_len, 0, num_threads * sizeof(size_t));
+
+    #pragma omp parallel num_threads(num_threads) reduction(|:error)
+    {
+#ifdef _OPENMP
+        int ith = omp_get_thread_num();
+        int n_threads = omp_get_num_threads();
+#else
+        int ith = 0;
+        int n_threads = 1;
+#endif
+        int64_t first = n * ith / n_threads;
+        int64_t last = n * (ith + 1) / n_threads;
+
+        size_t capacity = (size_t) (last - first) * FCIDUMP_MAX_LINE_LEN;
+        if (capacity > buffers->text_capacity[ith]) {
+            free(buffers->text[ith]);
+            buffers->text[ith] = (char *) malloc(capacity);
+            buffers->text_capacity[ith] = buffers->text[ith] ? capacity : 0;
+        }
+
+        char *p = buffers->text[ith];
+        if (p == NULL && last > first) {
+            error = 1;
+            last = first;
+        }
+        for (int64_t inz = first; inz < last; inz++) {
+            const int32_t *ind = chunk->indices + 4 * inz;
+            p += format_line(p, chunk->values + n_values * inz, is_real, ind[0], ind[1], ind[2], ind[3]);
+        }
+        buffers->text_len[ith] = p - buffers->text[ith];
+    }
+
+    chunk->size = 0;
+
+    if (error) {
+        errno = ENOMEM;
+        return EXIT_FAILURE;
+    }
+
+    for (int ith = 0; ith < num_threads; ith++) {
+        size_t len = buffers->text_len[ith];
+        if (len > 0 && fwrite(buffers->text[ith], 1, len, out) != len) {
+            return EXIT_FAILURE;
+        }
+        *bytes_written += len;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+
+/*
+ * "value i j k l\n" or "re im i j k l\n", returns the length
+ */
+static size_t format_line(char *buf, const double *value, int is_real, int32_t i, int32_t j, int32_t k, int32_t l)
+{
+    char *p = buf;
+
+    p += format_double(p, value[0]);
+    if (!is_real) {
+        *p++ = ' ';
+        p += format_double(p, value[1]);
+    }
+
+    int32_t indices[4] = {i, j, k, l};
+    for (int m = 0; m < 4; m++) {
+        *p++ = ' ';
+        p += format_int(p, indices[m]);
+    }
+    *p++ = '\n';
+
+    return (size_t) (p - buf);
+}
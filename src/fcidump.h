@@ -0,0 +1,35 @@
+/*
+ * Inspector of DIRAC files containing transformed molecular integrals.
+ *
+ * 2024 Alexander Oleynichenko
+ */
+
+#ifndef DIRAC_INSPECTOR_FCIDUMP_H
+#define DIRAC_INSPECTOR_FCIDUMP_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "mrconee.h"
+
+/*
+ * summary of the export, see write_fcidump()
+ */
+typedef struct {
+    int64_t num_two_electron;   // number of two-electron integrals written
+    int64_t num_one_electron;   // number of non-zero Fock matrix elements written
+    int64_t bytes_written;
+    double time;                // seconds
+    char error[256];            // empty string if the export succeeded
+} fcidump_result_t;
+
+int write_fcidump(char *path, mrconee_data_t *mrconee_data, char *mdcint_path, fcidump_result_t *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DIRAC_INSPECTOR_FCIDUMP_H
@@ -0,0 +1,95 @@
+/*
+ * Inspector of DIRAC files containing transformed molecular integrals.
+ *
+ * 2024 Alexander Oleynichenko
+ */
+
+#include "fock_analysis.h"
+
+#include <complex.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "matrix_analysis.h"
+#include "mrconee.h"
+
+
+/**
+ * Structural analysis of the Fock matrix stored in the MRCONEE file.
+ * Non-zero off-diagonal elements or diagonal elements differing from
+ * spinor energies indicate non-canonical orbitals.
+ * Returns NULL if there is no Fock matrix.
+ */
+fock_analysis_t *analyze_fock_matrix(mrconee_data_t *data)
+{
+    const double canonical_thresh = 1e-8;
+
+    int dim = data->num_spinors;
+    int num_irreps = data->num_irreps;
+    double _Complex *fock = data->fock;
+
+    if (fock == NULL || dim <= 0) {
+        return NULL;
+    }
+
+    fock_analysis_t *result = (fock_analysis_t *) calloc(1, sizeof(fock_analysis_t));
+    if (result == NULL) {
+        return NULL;
+    }
+    result->dim = dim;
+    result->num_irreps = num_irreps;
+
+    result->hermiticity_deviation = matrix_hermiticity_deviation(dim, fock);
+
+    matrix_off_diagonal_stats(dim, fock, &result->max_off_diag, &result->off_diag_norm,
+                              &result->max_row_ratio, &result->num_non_dominant_rows);
+
+    // diagonal vs one-electron energies
+    double max_diag_dev = 0.0;
+    double max_diag_imag = 0.0;
+    #pragma omp parallel for simd reduction(max:max_diag_dev, max_diag_imag)
+    for (int i = 0; i < dim; i++) {
+        double _Complex f_ii = fock[(size_t) i * dim + i];
+        double dev = fabs(creal(f_ii) - data->spinor_energies[i]);
+        double imag = fabs(cimag(f_ii));
+        max_diag_dev = dev > max_diag_dev ? dev : max_diag_dev;
+        max_diag_imag = imag > max_diag_imag ? imag : max_diag_imag;
+    }
+    result->max_diag_deviation = max_diag_dev;
+    result->max_diag_imag = max_diag_imag;
+    result->is_canonical = result->max_off_diag <= canonical_thresh && max_diag_dev <= canonical_thresh;
+
+    // blocks (irep, jrep) and (jrep, irep) are merged
+    double *block_max = (double *) calloc((size_t) num_irreps * num_irreps, sizeof(double));
+    if (block_max == NULL) {
+        free(result);
+        return NULL;
+    }
+    matrix_block_max_abs(dim, fock, dim, data->spinor_irreps, num_irreps, 1, block_max);
+    for (int irep = 0; irep < num_irreps; irep++) {
+        for (int jrep = irep; jrep < num_irreps; jrep++) {
+            double max_ij = block_max[irep * num_irreps + jrep];
+            double max_ji = block_max[jrep * num_irreps + irep];
+            double max_abs = max_ij > max_ji ? max_ij : max_ji;
+            block_max[irep * num_irreps + jrep] = max_abs;
+            block_max[jrep * num_irreps + irep] = max_abs;
+        }
+    }
+    result->block_max = block_max;
+
+    matrix_sparsity_profile(dim, fock, result->sparsity);
+
+    return result;
+}
+
+
+void free_fock_analysis(fock_analysis_t *analysis)
+{
+    if (analysis == NULL) {
+        return;
+    }
+
+    free(analysis->block_max);
+    free(analysis);
+}
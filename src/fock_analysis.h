@@ -0,0 +1,42 @@
+/*
+ * Inspector of DIRAC files containing transformed molecular integrals.
+ *
+ * 2024 Alexander Oleynichenko
+ */
+
+#ifndef DIRAC_INSPECTOR_FOCK_ANALYSIS_H
+#define DIRAC_INSPECTOR_FOCK_ANALYSIS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "matrix_analysis.h"
+#include "mrconee.h"
+
+typedef struct {
+    int dim;
+    int num_irreps;
+    double hermiticity_deviation;   // max |F_ij - conj(F_ji)|
+    double max_off_diag;            // max |F_ij|, i != j
+    double off_diag_norm;           // Frobenius norm of the off-diagonal part
+    double max_diag_deviation;      // max |Re F_ii - spinor energy|
+    double max_diag_imag;           // max |Im F_ii|
+    double max_row_ratio;           // max sum_{j != i} |F_ij| / |F_ii|
+    int num_non_dominant_rows;      // rows without diagonal dominance
+    int is_canonical;
+    double *block_max;              // max off-diagonal |F_ij| in the blocks of irreps, symmetric
+    int64_t sparsity[MATRIX_SPARSITY_NUM_BINS];
+} fock_analysis_t;
+
+fock_analysis_t *analyze_fock_matrix(mrconee_data_t *data);
+
+void free_fock_analysis(fock_analysis_t *analysis);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DIRAC_INSPECTOR_FOCK_ANALYSIS_H
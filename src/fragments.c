@@ -0,0 +1,514 @@
+/*
+ * Inspector of DIRAC files containing transformed molecular integrals.
+ *
+ * Merging and load-balanced re-splitting of MDCINT fragments.
+ *
+ * 2024 Alexander Oleynichenko
+ */
+
+#include "fragments.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "libunf.h"
+#include "mrconee.h"
+#include "util.h"
+
+/*
+ * Each fragment written by DIRAC is a complete MDCINT file: the header record,
+ * records of integrals and the end mark (ikr = jkr = 0). Records are never
+ * decoded here: the number of integrals in a record follows from its length,
+ * so the index of records (unf_build_index) is enough to plan the output.
+ * Output fragments get contiguous runs of records balanced by the number of
+ * integrals, and the runs are copied as byte ranges by OpenMP threads.
+ */
+
+// byte ranges are copied by pieces of this size
+#define FRAGMENTS_COPY_CHUNK (16 * 1024 * 1024)
+#define FRAGMENTS_MAX_PATH_LEN 1024
+// paths quoted in error messages are cut to this length, so that two of them fit into result->error
+#define FRAGMENTS_ERROR_PATH_LEN 100
+
+typedef struct {
+    char *path;
+    unf_file_t *file;
+    unf_rec_index_t *index;
+    char *header;             // payload of the header record
+    int32_t header_len;
+} fragment_t;
+
+/*
+ * byte range copied from the input fragment to the output one
+ */
+typedef struct {
+    int in;
+    int out;
+    int64_t in_offset;
+    int64_t out_offset;
+    int64_t n_bytes;
+} copy_job_t;
+
+typedef struct {
+    copy_job_t *jobs;
+    int64_t num_jobs;
+    int64_t capacity;
+} job_list_t;
+
+static int open_fragment(fragment_t *frag, char *path, mrconee_data_t *mrconee_data, fragments_result_t *result);
+
+static void close_fragment(fragment_t *frag);
+
+static int64_t record_integrals(int32_t rec_len, int int_size, int64_t integral_size);
+
+static int add_jobs(job_list_t *list, int in, int out, int64_t in_offset, int64_t out_offset, int64_t n_bytes);
+
+static int copy_range(int fd_in, int64_t in_offset, int fd_out, int64_t out_offset, int64_t n_bytes,
+                      char *buf, size_t buf_size);
+
+
+
+/**
+ * Finds fragments of MDCINT written by parallel DIRAC runs: the file itself and
+ * MDCINXXXX1, MDCINXXXX2, ... in the same directory. Paths are allocated
+ * by malloc and are to be freed by the caller.
+ *
+ * Returns the number of paths found (0 if MDCINT does not exist).
+ */
+int find_mdcint_fragments(char *mdcint_path, char **paths, int max_paths)
+{
+    struct stat st;
+    if (max_paths < 1 || stat(mdcint_path, &st) != 0) {
+        return 0;
+    }
+
+    paths[0] = strdup(mdcint_path);
+    if (paths[0] == NULL) {
+        return 0;
+    }
+
+    char *slash = strrchr(mdcint_path, '/');
+    int dir_len = slash ? (int) (slash - mdcint_path + 1) : 0;
+    int num_paths = 1;
+
+    while (num_paths < max_paths) {
+        char name[64];
+        char path[FRAGMENTS_MAX_PATH_LEN];
+        mdcint_fragment_name(num_paths, name, sizeof(name));
+        if (snprintf(path, sizeof(path), "%.*s%s", dir_len, mdcint_path, name) >= (int) sizeof(path) ||
+            stat(path, &st) != 0) {
+            break;
+        }
+        paths[num_paths] = strdup(path);
+        if (paths[num_paths] == NULL) {
+            break;
+        }
+        num_paths++;
+    }
+
+    return num_paths;
+}
+
+
+/**
+ * Name of the file of the given fragment (counting from 0), as in parallel DIRAC runs:
+ * MDCINT, MDCINXXXX1, MDCINXXXX2, ...
+ */
+void mdcint_fragment_name(int fragment, char *name, size_t size)
+{
+    if (fragment == 0) {
+        snprintf(name, size, "MDCINT");
+    }
+    else {
+        snprintf(name, size, "MDCINXXXX%d", fragment);
+    }
+}
+
+
+/**
+ * Merges MDCINT fragments into one file (num_outputs = 1) or re-splits them
+ * into num_outputs files balanced by the number of integrals. Output files
+ * are written to the directory 'dir' and named by mdcint_fragment_name().
+ *
+ * Records keep their order: each output gets a contiguous run of records of
+ * the concatenated input, so the number of integrals in any output differs
+ * from the ideal share by less than the size of one record. Headers of the
+ * inputs must coincide (except for the date and time); the header and the
+ * end mark of the first input are written to every output.
+ *
+ * Returns EXIT_SUCCESS or EXIT_FAILURE (with the message in result->error).
+ */
+int resplit_mdcint(char **in_paths, int num_inputs, char *dir, int num_outputs, mrconee_data_t *mrconee_data,
+                   fragments_result_t *result)
+{
+    memset(result, 0, sizeof(fragments_result_t));
+    double time_start = abs_time();
+
+    result->num_inputs = num_inputs;
+    result->num_outputs = num_outputs;
+
+    if (num_inputs < 1 || num_inputs > MDCINT_MAX_FRAGMENTS ||
+        num_outputs < 1 || num_outputs > MDCINT_MAX_FRAGMENTS) {
+        snprintf(result->error, sizeof(result->error), "wrong number of fragments");
+        return EXIT_FAILURE;
+    }
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+        snprintf(result->error, sizeof(result->error), "cannot create directory %.*s: %s",
+                 FRAGMENTS_ERROR_PATH_LEN, dir, strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    int int_size = mrconee_data->dirac_int_size;
+    int is_real = mrconee_data->group_arith == 1 || mrconee_data->is_spinfree == 1;
+    int64_t integral_size = 2 * int_size + (is_real ? sizeof(double) : 2 * sizeof(double));
+
+    fragment_t *inputs = (fragment_t *) calloc(num_inputs, sizeof(fragment_t));
+    int *out_fds = (int *) malloc(num_outputs * sizeof(int));
+    int64_t *out_sizes = (int64_t *) calloc(num_outputs, sizeof(int64_t));
+    int64_t *out_integrals = (int64_t *) calloc(num_outputs, sizeof(int64_t));
+    char (*out_paths)[FRAGMENTS_MAX_PATH_LEN] =
+        (char (*)[FRAGMENTS_MAX_PATH_LEN]) malloc(num_outputs * sizeof(*out_paths));
+    job_list_t list = {NULL, 0, 0};
+
+    if (inputs == NULL || out_fds == NULL || out_sizes == NULL || out_integrals == NULL || out_paths == NULL) {
+        snprintf(result->error, sizeof(result->error), "%s", strerror(ENOMEM));
+    }
+    for (int k = 0; k < num_outputs && out_fds; k++) {
+        out_fds[k] = -1;
+    }
+
+    // index of records of all inputs
+    for (int i = 0; i < num_inputs && result->error[0] == '\0'; i++) {
+        if (open_fragment(&inputs[i], in_paths[i], mrconee_data, result) == EXIT_SUCCESS &&
+            (inputs[i].header_len != inputs[0].header_len ||
+             memcmp(inputs[i].header + 18, inputs[0].header + 18, inputs[i].header_len - 18) != 0)) {
+            snprintf(result->error, sizeof(result->error), "headers of %.*s and %.*s differ",
+                     FRAGMENTS_ERROR_PATH_LEN, in_paths[0], FRAGMENTS_ERROR_PATH_LEN, in_paths[i]);
+        }
+    }
+
+    // total number of integrals
+    int64_t total = 0;
+    for (int i = 0; i < num_inputs && result->error[0] == '\0'; i++) {
+        unf_rec_index_t *index = inputs[i].index;
+        for (int64_t r = 1; r < index->num_records - 1; r++) {
+            total += record_integrals(index->lengths[r], int_size, integral_size);
+        }
+        result->num_records += index->num_records - 2;
+    }
+    result->num_integrals = total;
+
+    /*
+     * record with integrals from 'prefix' to 'prefix + n' (counting through all inputs)
+     * goes to the output in which its midpoint falls; runs of records going to the
+     * same output from the same input become byte ranges to be copied
+     */
+    int64_t header_bytes = inputs && inputs[0].index ? inputs[0].index->offsets[1] : 0;
+    for (int k = 0; k < num_outputs && result->error[0] == '\0'; k++) {
+        out_sizes[k] = header_bytes;
+    }
+
+    int64_t prefix = 0;
+    for (int i = 0; i < num_inputs && result->error[0] == '\0'; i++) {
+        unf_rec_index_t *index = inputs[i].index;
+        int64_t end_rec = index->num_records - 1;
+        int64_t run_start = 1;
+        int run_out = -1;
+
+        for (int64_t r = 1; r <= end_rec; r++) {
+            int out = run_out;
+            int64_t n = 0;
+            if (r < end_rec) {
+                n = record_integrals(index->lengths[r], int_size, integral_size);
+                out = total > 0 ? (int) ((2 * prefix + n) * num_outputs / (2 * total)) : 0;
+                out = out < num_outputs ? out : num_outputs - 1;
+            }
+            if (run_out >= 0 && (out != run_out || r == end_rec)) {
+                int64_t n_bytes = index->offsets[r] - index->offsets[run_start];
+                if (add_jobs(&list, i, run_out, index->offsets[run_start], out_sizes[run_out], n_bytes)
+                    == EXIT_FAILURE) {
+                    snprintf(result->error, sizeof(result->error), "%s", strerror(ENOMEM));
+                    break;
+                }
+                out_sizes[run_out] += n_bytes;
+                run_start = r;
+            }
+            run_out = out;
+            prefix += n;
+            if (r < end_rec) {
+                out_integrals[out] += n;
+            }
+        }
+    }
+
+    // output files; the header and the end mark are taken from the first input
+    for (int k = 0; k < num_outputs && result->error[0] == '\0'; k++) {
+        char name[64];
+        mdcint_fragment_name(k, name, sizeof(name));
+        if (snprintf(out_paths[k], FRAGMENTS_MAX_PATH_LEN, "%s/%s", dir, name) >= FRAGMENTS_MAX_PATH_LEN) {
+            snprintf(result->error, sizeof(result->error), "path is too long: %.*s/%.*s",
+                     FRAGMENTS_ERROR_PATH_LEN, dir, FRAGMENTS_ERROR_PATH_LEN, name);
+            break;
+        }
+        for (int i = 0; i < num_inputs; i++) {
+            if (unf_same_file(in_paths[i], out_paths[k])) {
+                snprintf(result->error, sizeof(result->error), "%.*s would be overwritten",
+                         FRAGMENTS_ERROR_PATH_LEN, in_paths[i]);
+                break;
+            }
+        }
+        if (result->error[0] != '\0') {
+            break;
+        }
+        out_fds[k] = open(out_paths[k], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (out_fds[k] < 0) {
+            snprintf(result->error, sizeof(result->error), "cannot open %.*s: %s",
+                     FRAGMENTS_ERROR_PATH_LEN, out_paths[k], strerror(errno));
+            break;
+        }
+
+        unf_rec_index_t *index = inputs[0].index;
+        int64_t end_offset = index->offsets[index->num_records - 1];
+        int64_t end_bytes = 3 * (int64_t) int_size + 2 * sizeof(int32_t);
+        if (add_jobs(&list, 0, k, 0, 0, header_bytes) == EXIT_FAILURE ||
+            add_jobs(&list, 0, k, end_offset, out_sizes[k], end_bytes) == EXIT_FAILURE) {
+            snprintf(result->error, sizeof(result->error), "%s", strerror(ENOMEM));
+            break;
+        }
+        out_sizes[k] += end_bytes;
+    }
+
+    // byte ranges are copied in parallel
+    if (result->error[0] == '\0') {
+        int n_failed = 0;
+        int64_t first_failed = -1;
+        int copy_errno = 0;
+
+        #pragma omp parallel reduction(+:n_failed)
+        {
+            char *buf = (char *) malloc(FRAGMENTS_COPY_CHUNK);
+
+            #pragma omp for schedule(dynamic)
+            for (int64_t j = 0; j < list.num_jobs; j++) {
+                copy_job_t *job = &list.jobs[j];
+                int fd_in = unf_fileno(inputs[job->in].file);
+                errno = 0;
+                if (buf == NULL ||
+                    copy_range(fd_in, job->in_offset, out_fds[job->out], job->out_offset, job->n_bytes,
+                               buf, FRAGMENTS_COPY_CHUNK) == EXIT_FAILURE) {
+                    n_failed++;
+                    #pragma omp critical(fragments_copy_error)
+                    if (first_failed < 0 || j < first_failed) {
+                        first_failed = j;
+                        copy_errno = buf == NULL ? ENOMEM : errno;
+                    }
+                }
+            }
+
+            free(buf);
+        }
+
+        if (n_failed > 0) {
+            copy_job_t *job = &list.jobs[first_failed];
+            snprintf(result->error, sizeof(result->error), "error while copying %.*s to %.*s: %s",
+                     FRAGMENTS_ERROR_PATH_LEN, in_paths[job->in], FRAGMENTS_ERROR_PATH_LEN, out_paths[job->out],
+                     copy_errno ? strerror(copy_errno) : "unexpected end of file");
+        }
+    }
+
+    for (int k = 0; k < num_outputs && out_fds; k++) {
+        if (out_fds[k] >= 0 && close(out_fds[k]) != 0 && result->error[0] == '\0') {
+            snprintf(result->error, sizeof(result->error), "error while writing %.*s: %s",
+                     FRAGMENTS_ERROR_PATH_LEN, out_paths[k], strerror(errno));
+        }
+    }
+
+    if (result->error[0] == '\0') {
+        result->min_integrals = out_integrals[0];
+        result->max_integrals = out_integrals[0];
+        for (int k = 0; k < num_outputs; k++) {
+            result->min_integrals = out_integrals[k] < result->min_integrals ? out_integrals[k] : result->min_integrals;
+            result->max_integrals = out_integrals[k] > result->max_integrals ? out_integrals[k] : result->max_integrals;
+            result->bytes_written += out_sizes[k];
+        }
+    }
+
+    for (int i = 0; i < num_inputs && inputs; i++) {
+        close_fragment(&inputs[i]);
+    }
+    free(inputs);
+    free(out_fds);
+    free(out_sizes);
+    free(out_integrals);
+    free(out_paths);
+    free(list.jobs);
+
+    result->time = abs_time() - time_start;
+
+    return result->error[0] == '\0' ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+/*
+ * opens the input fragment, builds the index of its records and validates
+ * the structure: header, records of integrals, end mark
+ */
+static int open_fragment(fragment_t *frag, char *path, mrconee_data_t *mrconee_data, fragments_result_t *result)
+{
+    int int_size = mrconee_data->dirac_int_size;
+    int is_real = mrconee_data->group_arith == 1 || mrconee_data->is_spinfree == 1;
+    int64_t integral_size = 2 * int_size + (is_real ? sizeof(double) : 2 * sizeof(double));
+
+    frag->path = path;
+    frag->file = unf_open(path, "r", UNF_ACCESS_SEQUENTIAL);
+    if (frag->file == NULL) {
+        snprintf(result->error, sizeof(result->error), "cannot open %.*s: %s",
+                 FRAGMENTS_ERROR_PATH_LEN, path, strerror(errno));
+        return EXIT_FAILURE;
+    }
+    unf_set_byte_order(frag->file, mrconee_data->swap_bytes ? UNF_BYTE_ORDER_SWAPPED : UNF_BYTE_ORDER_NATIVE);
+
+    frag->index = unf_build_index(frag->file, 0);
+    if (frag->index == NULL || frag->index->num_records < 2) {
+        snprintf(result->error, sizeof(result->error), "%.*s is not a valid MDCINT file",
+                 FRAGMENTS_ERROR_PATH_LEN, path);
+        return EXIT_FAILURE;
+    }
+
+    unf_rec_index_t *index = frag->index;
+    frag->header_len = index->lengths[0];
+    frag->header = (char *) malloc(frag->header_len);
+    if (frag->header == NULL) {
+        snprintf(result->error, sizeof(result->error), "%s", strerror(ENOMEM));
+        return EXIT_FAILURE;
+    }
+    unf_status_t status = unf_read_record_at(frag->file, 0, frag->header, frag->header_len, NULL, NULL);
+    if (status != UNF_STATUS_OK || frag->header_len < 18) {
+        snprintf(result->error, sizeof(result->error), "cannot read the header of %.*s",
+                 FRAGMENTS_ERROR_PATH_LEN, path);
+        return EXIT_FAILURE;
+    }
+
+    for (int64_t r = 1; r < index->num_records - 1; r++) {
+        int32_t len = index->lengths[r];
+        int64_t n = record_integrals(len, int_size, integral_size);
+        if (len < 3 * int_size || len != 3 * int_size + n * integral_size) {
+            snprintf(result->error, sizeof(result->error), "wrong length of record %lld of %.*s",
+                     (long long) (r + 1), FRAGMENTS_ERROR_PATH_LEN, path);
+            return EXIT_FAILURE;
+        }
+    }
+
+    // end mark: ikr = jkr = nonzr = 0 (zero in any byte order)
+    int64_t end_mark[3];
+    int64_t end_rec = index->num_records - 1;
+    status = unf_read_record_at(frag->file, index->offsets[end_rec], end_mark, sizeof(end_mark), NULL, NULL);
+    if (status != UNF_STATUS_OK || index->lengths[end_rec] != 3 * int_size ||
+        memcmp(end_mark, (int64_t[3]) {0, 0, 0}, 3 * int_size) != 0) {
+        snprintf(result->error, sizeof(result->error), "%.*s does not end with the end mark",
+                 FRAGMENTS_ERROR_PATH_LEN, path);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+
+static void close_fragment(fragment_t *frag)
+{
+    if (frag->index) {
+        unf_free_index(frag->index);
+    }
+    if (frag->file) {
+        unf_close(frag->file);
+    }
+    free(frag->header);
+}
+
+
+/*
+ * number of integrals in the record of the given length
+ */
+static int64_t record_integrals(int32_t rec_len, int int_size, int64_t integral_size)
+{
+    if (rec_len < 3 * int_size) {
+        return 0;
+    }
+
+    return (rec_len - 3 * int_size) / integral_size;
+}
+
+
+/*
+ * adds the byte range to the list, split into pieces of FRAGMENTS_COPY_CHUNK
+ * so that large ranges are copied by several threads
+ */
+static int add_jobs(job_list_t *list, int in, int out, int64_t in_offset, int64_t out_offset, int64_t n_bytes)
+{
+    for (int64_t done = 0; done < n_bytes; done += FRAGMENTS_COPY_CHUNK) {
+        if (list->num_jobs == list->capacity) {
+            int64_t capacity = list->capacity > 0 ? 2 * list->capacity : 1024;
+            copy_job_t *jobs = (copy_job_t *) realloc(list->jobs, capacity * sizeof(copy_job_t));
+            if (jobs == NULL) {
+                return EXIT_FAILURE;
+            }
+            list->jobs = jobs;
+            list->capacity = capacity;
+        }
+
+        copy_job_t *job = &list->jobs[list->num_jobs++];
+        job->in = in;
+        job->out = out;
+        job->in_offset = in_offset + done;
+        job->out_offset = out_offset + done;
+        job->n_bytes = n_bytes - done < FRAGMENTS_COPY_CHUNK ? n_bytes - done : FRAGMENTS_COPY_CHUNK;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+
+/*
+ * copies the byte range by pread/pwrite (no file positions are involved,
+ * so that threads can share the files)
+ */
+static int copy_range(int fd_in, int64_t in_offset, int fd_out, int64_t out_offset, int64_t n_bytes,
+                      char *buf, size_t buf_size)
+{
+    while (n_bytes > 0) {
+        size_t len = (size_t) n_bytes < buf_size ? (size_t) n_bytes : buf_size;
+
+        for (size_t done = 0; done < len; ) {
+            ssize_t n = pread(fd_in, buf + done, len - done, (off_t) (in_offset + done));
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return EXIT_FAILURE;
+            }
+            done += (size_t) n;
+        }
+        for (size_t done = 0; done < len; ) {
+            ssize_t n = pwrite(fd_out, buf + done, len - done, (off_t) (out_offset + done));
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return EXIT_FAILURE;
+            }
+            done += (size_t) n;
+        }
+
+        in_offset += len;
+        out_offset += len;
+        n_bytes -= len;
+    }
+
+    return EXIT_SUCCESS;
+}
+
@@ -0,0 +1,47 @@
+/*
+ * Inspector of DIRAC files containing transformed molecular integrals.
+ *
+ * 2024 Alexander Oleynichenko
+ */
+
+#ifndef DIRAC_INSPECTOR_FRAGMENTS_H
+#define DIRAC_INSPECTOR_FRAGMENTS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "mrconee.h"
+
+// max number of input or output fragments
+#define MDCINT_MAX_FRAGMENTS 4096
+
+/*
+ * summary of merging or re-splitting, see resplit_mdcint()
+ */
+typedef struct {
+    int num_inputs;
+    int num_outputs;
+    int64_t num_records;        // records of integrals (without headers and end marks)
+    int64_t num_integrals;
+    int64_t min_integrals;      // smallest number of integrals in an output fragment
+    int64_t max_integrals;      // largest number of integrals in an output fragment
+    int64_t bytes_written;
+    double time;                // seconds
+    char error[256];            // empty string if succeeded
+} fragments_result_t;
+
+int find_mdcint_fragments(char *mdcint_path, char **paths, int max_paths);
+
+void mdcint_fragment_name(int fragment, char *name, size_t size);
+
+int resplit_mdcint(char **in_paths, int num_inputs, char *dir, int num_outputs, mrconee_data_t *mrconee_data,
+                   fragments_result_t *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DIRAC_INSPECTOR_FRAGMENTS_H
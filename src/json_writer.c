@@ -0,0 +1,197 @@
+/*
+ * Inspector of DIRAC files containing transformed molecular integrals.
+ *
+ * Streaming JSON writer.
+ *
+ * 2024 Alexander Oleynichenko
+ */
+
+#include "json_writer.h"
+
+#include <math.h>
+
+static void begin_value(json_writer_t *w);
+
+static void indent(json_writer_t *w);
+
+static void write_string(FILE *out, const char *str);
+
+
+void json_init(json_writer_t *w, FILE *out)
+{
+    w->out = out;
+    w->depth = 0;
+    w->num_items[0] = 0;
+    w->after_key = 0;
+}
+
+
+void json_begin_object(json_writer_t *w)
+{
+    begin_value(w);
+    fputc('{', w->out);
+    w->depth++;
+    w->num_items[w->depth] = 0;
+}
+
+
+void json_end_object(json_writer_t *w)
+{
+    int empty = w->num_items[w->depth] == 0;
+    w->depth--;
+    if (!empty) {
+        indent(w);
+    }
+    fputc('}', w->out);
+    if (w->depth == 0) {
+        fputc('\n', w->out);
+    }
+}
+
+
+void json_begin_array(json_writer_t *w)
+{
+    begin_value(w);
+    fputc('[', w->out);
+    w->depth++;
+    w->num_items[w->depth] = 0;
+}
+
+
+void json_end_array(json_writer_t *w)
+{
+    int empty = w->num_items[w->depth] == 0;
+    w->depth--;
+    if (!empty) {
+        indent(w);
+    }
+    fputc(']', w->out);
+    if (w->depth == 0) {
+        fputc('\n', w->out);
+    }
+}
+
+
+void json_key(json_writer_t *w, const char *key)
+{
+    begin_value(w);
+    write_string(w->out, key);
+    fputs(": ", w->out);
+    w->after_key = 1;
+}
+
+
+void json_string(json_writer_t *w, const char *str)
+{
+    if (str == NULL) {
+        json_null(w);
+        return;
+    }
+
+    begin_value(w);
+    write_string(w->out, str);
+}
+
+
+void json_int(json_writer_t *w, int64_t value)
+{
+    begin_value(w);
+    fprintf(w->out, "%lld", (long long) value);
+}
+
+
+/*
+ * doubles are written with 17 significant digits (exact round trip);
+ * NaN and infinities are not representable in JSON and are written as null
+ */
+void json_double(json_writer_t *w, double value)
+{
+    if (!isfinite(value)) {
+        json_null(w);
+        return;
+    }
+
+    begin_value(w);
+    fprintf(w->out, "%.17g", value);
+}
+
+
+void json_bool(json_writer_t *w, int value)
+{
+    begin_value(w);
+    fputs(value ? "true" : "false", w->out);
+}
+
+
+void json_null(json_writer_t *w)
+{
+    begin_value(w);
+    fputs("null", w->out);
+}
+
+
+/*
+ * writes the separator and indentation preceding a value (or a key) in the current container
+ */
+static void begin_value(json_writer_t *w)
+{
+    if (w->after_key) {
+        w->after_key = 0;
+        return;
+    }
+    if (w->depth == 0) {
+        return;
+    }
+
+    if (w->num_items[w->depth] > 0) {
+        fputc(',', w->out);
+    }
+    w->num_items[w->depth]++;
+    indent(w);
+}
+
+
+static void indent(json_writer_t *w)
+{
+    fputc('\n', w->out);
+    for (int i = 0; i < w->depth; i++) {
+        fputs("  ", w->out);
+    }
+}
+
+
+/*
+ * control characters, quotes and backslashes are escaped;
+ * other bytes (including UTF-8 sequences) are written as is
+ */
+static void write_string(FILE *out, const char *str)
+{
+    fputc('"', out);
+    for (const unsigned char *p = (const unsigned char *) str; *p; p++) {
+        switch (*p) {
+            case '"':
+                fputs("\\\"", out);
+                break;
+            case '\\':
+                fputs("\\\\", out);
+                break;
+            case '\n':
+                fputs("\\n", out);
+                break;
+            case '\t':
+                fputs("\\t", out);
+                break;
+            case '\r':
+                fputs("\\r", out);
+                break;
+            default:
+                if (*p < 0x20) {
+                    fprintf(out, "\\u%04x", *p);
+                }
+                else {
+                    fputc(*p, out);
+                }
+        }
+    }
+    fputc('"', out);
+}
@@ -0,0 +1,47 @@
+/*
+ * Inspector of DIRAC files containing transformed molecular integrals.
+ *
+ * Streaming JSON writer: values are written to the stream as soon as they are
+ * emitted, only the nesting state is kept in memory.
+ *
+ * 2024 Alexander Oleynichenko
+ */
+
+#ifndef DIRAC_INSPECTOR_JSON_WRITER_H
+#define DIRAC_INSPECTOR_JSON_WRITER_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define JSON_MAX_DEPTH 32
+
+typedef struct {
+    FILE *out;
+    int depth;
+    int num_items[JSON_MAX_DEPTH];  // number of values already written at each level
+    int after_key;                  // the next value belongs to the key just written
+} json_writer_t;
+
+void json_init(json_writer_t *w, FILE *out);
+
+void json_begin_object(json_writer_t *w);
+
+void json_end_object(json_writer_t *w);
+
+void json_begin_array(json_writer_t *w);
+
+void json_end_array(json_writer_t *w);
+
+void json_key(json_writer_t *w, const char *key);
+
+void json_string(json_writer_t *w, const char *str);
+
+void json_int(json_writer_t *w, int64_t value);
+
+void json_double(json_writer_t *w, double value);
+
+void json_bool(json_writer_t *w, int value);
+
+void json_null(json_writer_t *w);
+
+#endif // DIRAC_INSPECTOR_JSON_WRITER_H
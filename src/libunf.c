@@ -12,10 +12,50 @@
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
+#include <limits.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <stdlib.h>
 
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define UNF_HAVE_AVX2_DISPATCH
+#endif
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
 #include "libunf.h"
+#include "unf_aio.h"
+
+/*
+ * records not larger than this size (markers included) are assembled in memory
+ * and written at once, larger records are streamed to the file
+ */
+#define UNF_WRITE_BUFFER_MAX (16 * 1024 * 1024)
+
+/*
+ * size of the stdio buffer for files opened for writing
+ */
+#define UNF_STDIO_WRITE_BUFFER (1024 * 1024)
+
+/*
+ * records not larger than this size are read by unf_read_at() to the stack
+ */
+#define UNF_SMALL_RECORD_SIZE 4096
+
+/*
+ * max number of destination segments of unf_read_segments_at()
+ */
+#define UNF_MAX_SEGMENTS 16
+
+/*
+ * default size of the record cache of direct-access files
+ */
+#define UNF_CACHE_SIZE (4 * 1024 * 1024)
+#define UNF_CACHE_MAX_SLOTS 4096
 
 enum {
     TYPE_CHAR,
@@ -29,9 +69,20 @@ enum {
     TYPE_COMPLEX_8,
 };
 
-static int try_read_bytes(unf_file_t *file, char *fmt, size_t *n_bytes_read, int *n_args_read, va_list ap);
+static int try_read_bytes(unf_file_t *file, char *fmt, const char *buf, size_t buf_len,
+                          size_t *n_bytes_read, int *n_args_read, va_list ap);
+
+/*
+ * destination of the data processed by try_write_bytes()
+ */
+typedef enum {
+    WRITE_DRY_RUN,   // only count bytes, nothing is written
+    WRITE_TO_BUFFER, // assemble the record in memory
+    WRITE_TO_FILE    // stream data directly to the file
+} write_mode_t;
 
-static int try_write_bytes(unf_file_t *file, char *fmt, size_t *n_bytes_written, int *n_args_written, va_list ap);
+static int try_write_bytes(unf_file_t *file, char *fmt, write_mode_t mode, char *buf,
+                           size_t *n_bytes_written, int *n_args_written, va_list ap);
 
 static int fmt_get_type_size(char **fmt, int *data_type, int *type_size, int *num_repeats);
 
@@ -39,6 +90,231 @@ static int seek_backward(unf_file_t *file);
 
 static int seek_forward(unf_file_t *file);
 
+static void byte_swap_scalar(void *data, size_t n_elements, int elem_size);
+
+static int read_marker(unf_file_t *file, int32_t *record_size);
+
+static int write_marker(unf_file_t *file, int32_t record_size);
+
+static int get_swap_unit(int data_type, int type_size);
+
+static int write_swapped(unf_file_t *file, void *data, size_t n_bytes, int swap_unit);
+
+static int write_record(unf_file_t *file, char *fmt, va_list ap);
+
+static int write_direct_record(unf_file_t *file, int rec, char *fmt, va_list ap);
+
+static int read_record(unf_file_t *file, char *fmt, va_list ap);
+
+static int read_direct_record(unf_file_t *file, int rec, char *fmt, va_list ap);
+
+static int write_zeros(unf_file_t *file, size_t n_bytes);
+
+static unf_status_t pread_full(int fd, void *buf, size_t n_bytes, int64_t offset);
+
+static unf_status_t preadv_full(int fd, struct iovec *iov, int iovcnt, int64_t offset, size_t *n_done);
+
+/*
+ * Record cache for direct-access files.
+ * Each slot holds the whole record. Slots are found by the record number
+ * using the hash table with chaining; slots are kept in the doubly linked list
+ * in the order of use, the least recently used one is reused on a miss.
+ * Modified (dirty) records are written back on eviction and by cache_flush().
+ */
+
+typedef struct cache_slot {
+    int rec;        // record number, 0 if the slot is free
+    int dirty;
+    size_t valid;   // number of bytes present (less than record_len for the truncated last record)
+    int prev;       // LRU list: previous (more recently used) slot
+    int next;       // LRU list: next (less recently used) slot
+    int hash_next;  // next slot in the same hash bucket
+    char *data;
+} cache_slot_t;
+
+struct unf_rec_cache {
+    int num_slots;
+    int bucket_mask;
+    int lru_head;   // most recently used
+    int lru_tail;   // least recently used
+    int *buckets;
+    cache_slot_t *slots;
+    char *data;
+};
+
+static void cache_free(struct unf_rec_cache *cache);
+
+static int cache_flush(unf_file_t *file);
+
+static cache_slot_t *cache_get(unf_file_t *file, int rec, int load);
+
+/*
+ * I/O calls and instrumentation counters.
+ * Counters are updated only if libunf is compiled with UNF_STATS.
+ */
+
+typedef struct {
+    double time_start;
+    double time_io_start;
+} stats_mark_t;
+
+#ifdef UNF_STATS
+
+#include <time.h>
+
+static double stats_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static stats_mark_t stats_begin(unf_file_t *file)
+{
+    stats_mark_t mark = {0.0, 0.0};
+    if (file) {
+        mark.time_start = stats_now();
+        mark.time_io_start = file->stats.time_io;
+    }
+    return mark;
+}
+
+// time spent in the API function, except for I/O calls, is attributed to format parsing
+static void stats_end(unf_file_t *file, stats_mark_t mark)
+{
+    if (file) {
+        double time_total = stats_now() - mark.time_start;
+        file->stats.time_parse += time_total - (file->stats.time_io - mark.time_io_start);
+    }
+}
+
+#define STATS_COUNT(file, counter, value) ((file)->stats.counter += (value))
+
+// for positionless reads which may be called by several threads at once
+static void stats_count_shared(unf_file_t *file, size_t n_bytes)
+{
+    #pragma omp critical(unf_stats)
+    {
+        file->stats.records_read++;
+        file->stats.bytes_read += n_bytes;
+    }
+}
+
+// counters of closed files
+typedef struct {
+    char *path;
+    unf_stats_t stats;
+} stats_entry_t;
+
+static stats_entry_t *stats_registry = NULL;
+static int stats_registry_size = 0;
+static int stats_registry_capacity = 0;
+
+static void stats_register(unf_file_t *file)
+{
+    #pragma omp critical(unf_stats)
+    {
+        if (stats_registry_size == stats_registry_capacity) {
+            stats_registry_capacity = stats_registry_capacity ? 2 * stats_registry_capacity : 16;
+            stats_registry = (stats_entry_t *) realloc(stats_registry,
+                                                       stats_registry_capacity * sizeof(stats_entry_t));
+        }
+        stats_registry[stats_registry_size].path = file->path ? strdup(file->path) : NULL;
+        stats_registry[stats_registry_size].stats = file->stats;
+        stats_registry_size++;
+    }
+}
+
+static size_t io_read(unf_file_t *file, void *ptr, size_t n_bytes)
+{
+    double t0 = stats_now();
+    size_t n_read = file->aio ? unf_aio_read(file->aio, ptr, n_bytes) : fread(ptr, 1, n_bytes, file->file_ptr);
+    file->stats.time_io += stats_now() - t0;
+    file->stats.n_fread++;
+    file->stats.bytes_read += n_read;
+    return n_read;
+}
+
+static size_t io_write(unf_file_t *file, const void *ptr, size_t n_bytes)
+{
+    double t0 = stats_now();
+    size_t n_written = fwrite(ptr, 1, n_bytes, file->file_ptr);
+    file->stats.time_io += stats_now() - t0;
+    file->stats.n_fwrite++;
+    file->stats.bytes_written += n_written;
+    return n_written;
+}
+
+static int io_seek(unf_file_t *file, off_t offset, int whence)
+{
+    double t0 = stats_now();
+    int status = file->aio ? unf_aio_seek(file->aio, offset, whence) : fseeko(file->file_ptr, offset, whence);
+    file->stats.time_io += stats_now() - t0;
+    file->stats.n_fseek++;
+    return status;
+}
+
+#else
+
+static inline stats_mark_t stats_begin(unf_file_t *file)
+{
+    (void) file;
+    stats_mark_t mark = {0.0, 0.0};
+    return mark;
+}
+
+static inline void stats_end(unf_file_t *file, stats_mark_t mark)
+{
+    (void) file;
+    (void) mark;
+}
+
+#define STATS_COUNT(file, counter, value) ((void) 0)
+
+static inline void stats_count_shared(unf_file_t *file, size_t n_bytes)
+{
+    (void) file;
+    (void) n_bytes;
+}
+
+static inline size_t io_read(unf_file_t *file, void *ptr, size_t n_bytes)
+{
+    if (file->aio) {
+        return unf_aio_read(file->aio, ptr, n_bytes);
+    }
+    return fread(ptr, 1, n_bytes, file->file_ptr);
+}
+
+static inline size_t io_write(unf_file_t *file, const void *ptr, size_t n_bytes)
+{
+    return fwrite(ptr, 1, n_bytes, file->file_ptr);
+}
+
+static inline int io_seek(unf_file_t *file, off_t offset, int whence)
+{
+    if (file->aio) {
+        return unf_aio_seek(file->aio, offset, whence);
+    }
+    return fseeko(file->file_ptr, offset, whence);
+}
+
+#endif // UNF_STATS
+
+static int io_eof(unf_file_t *file)
+{
+    return file->aio ? unf_aio_eof(file->aio) : feof(file->file_ptr);
+}
+
+static int io_error(unf_file_t *file)
+{
+    return file->aio ? unf_aio_error(file->aio) : ferror(file->file_ptr);
+}
+
+/*
+ * engine used for the files opened for reading
+ */
+static unf_read_engine_t default_read_engine = UNF_READ_ENGINE_STDIO;
+
 
 /**
  * Opens an unformatted file indicated by filename and returns a file stream
@@ -111,6 +387,31 @@ unf_file_t *unf_open(const char *path, const char *mode, unf_access_t access, ..
     unf_file->access = access;
     unf_file->record_len = record_len;
     unf_file->error_flag = 0;
+    unf_file->swap_bytes = 0;
+    unf_file->path = strdup(path);
+    unf_file->write_buf = NULL;
+    unf_file->write_buf_size = 0;
+    unf_file->cache = NULL;
+    unf_file->cache_slots = 0;
+    unf_file->aio = NULL;
+
+    // direct-access files: record cache is allocated on first access
+    if (access == UNF_ACCESS_DIRECT) {
+        int num_slots = UNF_CACHE_SIZE / record_len;
+        num_slots = num_slots < 1 ? 1 : num_slots;
+        num_slots = num_slots > UNF_CACHE_MAX_SLOTS ? UNF_CACHE_MAX_SLOTS : num_slots;
+        unf_file->cache_slots = num_slots;
+    }
+
+    // larger stdio buffer: many small records are merged into a single write call
+    if (strcmp(mode, "r") != 0) {
+        setvbuf(file, NULL, _IOFBF, UNF_STDIO_WRITE_BUFFER);
+    }
+
+    // falls back to stdio silently if the engine cannot be started
+    if (strcmp(mode, "r") == 0 && default_read_engine != UNF_READ_ENGINE_STDIO) {
+        unf_set_read_engine(unf_file, default_read_engine);
+    }
 
     return unf_file;
 }
@@ -130,17 +431,67 @@ int unf_close(unf_file_t *file)
         return UNF_ERROR;
     }
 
+    // modified records are written back to the file
+    int cache_status = cache_flush(file);
+    cache_free(file->cache);
+    file->cache = NULL;
+
+    unf_aio_free(file->aio);
+    file->aio = NULL;
+
     int status = fclose(file->file_ptr);
-    if (status == EOF) {
-        return UNF_ERROR;
-    }
 
+#ifdef UNF_STATS
+    stats_register(file);
+#endif
+
+    free(file->write_buf);
+    free(file->path);
     free(file);
 
+    if (status == EOF || cache_status == UNF_ERROR) {
+        return UNF_ERROR;
+    }
+
     return UNF_SUCCESS; // success
 }
 
 
+/**
+ * Returns 1 if both paths refer to the same existing file (e.g. through links
+ * or different spellings of the path), 0 otherwise.
+ */
+int unf_same_file(const char *path_1, const char *path_2)
+{
+    struct stat st_1;
+    struct stat st_2;
+
+    if (path_1 == NULL || path_2 == NULL ||
+        stat(path_1, &st_1) != 0 || stat(path_2, &st_2) != 0) {
+        return 0;
+    }
+
+    return st_1.st_dev == st_2.st_dev && st_1.st_ino == st_2.st_ino;
+}
+
+
+/**
+ * Returns the file descriptor of the opened file for copying its raw bytes
+ * (markers included) by pread(), or -1 if the file is NULL. The descriptor
+ * belongs to the file and must not be closed; data written to the file
+ * and not yet flushed is not seen through it.
+ */
+int unf_fileno(unf_file_t *file)
+{
+    if (file == NULL || file->file_ptr == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    return fileno(file->file_ptr);
+}
+
+
 /**
  * Writes data (the next record) to sequential and stream access files.
  * Arrays must be passed to the function by pointer, scalars and array dimensions
@@ -166,68 +517,14 @@ int unf_close(unf_file_t *file)
  */
 int unf_write(unf_file_t *file, char *fmt, ...)
 {
-    if (file == NULL ||
-        file->access == UNF_ACCESS_DIRECT) {
-        errno = EINVAL;
-        return 0;
-    }
-
-    // only for sequential files: size of the record in bytes
-    // here: just template, to be overwritten in future
-    if (file->access == UNF_ACCESS_SEQUENTIAL) {
-        int32_t record_size = 0;
-        size_t n_written = fwrite(&record_size, 1, sizeof(int32_t), file->file_ptr);
-        if (n_written != sizeof(int32_t)) {
-            file->error_flag = 1;
-            return 0;
-        }
-    }
-
-    // write target bytes.
-    // the same code for both sequential and stream access mode.
-    size_t n_bytes_written = 0;
-    int n_arguments_written = 0;
-
     va_list ap;
     va_start(ap, fmt);
-    int err = try_write_bytes(file, fmt, &n_bytes_written, &n_arguments_written, ap);
+    stats_mark_t mark = stats_begin(file);
+    int n_args = write_record(file, fmt, ap);
+    stats_end(file, mark);
     va_end(ap);
 
-    if (err == UNF_ERROR) {
-        file->error_flag = 1;
-        return n_arguments_written;
-    }
-
-    // only for sequential files: size of the record in bytes
-    if (file->access == UNF_ACCESS_SEQUENTIAL) {
-        // begin entry
-        int err = fseek(file->file_ptr, -sizeof(int32_t) - n_bytes_written, SEEK_CUR);
-        if (err != 0) {
-            file->error_flag = 1;
-            return n_arguments_written;
-        }
-
-        size_t n_written = fwrite(&n_bytes_written, 1, sizeof(int32_t), file->file_ptr);
-        if (n_written != sizeof(int32_t)) {
-            file->error_flag = 1;
-            return n_arguments_written;
-        }
-
-        // end entry
-        err = fseek(file->file_ptr, n_bytes_written, SEEK_CUR);
-        if (err != 0) {
-            file->error_flag = 1;
-            return n_arguments_written;
-        }
-
-        n_written = fwrite(&n_bytes_written, 1, sizeof(int32_t), file->file_ptr);
-        if (n_written != sizeof(int32_t)) {
-            file->error_flag = 1;
-            return n_arguments_written;
-        }
-    }
-
-    return n_arguments_written;
+    return n_args;
 }
 
 
@@ -246,47 +543,14 @@ int unf_write(unf_file_t *file, char *fmt, ...)
  */
 int unf_write_rec(unf_file_t *file, int rec, char *fmt, ...)
 {
-    if (file == NULL ||
-        file->access != UNF_ACCESS_DIRECT ||
-        file->record_len <= 0 ||
-        rec < 1) {
-        errno = EINVAL;
-        return 0;
-    }
-
-    // find the required entry
-    off_t offset = (rec - 1) * file->record_len;
-    int err = fseek(file->file_ptr, offset, SEEK_SET);
-    if (err != 0) {
-        file->error_flag = 1;
-        return 0;
-    }
-
-    // write target bytes.
-    // the same code for both sequential and stream access mode.
-    size_t n_bytes_written = 0;
-    int n_arguments_written = 0;
-
     va_list ap;
     va_start(ap, fmt);
-    err = try_write_bytes(file, fmt, &n_bytes_written, &n_arguments_written, ap);
+    stats_mark_t mark = stats_begin(file);
+    int n_args = write_direct_record(file, rec, fmt, ap);
+    stats_end(file, mark);
     va_end(ap);
 
-    if (n_bytes_written > file->record_len) {
-        file->error_flag = 1;
-    }
-    else if (n_bytes_written < file->record_len) {
-        // if needed: write zeros to preserve correct alignment of records
-        for (int i = 0; i < file->record_len - n_bytes_written; i++) {
-            fputc(0, file->file_ptr);
-        }
-    }
-
-    if (err == UNF_ERROR) {
-        file->error_flag = 1;
-    }
-
-    return n_arguments_written;
+    return n_args;
 }
 
 
@@ -314,114 +578,195 @@ int unf_write_rec(unf_file_t *file, int rec, char *fmt, ...)
  */
 int unf_read(unf_file_t *file, char *fmt, ...)
 {
-    if (file == NULL ||
-        file->access == UNF_ACCESS_DIRECT) {
-        errno = EINVAL;
-        return 0;
-    }
+    va_list ap;
+    va_start(ap, fmt);
+    stats_mark_t mark = stats_begin(file);
+    int n_args = read_record(file, fmt, ap);
+    stats_end(file, mark);
+    va_end(ap);
 
-    // only for sequential files: size of the record in bytes
-    int32_t record_size = 0;
-    if (file->access == UNF_ACCESS_SEQUENTIAL) {
-        size_t n_read = fread(&record_size, 1, sizeof(int32_t), file->file_ptr);
-        if (n_read != sizeof(int32_t)) {
-            file->error_flag = 1;
-            return 0;
-        }
-    }
+    return n_args;
+}
 
-    // read target bytes.
-    // the same code for both sequential and stream access mode.
-    size_t n_bytes_read = 0;
-    int n_arguments_read = 0;
 
+/**
+ * Reads data from record number 'rec'.
+ * For direct access files only.
+ * All arguments, both arrays and scalars, must be passed to the function by pointer.
+ * Format string is used to specify argument data types; see the description of the
+ * unf_read() function for details.
+ *
+ * Returns the number of receiving arguments successfully assigned
+ * (which may be zero in case a matching failure occurred before
+ * the first receiving argument was assigned).
+ *
+ * The unf_eof() and unf_error() functions and the errno variable are to be used to handle errors.
+ */
+int unf_read_rec(unf_file_t *file, int rec, char *fmt, ...)
+{
     va_list ap;
     va_start(ap, fmt);
-    int err = try_read_bytes(file, fmt, &n_bytes_read, &n_arguments_read, ap);
+    stats_mark_t mark = stats_begin(file);
+    int n_args = read_direct_record(file, rec, fmt, ap);
+    stats_end(file, mark);
     va_end(ap);
 
-    if (err == UNF_ERROR) {
-        file->error_flag = 1;
-        return n_arguments_read;
+    return n_args;
+}
+
+
+/**
+ * Reads up to max_records consecutive records of the sequential file at once.
+ * The caller provides the buffer 'buf' of size 'buf_size' bytes (arena); the file is read
+ * by one large fread() call, and records which fit into the buffer completely are accepted.
+ *
+ * The file is never read twice and no seeks are done: bytes following the last accepted
+ * record (the beginning of the next record) are carried over to the next call.
+ * On return, *n_carry is the number of these bytes; they are the last *n_carry bytes
+ * of the buffer. On entry, the last *n_carry bytes of the buffer are taken as the beginning
+ * of the data (zero for the first call); they are moved to the front of the buffer and
+ * the file is read after them. If the buffer is replaced by a larger one between calls,
+ * the caller copies the carried bytes to the end of the new buffer.
+ * Since the file position is ahead of the next record by *n_carry bytes, other
+ * functions reading the file are not to be mixed with batch reading.
+ *
+ * On return, the payload of the i-th record starts at buf + offsets[i] and
+ * its length in bytes is lengths[i]. Payloads are raw bytes: byte swapping (if any)
+ * is to be done by the caller (see unf_byte_swap()).
+ *
+ * Returns the number of records read. Zero is returned at the end of the file, on error
+ * (the error flag is set then) and if the next record is larger than the buffer
+ * (errno is set to ENOBUFS and lengths[0] is set to the payload length of the record).
+ */
+int unf_read_batch(unf_file_t *file, char *buf, size_t buf_size, size_t *n_carry, int max_records,
+                   size_t *offsets, int32_t *lengths)
+{
+    if (file == NULL ||
+        file->access != UNF_ACCESS_SEQUENTIAL ||
+        buf == NULL || n_carry == NULL || offsets == NULL || lengths == NULL ||
+        max_records <= 0 || *n_carry > buf_size) {
+        errno = EINVAL;
+        return 0;
     }
 
-    // only for sequential files: check the record size and rewind to the end of the entry
+    stats_mark_t mark = stats_begin(file);
 
-    if (file->access == UNF_ACCESS_SEQUENTIAL) {
-        // rewind to the end of the record if needed
-        if (n_bytes_read != record_size) {
-            off_t offset = record_size - n_bytes_read;
-            fseek(file->file_ptr, offset, SEEK_CUR);
-        }
+    size_t n_kept = *n_carry;
+    if (n_kept > 0 && n_kept < buf_size) {
+        memmove(buf, buf + buf_size - n_kept, n_kept);
+    }
+    *n_carry = 0;
 
-        // read size of the record in bytes
+    size_t n_new = n_kept < buf_size ? io_read(file, buf + n_kept, buf_size - n_kept) : 0;
+    size_t n_avail = n_kept + n_new;
+    if (n_avail < buf_size && io_error(file)) {
+        file->error_flag = 1;
+        stats_end(file, mark);
+        return 0;
+    }
+
+    // walk through the records in memory
+    size_t pos = 0;
+    int n_records = 0;
+    int32_t next_size = -1;
+    while (n_records < max_records && pos + sizeof(int32_t) <= n_avail) {
+        int32_t record_size = 0;
         int32_t record_size_2 = 0;
-        size_t n_read = fread(&record_size_2, 1, sizeof(int32_t), file->file_ptr);
-        if (n_read != sizeof(int32_t)) {
+
+        memcpy(&record_size, buf + pos, sizeof(int32_t));
+        if (file->swap_bytes) {
+            byte_swap_scalar(&record_size, 1, sizeof(int32_t));
+        }
+        if (record_size < 0) {
             file->error_flag = 1;
-            return n_arguments_read;
+            break;
         }
 
-        // two sizes of a record must coincide
+        // incomplete record
+        size_t record_end = pos + 2 * sizeof(int32_t) + (size_t) record_size;
+        if (record_end > n_avail) {
+            next_size = record_size;
+            break;
+        }
+
+        memcpy(&record_size_2, buf + record_end - sizeof(int32_t), sizeof(int32_t));
+        if (file->swap_bytes) {
+            byte_swap_scalar(&record_size_2, 1, sizeof(int32_t));
+        }
         if (record_size != record_size_2) {
             file->error_flag = 1;
-            return n_arguments_read;
+            break;
+        }
+
+        offsets[n_records] = pos + sizeof(int32_t);
+        lengths[n_records] = record_size;
+        n_records++;
+        pos = record_end;
+    }
+
+    // the rest is kept at the end of the buffer for the next call
+    if (pos < n_avail && !file->error_flag) {
+        *n_carry = n_avail - pos;
+        if (n_avail < buf_size) {
+            memmove(buf + buf_size - *n_carry, buf + pos, *n_carry);
         }
     }
 
-    return n_arguments_read;
+    if (n_records == 0 && n_avail > 0 && !file->error_flag) {
+        if (n_avail < buf_size) {
+            // the file ends inside the record
+            file->error_flag = 1;
+            *n_carry = 0;
+        }
+        else {
+            errno = ENOBUFS;
+            lengths[0] = next_size;
+        }
+    }
+
+    STATS_COUNT(file, records_read, n_records);
+    stats_end(file, mark);
+
+    return n_records;
 }
 
 
 /**
- * Reads data from record number 'rec'.
- * For direct access files only.
- * All arguments, both arrays and scalars, must be passed to the function by pointer.
- * Format string is used to specify argument data types; see the description of the
- * unf_read() function for details.
- *
- * Returns the number of receiving arguments successfully assigned
- * (which may be zero in case a matching failure occurred before
- * the first receiving argument was assigned).
- *
- * The unf_eof() and unf_error() functions and the errno variable are to be used to handle errors.
+ * Returns the current position in the file (in bytes), -1 on error.
+ * The position can be passed to positionless reads, e.g. unf_read_at().
  */
-int unf_read_rec(unf_file_t *file, int rec, char *fmt, ...)
+int64_t unf_tell(unf_file_t *file)
 {
-    if (file == NULL ||
-        file->access != UNF_ACCESS_DIRECT ||
-        file->record_len <= 0 ||
-        rec < 1) {
+    if (file == NULL) {
         errno = EINVAL;
-        return 0;
+        return -1;
     }
 
-    // find the required entry
-    off_t offset = (rec - 1) * file->record_len;
-    int err = fseek(file->file_ptr, offset, SEEK_SET);
-    if (err != 0) {
-        file->error_flag = 1;
-        return 0;
-    }
+    off_t pos = file->aio ? unf_aio_tell(file->aio) : ftello(file->file_ptr);
 
-    // read target bytes
-    size_t n_bytes_read = 0;
-    int n_arguments_read = 0;
+    return (int64_t) pos;
+}
 
-    va_list ap;
-    va_start(ap, fmt);
-    err = try_read_bytes(file, fmt, &n_bytes_read, &n_arguments_read, ap);
-    va_end(ap);
 
-    if (n_bytes_read > file->record_len) {
-        file->error_flag = 1;
+/**
+ * Sets the position in the file (in bytes) returned by unf_tell() or by positionless reads
+ * (e.g. the next record offset of unf_read_segments_at()), so that sequential reading
+ * can be continued from there.
+ * Returns UNF_SUCCESS upon success, UNF_ERROR otherwise.
+ */
+int unf_seek_offset(unf_file_t *file, int64_t offset)
+{
+    if (file == NULL || offset < 0) {
+        errno = EINVAL;
+        return UNF_ERROR;
     }
 
-    if (err == UNF_ERROR) {
+    if (io_seek(file, (off_t) offset, SEEK_SET) != 0) {
         file->error_flag = 1;
+        return UNF_ERROR;
     }
 
-    return n_arguments_read;
+    return UNF_SUCCESS;
 }
 
 
@@ -440,19 +785,252 @@ int unf_next_rec_size(unf_file_t *file)
     /*
      * read size of the record in bytes
      */
-    int record_size = 0;
-    size_t err = fread(&record_size, 1, sizeof(int32_t), file->file_ptr);
-    if (err != sizeof(int32_t)) {
+    int32_t record_size = 0;
+    if (read_marker(file, &record_size) == UNF_ERROR) {
         return 0;
     }
 
     off_t offset = -4;
-    fseek(file->file_ptr, offset, SEEK_CUR);
+    io_seek(file, offset, SEEK_CUR);
 
     return record_size;
 }
 
 
+/**
+ * Returns the message describing the status code of the positionless reads.
+ */
+const char *unf_status_string(unf_status_t status)
+{
+    switch (status) {
+        case UNF_STATUS_OK:
+            return "success";
+        case UNF_STATUS_EOF:
+            return "end of file";
+        case UNF_STATUS_IO_ERROR:
+            return "input/output error";
+        case UNF_STATUS_BAD_RECORD:
+            return "malformed or truncated record";
+        case UNF_STATUS_BAD_FORMAT:
+            return "format does not match the record";
+        case UNF_STATUS_BUFFER_TOO_SMALL:
+            return "record is larger than the buffer";
+        case UNF_STATUS_NO_MEMORY:
+            return "out of memory";
+        case UNF_STATUS_INVALID_ARGS:
+            return "invalid arguments";
+    }
+    return "unknown status";
+}
+
+
+/**
+ * Reads the record of the sequential file starting at the given byte offset
+ * (position of its leading marker) and copies its payload to 'buf' (raw bytes,
+ * byte swapping is left to the caller, see unf_byte_swap()).
+ *
+ * The read is done by pread(): the file position, the error flag and errno
+ * are not touched, so any number of threads may read the same file at once.
+ * Offsets are obtained from unf_build_index() or from 'next_offset' of the
+ * previous call. The file must not be written concurrently.
+ *
+ * On return, 'length' (if not NULL) is the payload length in bytes and, upon
+ * success, 'next_offset' (if not NULL) is the offset of the next record.
+ * If the payload does not fit into the buffer, UNF_STATUS_BUFFER_TOO_SMALL is
+ * returned and 'length' is set, so that the caller can retry with a larger one.
+ */
+unf_status_t unf_read_record_at(unf_file_t *file, int64_t offset, void *buf, size_t buf_size,
+                                int32_t *length, int64_t *next_offset)
+{
+    if (file == NULL ||
+        file->access != UNF_ACCESS_SEQUENTIAL ||
+        offset < 0 || (buf == NULL && buf_size > 0)) {
+        return UNF_STATUS_INVALID_ARGS;
+    }
+
+    int fd = fileno(file->file_ptr);
+
+    int32_t record_size = 0;
+    int32_t record_size_2 = 0;
+    unf_status_t status = pread_full(fd, &record_size, sizeof(int32_t), offset);
+    if (status != UNF_STATUS_OK) {
+        return status;
+    }
+    if (file->swap_bytes) {
+        byte_swap_scalar(&record_size, 1, sizeof(int32_t));
+    }
+    if (record_size < 0) {
+        return UNF_STATUS_BAD_RECORD;
+    }
+
+    if (length) {
+        *length = record_size;
+    }
+    if ((size_t) record_size > buf_size) {
+        return UNF_STATUS_BUFFER_TOO_SMALL;
+    }
+
+    int64_t payload_offset = offset + (int64_t) sizeof(int32_t);
+    status = pread_full(fd, buf, (size_t) record_size, payload_offset);
+    if (status == UNF_STATUS_OK) {
+        status = pread_full(fd, &record_size_2, sizeof(int32_t), payload_offset + record_size);
+    }
+    if (status != UNF_STATUS_OK) {
+        // the leading marker has been read, so the end of file means truncation
+        return status == UNF_STATUS_EOF ? UNF_STATUS_BAD_RECORD : status;
+    }
+    if (file->swap_bytes) {
+        byte_swap_scalar(&record_size_2, 1, sizeof(int32_t));
+    }
+    if (record_size != record_size_2) {
+        return UNF_STATUS_BAD_RECORD;
+    }
+
+    if (next_offset) {
+        *next_offset = payload_offset + record_size + (int64_t) sizeof(int32_t);
+    }
+    stats_count_shared(file, 2 * sizeof(int32_t) + (size_t) record_size);
+
+    return UNF_STATUS_OK;
+}
+
+
+/**
+ * Reads the payload of the record of the sequential file starting at the given byte
+ * offset directly into several destination arrays ('segments', filled one after
+ * another), by a single preadv() call. Byte swapping is left to the caller.
+ * Sizes of segments must sum up to the payload length 'length'; the length is
+ * to be known in advance: from unf_build_index() or from 'next_length' returned
+ * by the previous call. If 'length' is negative, the leading marker is read first.
+ *
+ * The leading marker of the next record is read by the same call: upon success,
+ * 'next_offset' (if not NULL) is the offset of the next record and 'next_length'
+ * (if not NULL) is its length or -1 if it is unknown (end of file).
+ * Like unf_read_record_at(), the function is positionless and thread-safe.
+ */
+unf_status_t unf_read_segments_at(unf_file_t *file, int64_t offset, int32_t length,
+                                  const unf_segment_t *segments, int n_segments,
+                                  int64_t *next_offset, int32_t *next_length)
+{
+    if (file == NULL ||
+        file->access != UNF_ACCESS_SEQUENTIAL ||
+        offset < 0 || n_segments < 0 || n_segments > UNF_MAX_SEGMENTS ||
+        (segments == NULL && n_segments > 0)) {
+        return UNF_STATUS_INVALID_ARGS;
+    }
+
+    int fd = fileno(file->file_ptr);
+
+    if (length < 0) {
+        unf_status_t status = pread_full(fd, &length, sizeof(int32_t), offset);
+        if (status != UNF_STATUS_OK) {
+            return status;
+        }
+        if (file->swap_bytes) {
+            byte_swap_scalar(&length, 1, sizeof(int32_t));
+        }
+        if (length < 0) {
+            return UNF_STATUS_BAD_RECORD;
+        }
+    }
+
+    // payload, trailing marker of the record and leading marker of the next one
+    struct iovec iov[UNF_MAX_SEGMENTS + 1];
+    int32_t markers[2];
+    size_t n_payload = 0;
+    for (int i = 0; i < n_segments; i++) {
+        if (segments[i].data == NULL && segments[i].n_bytes > 0) {
+            return UNF_STATUS_INVALID_ARGS;
+        }
+        iov[i].iov_base = segments[i].data;
+        iov[i].iov_len = segments[i].n_bytes;
+        n_payload += segments[i].n_bytes;
+    }
+    if (n_payload != (size_t) length) {
+        return UNF_STATUS_BAD_FORMAT;
+    }
+    iov[n_segments].iov_base = markers;
+    iov[n_segments].iov_len = sizeof(markers);
+
+    int64_t payload_offset = offset + (int64_t) sizeof(int32_t);
+    size_t n_done = 0;
+    unf_status_t status = preadv_full(fd, iov, n_segments + 1, payload_offset, &n_done);
+    if (status != UNF_STATUS_OK) {
+        return status;
+    }
+    if (n_done < n_payload + sizeof(int32_t)) {
+        return UNF_STATUS_BAD_RECORD;
+    }
+
+    if (file->swap_bytes) {
+        byte_swap_scalar(markers, 2, sizeof(int32_t));
+    }
+    if (markers[0] != length) {
+        return UNF_STATUS_BAD_RECORD;
+    }
+
+    if (next_offset) {
+        *next_offset = payload_offset + length + (int64_t) sizeof(int32_t);
+    }
+    if (next_length) {
+        *next_length = (n_done == n_payload + sizeof(markers) && markers[1] >= 0) ? markers[1] : -1;
+    }
+    stats_count_shared(file, n_done);
+
+    return UNF_STATUS_OK;
+}
+
+
+/**
+ * Reads the record of the sequential file starting at the given byte offset
+ * (position of its leading marker). Arguments and the format string are the same
+ * as for unf_read(); 'next_offset' (if not NULL) receives the offset of the next record.
+ *
+ * Like unf_read_record_at(), the function is positionless and thread-safe:
+ * the outcome is reported only by the returned status code.
+ */
+unf_status_t unf_read_at(unf_file_t *file, int64_t offset, int64_t *next_offset, char *fmt, ...)
+{
+    if (fmt == NULL) {
+        return UNF_STATUS_INVALID_ARGS;
+    }
+
+    // small records are read to the stack
+    char small_buf[UNF_SMALL_RECORD_SIZE];
+    char *buf = small_buf;
+    int32_t length = 0;
+
+    unf_status_t status = unf_read_record_at(file, offset, buf, sizeof(small_buf), &length, next_offset);
+    if (status == UNF_STATUS_BUFFER_TOO_SMALL) {
+        buf = (char *) malloc((size_t) length);
+        if (buf == NULL) {
+            return UNF_STATUS_NO_MEMORY;
+        }
+        status = unf_read_record_at(file, offset, buf, (size_t) length, &length, next_offset);
+    }
+
+    if (status == UNF_STATUS_OK) {
+        size_t n_bytes_read = 0;
+        int n_arguments_read = 0;
+
+        va_list ap;
+        va_start(ap, fmt);
+        int err = try_read_bytes(file, fmt, buf, (size_t) length, &n_bytes_read, &n_arguments_read, ap);
+        va_end(ap);
+
+        if (err == UNF_ERROR) {
+            status = UNF_STATUS_BAD_FORMAT;
+        }
+    }
+
+    if (buf != small_buf) {
+        free(buf);
+    }
+
+    return status;
+}
+
+
 /**
  * Sets the record position indicator for the sequential unformatted file
  * to the value pointed to by offset.
@@ -480,13 +1058,13 @@ int unf_seek(unf_file_t *file, unf_position_t pos, int offset)
 
     // set the position for further seeking
     if (pos == UNF_POS_BEGIN) {
-        int err = fseek(file->file_ptr, 0, SEEK_SET);
+        int err = io_seek(file, 0, SEEK_SET);
         if (err != 0) {
             return UNF_ERROR;
         }
     }
     else if (pos == UNF_POS_END) {
-        int err = fseek(file->file_ptr, 0, SEEK_END);
+        int err = io_seek(file, 0, SEEK_END);
         if (err != 0) {
             return UNF_ERROR;
         }
@@ -566,7 +1144,7 @@ int unf_skip(unf_file_t *file)
  */
 int unf_eof(unf_file_t *file)
 {
-    return feof(file->file_ptr);
+    return io_eof(file);
 }
 
 
@@ -581,398 +1159,1771 @@ int unf_error(unf_file_t *file)
         return UNF_ERROR;
     }
 
-    return ferror(file->file_ptr) ? UNF_ERROR : UNF_SUCCESS;
+    return io_error(file) ? UNF_ERROR : UNF_SUCCESS;
 }
 
 
-/*
- *
- * auxiliary functions
+/**
+ * Writes modified records kept in the record cache (direct-access files)
+ * and flushes the stdio buffer of the file.
  *
+ * Returns UNF_SUCCESS upon success, UNF_ERROR otherwise.
  */
+int unf_flush(unf_file_t *file)
+{
+    if (file == NULL) {
+        errno = EINVAL;
+        return UNF_ERROR;
+    }
+
+    if (cache_flush(file) == UNF_ERROR) {
+        return UNF_ERROR;
+    }
+
+    return fflush(file->file_ptr) == 0 ? UNF_SUCCESS : UNF_ERROR;
+}
 
 
-static int try_read_bytes(unf_file_t *file, char *fmt, size_t *n_bytes_read, int *n_args_read, va_list ap)
+/**
+ * Sets the maximum number of records of the direct-access file kept in memory.
+ * Records read by unf_read_rec() are cached, records written by unf_write_rec()
+ * are written back to the file on eviction, unf_flush() or unf_close().
+ * The least recently used record is evicted if the cache is full.
+ * num_slots = 0 disables caching: every call results in the file access.
+ * By default, the cache of about 4 MB is used.
+ *
+ * Returns UNF_SUCCESS upon success, UNF_ERROR otherwise.
+ */
+int unf_set_cache_size(unf_file_t *file, int num_slots)
 {
-    assert(file != NULL);
+    if (file == NULL ||
+        file->access != UNF_ACCESS_DIRECT ||
+        num_slots < 0) {
+        errno = EINVAL;
+        return UNF_ERROR;
+    }
 
-    *n_args_read = 0;
-    *n_bytes_read = 0;
+    // the cache will be reallocated on the next access
+    int status = cache_flush(file);
+    cache_free(file->cache);
+    file->cache = NULL;
+    file->cache_slots = num_slots;
 
-    char *p = fmt;
-    while (*p) {
-        // nothing to do, just skip
-        if (*p == ',') {
-            p++;
-            continue;
-        }
+    return status;
+}
 
-        int num_repeats = 1;
-        int type_size;
-        int data_type;
-        if (fmt_get_type_size(&p, &data_type, &type_size, &num_repeats) == UNF_ERROR) {
-            return UNF_ERROR;
-        }
 
-        /*
-         * array or not?
-         * array dimension can be specified by either integer-4 '[i4]' or integer-8 '[i8]' number
-         */
-        int is_array = 0;
-        int array_dim_type = TYPE_INTEGER_4;
-        if (strncmp(p, "[i4]", 4) == 0) {
-            is_array = 1;
-            array_dim_type = TYPE_INTEGER_4;
-            p += 4;
-        }
-        else if (strncmp(p, "[i8]", 4) == 0) {
-            is_array = 1;
-            array_dim_type = TYPE_INTEGER_8;
-            p += 4;
+/**
+ * Selects the engine used to read the file opened in the "r" mode.
+ * UNF_READ_ENGINE_ASYNC keeps several large reads in flight ahead of the current
+ * position (via io_uring on Linux, if libunf is compiled with UNF_HAVE_IO_URING;
+ * otherwise by pread()). For direct-access files records are read one by one
+ * without read-ahead. The file position is preserved.
+ *
+ * Returns UNF_SUCCESS upon success, UNF_ERROR otherwise.
+ */
+int unf_set_read_engine(unf_file_t *file, unf_read_engine_t engine)
+{
+    if (file == NULL ||
+        !(engine == UNF_READ_ENGINE_STDIO || engine == UNF_READ_ENGINE_ASYNC)) {
+        errno = EINVAL;
+        return UNF_ERROR;
+    }
+
+    int fd = fileno(file->file_ptr);
+    if ((fcntl(fd, F_GETFL) & O_ACCMODE) != O_RDONLY) {
+        errno = EINVAL;
+        return UNF_ERROR;
+    }
+
+    // switch back to stdio at the same position
+    if (engine == UNF_READ_ENGINE_STDIO) {
+        if (file->aio != NULL) {
+            off_t pos = unf_aio_tell(file->aio);
+            unf_aio_free(file->aio);
+            file->aio = NULL;
+            if (fseeko(file->file_ptr, pos, SEEK_SET) != 0) {
+                return UNF_ERROR;
+            }
         }
+        return UNF_SUCCESS;
+    }
 
-        for (int i_repeat = 0; i_repeat < num_repeats; i_repeat++) {
-            /*
-             * get pointer to data to be written
-             */
-            void *data_ptr = va_arg(ap, void *);
+    if (file->aio != NULL) {
+        return UNF_SUCCESS;
+    }
 
-            /*
+    off_t pos = ftello(file->file_ptr);
+    if (pos < 0) {
+        return UNF_ERROR;
+    }
+
+    if (file->access == UNF_ACCESS_DIRECT) {
+        file->aio = unf_aio_new(fd, pos, 1, file->record_len);
+    }
+    else {
+        file->aio = unf_aio_new(fd, pos, UNF_AIO_QUEUE_DEPTH, UNF_AIO_CHUNK_SIZE);
+    }
+
+    return file->aio != NULL ? UNF_SUCCESS : UNF_ERROR;
+}
+
+
+/**
+ * Sets the engine to be used for all files opened for reading afterwards.
+ * Is not thread-safe: to be called at startup.
+ */
+void unf_set_default_read_engine(unf_read_engine_t engine)
+{
+    default_read_engine = engine;
+}
+
+
+/**
+ * Returns the name of the read engine actually used for the file:
+ * "stdio", "io_uring" or "pread".
+ */
+const char *unf_get_read_engine_name(unf_file_t *file)
+{
+    if (file == NULL || file->aio == NULL) {
+        return "stdio";
+    }
+
+    return unf_aio_backend(file->aio);
+}
+
+
+/**
+ * Sets byte order of data stored in the unformatted file.
+ * UNF_BYTE_ORDER_SWAPPED is to be used for files written on machines with
+ * the opposite endianness (or with the -fconvert=big-endian and similar options);
+ * record markers and numeric data are then byte-swapped on the fly.
+ *
+ * Returns UNF_SUCCESS upon success, UNF_ERROR otherwise.
+ */
+int unf_set_byte_order(unf_file_t *file, unf_byte_order_t order)
+{
+    if (file == NULL ||
+        !(order == UNF_BYTE_ORDER_NATIVE || order == UNF_BYTE_ORDER_SWAPPED)) {
+        errno = EINVAL;
+        return UNF_ERROR;
+    }
+
+    file->swap_bytes = (order == UNF_BYTE_ORDER_SWAPPED);
+
+    return UNF_SUCCESS;
+}
+
+
+/**
+ * Returns byte order of data stored in the unformatted file.
+ */
+unf_byte_order_t unf_get_byte_order(unf_file_t *file)
+{
+    return file->swap_bytes ? UNF_BYTE_ORDER_SWAPPED : UNF_BYTE_ORDER_NATIVE;
+}
+
+
+/**
+ * Detects byte order of the sequential file using the known size of the next record.
+ * The file position is not changed.
+ * If the size of the next record coincides with expected_rec_size in either native or
+ * swapped byte order, the corresponding byte order is set for the file.
+ *
+ * Returns UNF_SUCCESS upon success, UNF_ERROR if the size of the next record
+ * does not match the expected one in any byte order.
+ */
+int unf_detect_byte_order(unf_file_t *file, int expected_rec_size)
+{
+    if (file == NULL ||
+        file->access != UNF_ACCESS_SEQUENTIAL) {
+        errno = EINVAL;
+        return UNF_ERROR;
+    }
+
+    int32_t record_size = 0;
+    size_t n_read = io_read(file, &record_size, sizeof(int32_t));
+    if (n_read != sizeof(int32_t)) {
+        return UNF_ERROR;
+    }
+    io_seek(file, -(off_t) sizeof(int32_t), SEEK_CUR);
+
+    if (record_size == expected_rec_size) {
+        file->swap_bytes = 0;
+        return UNF_SUCCESS;
+    }
+
+    unf_byte_swap(&record_size, 1, sizeof(int32_t));
+    if (record_size == expected_rec_size) {
+        file->swap_bytes = 1;
+        return UNF_SUCCESS;
+    }
+
+    return UNF_ERROR;
+}
+
+
+#ifdef UNF_HAVE_AVX2_DISPATCH
+
+static int cpu_has_avx2 = 0;
+
+/*
+ * processor features are detected once, when the library is loaded (before any threads
+ * are started), so that the kernels below can be dispatched from parallel regions
+ */
+__attribute__((constructor))
+static void detect_cpu_features(void)
+{
+    __builtin_cpu_init();
+    cpu_has_avx2 = __builtin_cpu_supports("avx2") ? 1 : 0;
+}
+
+#endif // UNF_HAVE_AVX2_DISPATCH
+
+
+/**
+ * Returns 1 if AVX2 versions of the kernels are compiled in and supported
+ * by the processor, 0 otherwise.
+ */
+int unf_cpu_has_avx2(void)
+{
+#ifdef UNF_HAVE_AVX2_DISPATCH
+    return cpu_has_avx2;
+#else
+    return 0;
+#endif
+}
+
+
+/*
+ * byte swap kernels: scalar version and AVX2 version selected at runtime
+ */
+
+static void byte_swap_scalar(void *data, size_t n_elements, int elem_size)
+{
+    // data can be unaligned (records assembled in memory): elements are accessed via memcpy
+    char *p = (char *) data;
+
+    if (elem_size == 2) {
+        for (size_t i = 0; i < n_elements; i++, p += 2) {
+            uint16_t x;
+            memcpy(&x, p, 2);
+            x = (uint16_t) ((x >> 8) | (x << 8));
+            memcpy(p, &x, 2);
+        }
+    }
+    else if (elem_size == 4) {
+        for (size_t i = 0; i < n_elements; i++, p += 4) {
+            uint32_t x;
+            memcpy(&x, p, 4);
+            x = (x >> 24) | ((x >> 8) & 0x0000ff00u) | ((x << 8) & 0x00ff0000u) | (x << 24);
+            memcpy(p, &x, 4);
+        }
+    }
+    else if (elem_size == 8) {
+        for (size_t i = 0; i < n_elements; i++, p += 8) {
+            uint64_t x;
+            memcpy(&x, p, 8);
+            x = ((x & 0x00000000ffffffffull) << 32) | ((x & 0xffffffff00000000ull) >> 32);
+            x = ((x & 0x0000ffff0000ffffull) << 16) | ((x & 0xffff0000ffff0000ull) >> 16);
+            x = ((x & 0x00ff00ff00ff00ffull) << 8) | ((x & 0xff00ff00ff00ff00ull) >> 8);
+            memcpy(p, &x, 8);
+        }
+    }
+}
+
+#ifdef UNF_HAVE_AVX2_DISPATCH
+
+__attribute__((target("avx2")))
+static void byte_swap_avx2(void *data, size_t n_elements, int elem_size)
+{
+    __m256i mask;
+    if (elem_size == 2) {
+        mask = _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+                                1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+    }
+    else if (elem_size == 4) {
+        mask = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    }
+    else {
+        mask = _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+                                7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+    }
+
+    char *p = (char *) data;
+    size_t n_bytes = n_elements * elem_size;
+    size_t i = 0;
+
+    for (; i + 128 <= n_bytes; i += 128) {
+        __m256i v0 = _mm256_loadu_si256((__m256i *) (p + i));
+        __m256i v1 = _mm256_loadu_si256((__m256i *) (p + i + 32));
+        __m256i v2 = _mm256_loadu_si256((__m256i *) (p + i + 64));
+        __m256i v3 = _mm256_loadu_si256((__m256i *) (p + i + 96));
+        _mm256_storeu_si256((__m256i *) (p + i), _mm256_shuffle_epi8(v0, mask));
+        _mm256_storeu_si256((__m256i *) (p + i + 32), _mm256_shuffle_epi8(v1, mask));
+        _mm256_storeu_si256((__m256i *) (p + i + 64), _mm256_shuffle_epi8(v2, mask));
+        _mm256_storeu_si256((__m256i *) (p + i + 96), _mm256_shuffle_epi8(v3, mask));
+    }
+    for (; i + 32 <= n_bytes; i += 32) {
+        __m256i v = _mm256_loadu_si256((__m256i *) (p + i));
+        _mm256_storeu_si256((__m256i *) (p + i), _mm256_shuffle_epi8(v, mask));
+    }
+
+    byte_swap_scalar(p + i, (n_bytes - i) / elem_size, elem_size);
+}
+
+#endif // UNF_HAVE_AVX2_DISPATCH
+
+
+/**
+ * Reverses byte order of each element of an array in place.
+ * Element size can be 1 (nothing to do), 2, 4 or 8 bytes.
+ * The AVX2 version of the kernel is used if supported by the processor.
+ */
+void unf_byte_swap(void *data, size_t n_elements, int elem_size)
+{
+    if (data == NULL || elem_size <= 1) {
+        return;
+    }
+
+#ifdef UNF_HAVE_AVX2_DISPATCH
+    if (unf_cpu_has_avx2()) {
+        byte_swap_avx2(data, n_elements, elem_size);
+        return;
+    }
+#endif
+
+    byte_swap_scalar(data, n_elements, elem_size);
+}
+
+
+/*
+ * deinterleave kernels: scalar version and AVX2 version selected at runtime
+ */
+
+static void deinterleave_int32_scalar(const char *pairs, size_t n_pairs, int32_t *first, int32_t *second)
+{
+    // pairs can be unaligned (records read by batches)
+    for (size_t i = 0; i < n_pairs; i++) {
+        int32_t pair[2];
+        memcpy(pair, pairs + 2 * sizeof(int32_t) * i, sizeof(pair));
+        first[i] = pair[0];
+        second[i] = pair[1];
+    }
+}
+
+#ifdef UNF_HAVE_AVX2_DISPATCH
+
+__attribute__((target("avx2")))
+static void deinterleave_int32_avx2(const char *pairs, size_t n_pairs, int32_t *first, int32_t *second)
+{
+    // (a0 b0 a1 b1 | a2 b2 a3 b3) -> (a0 a1 b0 b1 | a2 a3 b2 b3)
+    const __m256i perm = _mm256_setr_epi32(0, 2, 1, 3, 4, 6, 5, 7);
+    size_t i = 0;
+
+    for (; i + 8 <= n_pairs; i += 8) {
+        const char *p = pairs + 2 * sizeof(int32_t) * i;
+        __m256i v0 = _mm256_permutevar8x32_epi32(_mm256_loadu_si256((__m256i *) p), perm);
+        __m256i v1 = _mm256_permutevar8x32_epi32(_mm256_loadu_si256((__m256i *) (p + 32)), perm);
+        // (a0 a1 a4 a5 | a2 a3 a6 a7), the same for b
+        __m256i a = _mm256_unpacklo_epi64(v0, v1);
+        __m256i b = _mm256_unpackhi_epi64(v0, v1);
+        a = _mm256_permute4x64_epi64(a, 0xd8);
+        b = _mm256_permute4x64_epi64(b, 0xd8);
+        _mm256_storeu_si256((__m256i *) (first + i), a);
+        _mm256_storeu_si256((__m256i *) (second + i), b);
+    }
+
+    deinterleave_int32_scalar(pairs + 2 * sizeof(int32_t) * i, n_pairs - i, first + i, second + i);
+}
+
+#endif // UNF_HAVE_AVX2_DISPATCH
+
+
+/**
+ * Splits an array of pairs of 4-byte integers (a0, b0, a1, b1, ...) into
+ * two contiguous arrays (a0, a1, ...) and (b0, b1, ...). Pairs need not be aligned.
+ * The AVX2 version of the kernel is used if supported by the processor.
+ */
+void unf_deinterleave_int32(const void *pairs, size_t n_pairs, int32_t *first, int32_t *second)
+{
+    if (pairs == NULL || first == NULL || second == NULL) {
+        return;
+    }
+
+#ifdef UNF_HAVE_AVX2_DISPATCH
+    if (unf_cpu_has_avx2()) {
+        deinterleave_int32_avx2((const char *) pairs, n_pairs, first, second);
+        return;
+    }
+#endif
+
+    deinterleave_int32_scalar((const char *) pairs, n_pairs, first, second);
+}
+
+
+/*
+ * narrowing kernels: scalar version and AVX2 version selected at runtime.
+ * Return the number of values out of the range of 4-byte integers
+ * (such values are truncated).
+ */
+
+static size_t narrow_int64_scalar(const char *src, size_t n, int32_t *dst)
+{
+    size_t n_overflow = 0;
+    for (size_t i = 0; i < n; i++) {
+        int64_t x;
+        memcpy(&x, src + sizeof(int64_t) * i, sizeof(int64_t));
+        dst[i] = (int32_t) x;
+        n_overflow += (x != dst[i]);
+    }
+
+    return n_overflow;
+}
+
+static size_t deinterleave_narrow_int64_scalar(const char *pairs, size_t n_pairs, int32_t *first, int32_t *second)
+{
+    size_t n_overflow = 0;
+    for (size_t i = 0; i < n_pairs; i++) {
+        int64_t pair[2];
+        memcpy(pair, pairs + 2 * sizeof(int64_t) * i, sizeof(pair));
+        first[i] = (int32_t) pair[0];
+        second[i] = (int32_t) pair[1];
+        n_overflow += (pair[0] != first[i]) + (pair[1] != second[i]);
+    }
+
+    return n_overflow;
+}
+
+#ifdef UNF_HAVE_AVX2_DISPATCH
+
+/*
+ * Lower halves of four 64-bit integers; 'ok' accumulates the lanes where
+ * the upper half is the sign extension of the lower one.
+ */
+__attribute__((target("avx2")))
+static inline __m128i narrow_4x64(__m256i v, __m128i *ok)
+{
+    const __m256i perm = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+    __m256i lo_hi = _mm256_permutevar8x32_epi32(v, perm);
+    __m128i lo = _mm256_castsi256_si128(lo_hi);
+    __m128i hi = _mm256_extracti128_si256(lo_hi, 1);
+    *ok = _mm_and_si128(*ok, _mm_cmpeq_epi32(hi, _mm_srai_epi32(lo, 31)));
+    return lo;
+}
+
+__attribute__((target("avx2")))
+static size_t narrow_int64_avx2(const char *src, size_t n, int32_t *dst)
+{
+    __m128i ok = _mm_set1_epi32(-1);
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        __m128i lo0 = narrow_4x64(_mm256_loadu_si256((__m256i *) (src + sizeof(int64_t) * i)), &ok);
+        __m128i lo1 = narrow_4x64(_mm256_loadu_si256((__m256i *) (src + sizeof(int64_t) * (i + 4))), &ok);
+        _mm_storeu_si128((__m128i *) (dst + i), lo0);
+        _mm_storeu_si128((__m128i *) (dst + i + 4), lo1);
+    }
+
+    // overflows are rare: only count them exactly if there are any
+    size_t n_overflow = narrow_int64_scalar(src + sizeof(int64_t) * i, n - i, dst + i);
+    if (_mm_movemask_epi8(ok) != 0xffff) {
+        n_overflow += narrow_int64_scalar(src, i, dst);
+    }
+
+    return n_overflow;
+}
+
+__attribute__((target("avx2")))
+static size_t deinterleave_narrow_int64_avx2(const char *pairs, size_t n_pairs, int32_t *first, int32_t *second)
+{
+    // (a0 b0 a1 b1 | a2 b2 a3 b3) -> (a0 a1 a2 a3 | b0 b1 b2 b3)
+    const __m256i perm = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+    __m128i ok = _mm_set1_epi32(-1);
+    size_t i = 0;
+
+    for (; i + 4 <= n_pairs; i += 4) {
+        const char *p = pairs + 2 * sizeof(int64_t) * i;
+        __m128i lo0 = narrow_4x64(_mm256_loadu_si256((__m256i *) p), &ok);
+        __m128i lo1 = narrow_4x64(_mm256_loadu_si256((__m256i *) (p + 32)), &ok);
+        __m256i ab = _mm256_permutevar8x32_epi32(_mm256_set_m128i(lo1, lo0), perm);
+        _mm_storeu_si128((__m128i *) (first + i), _mm256_castsi256_si128(ab));
+        _mm_storeu_si128((__m128i *) (second + i), _mm256_extracti128_si256(ab, 1));
+    }
+
+    size_t n_overflow = deinterleave_narrow_int64_scalar(pairs + 2 * sizeof(int64_t) * i, n_pairs - i,
+                                                         first + i, second + i);
+    if (_mm_movemask_epi8(ok) != 0xffff) {
+        n_overflow += deinterleave_narrow_int64_scalar(pairs, i, first, second);
+    }
+
+    return n_overflow;
+}
+
+#endif // UNF_HAVE_AVX2_DISPATCH
+
+
+/**
+ * Converts an array of 8-byte integers to 4-byte integers.
+ * The source need not be aligned.
+ * The AVX2 version of the kernel is used if supported by the processor.
+ *
+ * Returns UNF_SUCCESS upon success, UNF_ERROR if some of the values do not fit
+ * into 4-byte integers (errno is set to ERANGE; all values are converted anyway,
+ * those out of range are truncated).
+ */
+int unf_narrow_int64(const void *src, size_t n, int32_t *dst)
+{
+    if (src == NULL || dst == NULL) {
+        errno = EINVAL;
+        return UNF_ERROR;
+    }
+
+    size_t n_overflow;
+
+#ifdef UNF_HAVE_AVX2_DISPATCH
+    if (unf_cpu_has_avx2()) {
+        n_overflow = narrow_int64_avx2((const char *) src, n, dst);
+    }
+    else {
+        n_overflow = narrow_int64_scalar((const char *) src, n, dst);
+    }
+#else
+    n_overflow = narrow_int64_scalar((const char *) src, n, dst);
+#endif
+
+    if (n_overflow > 0) {
+        errno = ERANGE;
+        return UNF_ERROR;
+    }
+
+    return UNF_SUCCESS;
+}
+
+
+/**
+ * Splits an array of pairs of 8-byte integers (a0, b0, a1, b1, ...) into two
+ * contiguous arrays of 4-byte integers (a0, a1, ...) and (b0, b1, ...).
+ * The semantics is that of unf_narrow_int64(): returns UNF_ERROR (errno is set
+ * to ERANGE) if some of the values do not fit into 4-byte integers.
+ */
+int unf_deinterleave_narrow_int64(const void *pairs, size_t n_pairs, int32_t *first, int32_t *second)
+{
+    if (pairs == NULL || first == NULL || second == NULL) {
+        errno = EINVAL;
+        return UNF_ERROR;
+    }
+
+    size_t n_overflow;
+
+#ifdef UNF_HAVE_AVX2_DISPATCH
+    if (unf_cpu_has_avx2()) {
+        n_overflow = deinterleave_narrow_int64_avx2((const char *) pairs, n_pairs, first, second);
+    }
+    else {
+        n_overflow = deinterleave_narrow_int64_scalar((const char *) pairs, n_pairs, first, second);
+    }
+#else
+    n_overflow = deinterleave_narrow_int64_scalar((const char *) pairs, n_pairs, first, second);
+#endif
+
+    if (n_overflow > 0) {
+        errno = ERANGE;
+        return UNF_ERROR;
+    }
+
+    return UNF_SUCCESS;
+}
+
+
+/**
+ * Copies I/O counters of the file to 'stats'.
+ * Counters are collected only if libunf is compiled with UNF_STATS.
+ *
+ * Returns UNF_SUCCESS upon success, UNF_ERROR otherwise.
+ */
+int unf_get_stats(unf_file_t *file, unf_stats_t *stats)
+{
+    if (file == NULL || stats == NULL) {
+        errno = EINVAL;
+        return UNF_ERROR;
+    }
+
+    *stats = file->stats;
+
+    return UNF_SUCCESS;
+}
+
+
+/**
+ * Prints I/O counters of all closed files as a JSON array, one object per file.
+ * The array is empty if libunf is compiled without UNF_STATS.
+ */
+void unf_stats_dump(FILE *out)
+{
+    fprintf(out, "[");
+
+#ifdef UNF_STATS
+    #pragma omp critical(unf_stats)
+    {
+        for (int i = 0; i < stats_registry_size; i++) {
+            unf_stats_t *st = &stats_registry[i].stats;
+            fprintf(out, "%s\n  {\"path\": \"", i > 0 ? "," : "");
+            for (char *c = stats_registry[i].path; c && *c; c++) {
+                if (*c == '"' || *c == '\\') {
+                    fputc('\\', out);
+                }
+                fputc(*c, out);
+            }
+            fprintf(out, "\", \"bytes_read\": %lld, \"bytes_written\": %lld, "
+                         "\"records_read\": %lld, \"records_written\": %lld, "
+                         "\"n_fread\": %lld, \"n_fwrite\": %lld, \"n_fseek\": %lld, "
+                         "\"cache_hits\": %lld, \"cache_misses\": %lld, "
+                         "\"time_io\": %.6f, \"time_parse\": %.6f}",
+                    (long long) st->bytes_read, (long long) st->bytes_written,
+                    (long long) st->records_read, (long long) st->records_written,
+                    (long long) st->n_fread, (long long) st->n_fwrite, (long long) st->n_fseek,
+                    (long long) st->cache_hits, (long long) st->cache_misses,
+                    st->time_io, st->time_parse);
+        }
+        if (stats_registry_size > 0) {
+            fprintf(out, "\n");
+        }
+    }
+#endif
+
+    fprintf(out, "]");
+}
+
+/*
+ *
+ * auxiliary functions
+ *
+ */
+
+
+/*
+ * Reads data described by the format string.
+ * If 'buf' is not NULL, the data is taken from the buffer of length 'buf_len'
+ * (record cache) instead of the file.
+ */
+static int try_read_bytes(unf_file_t *file, char *fmt, const char *buf, size_t buf_len,
+                          size_t *n_bytes_read, int *n_args_read, va_list ap)
+{
+    assert(file != NULL);
+
+    *n_args_read = 0;
+    *n_bytes_read = 0;
+
+    char *p = fmt;
+    while (*p) {
+        // nothing to do, just skip
+        if (*p == ',') {
+            p++;
+            continue;
+        }
+
+        int num_repeats = 1;
+        int type_size;
+        int data_type;
+        if (fmt_get_type_size(&p, &data_type, &type_size, &num_repeats) == UNF_ERROR) {
+            return UNF_ERROR;
+        }
+
+        /*
+         * array or not?
+         * array dimension can be specified by either integer-4 '[i4]' or integer-8 '[i8]' number
+         */
+        int is_array = 0;
+        int array_dim_type = TYPE_INTEGER_4;
+        if (strncmp(p, "[i4]", 4) == 0) {
+            is_array = 1;
+            array_dim_type = TYPE_INTEGER_4;
+            p += 4;
+        }
+        else if (strncmp(p, "[i8]", 4) == 0) {
+            is_array = 1;
+            array_dim_type = TYPE_INTEGER_8;
+            p += 4;
+        }
+
+        for (int i_repeat = 0; i_repeat < num_repeats; i_repeat++) {
+            /*
+             * get pointer to data to be written
+             */
+            void *data_ptr = va_arg(ap, void *);
+
+            /*
+             * if needed, get array length
+             */
+            size_t array_dim = 1;
+            if (is_array && array_dim_type == TYPE_INTEGER_4) {
+                int32_t *array_dim_ptr = va_arg(ap, int32_t *);
+                if (array_dim_ptr == NULL) {
+                    errno = EINVAL; // wrong argument
+                    return UNF_ERROR;
+                }
+                array_dim = *array_dim_ptr;
+            }
+            else if (is_array && array_dim_type == TYPE_INTEGER_8) {
+                int64_t *array_dim_ptr = va_arg(ap, int64_t *);
+                if (array_dim_ptr == NULL) {
+                    errno = EINVAL; // wrong argument
+                    return UNF_ERROR;
+                }
+                array_dim = *array_dim_ptr;
+            }
+
+            /*
+             * read entry from the unformatted file
+             * or skip it, if the data pointer is NULL
+             */
+            size_t n_bytes = array_dim * type_size;
+            if (buf != NULL) {
+                if (*n_bytes_read + n_bytes > buf_len) {
+                    return UNF_ERROR;
+                }
+                if (data_ptr != NULL) {
+                    memcpy(data_ptr, buf + *n_bytes_read, n_bytes);
+                    if (file->swap_bytes) {
+                        int swap_unit = get_swap_unit(data_type, type_size);
+                        unf_byte_swap(data_ptr, n_bytes / swap_unit, swap_unit);
+                    }
+                }
+            }
+            else if (data_ptr != NULL) {
+                size_t err = io_read(file, data_ptr, n_bytes);
+                if (err != n_bytes) {
+                    return UNF_ERROR;
+                }
+                if (file->swap_bytes) {
+                    int swap_unit = get_swap_unit(data_type, type_size);
+                    unf_byte_swap(data_ptr, n_bytes / swap_unit, swap_unit);
+                }
+            }
+            else {
+                int err = io_seek(file, (off_t) n_bytes, SEEK_CUR);
+                if (err != 0) {
+                    return UNF_ERROR;
+                }
+            }
+
+            *n_bytes_read += n_bytes;
+            *n_args_read += 1;
+        }
+    }
+
+    return UNF_SUCCESS;
+}
+
+
+/*
+ * Writes data described by the format string.
+ * Depending on the mode, the data is either copied to the buffer 'buf' (in the byte
+ * order of the file), written to the file or only counted (WRITE_DRY_RUN).
+ */
+static int try_write_bytes(unf_file_t *file, char *fmt, write_mode_t mode, char *buf,
+                           size_t *n_bytes_written, int *n_args_written, va_list ap)
+{
+    assert(file != NULL);
+
+    *n_args_written = 0;
+    *n_bytes_written = 0;
+
+    char *p = fmt;
+    while (*p) {
+        // nothing to do, just skip
+        if (*p == ',') {
+            p++;
+            continue;
+        }
+
+        int num_repeats = 1;
+        int type_size;
+        int data_type;
+
+        if (fmt_get_type_size(&p, &data_type, &type_size, &num_repeats) == UNF_ERROR) {
+            return UNF_ERROR;
+        }
+
+        /*
+         * array or not?
+         * array dimension can be specified by either integer-4 '[i4]' or integer-8 '[i8]' number
+         */
+        int is_array = 0;
+        int array_dim_type = TYPE_INTEGER_4;
+        if (strncmp(p, "[i4]", 4) == 0) {
+            is_array = 1;
+            array_dim_type = TYPE_INTEGER_4;
+            p += 4;
+        }
+        else if (strncmp(p, "[i8]", 4) == 0) {
+            is_array = 1;
+            array_dim_type = TYPE_INTEGER_8;
+            p += 4;
+        }
+
+        for (int i_repeat = 0; i_repeat < num_repeats; i_repeat++) {
+            /*
+             * get pointer to data to be written
+             */
+            char data_char = 0;
+            int8_t data_int1 = 0;
+            int16_t data_int2 = 0;
+            int32_t data_int4 = 0;
+            int64_t data_int8 = 0;
+            float data_real4 = 0;
+            double data_real8 = 0;
+            float _Complex data_complex4 = 0.0 + 0.0 * _Complex_I;
+            double _Complex data_complex8 = 0.0 + 0.0 * _Complex_I;
+            void *data_ptr = NULL;
+
+            if (is_array || (data_type == TYPE_CHAR && type_size > 1)) {
+                data_ptr = va_arg(ap, void *);
+            }
+            else {
+                if (data_type == TYPE_CHAR) {
+                    data_char = va_arg(ap, char);
+                    data_ptr = &data_char;
+                }
+                else if (data_type == TYPE_INTEGER_1) {
+                    data_int1 = va_arg(ap, int8_t);
+                    data_ptr = &data_int1;
+                }
+                else if (data_type == TYPE_INTEGER_2) {
+                    data_int2 = va_arg(ap, int16_t);
+                    data_ptr = &data_int2;
+                }
+                else if (data_type == TYPE_INTEGER_4) {
+                    data_int4 = va_arg(ap, int32_t);
+                    data_ptr = &data_int4;
+                }
+                else if (data_type == TYPE_INTEGER_8) {
+                    data_int8 = va_arg(ap, int64_t);
+                    data_ptr = &data_int8;
+                }
+                else if (data_type == TYPE_REAL_4) {
+                    data_real4 = va_arg(ap, float);
+                    data_ptr = &data_real4;
+                }
+                else if (data_type == TYPE_REAL_8) {
+                    data_real8 = va_arg(ap, double);
+                    data_ptr = &data_real8;
+                }
+                else if (data_type == TYPE_COMPLEX_4) {
+                    data_complex4 = va_arg(ap, float _Complex);
+                    data_ptr = &data_complex4;
+                }
+                else if (data_type == TYPE_COMPLEX_8) {
+                    data_complex8 = va_arg(ap, double _Complex);
+                    data_ptr = &data_complex8;
+                }
+            }
+
+            /*
              * if needed, get array length
              */
             size_t array_dim = 1;
             if (is_array && array_dim_type == TYPE_INTEGER_4) {
-                int32_t *array_dim_ptr = va_arg(ap, int32_t *);
-                if (array_dim_ptr == NULL) {
-                    errno = EINVAL; // wrong argument
-                    return UNF_ERROR;
-                }
-                array_dim = *array_dim_ptr;
+                array_dim = va_arg(ap, int32_t);
             }
             else if (is_array && array_dim_type == TYPE_INTEGER_8) {
-                int64_t *array_dim_ptr = va_arg(ap, int64_t *);
-                if (array_dim_ptr == NULL) {
-                    errno = EINVAL; // wrong argument
-                    return UNF_ERROR;
-                }
-                array_dim = *array_dim_ptr;
+                array_dim = va_arg(ap, int64_t);
             }
 
             /*
-             * read entry from the unformatted file
-             * or skip it, if the data pointer is NULL
+             * write entry to the unformatted file
+             * or write zeros, if the data pointer is NULL
              */
             size_t n_bytes = array_dim * type_size;
-            if (data_ptr != NULL) {
-                size_t err = fread(data_ptr, 1, n_bytes, file->file_ptr);
+            int swap_unit = get_swap_unit(data_type, type_size);
+            if (mode == WRITE_DRY_RUN) {
+                // nothing to do
+            }
+            else if (mode == WRITE_TO_BUFFER) {
+                char *dest = buf + *n_bytes_written;
+                if (data_ptr != NULL) {
+                    memcpy(dest, data_ptr, n_bytes);
+                    if (file->swap_bytes && swap_unit > 1) {
+                        unf_byte_swap(dest, n_bytes / swap_unit, swap_unit);
+                    }
+                }
+                else {
+                    memset(dest, 0, n_bytes);
+                }
+            }
+            else if (data_ptr != NULL && file->swap_bytes && swap_unit > 1) {
+                if (write_swapped(file, data_ptr, n_bytes, swap_unit) == UNF_ERROR) {
+                    return UNF_ERROR;
+                }
+            }
+            else if (data_ptr != NULL) {
+                size_t err = io_write(file, data_ptr, n_bytes);
                 if (err != n_bytes) {
                     return UNF_ERROR;
                 }
             }
             else {
-                int err = fseek(file->file_ptr, (off_t) n_bytes, SEEK_CUR);
-                if (err != 0) {
+                if (write_zeros(file, n_bytes) == UNF_ERROR) {
                     return UNF_ERROR;
                 }
             }
 
-            *n_bytes_read += n_bytes;
-            *n_args_read += 1;
+            *n_bytes_written += n_bytes;
+            *n_args_written += 1;
+        }
+    }
+
+    return UNF_SUCCESS;
+}
+
+
+// returns 0 if success, -1 if error
+static int fmt_get_type_size(char **fmt, int *data_type, int *type_size, int *num_repeats)
+{
+    char *p = *fmt;
+
+    // try to get number of repeats
+    long parsed_int = strtol(p, &p, 10);
+    if (parsed_int < 0 || errno == ERANGE) {
+        return -1;
+    }
+    else if (parsed_int > 0) {
+        *num_repeats = parsed_int;
+    }
+    else {
+        *num_repeats = 1;
+    }
+
+
+    if (*p == 'c') {
+        // 'c'
+        *type_size = sizeof(char); // default: only one character
+        *data_type = TYPE_CHAR;
+        p++;
+
+        // try to read length - is it a Fortran string?
+        parsed_int = strtol(p, &p, 10);
+        if (parsed_int < 0 || errno == ERANGE) {
+            return -1;
+        }
+        else if (parsed_int > 0) {
+            *type_size = parsed_int;
+        }
+    }
+    else {
+        // one of numeric types
+        if (strncmp(p, "i1", 2) == 0) {
+            // 'i1'
+            *type_size = sizeof(int8_t);
+            *data_type = TYPE_INTEGER_1;
+        }
+        else if (strncmp(p, "i2", 2) == 0) {
+            // 'i2'
+            *type_size = sizeof(int16_t);
+            *data_type = TYPE_INTEGER_2;
+        }
+        else if (strncmp(p, "i4", 2) == 0) {
+            // 'i4'
+            *type_size = sizeof(int32_t);
+            *data_type = TYPE_INTEGER_4;
+        }
+        else if (strncmp(p, "i8", 2) == 0) {
+            // 'i8'
+            *type_size = sizeof(int64_t);
+            *data_type = TYPE_INTEGER_8;
+        }
+        else if (strncmp(p, "r4", 2) == 0) {
+            // 'r4'
+            *type_size = sizeof(float);
+            *data_type = TYPE_REAL_4;
+        }
+        else if (strncmp(p, "r8", 2) == 0) {
+            // 'r8'
+            *type_size = sizeof(double);
+            *data_type = TYPE_REAL_8;
+        }
+        else if (strncmp(p, "z4", 2) == 0) {
+            // 'z4'
+            *type_size = sizeof(float _Complex);
+            *data_type = TYPE_COMPLEX_4;
+        }
+        else if (strncmp(p, "z8", 2) == 0) {
+            // 'z8'
+            *type_size = sizeof(double _Complex);
+            *data_type = TYPE_COMPLEX_8;
+        }
+        else {
+            errno = EINVAL;
+            return UNF_ERROR;
+        }
+
+        p += 2;
+    }
+
+    *fmt = p;
+
+    return UNF_SUCCESS;
+}
+
+
+/**
+ * Seeks 1 record forward (auxiliary function).
+ * For sequential files only.
+ * Returns UNF_SUCCESS upon success, UNF_ERROR otherwise.
+ */
+static int seek_forward(unf_file_t *file)
+{
+    // read size of the record in bytes
+    int32_t record_size = 0;
+    if (read_marker(file, &record_size) == UNF_ERROR) {
+        return UNF_ERROR;
+    }
+
+    int status = io_seek(file, record_size, SEEK_CUR);
+    if (status != 0) {
+        return UNF_ERROR;
+    }
+
+    int32_t record_size_2 = 0;
+    if (read_marker(file, &record_size_2) == UNF_ERROR) {
+        return UNF_ERROR;
+    }
+
+    if (record_size != record_size_2) {
+        return UNF_ERROR;
+    }
+
+    return UNF_SUCCESS;
+}
+
+
+/**
+ * Seeks 1 record backward (auxiliary function).
+ * For sequential files only.
+ * Returns UNF_SUCCESS upon success, UNF_ERROR otherwise.
+ */
+static int seek_backward(unf_file_t *file)
+{
+    // if we are at the beginning of the file,
+    // the following fseek() call will simply return error
+    // (without setting error flag however)
+
+    // access the last record size
+    off_t offset = -4;
+    int err = io_seek(file, offset, SEEK_CUR);
+    if (err != 0) {
+        return UNF_ERROR;
+    }
+
+    int32_t record_size = 0;
+    if (read_marker(file, &record_size) == UNF_ERROR) {
+        return UNF_ERROR;
+    }
+
+    offset = -(2 * sizeof(int32_t) + record_size);
+    err = io_seek(file, offset, SEEK_CUR);
+    if (err != 0) {
+        return UNF_ERROR;
+    }
+
+    return UNF_SUCCESS;
+}
+
+
+/**
+ * Reads the record marker (size of the record in bytes) taking into account the byte order.
+ * Returns UNF_SUCCESS upon success, UNF_ERROR otherwise.
+ */
+static int read_marker(unf_file_t *file, int32_t *record_size)
+{
+    size_t n_read = io_read(file, record_size, sizeof(int32_t));
+    if (n_read != sizeof(int32_t)) {
+        return UNF_ERROR;
+    }
+
+    if (file->swap_bytes) {
+        byte_swap_scalar(record_size, 1, sizeof(int32_t));
+    }
+
+    return UNF_SUCCESS;
+}
+
+
+/**
+ * Writes the record marker (size of the record in bytes) taking into account the byte order.
+ * Returns UNF_SUCCESS upon success, UNF_ERROR otherwise.
+ */
+static int write_marker(unf_file_t *file, int32_t record_size)
+{
+    if (file->swap_bytes) {
+        byte_swap_scalar(&record_size, 1, sizeof(int32_t));
+    }
+
+    size_t n_written = io_write(file, &record_size, sizeof(int32_t));
+    if (n_written != sizeof(int32_t)) {
+        return UNF_ERROR;
+    }
+
+    return UNF_SUCCESS;
+}
+
+
+/**
+ * Size of the unit for byte swapping: size of a number, or of its real (imaginary) part
+ * for complex numbers. Characters are never swapped.
+ */
+static int get_swap_unit(int data_type, int type_size)
+{
+    if (data_type == TYPE_CHAR) {
+        return 1;
+    }
+    else if (data_type == TYPE_COMPLEX_4 || data_type == TYPE_COMPLEX_8) {
+        return type_size / 2;
+    }
+
+    return type_size;
+}
+
+
+/**
+ * Writes byte-swapped copy of data; the user's data remain unchanged.
+ * Data are processed by chunks in order to avoid allocation of large buffers.
+ * Returns UNF_SUCCESS upon success, UNF_ERROR otherwise.
+ */
+static int write_swapped(unf_file_t *file, void *data, size_t n_bytes, int swap_unit)
+{
+    uint64_t chunk[8192];
+    char *p = (char *) data;
+
+    while (n_bytes > 0) {
+        size_t n_chunk = n_bytes < sizeof(chunk) ? n_bytes : sizeof(chunk);
+
+        memcpy(chunk, p, n_chunk);
+        unf_byte_swap(chunk, n_chunk / swap_unit, swap_unit);
+
+        size_t n_written = io_write(file, chunk, n_chunk);
+        if (n_written != n_chunk) {
+            return UNF_ERROR;
         }
+
+        p += n_chunk;
+        n_bytes -= n_chunk;
     }
 
     return UNF_SUCCESS;
 }
 
 
-static int try_write_bytes(unf_file_t *file, char *fmt, size_t *n_bytes_written, int *n_args_written, va_list ap)
+/**
+ * Implementation of unf_write().
+ *
+ * The size of the record is determined in advance by a dry pass over the arguments.
+ * Records up to UNF_WRITE_BUFFER_MAX bytes are assembled in the per-file buffer
+ * together with both length markers and emitted by a single write call;
+ * larger records are streamed to the file. No seeks are performed in both cases.
+ */
+static int write_record(unf_file_t *file, char *fmt, va_list ap)
 {
-    assert(file != NULL);
+    if (file == NULL ||
+        file->access == UNF_ACCESS_DIRECT) {
+        errno = EINVAL;
+        return 0;
+    }
 
-    *n_args_written = 0;
-    *n_bytes_written = 0;
+    // dry run: size of the record in bytes
+    size_t n_bytes_written = 0;
+    int n_arguments_written = 0;
 
-    char *p = fmt;
-    while (*p) {
-        // nothing to do, just skip
-        if (*p == ',') {
-            p++;
-            continue;
+    va_list ap_count;
+    va_copy(ap_count, ap);
+    int err = try_write_bytes(file, fmt, WRITE_DRY_RUN, NULL, &n_bytes_written, &n_arguments_written, ap_count);
+    va_end(ap_count);
+
+    if (err == UNF_ERROR) {
+        file->error_flag = 1;
+        return 0;
+    }
+
+    int sequential = (file->access == UNF_ACCESS_SEQUENTIAL);
+    if (sequential && n_bytes_written > INT32_MAX) {
+        errno = EOVERFLOW;
+        file->error_flag = 1;
+        return 0;
+    }
+
+    size_t marker_size = sequential ? sizeof(int32_t) : 0;
+    size_t total_size = n_bytes_written + 2 * marker_size;
+
+    if (total_size <= UNF_WRITE_BUFFER_MAX) {
+        /*
+         * assemble the whole record in memory
+         */
+        if (total_size > file->write_buf_size) {
+            size_t new_size = file->write_buf_size > 0 ? file->write_buf_size : 4096;
+            while (new_size < total_size) {
+                new_size *= 2;
+            }
+            char *new_buf = (char *) realloc(file->write_buf, new_size);
+            if (new_buf == NULL) {
+                file->error_flag = 1;
+                return 0;
+            }
+            file->write_buf = new_buf;
+            file->write_buf_size = new_size;
         }
 
-        int num_repeats = 1;
-        int type_size;
-        int data_type;
+        char *buf = file->write_buf;
+        if (sequential) {
+            int32_t marker = (int32_t) n_bytes_written;
+            if (file->swap_bytes) {
+                byte_swap_scalar(&marker, 1, sizeof(int32_t));
+            }
+            memcpy(buf, &marker, sizeof(int32_t));
+            memcpy(buf + marker_size + n_bytes_written, &marker, sizeof(int32_t));
+        }
 
-        if (fmt_get_type_size(&p, &data_type, &type_size, &num_repeats) == UNF_ERROR) {
-            return UNF_ERROR;
+        err = try_write_bytes(file, fmt, WRITE_TO_BUFFER, buf + marker_size,
+                              &n_bytes_written, &n_arguments_written, ap);
+        if (err == UNF_ERROR) {
+            file->error_flag = 1;
+            return 0;
         }
 
+        if (io_write(file, buf, total_size) != total_size) {
+            file->error_flag = 1;
+            return 0;
+        }
+    }
+    else {
         /*
-         * array or not?
-         * array dimension can be specified by either integer-4 '[i4]' or integer-8 '[i8]' number
+         * huge record: stream it to the file
          */
-        int is_array = 0;
-        int array_dim_type = TYPE_INTEGER_4;
-        if (strncmp(p, "[i4]", 4) == 0) {
-            is_array = 1;
-            array_dim_type = TYPE_INTEGER_4;
-            p += 4;
+        if (sequential && write_marker(file, (int32_t) n_bytes_written) == UNF_ERROR) {
+            file->error_flag = 1;
+            return 0;
         }
-        else if (strncmp(p, "[i8]", 4) == 0) {
-            is_array = 1;
-            array_dim_type = TYPE_INTEGER_8;
-            p += 4;
+
+        err = try_write_bytes(file, fmt, WRITE_TO_FILE, NULL, &n_bytes_written, &n_arguments_written, ap);
+        if (err == UNF_ERROR) {
+            file->error_flag = 1;
+            return n_arguments_written;
         }
 
-        for (int i_repeat = 0; i_repeat < num_repeats; i_repeat++) {
-            /*
-             * get pointer to data to be written
-             */
-            char data_char = 0;
-            int8_t data_int1 = 0;
-            int16_t data_int2 = 0;
-            int32_t data_int4 = 0;
-            int64_t data_int8 = 0;
-            float data_real4 = 0;
-            double data_real8 = 0;
-            float _Complex data_complex4 = 0.0 + 0.0 * _Complex_I;
-            double _Complex data_complex8 = 0.0 + 0.0 * _Complex_I;
-            void *data_ptr = NULL;
+        if (sequential && write_marker(file, (int32_t) n_bytes_written) == UNF_ERROR) {
+            file->error_flag = 1;
+            return n_arguments_written;
+        }
+    }
 
-            if (is_array || (data_type == TYPE_CHAR && type_size > 1)) {
-                data_ptr = va_arg(ap, void *);
-            }
-            else {
-                if (data_type == TYPE_CHAR) {
-                    data_char = va_arg(ap, char);
-                    data_ptr = &data_char;
-                }
-                else if (data_type == TYPE_INTEGER_1) {
-                    data_int1 = va_arg(ap, int8_t);
-                    data_ptr = &data_int1;
-                }
-                else if (data_type == TYPE_INTEGER_2) {
-                    data_int2 = va_arg(ap, int16_t);
-                    data_ptr = &data_int2;
-                }
-                else if (data_type == TYPE_INTEGER_4) {
-                    data_int4 = va_arg(ap, int32_t);
-                    data_ptr = &data_int4;
-                }
-                else if (data_type == TYPE_INTEGER_8) {
-                    data_int8 = va_arg(ap, int64_t);
-                    data_ptr = &data_int8;
-                }
-                else if (data_type == TYPE_REAL_4) {
-                    data_real4 = va_arg(ap, float);
-                    data_ptr = &data_real4;
-                }
-                else if (data_type == TYPE_REAL_8) {
-                    data_real8 = va_arg(ap, double);
-                    data_ptr = &data_real8;
-                }
-                else if (data_type == TYPE_COMPLEX_4) {
-                    data_complex4 = va_arg(ap, float _Complex);
-                    data_ptr = &data_complex4;
-                }
-                else if (data_type == TYPE_COMPLEX_8) {
-                    data_complex8 = va_arg(ap, double _Complex);
-                    data_ptr = &data_complex8;
-                }
-            }
+    STATS_COUNT(file, records_written, 1);
 
-            /*
-             * if needed, get array length
-             */
-            size_t array_dim = 1;
-            if (is_array && array_dim_type == TYPE_INTEGER_4) {
-                array_dim = va_arg(ap, int32_t);
-            }
-            else if (is_array && array_dim_type == TYPE_INTEGER_8) {
-                array_dim = va_arg(ap, int64_t);
-            }
+    return n_arguments_written;
+}
 
-            /*
-             * write entry to the unformatted file
-             * or write zeros, if the data pointer is NULL
-             */
-            size_t n_bytes = array_dim * type_size;
-            if (data_ptr != NULL) {
-                size_t err = fwrite(data_ptr, 1, n_bytes, file->file_ptr);
-                if (err != n_bytes) {
-                    return UNF_ERROR;
-                }
-            }
-            else {
-                for (int i = 0; i < n_bytes; i++) {
-                    fputc(0, file->file_ptr);
-                }
-                if (ferror(file->file_ptr)) {
-                    return UNF_ERROR;
-                }
-            }
 
-            *n_bytes_written += n_bytes;
-            *n_args_written += 1;
+/**
+ * Implementation of unf_write_rec().
+ */
+static int write_direct_record(unf_file_t *file, int rec, char *fmt, va_list ap)
+{
+    if (file == NULL ||
+        file->access != UNF_ACCESS_DIRECT ||
+        file->record_len <= 0 ||
+        rec < 1) {
+        errno = EINVAL;
+        return 0;
+    }
+
+    size_t n_bytes_written = 0;
+    int n_arguments_written = 0;
+
+    if (file->cache_slots > 0) {
+        // dry run: the record must fit into the slot
+        va_list ap_count;
+        va_copy(ap_count, ap);
+        int err = try_write_bytes(file, fmt, WRITE_DRY_RUN, NULL, &n_bytes_written, &n_arguments_written, ap_count);
+        va_end(ap_count);
+
+        if (err == UNF_ERROR || n_bytes_written > file->record_len) {
+            file->error_flag = 1;
+            return 0;
+        }
+
+        cache_slot_t *slot = cache_get(file, rec, 0);
+        if (slot == NULL) {
+            file->error_flag = 1;
+            return 0;
+        }
+
+        try_write_bytes(file, fmt, WRITE_TO_BUFFER, slot->data, &n_bytes_written, &n_arguments_written, ap);
+        memset(slot->data + n_bytes_written, 0, file->record_len - n_bytes_written);
+        slot->valid = file->record_len;
+        slot->dirty = 1;
+
+        STATS_COUNT(file, records_written, 1);
+
+        return n_arguments_written;
+    }
+
+    // find the required entry
+    off_t offset = (off_t) (rec - 1) * file->record_len;
+    int err = io_seek(file, offset, SEEK_SET);
+    if (err != 0) {
+        file->error_flag = 1;
+        return 0;
+    }
+
+    err = try_write_bytes(file, fmt, WRITE_TO_FILE, NULL, &n_bytes_written, &n_arguments_written, ap);
+
+    if (n_bytes_written > file->record_len) {
+        file->error_flag = 1;
+    }
+    else if (n_bytes_written < file->record_len) {
+        // if needed: write zeros to preserve correct alignment of records
+        if (write_zeros(file, file->record_len - n_bytes_written) == UNF_ERROR) {
+            file->error_flag = 1;
+        }
+    }
+
+    if (err == UNF_ERROR) {
+        file->error_flag = 1;
+    }
+
+    STATS_COUNT(file, records_written, 1);
+
+    return n_arguments_written;
+}
+
+
+/**
+ * Implementation of unf_read().
+ */
+static int read_record(unf_file_t *file, char *fmt, va_list ap)
+{
+    if (file == NULL ||
+        file->access == UNF_ACCESS_DIRECT) {
+        errno = EINVAL;
+        return 0;
+    }
+
+    // only for sequential files: size of the record in bytes
+    int32_t record_size = 0;
+    if (file->access == UNF_ACCESS_SEQUENTIAL) {
+        if (read_marker(file, &record_size) == UNF_ERROR) {
+            file->error_flag = 1;
+            return 0;
+        }
+    }
+
+    // read target bytes.
+    // the same code for both sequential and stream access mode.
+    size_t n_bytes_read = 0;
+    int n_arguments_read = 0;
+
+    int err = try_read_bytes(file, fmt, NULL, 0, &n_bytes_read, &n_arguments_read, ap);
+
+    if (err == UNF_ERROR) {
+        file->error_flag = 1;
+        return n_arguments_read;
+    }
+
+    // only for sequential files: check the record size and rewind to the end of the entry
+
+    if (file->access == UNF_ACCESS_SEQUENTIAL) {
+        // rewind to the end of the record if needed
+        if (n_bytes_read != record_size) {
+            off_t offset = record_size - n_bytes_read;
+            io_seek(file, offset, SEEK_CUR);
+        }
+
+        // read size of the record in bytes
+        int32_t record_size_2 = 0;
+        if (read_marker(file, &record_size_2) == UNF_ERROR) {
+            file->error_flag = 1;
+            return n_arguments_read;
+        }
+
+        // two sizes of a record must coincide
+        if (record_size != record_size_2) {
+            file->error_flag = 1;
+            return n_arguments_read;
         }
     }
 
-    return UNF_SUCCESS;
+    STATS_COUNT(file, records_read, 1);
+
+    return n_arguments_read;
 }
 
 
-// returns 0 if success, -1 if error
-static int fmt_get_type_size(char **fmt, int *data_type, int *type_size, int *num_repeats)
+/**
+ * Reads exactly n_bytes at the given offset by pread(), retrying on short reads.
+ * Returns UNF_STATUS_EOF if the file ends at the offset and UNF_STATUS_BAD_RECORD
+ * if it ends inside the requested range.
+ */
+static unf_status_t pread_full(int fd, void *buf, size_t n_bytes, int64_t offset)
 {
-    char *p = *fmt;
-
-    // try to get number of repeats
-    long parsed_int = strtol(p, &p, 10);
-    if (parsed_int < 0 || errno == ERANGE) {
-        return -1;
-    }
-    else if (parsed_int > 0) {
-        *num_repeats = parsed_int;
-    }
-    else {
-        *num_repeats = 1;
+    size_t n_done = 0;
+    while (n_done < n_bytes) {
+        ssize_t n = pread(fd, (char *) buf + n_done, n_bytes - n_done, (off_t) (offset + n_done));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            return UNF_STATUS_IO_ERROR;
+        }
+        if (n == 0) {
+            return n_done == 0 ? UNF_STATUS_EOF : UNF_STATUS_BAD_RECORD;
+        }
+        n_done += (size_t) n;
     }
 
+    return UNF_STATUS_OK;
+}
 
-    if (*p == 'c') {
-        // 'c'
-        *type_size = sizeof(char); // default: only one character
-        *data_type = TYPE_CHAR;
-        p++;
 
-        // try to read length - is it a Fortran string?
-        parsed_int = strtol(p, &p, 10);
-        if (parsed_int < 0 || errno == ERANGE) {
-            return -1;
-        }
-        else if (parsed_int > 0) {
-            *type_size = parsed_int;
-        }
-    }
-    else {
-        // one of numeric types
-        if (strncmp(p, "i1", 2) == 0) {
-            // 'i1'
-            *type_size = sizeof(int8_t);
-            *data_type = TYPE_INTEGER_1;
-        }
-        else if (strncmp(p, "i2", 2) == 0) {
-            // 'i2'
-            *type_size = sizeof(int16_t);
-            *data_type = TYPE_INTEGER_2;
+/**
+ * Reads up to the total length of the vectors at the given offset by preadv(),
+ * retrying on short reads. The number of bytes read is less than requested only
+ * at the end of file. Vectors are modified.
+ */
+static unf_status_t preadv_full(int fd, struct iovec *iov, int iovcnt, int64_t offset, size_t *n_done)
+{
+    *n_done = 0;
+    while (iovcnt > 0) {
+        ssize_t n = preadv(fd, iov, iovcnt, (off_t) (offset + *n_done));
+        if (n < 0 && errno == EINTR) {
+            continue;
         }
-        else if (strncmp(p, "i4", 2) == 0) {
-            // 'i4'
-            *type_size = sizeof(int32_t);
-            *data_type = TYPE_INTEGER_4;
+        if (n < 0) {
+            return UNF_STATUS_IO_ERROR;
         }
-        else if (strncmp(p, "i8", 2) == 0) {
-            // 'i8'
-            *type_size = sizeof(int64_t);
-            *data_type = TYPE_INTEGER_8;
+        if (n == 0) {
+            break;
         }
-        else if (strncmp(p, "r4", 2) == 0) {
-            // 'r4'
-            *type_size = sizeof(float);
-            *data_type = TYPE_REAL_4;
+        *n_done += (size_t) n;
+
+        // skip vectors filled completely
+        while (iovcnt > 0 && (size_t) n >= iov->iov_len) {
+            n -= (ssize_t) iov->iov_len;
+            iov++;
+            iovcnt--;
         }
-        else if (strncmp(p, "r8", 2) == 0) {
-            // 'r8'
-            *type_size = sizeof(double);
-            *data_type = TYPE_REAL_8;
+        if (iovcnt > 0) {
+            iov->iov_base = (char *) iov->iov_base + n;
+            iov->iov_len -= (size_t) n;
         }
-        else if (strncmp(p, "z4", 2) == 0) {
-            // 'z4'
-            *type_size = sizeof(float _Complex);
-            *data_type = TYPE_COMPLEX_4;
+    }
+
+    return UNF_STATUS_OK;
+}
+
+
+/**
+ * Implementation of unf_read_rec().
+ */
+static int read_direct_record(unf_file_t *file, int rec, char *fmt, va_list ap)
+{
+    if (file == NULL ||
+        file->access != UNF_ACCESS_DIRECT ||
+        file->record_len <= 0 ||
+        rec < 1) {
+        errno = EINVAL;
+        return 0;
+    }
+
+    size_t n_bytes_read = 0;
+    int n_arguments_read = 0;
+    int err;
+
+    if (file->cache_slots > 0) {
+        cache_slot_t *slot = cache_get(file, rec, 1);
+        if (slot == NULL) {
+            file->error_flag = 1;
+            return 0;
         }
-        else if (strncmp(p, "z8", 2) == 0) {
-            // 'z8'
-            *type_size = sizeof(double _Complex);
-            *data_type = TYPE_COMPLEX_8;
+
+        err = try_read_bytes(file, fmt, slot->data, slot->valid, &n_bytes_read, &n_arguments_read, ap);
+    }
+    else {
+        // find the required entry
+        off_t offset = (off_t) (rec - 1) * file->record_len;
+        err = io_seek(file, offset, SEEK_SET);
+        if (err != 0) {
+            file->error_flag = 1;
+            return 0;
         }
-        else {
-            errno = EINVAL;
+
+        // read target bytes
+        err = try_read_bytes(file, fmt, NULL, 0, &n_bytes_read, &n_arguments_read, ap);
+    }
+
+    if (n_bytes_read > file->record_len) {
+        file->error_flag = 1;
+    }
+
+    if (err == UNF_ERROR) {
+        file->error_flag = 1;
+    }
+
+    STATS_COUNT(file, records_read, 1);
+
+    return n_arguments_read;
+}
+
+
+/*
+ * Writes n_bytes zero bytes to the file.
+ */
+static int write_zeros(unf_file_t *file, size_t n_bytes)
+{
+    static const char zeros[4096] = {0};
+
+    while (n_bytes > 0) {
+        size_t n_chunk = n_bytes < sizeof(zeros) ? n_bytes : sizeof(zeros);
+        if (io_write(file, zeros, n_chunk) != n_chunk) {
             return UNF_ERROR;
         }
+        n_bytes -= n_chunk;
+    }
 
-        p += 2;
+    return UNF_SUCCESS;
+}
+
+
+static struct unf_rec_cache *cache_new(int num_slots, int record_len)
+{
+    if (num_slots <= 0 || num_slots > INT_MAX / 4 || record_len <= 0 ||
+        (size_t) num_slots > SIZE_MAX / (size_t) record_len) {
+        errno = ENOMEM;
+        return NULL;
     }
 
-    *fmt = p;
+    struct unf_rec_cache *cache = (struct unf_rec_cache *) calloc(1, sizeof(struct unf_rec_cache));
+    if (cache == NULL) {
+        return NULL;
+    }
 
-    return UNF_SUCCESS;
+    // the table has at least twice as many buckets as slots; bucket numbers are int
+    size_t num_buckets = 1;
+    while (num_buckets < 2 * (size_t) num_slots) {
+        num_buckets *= 2;
+    }
+
+    cache->num_slots = num_slots;
+    cache->bucket_mask = (int) (num_buckets - 1);
+    cache->buckets = (int *) malloc(sizeof(int) * num_buckets);
+    cache->slots = (cache_slot_t *) calloc(num_slots, sizeof(cache_slot_t));
+    cache->data = (char *) malloc((size_t) num_slots * record_len);
+
+    if (cache->buckets == NULL || cache->slots == NULL || cache->data == NULL) {
+        cache_free(cache);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < num_buckets; i++) {
+        cache->buckets[i] = -1;
+    }
+
+    for (int i = 0; i < num_slots; i++) {
+        cache_slot_t *slot = &cache->slots[i];
+        slot->rec = 0;
+        slot->prev = i - 1;
+        slot->next = (i + 1 < num_slots) ? i + 1 : -1;
+        slot->hash_next = -1;
+        slot->data = cache->data + (size_t) i * record_len;
+    }
+    cache->lru_head = 0;
+    cache->lru_tail = num_slots - 1;
+
+    return cache;
 }
 
 
-/**
- * Seeks 1 record forward (auxiliary function).
- * For sequential files only.
- * Returns UNF_SUCCESS upon success, UNF_ERROR otherwise.
- */
-static int seek_forward(unf_file_t *file)
+static void cache_free(struct unf_rec_cache *cache)
 {
-    // read size of the record in bytes
-    int32_t record_size = 0;
-    size_t err = fread(&record_size, 1, sizeof(int32_t), file->file_ptr);
-    if (err != sizeof(int32_t)) {
-        return UNF_ERROR;
+    if (cache == NULL) {
+        return;
     }
 
-    int status = fseek(file->file_ptr, record_size, SEEK_CUR);
-    if (status != 0) {
-        return UNF_ERROR;
+    free(cache->buckets);
+    free(cache->slots);
+    free(cache->data);
+    free(cache);
+}
+
+
+static int cache_bucket(struct unf_rec_cache *cache, int rec)
+{
+    return (int) (((uint32_t) rec * 2654435761u) & (uint32_t) cache->bucket_mask);
+}
+
+
+static void cache_unlink_hash(struct unf_rec_cache *cache, int i_slot)
+{
+    int *link = &cache->buckets[cache_bucket(cache, cache->slots[i_slot].rec)];
+    while (*link != i_slot) {
+        link = &cache->slots[*link].hash_next;
     }
+    *link = cache->slots[i_slot].hash_next;
+    cache->slots[i_slot].hash_next = -1;
+}
 
-    int32_t record_size_2 = 0;
-    err = fread(&record_size_2, 1, sizeof(int32_t), file->file_ptr);
-    if (err != sizeof(int32_t)) {
-        return UNF_ERROR;
+
+static void cache_move_to_front(struct unf_rec_cache *cache, int i_slot)
+{
+    cache_slot_t *slots = cache->slots;
+
+    if (cache->lru_head == i_slot) {
+        return;
     }
 
-    if (record_size != record_size_2) {
+    // unlink
+    slots[slots[i_slot].prev].next = slots[i_slot].next;
+    if (slots[i_slot].next >= 0) {
+        slots[slots[i_slot].next].prev = slots[i_slot].prev;
+    }
+    else {
+        cache->lru_tail = slots[i_slot].prev;
+    }
+
+    // insert at the head
+    slots[i_slot].prev = -1;
+    slots[i_slot].next = cache->lru_head;
+    slots[cache->lru_head].prev = i_slot;
+    cache->lru_head = i_slot;
+}
+
+
+static int cache_write_slot(unf_file_t *file, cache_slot_t *slot)
+{
+    off_t offset = (off_t) (slot->rec - 1) * file->record_len;
+    if (io_seek(file, offset, SEEK_SET) != 0) {
+        return UNF_ERROR;
+    }
+    if (io_write(file, slot->data, file->record_len) != (size_t) file->record_len) {
         return UNF_ERROR;
     }
+    slot->dirty = 0;
 
     return UNF_SUCCESS;
 }
 
 
-/**
- * Seeks 1 record backward (auxiliary function).
- * For sequential files only.
- * Returns UNF_SUCCESS upon success, UNF_ERROR otherwise.
+/*
+ * Returns the slot containing the record 'rec'.
+ * On a miss, the least recently used slot is evicted; if 'load' is nonzero,
+ * the record is read from the file (otherwise the caller overwrites it entirely).
+ * Returns NULL on error.
  */
-static int seek_backward(unf_file_t *file)
+static cache_slot_t *cache_get(unf_file_t *file, int rec, int load)
 {
-    // if we are at the beginning of the file,
-    // the following fseek() call will simply return error
-    // (without setting error flag however)
+    if (file->cache == NULL) {
+        file->cache = cache_new(file->cache_slots, file->record_len);
+        if (file->cache == NULL) {
+            return NULL;
+        }
+    }
 
-    // access the last record size
-    off_t offset = -4;
-    int err = fseek(file->file_ptr, offset, SEEK_CUR);
-    if (err != 0) {
-        return UNF_ERROR;
+    struct unf_rec_cache *cache = file->cache;
+
+    // lookup
+    for (int i = cache->buckets[cache_bucket(cache, rec)]; i >= 0; i = cache->slots[i].hash_next) {
+        if (cache->slots[i].rec == rec) {
+            STATS_COUNT(file, cache_hits, 1);
+            cache_move_to_front(cache, i);
+            return &cache->slots[i];
+        }
     }
 
-    int32_t record_size = 0;
-    size_t n_read = fread(&record_size, 1, sizeof(int32_t), file->file_ptr);
-    if (n_read != sizeof(int32_t)) {
-        return UNF_ERROR;
+    STATS_COUNT(file, cache_misses, 1);
+
+    // evict the least recently used record
+    int i_slot = cache->lru_tail;
+    cache_slot_t *slot = &cache->slots[i_slot];
+    if (slot->rec != 0) {
+        if (slot->dirty && cache_write_slot(file, slot) == UNF_ERROR) {
+            return NULL;
+        }
+        cache_unlink_hash(cache, i_slot);
+        slot->rec = 0;
     }
 
-    offset = -(2 * sizeof(int32_t) + record_size);
-    err = fseek(file->file_ptr, offset, SEEK_CUR);
-    if (err != 0) {
+    if (load) {
+        off_t offset = (off_t) (rec - 1) * file->record_len;
+        if (file->aio == NULL && io_seek(file, offset, SEEK_SET) != 0) {
+            return NULL;
+        }
+        if (file->aio) {
+            // no read-ahead for random access
+            slot->valid = unf_aio_pread(file->aio, slot->data, file->record_len, offset);
+        }
+        else {
+            slot->valid = io_read(file, slot->data, file->record_len);
+        }
+        if (io_error(file)) {
+            return NULL;
+        }
+    }
+    else {
+        slot->valid = 0;
+    }
+
+    int bucket = cache_bucket(cache, rec);
+    slot->rec = rec;
+    slot->dirty = 0;
+    slot->hash_next = cache->buckets[bucket];
+    cache->buckets[bucket] = i_slot;
+    cache_move_to_front(cache, i_slot);
+
+    return slot;
+}
+
+
+static int compare_slots_by_rec(const void *a, const void *b)
+{
+    const cache_slot_t *slot_a = *(const cache_slot_t **) a;
+    const cache_slot_t *slot_b = *(const cache_slot_t **) b;
+
+    return (slot_a->rec > slot_b->rec) - (slot_a->rec < slot_b->rec);
+}
+
+
+/*
+ * Writes all modified records to the file in the ascending order of record numbers.
+ */
+static int cache_flush(unf_file_t *file)
+{
+    struct unf_rec_cache *cache = file->cache;
+    if (cache == NULL) {
+        return UNF_SUCCESS;
+    }
+
+    cache_slot_t **dirty = (cache_slot_t **) malloc(sizeof(cache_slot_t *) * cache->num_slots);
+    if (dirty == NULL) {
         return UNF_ERROR;
     }
 
-    return UNF_SUCCESS;
+    int n_dirty = 0;
+    for (int i = 0; i < cache->num_slots; i++) {
+        if (cache->slots[i].rec != 0 && cache->slots[i].dirty) {
+            dirty[n_dirty++] = &cache->slots[i];
+        }
+    }
+
+    qsort(dirty, n_dirty, sizeof(cache_slot_t *), compare_slots_by_rec);
+
+    int status = UNF_SUCCESS;
+    for (int i = 0; i < n_dirty; i++) {
+        if (cache_write_slot(file, dirty[i]) == UNF_ERROR) {
+            status = UNF_ERROR;
+            break;
+        }
+    }
+
+    free(dirty);
+
+    return status;
 }
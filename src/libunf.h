@@ -13,6 +13,7 @@
 extern "C" {
 #endif
 
+#include <stdint.h>
 #include <stdio.h>
 
 typedef enum {
@@ -27,22 +28,101 @@ typedef enum {
     UNF_POS_END
 } unf_position_t;
 
+typedef enum {
+    UNF_BYTE_ORDER_NATIVE,
+    UNF_BYTE_ORDER_SWAPPED
+} unf_byte_order_t;
+
+/*
+ * Engines used to read files opened in the "r" mode.
+ * UNF_READ_ENGINE_ASYNC: read-ahead by large chunks submitted via io_uring
+ * (if available, otherwise pread() is used).
+ */
+typedef enum {
+    UNF_READ_ENGINE_STDIO,
+    UNF_READ_ENGINE_ASYNC
+} unf_read_engine_t;
+
 enum {
     UNF_ERROR = -1,
     UNF_SUCCESS = 0,
 };
 
+/*
+ * Outcome of the positionless reads (unf_read_at(), unf_read_record_at()).
+ * These functions do not use errno and the error flag of the file.
+ */
+typedef enum {
+    UNF_STATUS_OK = 0,
+    UNF_STATUS_EOF,               // no record starts at the offset
+    UNF_STATUS_IO_ERROR,
+    UNF_STATUS_BAD_RECORD,        // markers do not coincide or the record is truncated
+    UNF_STATUS_BAD_FORMAT,        // the format string does not match the record
+    UNF_STATUS_BUFFER_TOO_SMALL,
+    UNF_STATUS_NO_MEMORY,
+    UNF_STATUS_INVALID_ARGS
+} unf_status_t;
+
+/*
+ * destination of a part of the record payload, see unf_read_segments_at()
+ */
+typedef struct {
+    void *data;
+    size_t n_bytes;
+} unf_segment_t;
+
+/*
+ * I/O instrumentation counters.
+ * Updated only if libunf is compiled with UNF_STATS, otherwise remain zero.
+ */
+typedef struct {
+    int64_t bytes_read;
+    int64_t bytes_written;
+    int64_t records_read;
+    int64_t records_written;
+    int64_t n_fread;
+    int64_t n_fwrite;
+    int64_t n_fseek;
+    int64_t cache_hits;   // direct-access record cache
+    int64_t cache_misses;
+    double time_io;     // seconds spent in fread/fwrite/fseek
+    double time_parse;  // seconds spent in unf_read/unf_write/unf_read_batch apart from I/O
+} unf_stats_t;
+
+/*
+ * Index of records of a sequential file, see unf_build_index().
+ * offsets[i] is the position of the leading marker of the i-th record,
+ * lengths[i] is the length of its payload in bytes.
+ */
+typedef struct {
+    int64_t num_records;
+    int64_t *offsets;
+    int32_t *lengths;
+} unf_rec_index_t;
+
 typedef struct {
     FILE *file_ptr;
     int access;
     int record_len; // is used only for direct-access files
     int error_flag;
+    int swap_bytes; // byte order of the file differs from the native one
+    char *path;
+    char *write_buf; // record assembly buffer for unf_write()
+    size_t write_buf_size;
+    int cache_slots; // max number of cached records, direct-access files only
+    struct unf_rec_cache *cache;
+    struct unf_aio *aio; // asynchronous read engine, NULL if stdio is used
+    unf_stats_t stats;
 } unf_file_t;
 
 unf_file_t *unf_open(const char *path, const char *mode, unf_access_t access, ...);
 
 int unf_close(unf_file_t *file);
 
+int unf_same_file(const char *path_1, const char *path_2);
+
+int unf_fileno(unf_file_t *file);
+
 int unf_write(unf_file_t *file, char *fmt, ...);
 
 int unf_write_rec(unf_file_t *file, int rec, char *fmt, ...);
@@ -51,8 +131,32 @@ int unf_read(unf_file_t *file, char *fmt, ...);
 
 int unf_read_rec(unf_file_t *file, int rec, char *fmt, ...);
 
+int unf_read_batch(unf_file_t *file, char *buf, size_t buf_size, size_t *n_carry, int max_records,
+                   size_t *offsets, int32_t *lengths);
+
 int unf_next_rec_size(unf_file_t *file);
 
+int64_t unf_tell(unf_file_t *file);
+
+int unf_seek_offset(unf_file_t *file, int64_t offset);
+
+unf_status_t unf_read_at(unf_file_t *file, int64_t offset, int64_t *next_offset, char *fmt, ...);
+
+unf_status_t unf_read_record_at(unf_file_t *file, int64_t offset, void *buf, size_t buf_size,
+                                int32_t *length, int64_t *next_offset);
+
+unf_status_t unf_read_segments_at(unf_file_t *file, int64_t offset, int32_t length,
+                                  const unf_segment_t *segments, int n_segments,
+                                  int64_t *next_offset, int32_t *next_length);
+
+const char *unf_status_string(unf_status_t status);
+
+unf_rec_index_t *unf_build_index(unf_file_t *file, int num_threads);
+
+void unf_free_index(unf_rec_index_t *index);
+
+int unf_seek_index(unf_file_t *file, unf_rec_index_t *index, int64_t rec);
+
 int unf_seek(unf_file_t *file, unf_position_t pos, int offset);
 
 int unf_rewind(unf_file_t *file);
@@ -65,6 +169,36 @@ int unf_eof(unf_file_t *file);
 
 int unf_error(unf_file_t *file);
 
+int unf_flush(unf_file_t *file);
+
+int unf_set_cache_size(unf_file_t *file, int num_slots);
+
+int unf_set_read_engine(unf_file_t *file, unf_read_engine_t engine);
+
+void unf_set_default_read_engine(unf_read_engine_t engine);
+
+const char *unf_get_read_engine_name(unf_file_t *file);
+
+int unf_set_byte_order(unf_file_t *file, unf_byte_order_t order);
+
+unf_byte_order_t unf_get_byte_order(unf_file_t *file);
+
+int unf_detect_byte_order(unf_file_t *file, int expected_rec_size);
+
+int unf_cpu_has_avx2(void);
+
+void unf_byte_swap(void *data, size_t n_elements, int elem_size);
+
+void unf_deinterleave_int32(const void *pairs, size_t n_pairs, int32_t *first, int32_t *second);
+
+int unf_narrow_int64(const void *src, size_t n, int32_t *dst);
+
+int unf_deinterleave_narrow_int64(const void *pairs, size_t n_pairs, int32_t *first, int32_t *second);
+
+int unf_get_stats(unf_file_t *file, unf_stats_t *stats);
+
+void unf_stats_dump(FILE *out);
+
 #ifdef __cplusplus
 }
 #endif
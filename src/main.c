@@ -5,28 +5,867 @@
  */
 
 #include <ctype.h>
+#include <errno.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "fcidump.h"
+#include "fock_analysis.h"
 #include "mdprop.h"
 #include "mrconee.h"
 #include "mdcint.h"
+#include "json_writer.h"
+#include "libunf.h"
+#include "npy.h"
+#include "convert.h"
+#include "fragments.h"
+#include "classes.h"
+#include "report.h"
+
+#define MAX_PATH_LEN 1024
+
+typedef enum {
+    FORMAT_TEXT,
+    FORMAT_JSON
+} output_format_t;
+
+/*
+ * stages of the inspection, can be combined
+ */
+enum {
+    STAGE_MRCONEE = 1,
+    STAGE_FOCK = 2,
+    STAGE_MDPROP = 4,
+    STAGE_MDCINT = 8,
+    STAGE_ALL = STAGE_MRCONEE | STAGE_FOCK | STAGE_MDPROP | STAGE_MDCINT
+};
+
+typedef struct {
+    output_format_t format;
+    int stages;
+    char mrconee_path[MAX_PATH_LEN];
+    char mdprop_path[MAX_PATH_LEN];
+    char mdcint_path[MAX_PATH_LEN];
+    int num_threads;            // 0: OpenMP default
+    size_t buffer_size;         // 0: default size of the MDCINT read buffer
+    unf_read_engine_t engine;
+    char *fcidump_path;         // export mode if not NULL
+    char *npy_dir;              // export mode if not NULL
+    char *convert_dir;          // conversion mode if not NULL
+    int int_size;               // size of integers after the conversion, 0: default
+    double imag_threshold;      // complex integrals are converted to real ones if not negative
+    char *resplit_dir;          // merging/re-splitting mode if not NULL
+    int num_fragments;          // number of output fragments of MDCINT
+    char *fragments;            // comma-separated input fragments, NULL: found next to MDCINT
+    char *classes_dir;          // classification mode if not NULL, "-": no files are written
+} inspector_options_t;
+
+/*
+ * destination of reports
+ */
+typedef struct {
+    inspector_options_t *opt;
+    json_writer_t json;
+} reporter_t;
+
+static void print_usage();
+
+static int parse_args(int argc, char **argv, inspector_options_t *opt);
+
+static char *option_value(char *arg, const char *name);
+
+static int parse_stages(char *list, int *stages);
 
-int main()
+static int parse_size(char *str, size_t *size);
+
+static void run_inspection(inspector_options_t *opt);
+
+static int run_fcidump_export(inspector_options_t *opt);
+
+static int run_npy_export(inspector_options_t *opt);
+
+static int run_conversion(inspector_options_t *opt);
+
+static int run_resplit(inspector_options_t *opt);
+
+static int run_classification(inspector_options_t *opt);
+
+static void report_mrconee(reporter_t *r, mrconee_data_t *data);
+
+static void report_fock(reporter_t *r, mrconee_data_t *mrconee_data, fock_analysis_t *analysis);
+
+static void report_mdprop(reporter_t *r, mrconee_data_t *mrconee_data, mdprop_data_t *data);
+
+static void report_mdcint(reporter_t *r, mrconee_data_t *mrconee_data, mdcint_data_t *data, int error_code);
+
+#ifdef DIRAC_INSPECTOR_STATS
+static void dump_stats();
+#endif
+
+int main(int argc, char **argv)
 {
-    mrconee_data_t *mrconee_data = read_mrconee("MRCONEE");
+    inspector_options_t opt;
+
+#ifdef DIRAC_INSPECTOR_STATS
+    atexit(dump_stats);
+#endif
+
+    if (parse_args(argc, argv, &opt) == EXIT_FAILURE) {
+        print_usage();
+        return EXIT_FAILURE;
+    }
+
+#ifdef _OPENMP
+    if (opt.num_threads > 0) {
+        omp_set_num_threads(opt.num_threads);
+    }
+#endif
+    if (opt.buffer_size > 0) {
+        mdcint_set_batch_size(opt.buffer_size);
+    }
+    unf_set_default_read_engine(opt.engine);
+
+    if (opt.fcidump_path) {
+        return run_fcidump_export(&opt);
+    }
+    if (opt.npy_dir) {
+        return run_npy_export(&opt);
+    }
+    if (opt.convert_dir) {
+        return run_conversion(&opt);
+    }
+    if (opt.resplit_dir) {
+        return run_resplit(&opt);
+    }
+    if (opt.classes_dir) {
+        return run_classification(&opt);
+    }
+
+    run_inspection(&opt);
+
+    return 0;
+}
+
+
+static void print_usage()
+{
+    printf("usage: dirac_inspector.x [options]\n");
+    printf("  --dir=<path>          directory with MRCONEE, MDPROP and MDCINT files (default: current directory)\n");
+    printf("  --mrconee=<path>      path to the MRCONEE file (overrides --dir)\n");
+    printf("  --mdprop=<path>       path to the MDPROP file (overrides --dir)\n");
+    printf("  --mdcint=<path>       path to the MDCINT file (overrides --dir)\n");
+    printf("  --stages=<list>       comma-separated stages to run: mrconee, fock, mdprop, mdcint (default: all)\n");
+    printf("  --skip=<list>         comma-separated stages not to run\n");
+    printf("  --format=<name>       output format: text or json (default: text)\n");
+    printf("  --threads=<n>         number of OpenMP threads (default: OMP_NUM_THREADS)\n");
+    printf("  --buffer-size=<size>  size of the MDCINT read buffer in bytes (min 64), K/M/G suffixes allowed (default: 4M)\n");
+    printf("  --io=<name>           read engine: stdio or async (io_uring/pread read-ahead) (default: stdio)\n");
+    printf("  --fcidump=<path>      export integrals to the FCIDUMP file instead of printing reports\n");
+    printf("  --npy=<dir>           export arrays to NumPy .npy files in the directory instead of printing reports\n");
+    printf("  --convert=<dir>       rewrite the files with integers of another size into the directory\n");
+    printf("  --int-size=<n>        size of integers after the conversion: 4 or 8 (default: the opposite one,\n");
+    printf("                        or the same one with --real)\n");
+    printf("  --real=<threshold>    convert complex integrals to real ones, max allowed |Im| (e.g. 1e-12)\n");
+    printf("  --resplit=<dir>       merge MDCINT fragments or re-split them into the directory\n");
+    printf("  --num-fragments=<n>   number of balanced output fragments of MDCINT (default: 1, merge)\n");
+    printf("  --fragments=<list>    comma-separated input fragments (default: MDCINT, MDCINXXXX1, ...)\n");
+    printf("  --classes=<dir>       count integrals by occupation classes (oooo, ..., vvvv) and write them\n");
+    printf("                        to per-class files in the directory ('-': count only)\n");
+}
+
+
+static int parse_args(int argc, char **argv, inspector_options_t *opt)
+{
+    char *dir = NULL;
+    char *mrconee_path = NULL;
+    char *mdprop_path = NULL;
+    char *mdcint_path = NULL;
+    int skip = 0;
+
+    opt->format = FORMAT_TEXT;
+    opt->stages = STAGE_ALL;
+    opt->num_threads = 0;
+    opt->buffer_size = 0;
+    opt->engine = UNF_READ_ENGINE_STDIO;
+    opt->fcidump_path = NULL;
+    opt->npy_dir = NULL;
+    opt->convert_dir = NULL;
+    opt->int_size = 0;
+    opt->imag_threshold = -1.0;
+    opt->resplit_dir = NULL;
+    opt->num_fragments = 1;
+    opt->fragments = NULL;
+    opt->classes_dir = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        char *arg = argv[i];
+        char *value = NULL;
+
+        if ((value = option_value(arg, "--dir"))) {
+            dir = value;
+        }
+        else if ((value = option_value(arg, "--mrconee"))) {
+            mrconee_path = value;
+        }
+        else if ((value = option_value(arg, "--mdprop"))) {
+            mdprop_path = value;
+        }
+        else if ((value = option_value(arg, "--mdcint"))) {
+            mdcint_path = value;
+        }
+        else if ((value = option_value(arg, "--stages"))) {
+            if (parse_stages(value, &opt->stages) == EXIT_FAILURE) {
+                return EXIT_FAILURE;
+            }
+        }
+        else if ((value = option_value(arg, "--skip"))) {
+            if (parse_stages(value, &skip) == EXIT_FAILURE) {
+                return EXIT_FAILURE;
+            }
+        }
+        else if ((value = option_value(arg, "--format"))) {
+            if (strcmp(value, "text") == 0) {
+                opt->format = FORMAT_TEXT;
+            }
+            else if (strcmp(value, "json") == 0) {
+                opt->format = FORMAT_JSON;
+            }
+            else {
+                fprintf(stderr, "unknown output format: %s\n", value);
+                return EXIT_FAILURE;
+            }
+        }
+        else if ((value = option_value(arg, "--threads"))) {
+            opt->num_threads = atoi(value);
+            if (opt->num_threads < 1) {
+                fprintf(stderr, "wrong number of threads: %s\n", value);
+                return EXIT_FAILURE;
+            }
+        }
+        else if ((value = option_value(arg, "--buffer-size"))) {
+            if (parse_size(value, &opt->buffer_size) == EXIT_FAILURE) {
+                fprintf(stderr, "wrong buffer size: %s\n", value);
+                return EXIT_FAILURE;
+            }
+        }
+        else if ((value = option_value(arg, "--io"))) {
+            if (strcmp(value, "stdio") == 0) {
+                opt->engine = UNF_READ_ENGINE_STDIO;
+            }
+            else if (strcmp(value, "async") == 0) {
+                opt->engine = UNF_READ_ENGINE_ASYNC;
+            }
+            else {
+                fprintf(stderr, "unknown read engine: %s\n", value);
+                return EXIT_FAILURE;
+            }
+        }
+        else if ((value = option_value(arg, "--fcidump"))) {
+            opt->fcidump_path = value;
+        }
+        else if ((value = option_value(arg, "--npy"))) {
+            opt->npy_dir = value;
+        }
+        else if ((value = option_value(arg, "--convert"))) {
+            opt->convert_dir = value;
+        }
+        else if ((value = option_value(arg, "--int-size"))) {
+            opt->int_size = atoi(value);
+            if (opt->int_size != 4 && opt->int_size != 8) {
+                fprintf(stderr, "wrong size of integers: %s\n", value);
+                return EXIT_FAILURE;
+            }
+        }
+        else if ((value = option_value(arg, "--real"))) {
+            char *end = NULL;
+            opt->imag_threshold = strtod(value, &end);
+            if (end == value || *end != '\0' || !(opt->imag_threshold >= 0.0)) {
+                fprintf(stderr, "wrong threshold for imaginary parts: %s\n", value);
+                return EXIT_FAILURE;
+            }
+        }
+        else if ((value = option_value(arg, "--resplit"))) {
+            opt->resplit_dir = value;
+        }
+        else if ((value = option_value(arg, "--num-fragments"))) {
+            opt->num_fragments = atoi(value);
+            if (opt->num_fragments < 1 || opt->num_fragments > MDCINT_MAX_FRAGMENTS) {
+                fprintf(stderr, "wrong number of fragments: %s\n", value);
+                return EXIT_FAILURE;
+            }
+        }
+        else if ((value = option_value(arg, "--fragments"))) {
+            opt->fragments = value;
+        }
+        else if ((value = option_value(arg, "--classes"))) {
+            opt->classes_dir = value;
+        }
+        else {
+            fprintf(stderr, "unknown option: %s\n", arg);
+            return EXIT_FAILURE;
+        }
+    }
+
+    opt->stages &= ~skip;
+
+    struct {
+        char *path;
+        char *name;
+        char *dest;
+    } files[] = {
+        {mrconee_path, "MRCONEE", opt->mrconee_path},
+        {mdprop_path, "MDPROP", opt->mdprop_path},
+        {mdcint_path, "MDCINT", opt->mdcint_path}
+    };
+    for (int i = 0; i < 3; i++) {
+        int len;
+        if (files[i].path) {
+            len = snprintf(files[i].dest, MAX_PATH_LEN, "%s", files[i].path);
+        }
+        else if (dir) {
+            len = snprintf(files[i].dest, MAX_PATH_LEN, "%s/%s", dir, files[i].name);
+        }
+        else {
+            len = snprintf(files[i].dest, MAX_PATH_LEN, "%s", files[i].name);
+        }
+        if (len >= MAX_PATH_LEN) {
+            fprintf(stderr, "path is too long: %s\n", files[i].path ? files[i].path : dir);
+            return EXIT_FAILURE;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+
+/*
+ * returns the value of the option given as "--name=value", NULL if the argument is another option
+ */
+static char *option_value(char *arg, const char *name)
+{
+    size_t len = strlen(name);
+    if (strncmp(arg, name, len) == 0 && arg[len] == '=') {
+        return arg + len + 1;
+    }
+    return NULL;
+}
+
+
+/*
+ * comma-separated list of stage names -> bit mask
+ */
+static int parse_stages(char *list, int *stages)
+{
+    *stages = 0;
+
+    char *p = list;
+    while (*p) {
+        size_t len = strcspn(p, ",");
+        if (len == 7 && strncmp(p, "mrconee", len) == 0) {
+            *stages |= STAGE_MRCONEE;
+        }
+        else if (len == 4 && strncmp(p, "fock", len) == 0) {
+            *stages |= STAGE_FOCK;
+        }
+        else if (len == 6 && strncmp(p, "mdprop", len) == 0) {
+            *stages |= STAGE_MDPROP;
+        }
+        else if (len == 6 && strncmp(p, "mdcint", len) == 0) {
+            *stages |= STAGE_MDCINT;
+        }
+        else if (len == 3 && strncmp(p, "all", len) == 0) {
+            *stages |= STAGE_ALL;
+        }
+        else {
+            fprintf(stderr, "unknown stage: %.*s\n", (int) len, p);
+            return EXIT_FAILURE;
+        }
+        p += len;
+        if (*p == ',') {
+            p++;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+
+/*
+ * size in bytes with an optional K, M or G suffix;
+ * fails if the size does not fit into size_t
+ */
+static int parse_size(char *str, size_t *size)
+{
+    char *end = NULL;
+    errno = 0;
+    unsigned long long value = strtoull(str, &end, 10);
+    if (errno != 0 || end == str || value == 0 || str[0] == '-') {
+        return EXIT_FAILURE;
+    }
+
+    int shift = 0;
+    char suffix = (char) toupper((unsigned char) *end);
+    if (suffix == 'K') {
+        shift = 10;
+        end++;
+    }
+    else if (suffix == 'M') {
+        shift = 20;
+        end++;
+    }
+    else if (suffix == 'G') {
+        shift = 30;
+        end++;
+    }
+    if (*end != '\0' || value > (SIZE_MAX >> shift)) {
+        return EXIT_FAILURE;
+    }
+    value <<= shift;
+
+    *size = (size_t) value;
+    return EXIT_SUCCESS;
+}
+
+
+/**
+ * The MRCONEE file is read first if any stage is selected: the other readers
+ * need its data (the MDCINT reader cannot work without it).
+ *
+ * Then the MDCINT file is read concurrently with the analysis of the Fock matrix
+ * and of the MDPROP file: they use separate file streams, and the analysis runs in
+ * its own (nested) team of threads. Reports are written in the fixed order
+ * mrconee, fock_analysis, mdprop, mdcint; only the first section writes to stdout
+ * while both are running.
+ */
+static void run_inspection(inspector_options_t *opt)
+{
+    reporter_t r;
+    r.opt = opt;
+    json_init(&r.json, stdout);
+
+    if (opt->format == FORMAT_JSON) {
+        json_begin_object(&r.json);
+    }
+
+    mrconee_data_t *mrconee_data = NULL;
+    if (opt->stages) {
+        mrconee_data = read_mrconee(opt->mrconee_path);
+    }
+    if (opt->stages & STAGE_MRCONEE) {
+        report_mrconee(&r, mrconee_data);
+    }
+
+    int read_mdcint_file = (opt->stages & STAGE_MDCINT) && mrconee_data != NULL;
+    mdcint_data_t *mdcint_data = NULL;
+    int mdcint_errno = 0;
+
+#ifdef _OPENMP
+    int num_threads = omp_get_max_threads();
+    omp_set_max_active_levels(2);
+#endif
+
+    #pragma omp parallel sections num_threads(2) if(read_mdcint_file)
+    {
+        #pragma omp section
+        {
+#ifdef _OPENMP
+            // one thread is left to the MDCINT reader
+            if (read_mdcint_file) {
+                omp_set_num_threads(num_threads > 2 ? num_threads - 1 : 1);
+            }
+#endif
+            if (opt->stages & STAGE_FOCK) {
+                fock_analysis_t *fock_analysis = mrconee_data ? analyze_fock_matrix(mrconee_data) : NULL;
+                report_fock(&r, mrconee_data, fock_analysis);
+                free_fock_analysis(fock_analysis);
+            }
+            if (opt->stages & STAGE_MDPROP) {
+                mdprop_data_t *mdprop_data = read_mdprop(opt->mdprop_path, mrconee_data);
+                report_mdprop(&r, mrconee_data, mdprop_data);
+                free_mdprop_data(mdprop_data);
+            }
+        }
+
+        #pragma omp section
+        {
+            if (read_mdcint_file) {
+                mdcint_data = read_mdcint(opt->mdcint_path, mrconee_data);
+                mdcint_errno = errno;
+            }
+        }
+    }
+
+    if (opt->stages & STAGE_MDCINT) {
+        report_mdcint(&r, mrconee_data, mdcint_data, mdcint_errno);
+        free_mdcint_data(mdcint_data);
+    }
+
+    if (opt->format == FORMAT_JSON) {
+        json_end_object(&r.json);
+    }
+
+    if (mrconee_data) {
+        free_mrconee_data(mrconee_data);
+    }
+}
+
+
+/**
+ * Export mode: integrals from MRCONEE and MDCINT are written to the FCIDUMP file,
+ * only a short summary is printed.
+ */
+static int run_fcidump_export(inspector_options_t *opt)
+{
+    mrconee_data_t *mrconee_data = read_mrconee(opt->mrconee_path);
+    if (mrconee_data == NULL) {
+        fprintf(stderr, " MRCONEE file not found\n");
+        return EXIT_FAILURE;
+    }
+
+    fcidump_result_t result;
+    int status = write_fcidump(opt->fcidump_path, mrconee_data, opt->mdcint_path, &result);
+    free_mrconee_data(mrconee_data);
+
+    if (status == EXIT_FAILURE) {
+        fprintf(stderr, " export to FCIDUMP failed: %s\n", result.error);
+        return EXIT_FAILURE;
+    }
+
+    printf(" FCIDUMP file               %s\n", opt->fcidump_path);
+    printf(" two-electron integrals     %lld\n", (long long) result.num_two_electron);
+    printf(" one-electron integrals     %lld\n", (long long) result.num_one_electron);
+    printf(" bytes written              %lld\n", (long long) result.bytes_written);
+    printf(" time for export            %.2f sec\n", result.time);
+
+    return EXIT_SUCCESS;
+}
+
+
+/**
+ * Export mode: arrays from MRCONEE, MDPROP and MDCINT are written to .npy files;
+ * MDPROP and MDCINT are skipped if their stages are not selected.
+ */
+static int run_npy_export(inspector_options_t *opt)
+{
+    mrconee_data_t *mrconee_data = read_mrconee(opt->mrconee_path);
+    if (mrconee_data == NULL) {
+        fprintf(stderr, " MRCONEE file not found\n");
+        return EXIT_FAILURE;
+    }
+
+    npy_export_result_t result;
+    int status = write_npy_export(opt->npy_dir, mrconee_data,
+                                  (opt->stages & STAGE_MDPROP) ? opt->mdprop_path : NULL,
+                                  (opt->stages & STAGE_MDCINT) ? opt->mdcint_path : NULL, &result);
+    free_mrconee_data(mrconee_data);
+
+    if (status == EXIT_FAILURE) {
+        fprintf(stderr, " export to .npy failed: %s\n", result.error);
+        return EXIT_FAILURE;
+    }
+
+    printf(" .npy directory             %s\n", opt->npy_dir);
+    printf(" files written              %d\n", result.num_files);
+    printf(" property operators         %d\n", result.num_operators);
+    printf(" two-electron integrals     %lld\n", (long long) result.num_integrals);
+    printf(" bytes written              %lld\n", (long long) result.bytes_written);
+    printf(" time for export            %.2f sec\n", result.time);
+
+    return EXIT_SUCCESS;
+}
+
+
+/**
+ * Conversion mode: MRCONEE, MDPROP and MDCINT are rewritten with integers of
+ * another size and/or with complex integrals replaced by real ones;
+ * MDPROP and MDCINT are skipped if their stages are not selected.
+ */
+static int run_conversion(inspector_options_t *opt)
+{
+    mrconee_data_t *mrconee_data = read_mrconee(opt->mrconee_path);
     if (mrconee_data == NULL) {
-        printf(" MRCONEE file not found\n");
+        fprintf(stderr, " MRCONEE file not found\n");
+        return EXIT_FAILURE;
+    }
+
+    int to_real = opt->imag_threshold >= 0.0;
+    int int_size = opt->int_size;
+    if (int_size == 0 && to_real) {
+        int_size = mrconee_data->dirac_int_size;
+    }
+    else if (int_size == 0) {
+        int_size = mrconee_data->dirac_int_size == 8 ? 4 : 8;
+    }
+
+    char *mdprop_path = (opt->stages & STAGE_MDPROP) ? opt->mdprop_path : NULL;
+    char *mdcint_path = (opt->stages & STAGE_MDCINT) ? opt->mdcint_path : NULL;
+    convert_result_t result;
+    int status;
+    if (to_real) {
+        status = convert_to_real(opt->convert_dir, int_size, opt->imag_threshold, mrconee_data,
+                                 opt->mrconee_path, mdprop_path, mdcint_path, &result);
     }
     else {
-        print_mrconee_data(stdout, mrconee_data);
+        status = convert_int_size(opt->convert_dir, int_size, mrconee_data, opt->mrconee_path,
+                                  mdprop_path, mdcint_path, &result);
+    }
+    free_mrconee_data(mrconee_data);
+
+    if (status == EXIT_FAILURE) {
+        fprintf(stderr, " conversion failed: %s\n", result.error);
+        return EXIT_FAILURE;
     }
 
-    read_mdprop("MDPROP", mrconee_data);
-    read_mdcint("MDCINT", mrconee_data);
+    printf(" output directory           %s\n", opt->convert_dir);
+    printf(" size of integers           %d -> %d bytes\n", result.from_int_size, result.to_int_size);
+    if (result.to_real) {
+        printf(" arithmetic                 complex -> real\n");
+        printf(" max |Im| of integrals      %.3e\n", result.max_imag);
+    }
+    printf(" files written              %d\n", result.num_files);
+    printf(" records                    %lld\n", (long long) result.num_records);
+    printf(" bytes read                 %lld\n", (long long) result.bytes_read);
+    printf(" bytes written              %lld\n", (long long) result.bytes_written);
+    printf(" time for conversion        %.2f sec\n", result.time);
 
-    return 0;
+    return EXIT_SUCCESS;
+}
+
+
+/**
+ * Merging/re-splitting mode: MDCINT fragments (given by --fragments or found
+ * next to MDCINT) are rewritten into the given number of balanced fragments.
+ */
+static int run_resplit(inspector_options_t *opt)
+{
+    mrconee_data_t *mrconee_data = read_mrconee(opt->mrconee_path);
+    if (mrconee_data == NULL) {
+        fprintf(stderr, " MRCONEE file not found\n");
+        return EXIT_FAILURE;
+    }
+
+    char *paths[MDCINT_MAX_FRAGMENTS];
+    int num_inputs = 0;
+    if (opt->fragments) {
+        for (char *p = strtok(opt->fragments, ","); p && num_inputs < MDCINT_MAX_FRAGMENTS; p = strtok(NULL, ",")) {
+            paths[num_inputs++] = strdup(p);
+        }
+    }
+    else {
+        num_inputs = find_mdcint_fragments(opt->mdcint_path, paths, MDCINT_MAX_FRAGMENTS);
+    }
+    if (num_inputs == 0) {
+        fprintf(stderr, " MDCINT file not found\n");
+        free_mrconee_data(mrconee_data);
+        return EXIT_FAILURE;
+    }
+
+    fragments_result_t result;
+    int status = resplit_mdcint(paths, num_inputs, opt->resplit_dir, opt->num_fragments, mrconee_data, &result);
+    free_mrconee_data(mrconee_data);
+    for (int i = 0; i < num_inputs; i++) {
+        free(paths[i]);
+    }
+
+    if (status == EXIT_FAILURE) {
+        fprintf(stderr, " merging/re-splitting of MDCINT failed: %s\n", result.error);
+        return EXIT_FAILURE;
+    }
+
+    printf(" output directory           %s\n", opt->resplit_dir);
+    printf(" fragments                  %d -> %d\n", result.num_inputs, result.num_outputs);
+    printf(" records                    %lld\n", (long long) result.num_records);
+    printf(" two-electron integrals     %lld\n", (long long) result.num_integrals);
+    printf(" integrals per fragment     %lld .. %lld\n", (long long) result.min_integrals,
+           (long long) result.max_integrals);
+    printf(" bytes written              %lld\n", (long long) result.bytes_written);
+    printf(" time for re-splitting      %.2f sec\n", result.time);
+
+    return EXIT_SUCCESS;
+}
+
+
+/**
+ * Classification mode: integrals of MDCINT are counted by occupation classes
+ * and optionally written to per-class files.
+ */
+static int run_classification(inspector_options_t *opt)
+{
+    mrconee_data_t *mrconee_data = read_mrconee(opt->mrconee_path);
+    if (mrconee_data == NULL) {
+        fprintf(stderr, " MRCONEE file not found\n");
+        return EXIT_FAILURE;
+    }
+
+    char *dir = strcmp(opt->classes_dir, "-") == 0 ? NULL : opt->classes_dir;
+    classes_result_t result;
+    int status = classify_integrals(opt->mdcint_path, mrconee_data, dir, &result);
+    free_mrconee_data(mrconee_data);
+
+    if (status == EXIT_FAILURE) {
+        fprintf(stderr, " classification of integrals failed: %s\n", result.error);
+        return EXIT_FAILURE;
+    }
+
+    printf(" class        integrals        %%     values, MB\n");
+    for (int c = 0; c < NUM_INTEGRAL_CLASSES; c++) {
+        double percent = result.total_integrals > 0 ? 100.0 * result.num_integrals[c] / result.total_integrals : 0.0;
+        printf(" %-6s%16lld%9.2f%15.3f\n", integral_class_name(c), (long long) result.num_integrals[c], percent,
+               result.value_bytes[c] / (1024.0 * 1024.0));
+    }
+    printf(" two-electron integrals     %lld\n", (long long) result.total_integrals);
+    if (dir) {
+        printf(" output directory           %s\n", dir);
+        printf(" bytes written              %lld\n", (long long) result.bytes_written);
+    }
+    printf(" time for classification    %.2f sec\n", result.time);
+
+    return EXIT_SUCCESS;
+}
+
+
+/*
+ * Reports on each stage, in text or JSON.
+ * A JSON report that cannot be produced is replaced with an object containing
+ * the "error" key only.
+ */
+
+static void report_mrconee(reporter_t *r, mrconee_data_t *data)
+{
+    if (r->opt->format == FORMAT_JSON) {
+        json_key(&r->json, "mrconee");
+        if (data == NULL) {
+            json_error(&r->json, "MRCONEE file not found");
+        }
+        else {
+            json_mrconee_data(&r->json, data);
+        }
+    }
+    else {
+        if (data == NULL) {
+            printf(" MRCONEE file not found\n");
+        }
+        else {
+            print_mrconee_data(stdout, data);
+        }
+    }
+}
+
+
+static void report_fock(reporter_t *r, mrconee_data_t *mrconee_data, fock_analysis_t *analysis)
+{
+    if (r->opt->format == FORMAT_JSON) {
+        json_key(&r->json, "fock_analysis");
+        if (analysis == NULL) {
+            json_error(&r->json, "Fock matrix is not available");
+        }
+        else {
+            json_fock_analysis(&r->json, mrconee_data, analysis);
+        }
+    }
+    else {
+        if (mrconee_data == NULL && !(r->opt->stages & STAGE_MRCONEE)) {
+            printf(" MRCONEE file not found\n");
+        }
+        else if (analysis) {
+            print_fock_analysis(stdout, mrconee_data, analysis);
+        }
+    }
 }
 
 
+static void report_mdprop(reporter_t *r, mrconee_data_t *mrconee_data, mdprop_data_t *data)
+{
+    if (r->opt->format == FORMAT_JSON) {
+        json_key(&r->json, "mdprop");
+        if (data == NULL) {
+            json_error(&r->json, "MDPROP file not found");
+        }
+        else {
+            json_mdprop_data(&r->json, mrconee_data, data);
+        }
+    }
+    else {
+        if (data == NULL) {
+            printf(" MDPROP file not found\n");
+        }
+        else {
+            print_mdprop_data(stdout, mrconee_data, data);
+        }
+    }
+}
+
 
+/*
+ * error_code: errno left by read_mdcint() if it has returned NULL
+ */
+static void report_mdcint(reporter_t *r, mrconee_data_t *mrconee_data, mdcint_data_t *data, int error_code)
+{
+    if (r->opt->format == FORMAT_JSON) {
+        json_key(&r->json, "mdcint");
+        if (mrconee_data == NULL) {
+            json_error(&r->json, "MDCINT file cannot be parsed without auxiliary data from the MRCONEE file");
+        }
+        else if (data == NULL && error_code == ENOENT) {
+            json_error(&r->json, "MDCINT file not found");
+        }
+        else if (data == NULL) {
+            char message[256];
+            snprintf(message, sizeof(message), "error while reading MDCINT file: %s", strerror(error_code));
+            json_error(&r->json, message);
+        }
+        else {
+            json_mdcint_data(&r->json, data);
+        }
+    }
+    else {
+        if (mrconee_data == NULL) {
+            printf(" MDCINT file cannot be parsed without auxuliary data from the MRCONEE file\n");
+        }
+        else if (data == NULL && error_code == ENOENT) {
+            printf(" MDCINT file not found\n");
+        }
+        else if (data == NULL) {
+            printf(" two-electron integrals file\n");
+            fflush(stdout);
+            errno = error_code;
+            perror(" error while reading MDCINT file");
+        }
+        else {
+            print_mdcint_data(stdout, data);
+        }
+    }
+}
+
+
+#ifdef DIRAC_INSPECTOR_STATS
+/**
+ * I/O and decoding counters are written at exit as a JSON object
+ * to the file given by the DIRAC_INSPECTOR_STATS_FILE environment variable
+ * (or to stderr if it is not set).
+ */
+static void dump_stats()
+{
+    char *path = getenv("DIRAC_INSPECTOR_STATS_FILE");
+    FILE *out = path ? fopen(path, "w") : stderr;
+    if (out == NULL) {
+        return;
+    }
+
+    fprintf(out, "{\"libunf\": ");
+    unf_stats_dump(out);
+    fprintf(out, ",\n\"mdcint\": ");
+    mdcint_stats_dump(out);
+    fprintf(out, "}\n");
+
+    if (out != stderr) {
+        fclose(out);
+    }
+}
+#endif
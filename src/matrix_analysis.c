@@ -0,0 +1,259 @@
+/*
+ * Inspector of DIRAC files containing transformed molecular integrals.
+ *
+ * 2024 Alexander Oleynichenko
+ */
+
+#include "matrix_analysis.h"
+
+#include <complex.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+
+/**
+ * Checks if the real and imaginary parts of a square matrix are zero and
+ * whether they are symmetric or antisymmetric.
+ * Rows are distributed over OpenMP threads, inner loops are vectorized.
+ */
+void analyze_complex_matrix(int dim, double _Complex *matrix,
+                            int *re_zero, int *im_zero, int *re_symmetric, int *im_symmetric)
+{
+    const double zero_thresh = 1e-14;
+
+    double max_re = 0.0;
+    double max_im = 0.0;
+    double max_re_asymm = 0.0;
+    double max_im_asymm = 0.0;
+
+    #pragma omp parallel for schedule(dynamic, 16) reduction(max:max_re, max_im, max_re_asymm, max_im_asymm)
+    for (int i = 0; i < dim; i++) {
+        #pragma omp simd reduction(max:max_re, max_im, max_re_asymm, max_im_asymm)
+        for (int j = i; j < dim; j++) {
+            double _Complex a_ij = matrix[(size_t) i * dim + j];
+            double _Complex a_ji = matrix[(size_t) j * dim + i];
+
+            double re = fabs(creal(a_ij)) > fabs(creal(a_ji)) ? fabs(creal(a_ij)) : fabs(creal(a_ji));
+            double im = fabs(cimag(a_ij)) > fabs(cimag(a_ji)) ? fabs(cimag(a_ij)) : fabs(cimag(a_ji));
+            double re_asymm = fabs(creal(a_ij) - creal(a_ji));
+            double im_asymm = fabs(cimag(a_ij) - cimag(a_ji));
+
+            max_re = re > max_re ? re : max_re;
+            max_im = im > max_im ? im : max_im;
+            max_re_asymm = re_asymm > max_re_asymm ? re_asymm : max_re_asymm;
+            max_im_asymm = im_asymm > max_im_asymm ? im_asymm : max_im_asymm;
+        }
+    }
+
+    *re_zero = max_re <= zero_thresh;
+    *im_zero = max_im <= zero_thresh;
+    *re_symmetric = max_re_asymm <= zero_thresh;
+    *im_symmetric = max_im_asymm <= zero_thresh;
+}
+
+
+/**
+ * Returns max |a_ij - conj(a_ji)| over all pairs of matrix elements.
+ */
+double matrix_hermiticity_deviation(int dim, double _Complex *matrix)
+{
+    double max_dev = 0.0;
+
+    #pragma omp parallel for schedule(dynamic, 16) reduction(max:max_dev)
+    for (int i = 0; i < dim; i++) {
+        #pragma omp simd reduction(max:max_dev)
+        for (int j = i; j < dim; j++) {
+            double _Complex a_ij = matrix[(size_t) i * dim + j];
+            double _Complex a_ji = matrix[(size_t) j * dim + i];
+
+            double dev = cabs(a_ij - conj(a_ji));
+            max_dev = dev > max_dev ? dev : max_dev;
+        }
+    }
+
+    return max_dev;
+}
+
+
+/**
+ * Statistics of off-diagonal elements: max |a_ij| (i != j), Frobenius norm of the
+ * off-diagonal part and diagonal dominance of rows. A row is diagonally dominant
+ * if sum_{j != i} |a_ij| < |a_ii|; max_row_ratio is the max of this sum divided by |a_ii|.
+ */
+void matrix_off_diagonal_stats(int dim, double _Complex *matrix, double *max_off_diag, double *off_diag_norm,
+                               double *max_row_ratio, int *num_non_dominant_rows)
+{
+    double max_abs = 0.0;
+    double sum_sq = 0.0;
+    double max_ratio = 0.0;
+    int num_non_dominant = 0;
+
+    #pragma omp parallel for schedule(static) reduction(max:max_abs, max_ratio) reduction(+:sum_sq, num_non_dominant)
+    for (int i = 0; i < dim; i++) {
+        double _Complex *row = matrix + (size_t) i * dim;
+        double row_sum = 0.0;
+        double row_sum_sq = 0.0;
+        double row_max = 0.0;
+
+        #pragma omp simd reduction(+:row_sum, row_sum_sq) reduction(max:row_max)
+        for (int j = 0; j < dim; j++) {
+            double abs_val = (j == i) ? 0.0 : cabs(row[j]);
+            row_sum += abs_val;
+            row_sum_sq += abs_val * abs_val;
+            row_max = abs_val > row_max ? abs_val : row_max;
+        }
+
+        double diag = cabs(row[i]);
+        double ratio = diag > 0.0 ? row_sum / diag : (row_sum > 0.0 ? INFINITY : 0.0);
+
+        max_abs = row_max > max_abs ? row_max : max_abs;
+        max_ratio = ratio > max_ratio ? ratio : max_ratio;
+        sum_sq += row_sum_sq;
+        if (row_sum >= diag && row_sum > 0.0) {
+            num_non_dominant++;
+        }
+    }
+
+    *max_off_diag = max_abs;
+    *off_diag_norm = sqrt(sum_sq);
+    *max_row_ratio = max_ratio;
+    *num_non_dominant_rows = num_non_dominant;
+}
+
+
+/**
+ * Max |a_ij| over the blocks of a matrix; the block of an element is determined
+ * by irreps of its row and column, block_max[irep * num_irreps + jrep].
+ * Only the first n_rows rows and columns are analyzed, dim is the leading dimension.
+ * Diagonal elements are excluded if skip_diagonal != 0.
+ */
+void matrix_block_max_abs(int dim, double _Complex *matrix, int n_rows, int *irreps, int num_irreps,
+                          int skip_diagonal, double *block_max)
+{
+    int num_blocks = num_irreps * num_irreps;
+
+    for (int ib = 0; ib < num_blocks; ib++) {
+        block_max[ib] = 0.0;
+    }
+
+    int num_threads = 1;
+#ifdef _OPENMP
+    num_threads = omp_get_max_threads();
+#endif
+
+    /*
+     * per-thread scratch is allocated before the parallel region: block maxima
+     * (padded to a cache line against false sharing) and magnitudes of the current row
+     */
+    size_t max_stride = ((size_t) num_blocks + 7) & ~(size_t) 7;
+    double *local_max = (double *) calloc((size_t) num_threads * max_stride, sizeof(double));
+    double *row_abs = (double *) malloc((size_t) num_threads * (n_rows > 0 ? n_rows : 1) * sizeof(double));
+
+    if (local_max == NULL || row_abs == NULL) {
+        // no memory for the scratch: elements are processed one by one
+        for (int i = 0; i < n_rows; i++) {
+            double *row_block_max = block_max + irreps[i] * num_irreps;
+            for (int j = 0; j < n_rows; j++) {
+                double abs_val = (skip_diagonal && i == j) ? 0.0 : cabs(matrix[(size_t) i * dim + j]);
+                if (abs_val > row_block_max[irreps[j]]) {
+                    row_block_max[irreps[j]] = abs_val;
+                }
+            }
+        }
+        free(row_abs);
+        free(local_max);
+        return;
+    }
+
+    #pragma omp parallel num_threads(num_threads)
+    {
+        int ith = 0;
+#ifdef _OPENMP
+        ith = omp_get_thread_num();
+#endif
+        double *thread_max = local_max + (size_t) ith * max_stride;
+        double *thread_row = row_abs + (size_t) ith * n_rows;
+
+        #pragma omp for schedule(static)
+        for (int i = 0; i < n_rows; i++) {
+            double _Complex *row = matrix + (size_t) i * dim;
+
+            #pragma omp simd
+            for (int j = 0; j < n_rows; j++) {
+                thread_row[j] = cabs(row[j]);
+            }
+            if (skip_diagonal) {
+                thread_row[i] = 0.0;
+            }
+
+            double *row_block_max = thread_max + irreps[i] * num_irreps;
+            for (int j = 0; j < n_rows; j++) {
+                int jrep = irreps[j];
+                if (thread_row[j] > row_block_max[jrep]) {
+                    row_block_max[jrep] = thread_row[j];
+                }
+            }
+        }
+    }
+
+    for (int ith = 0; ith < num_threads; ith++) {
+        for (int ib = 0; ib < num_blocks; ib++) {
+            if (local_max[ith * max_stride + ib] > block_max[ib]) {
+                block_max[ib] = local_max[ith * max_stride + ib];
+            }
+        }
+    }
+
+    free(row_abs);
+    free(local_max);
+}
+
+
+/**
+ * Histogram of the magnitudes of matrix elements by decades,
+ * see MATRIX_SPARSITY_NUM_BINS for the layout of bins.
+ */
+void matrix_sparsity_profile(int dim, double _Complex *matrix, int64_t *bin_counts)
+{
+    int64_t counts[MATRIX_SPARSITY_NUM_BINS];
+    double thresholds[MATRIX_SPARSITY_NUM_BINS - 1];
+    size_t n_elements = (size_t) dim * dim;
+
+    memset(counts, 0, sizeof(counts));
+    for (int k = 0; k < MATRIX_SPARSITY_NUM_BINS - 1; k++) {
+        thresholds[k] = matrix_sparsity_bin_lower_bound(k + 1);
+    }
+
+    #pragma omp parallel for schedule(static) reduction(+:counts[:MATRIX_SPARSITY_NUM_BINS])
+    for (size_t i = 0; i < n_elements; i++) {
+        double abs_val = cabs(matrix[i]);
+        int bin = 0;
+        for (int k = 0; k < MATRIX_SPARSITY_NUM_BINS - 1; k++) {
+            bin += abs_val >= thresholds[k];
+        }
+        counts[bin]++;
+    }
+
+    for (int k = 0; k < MATRIX_SPARSITY_NUM_BINS; k++) {
+        bin_counts[k] = counts[k];
+    }
+}
+
+
+/**
+ * Lower bound of the bin of the sparsity profile:
+ * 0 for the first bin, 10^(bin-15) for others.
+ */
+double matrix_sparsity_bin_lower_bound(int bin)
+{
+    if (bin <= 0) {
+        return 0.0;
+    }
+
+    return pow(10.0, bin - 15);
+}
@@ -0,0 +1,42 @@
+/*
+ * Inspector of DIRAC files containing transformed molecular integrals.
+ *
+ * 2024 Alexander Oleynichenko
+ */
+
+#ifndef DIRAC_INSPECTOR_MATRIX_ANALYSIS_H
+#define DIRAC_INSPECTOR_MATRIX_ANALYSIS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/*
+ * decade thresholds used to build sparsity profiles of matrices:
+ * bin 0 counts |a_ij| < 1e-14, bin k counts 10^(k-15) <= |a_ij| < 10^(k-14),
+ * the last bin counts all elements >= 1.
+ */
+#define MATRIX_SPARSITY_NUM_BINS 16
+
+void analyze_complex_matrix(int dim, double _Complex *matrix,
+                            int *re_zero, int *im_zero, int *re_symmetric, int *im_symmetric);
+
+double matrix_hermiticity_deviation(int dim, double _Complex *matrix);
+
+void matrix_off_diagonal_stats(int dim, double _Complex *matrix, double *max_off_diag, double *off_diag_norm,
+                               double *max_row_ratio, int *num_non_dominant_rows);
+
+void matrix_block_max_abs(int dim, double _Complex *matrix, int n_rows, int *irreps, int num_irreps,
+                          int skip_diagonal, double *block_max);
+
+void matrix_sparsity_profile(int dim, double _Complex *matrix, int64_t *bin_counts);
+
+double matrix_sparsity_bin_lower_bound(int bin);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DIRAC_INSPECTOR_MATRIX_ANALYSIS_H
@@ -6,37 +6,360 @@
 
 #include "mdcint.h"
 
+#include <errno.h>
 #include <stdbool.h>
 #include <stdlib.h>
-#include <sys/time.h>
+#include <string.h>
 
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define MDCINT_HAVE_AVX2_DISPATCH
+#endif
+
+#include "arena.h"
 #include "libunf.h"
 #include "mrconee.h"
+#include "util.h"
+
+// size of the arena for batched reading of records, in bytes
+#define MDCINT_BATCH_SIZE (4 * 1024 * 1024)
+// smaller buffers are enlarged to this size: they would not hold even the header of a record
+#define MDCINT_MIN_BATCH_SIZE 64
+// max number of records read at once
+#define MDCINT_BATCH_MAX_RECORDS 4096
+// records not smaller than this size (in bytes) are read one by one by scatter reads
+#define MDCINT_SCATTER_MIN_SIZE (16 * 1024)
+
+static size_t batch_size = MDCINT_BATCH_SIZE;
+
+/*
+ * decoder of the record specialized for the layout of the file, see select_decoder()
+ */
+typedef int (*mdcint_decoder_t)(mdcint_iter_t *iter, char *header_raw, char *ind, double *values,
+                                int64_t n_integrals, mdcint_record_t *out);
+
+struct mdcint_iter {
+    unf_file_t *file;
+    arena_t *arena;
+    mdcint_header_t header;
+    int int_size;
+    int is_real;
+    int swap_bytes;
+    size_t integral_size;      // two indices and the value
+    mdcint_decoder_t decode;
+    // large records read one by one, directly to the buffers of the decoded record
+    int scatter;               // the last record was read by a scatter read, the file position is stale
+    int64_t offset;            // position of the next record
+    int32_t next_length;       // payload length of the next record, -1 if unknown
+    // small records read by batches
+    char *batch_buf;
+    size_t batch_size;
+    size_t n_carry;            // beginning of the next record kept at the end of batch_buf
+    size_t *rec_offsets;
+    int32_t *rec_lengths;
+    int n_batch;
+    int i_batch;
+    // decoded record
+    int64_t buf_capacity;
+    char *ind_buf;             // pairs of indices as read by scatter reads
+    int32_t *indk;
+    int32_t *indl;
+    double *values;
+    int finished;
+    char error[256];
+};
+
+static int read_mdcint_header(mdcint_iter_t *iter, int dirac_int_size);
+
+static int next_record(mdcint_iter_t *iter, mdcint_record_t *out);
+
+static int32_t next_record_length(mdcint_iter_t *iter);
+
+static int read_next_batch(mdcint_iter_t *iter, int32_t first_length);
+
+static int read_next_record(mdcint_iter_t *iter, mdcint_record_t *out);
+
+static int next_batch_record(mdcint_iter_t *iter, mdcint_record_t *out);
+
+static int alloc_record_buffers(mdcint_iter_t *iter, int64_t n_integrals);
+
+static int alloc_record_buffers_for(mdcint_iter_t *iter, int64_t n_integrals);
+
+static mdcint_decoder_t select_decoder(int int_size, int is_real);
+
+static int64_t max_integrals_in_record(int32_t rec_len, int int_size, size_t integral_size);
+
+#ifdef DIRAC_INSPECTOR_STATS
+/*
+ * decoding counters, collected only if compiled with DIRAC_INSPECTOR_STATS
+ */
+typedef struct {
+    int nkr;
+    int64_t n_batches;
+    int64_t n_records;
+    double time_read;           // time spent in unf_read_batch() or unf_read_segments_at()
+    double time_decode;         // time spent in decoding of records
+    double max_record_time;     // max decoding time of a single record
+    int64_t *records_per_ikr;   // per-block counters, blocks are labelled by |ikr|
+    int64_t *integrals_per_ikr;
+    double *time_per_ikr;
+} mdcint_stats_t;
 
-double abs_time();
+static mdcint_stats_t mdcint_stats;
 
+static void stats_init(int nkr);
 
-void read_mdcint(char *path, mrconee_data_t *mrconee_data)
+static void stats_add_record(int32_t ikr, int32_t nonzr, double time);
+#endif
+
+
+/**
+ * Opens the MDCINT file for reading records of integrals one by one
+ * (see mdcint_iter_next()). The header of the file is read at once.
+ * Sizes of integers, the byte order and the arithmetic are taken from MRCONEE.
+ *
+ * Returns NULL if the file cannot be opened or its header cannot be read
+ * (errno is set then).
+ */
+mdcint_iter_t *mdcint_iter_open(char *path, mrconee_data_t *mrconee_data)
 {
     if (mrconee_data == NULL) {
-        printf(" MDCINT file cannot be parsed without auxuliary data from the MRCONEE file\n");
-        return;
+        errno = EINVAL;
+        return NULL;
     }
 
-    int use_int4 = mrconee_data->dirac_int_size == 4;
-    int use_int8 = mrconee_data->dirac_int_size == 8;
+    unf_file_t *file = unf_open(path, "r", UNF_ACCESS_SEQUENTIAL);
+    if (file == NULL) {
+        return NULL;
+    }
+    unf_set_byte_order(file, mrconee_data->swap_bytes ? UNF_BYTE_ORDER_SWAPPED : UNF_BYTE_ORDER_NATIVE);
 
-    unf_file_t *mdcint = unf_open(path, "r", UNF_ACCESS_SEQUENTIAL);
-    if (mdcint == NULL) {
-        printf(" MDCINT file not found\n");
-        return;
+    mdcint_iter_t *iter = (mdcint_iter_t *) calloc(1, sizeof(mdcint_iter_t));
+    if (iter == NULL) {
+        unf_close(file);
+        return NULL;
     }
 
-    printf(" two-electron integrals file\n");
+    iter->file = file;
+    iter->arena = arena_new();
+    iter->int_size = mrconee_data->dirac_int_size;
+    iter->is_real = mrconee_data->group_arith == 1 || mrconee_data->is_spinfree == 1;
+    iter->swap_bytes = mrconee_data->swap_bytes;
+    iter->integral_size = 2 * iter->int_size + (iter->is_real ? sizeof(double) : sizeof(double _Complex));
+    iter->decode = select_decoder(iter->int_size, iter->is_real);
+
+    if (read_mdcint_header(iter, mrconee_data->dirac_int_size) == EXIT_FAILURE) {
+        int saved_errno = errno;
+        mdcint_iter_close(iter);
+        errno = saved_errno;
+        return NULL;
+    }
 
     /*
-     * read date and time, total number of Kramers pairs
+     * buffers for decoded records are sized by the largest record seen so far,
+     * starting from the size of the first record
      */
+    int32_t first_length = unf_next_rec_size(file);
+    int64_t capacity = max_integrals_in_record(first_length, iter->int_size, iter->integral_size);
+    if (alloc_record_buffers(iter, capacity < 1 ? 1 : capacity) == EXIT_FAILURE) {
+        mdcint_iter_close(iter);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    iter->next_length = -1;
+    iter->batch_size = batch_size;
+    iter->batch_buf = (char *) arena_alloc(iter->arena, iter->batch_size);
+    iter->rec_offsets = (size_t *) arena_alloc(iter->arena, MDCINT_BATCH_MAX_RECORDS * sizeof(size_t));
+    iter->rec_lengths = (int32_t *) arena_alloc(iter->arena, MDCINT_BATCH_MAX_RECORDS * sizeof(int32_t));
+    if (iter->batch_buf == NULL || iter->rec_offsets == NULL || iter->rec_lengths == NULL) {
+        mdcint_iter_close(iter);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+#ifdef DIRAC_INSPECTOR_STATS
+    stats_init(iter->header.nkr);
+#endif
+
+    return iter;
+}
+
+
+/**
+ * Header of the MDCINT file opened by mdcint_iter_open().
+ */
+const mdcint_header_t *mdcint_iter_header(mdcint_iter_t *iter)
+{
+    return iter ? &iter->header : NULL;
+}
+
+
+/**
+ * Reads the next record of non-zero integrals:
+ * ikr, jkr, nonzr, (indk(inz), indl(inz), inz = 1, nonzr), (cbuf(inz), inz = 1, nonzr).
+ * Indices are converted to 4-byte integers and to the native byte order.
+ * Arrays of 'rec' are owned by the iterator and are valid until the next call.
+ *
+ * Returns 1 if the record is read, 0 at the end of integrals (the record with
+ * ikr = jkr = 0), -1 on error (see mdcint_iter_error()).
+ */
+int mdcint_iter_next(mdcint_iter_t *iter, mdcint_record_t *rec)
+{
+    if (iter == NULL || rec == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (iter->finished) {
+        return iter->error[0] ? -1 : 0;
+    }
+
+    if (next_record(iter, rec) == EXIT_FAILURE) {
+        iter->finished = 1;
+        return -1;
+    }
+
+    if (rec->ikr == 0 && rec->jkr == 0) {
+        iter->finished = 1;
+        return 0;
+    }
+
+    return 1;
+}
+
+
+/**
+ * Returns the description of the error occurred in mdcint_iter_next(), NULL if none.
+ */
+const char *mdcint_iter_error(mdcint_iter_t *iter)
+{
+    if (iter == NULL || iter->error[0] == '\0') {
+        return NULL;
+    }
+
+    return iter->error;
+}
+
+
+/**
+ * Closes the MDCINT file and releases all buffers of the iterator.
+ */
+void mdcint_iter_close(mdcint_iter_t *iter)
+{
+    if (iter == NULL) {
+        return;
+    }
+
+    unf_close(iter->file);
+    arena_free(iter->arena);
+    free(iter);
+}
+
+
+/**
+ * Reads the whole MDCINT file: header, number of records and of non-zero integrals.
+ * Complex integrals are checked for imaginary parts: the largest one and records
+ * having all of them not above MDCINT_IMAG_THRESHOLD are counted.
+ * Returns NULL if the file cannot be opened or its header cannot be read;
+ * errors in records of integrals are reported by the 'error' field.
+ */
+mdcint_data_t *read_mdcint(char *path, mrconee_data_t *mrconee_data)
+{
+    mdcint_iter_t *iter = mdcint_iter_open(path, mrconee_data);
+    if (iter == NULL) {
+        return NULL;
+    }
+
+    mdcint_data_t *data = (mdcint_data_t *) calloc(1, sizeof(mdcint_data_t));
+    arena_t *arena = arena_new();
+    int32_t *kramers_pairs = (int32_t *) arena_alloc(arena, 2 * (size_t) iter->header.nkr * sizeof(int32_t));
+    if (data == NULL || kramers_pairs == NULL) {
+        free(data);
+        arena_free(arena);
+        mdcint_iter_close(iter);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    data->arena = arena;
+    data->header = iter->header;
+    data->header.kramers_pairs = kramers_pairs;
+    memcpy(kramers_pairs, iter->header.kramers_pairs, 2 * (size_t) iter->header.nkr * sizeof(int32_t));
+
+    double time_start = abs_time();
+
+    data->is_real = iter->is_real;
+
+    mdcint_record_t rec;
+    int status;
+    while ((status = mdcint_iter_next(iter, &rec)) == 1) {
+        data->num_records++;
+        data->num_integrals += rec.nonzr;
+
+        if (!rec.is_real) {
+            double max_imag = mdcint_max_imag(rec.values, rec.nonzr);
+            if (max_imag > data->max_imag) {
+                data->max_imag = max_imag;
+            }
+            if (max_imag <= MDCINT_IMAG_THRESHOLD) {
+                data->num_real_records++;
+                data->num_real_integrals += rec.nonzr;
+            }
+        }
+    }
+
+    data->read_time = abs_time() - time_start;
+
+    if (status < 0) {
+        const char *error = mdcint_iter_error(iter);
+        char *error_copy = (char *) arena_alloc(arena, strlen(error) + 1);
+        strcpy(error_copy, error);
+        data->error = error_copy;
+    }
+
+    mdcint_iter_close(iter);
+
+    return data;
+}
+
+
+void free_mdcint_data(mdcint_data_t *data)
+{
+    if (data == NULL) {
+        return;
+    }
+
+    arena_free(data->arena);
+    free(data);
+}
+
+
+/**
+ * Sets the size of the buffer for batched reading of records by iterators
+ * opened afterwards. Records larger than the buffer are still read
+ * (the buffer grows as needed). Zero restores the default size;
+ * sizes below MDCINT_MIN_BATCH_SIZE are rounded up to it.
+ */
+void mdcint_set_batch_size(size_t size)
+{
+    if (size == 0) {
+        batch_size = MDCINT_BATCH_SIZE;
+    }
+    else {
+        batch_size = size < MDCINT_MIN_BATCH_SIZE ? MDCINT_MIN_BATCH_SIZE : size;
+    }
+}
+
+
+/**
+ * Reads the first record: date and time, total number of Kramers pairs
+ * and indices of Kramers pairs.
+ */
+static int read_mdcint_header(mdcint_iter_t *iter, int dirac_int_size)
+{
+    unf_file_t *mdcint = iter->file;
+    int use_int4 = dirac_int_size == 4;
     char date_time[100];
     int32_t nkr = 0;
     int64_t nkr_8 = 0;
@@ -47,11 +370,12 @@ void read_mdcint(char *path, mrconee_data_t *mrconee_data)
     }
     else {
         nread = unf_read(mdcint, "c18,i8", date_time, &nkr_8);
-        nkr = (int32_t) nkr_8;
+        if (nread == 2 && unf_narrow_int64(&nkr_8, 1, &nkr) == UNF_ERROR) {
+            return EXIT_FAILURE;
+        }
     }
-    if (nread != 2 || unf_error(mdcint)) {
-        perror(" error while reading MDCINT file");
-        return;
+    if (nread != 2 || unf_error(mdcint) || nkr < 0) {
+        return EXIT_FAILURE;
     }
 
     /*
@@ -60,8 +384,8 @@ void read_mdcint(char *path, mrconee_data_t *mrconee_data)
     unf_backspace(mdcint);
 
     int32_t num_spinors = 2 * nkr;
-    int32_t *kr = (int32_t *) calloc(num_spinors, sizeof(int32_t *));
-    int64_t *kr_8 = (int64_t *) calloc(num_spinors, sizeof(int64_t *));
+    int32_t *kr = (int32_t *) arena_alloc(iter->arena, num_spinors * sizeof(int32_t));
+    int64_t *kr_8 = (int64_t *) arena_alloc(iter->arena, num_spinors * sizeof(int64_t));
 
     if (use_int4) {
         nread = unf_read(mdcint, "c18,i4,i4[i4]", date_time, &nkr, kr, &num_spinors);
@@ -70,111 +394,578 @@ void read_mdcint(char *path, mrconee_data_t *mrconee_data)
         nread = unf_read(mdcint, "c18,i8,i8[i4]", date_time, &nkr_8, kr_8, &num_spinors);
     }
     if (nread != 3 || unf_error(mdcint)) {
-        perror(" error while reading MDCINT file");
-        return;
+        return EXIT_FAILURE;
+    }
+
+    if (!use_int4 && unf_narrow_int64(kr_8, num_spinors, kr) == UNF_ERROR) {
+        return EXIT_FAILURE;
+    }
+
+    memcpy(iter->header.date_time, date_time, 18);
+    iter->header.date_time[18] = '\0';
+    iter->header.nkr = nkr;
+    iter->header.kramers_pairs = kr;
+
+    return EXIT_SUCCESS;
+}
+
+
+/**
+ * Reads the next record. The way of reading is chosen for each record by its length:
+ * header, indices and values of a large record go directly to separate buffers by one
+ * preadv() call, no copying is needed; small records are read by batches into the arena
+ * (fewer system calls).
+ */
+static int next_record(mdcint_iter_t *iter, mdcint_record_t *out)
+{
+    if (iter->i_batch < iter->n_batch) {
+        return next_batch_record(iter, out);
     }
 
-    if (use_int8) {
-        for (int i = 0; i < num_spinors; i++) {
-            kr[i] = (int32_t) kr_8[i];
+    int32_t length = next_record_length(iter);
+
+    if (length >= MDCINT_SCATTER_MIN_SIZE) {
+        if (!iter->scatter) {
+            // the record starts with the bytes carried over from the last batch
+            iter->offset = unf_tell(iter->file) - (int64_t) iter->n_carry;
+            iter->next_length = length;
+            iter->n_carry = 0;
+            iter->scatter = 1;
         }
+        return read_next_record(iter, out);
     }
-    free(kr_8);
 
-    date_time[18] = '\0';
-    printf(" date and time              %s\n", date_time);
-    printf(" number of Kramers pairs    %d\n", nkr);
-    for (int i = 0; i < nkr; i++) {
-        printf("%4d%4d\n", kr[2*i], kr[2*i + 1]);
+    if (iter->scatter) {
+        // sequential reading is continued after the last record read by a scatter read
+        if (unf_seek_offset(iter->file, iter->offset) == UNF_ERROR) {
+            snprintf(iter->error, sizeof(iter->error), "error while reading MDCINT file: %s", strerror(errno));
+            return EXIT_FAILURE;
+        }
+        iter->scatter = 0;
     }
 
-    /*
-     * read chunks of non-zero two-electron integrals
-     *
-     * read (luint, end = 1301, err = 1302) ikr, jkr, nonzr, &
-     * (indk(inz), indl(inz), inz = 1, nonzr), &
-     * (cbuf(1, inz), inz = 1, nonzr)
-     */
-    int64_t count_non_zero = 0;
-
-    char *ind_buf = (char *) calloc(num_spinors * num_spinors, 2 * sizeof(int32_t));
-    char *ind_buf_8 = (char *) calloc(num_spinors * num_spinors, 2 * sizeof(int64_t));
-    double *val_buf_real = (double *) calloc(num_spinors * num_spinors, sizeof(double));
-    double *val_buf_complex = (double *) calloc(num_spinors * num_spinors, sizeof(double));
-
-    int32_t ikr = 0;
-    int32_t jkr = 0;
-    int32_t nonzr = 0;
-    int64_t ikr8 = 0;
-    int64_t jkr8 = 0;
-    int64_t nonzr8 = 0;
-    double time_start = abs_time();
+    if (read_next_batch(iter, length) == EXIT_FAILURE) {
+        return EXIT_FAILURE;
+    }
 
-    while (true) {
-        if (mrconee_data->group_arith == 1 || mrconee_data->is_spinfree == 1) {
-            if (use_int4) {
-                nread = unf_read(mdcint, "3i4,c8[i4],r8[i4]", &ikr, &jkr, &nonzr, ind_buf, &nonzr, val_buf_real,
-                                 &nonzr);
-            }
-            else {
-                nread = unf_read(mdcint, "3i8,c16[i8],r8[i8]", &ikr8, &jkr8, &nonzr8, ind_buf_8, &nonzr8, val_buf_real,
-                                 &nonzr8);
-                ikr = (int32_t) ikr8;
-                jkr = (int32_t) jkr8;
-                nonzr = (int32_t) nonzr8;
-            }
+    return next_batch_record(iter, out);
+}
+
+
+/**
+ * Payload length of the record following the current batch or the last scattered record,
+ * -1 if it is not known without reading the file.
+ */
+static int32_t next_record_length(mdcint_iter_t *iter)
+{
+    if (iter->scatter) {
+        return iter->next_length;
+    }
+
+    if (iter->n_carry == 0) {
+        return unf_next_rec_size(iter->file);
+    }
+
+    // leading marker of the record carried over from the last batch
+    if (iter->n_carry >= sizeof(int32_t)) {
+        int32_t length;
+        memcpy(&length, iter->batch_buf + iter->batch_size - iter->n_carry, sizeof(int32_t));
+        if (iter->swap_bytes) {
+            unf_byte_swap(&length, 1, sizeof(int32_t));
         }
-        else {
-            if (use_int4) {
-                nread = unf_read(mdcint, "3i4,c8[i4],z8[i4]", &ikr, &jkr, &nonzr, ind_buf, &nonzr, val_buf_complex,
-                                 &nonzr);
-            }
-            else {
-                nread = unf_read(mdcint, "3i8,c16[i8],z8[i8]", &ikr8, &jkr8, &nonzr8, ind_buf_8, &nonzr8,
-                                 val_buf_complex, &nonzr8);
-                ikr = (int32_t) ikr8;
-                jkr = (int32_t) jkr8;
-                nonzr = (int32_t) nonzr8;
+        return length;
+    }
+
+    return -1;
+}
+
+
+/**
+ * Takes the next record from the current batch and decodes it.
+ * Values are decoded in place in the batch when they are aligned (no copying);
+ * otherwise they are copied to the values array first.
+ */
+static int next_batch_record(mdcint_iter_t *iter, mdcint_record_t *out)
+{
+    int irec = iter->i_batch++;
+    char *rec_data = iter->batch_buf + iter->rec_offsets[irec];
+    int32_t rec_len = iter->rec_lengths[irec];
+    int int_size = iter->int_size;
+
+    int64_t n_integrals = max_integrals_in_record(rec_len, int_size, iter->integral_size);
+    if (rec_len < 3 * int_size ||
+        (size_t) rec_len != 3 * int_size + (size_t) n_integrals * iter->integral_size) {
+        snprintf(iter->error, sizeof(iter->error), "error while reading MDCINT file: wrong record length");
+        return EXIT_FAILURE;
+    }
+    if (alloc_record_buffers_for(iter, n_integrals) == EXIT_FAILURE) {
+        return EXIT_FAILURE;
+    }
+
+#ifdef DIRAC_INSPECTOR_STATS
+    double time_record = abs_time();
+#endif
+    char *ind = rec_data + 3 * int_size;
+    char *values_raw = ind + n_integrals * 2 * int_size;
+    double *values = (double *) values_raw;
+    if ((uintptr_t) values_raw % sizeof(double) != 0) {
+        values = iter->values;
+        memcpy(values, values_raw, rec_len - 3 * int_size - n_integrals * 2 * int_size);
+    }
+    int err = iter->decode(iter, rec_data, ind, values, n_integrals, out);
+#ifdef DIRAC_INSPECTOR_STATS
+    stats_add_record(out->ikr, out->nonzr, abs_time() - time_record);
+#endif
+
+    return err;
+}
+
+
+/**
+ * Reads the next record by one scatter read: three integers go to the local buffer,
+ * pairs of indices to ind_buf and values directly to the values array; the length
+ * of the following record is fetched by the same call. Then the record is decoded.
+ */
+static int read_next_record(mdcint_iter_t *iter, mdcint_record_t *out)
+{
+    int int_size = iter->int_size;
+    int64_t header[3];
+    int32_t rec_len = iter->next_length;
+    unf_status_t status = UNF_STATUS_OK;
+
+    // length of the record is not known: the previous one was the last in the file
+    if (rec_len < 0) {
+        status = unf_read_record_at(iter->file, iter->offset, NULL, 0, &rec_len, NULL);
+        if (status == UNF_STATUS_BUFFER_TOO_SMALL) {
+            status = UNF_STATUS_OK;
+        }
+    }
+
+    int64_t n_integrals = 0;
+    if (status == UNF_STATUS_OK) {
+        n_integrals = max_integrals_in_record(rec_len, int_size, iter->integral_size);
+        if (rec_len < 3 * int_size ||
+            (size_t) rec_len != 3 * int_size + (size_t) n_integrals * iter->integral_size) {
+            snprintf(iter->error, sizeof(iter->error), "error while reading MDCINT file: wrong record length");
+            return EXIT_FAILURE;
+        }
+        if (alloc_record_buffers_for(iter, n_integrals) == EXIT_FAILURE) {
+            return EXIT_FAILURE;
+        }
+
+        size_t ind_bytes = (size_t) n_integrals * 2 * int_size;
+        unf_segment_t segments[3] = {
+            {header, 3 * (size_t) int_size},
+            {iter->ind_buf, ind_bytes},
+            {iter->values, (size_t) rec_len - 3 * int_size - ind_bytes}
+        };
+#ifdef DIRAC_INSPECTOR_STATS
+        double time_read = abs_time();
+#endif
+        status = unf_read_segments_at(iter->file, iter->offset, rec_len, segments, n_integrals > 0 ? 3 : 1,
+                                      &iter->offset, &iter->next_length);
+#ifdef DIRAC_INSPECTOR_STATS
+        mdcint_stats.time_read += abs_time() - time_read;
+        mdcint_stats.n_batches++;
+#endif
+    }
+
+    if (status != UNF_STATUS_OK) {
+        snprintf(iter->error, sizeof(iter->error), "error while reading MDCINT file: %s",
+                 status == UNF_STATUS_EOF ? "unexpected end of file" : unf_status_string(status));
+        return EXIT_FAILURE;
+    }
+
+#ifdef DIRAC_INSPECTOR_STATS
+    double time_record = abs_time();
+#endif
+    int err = iter->decode(iter, (char *) header, iter->ind_buf, iter->values, n_integrals, out);
+#ifdef DIRAC_INSPECTOR_STATS
+    stats_add_record(out->ikr, out->nonzr, abs_time() - time_record);
+#endif
+
+    return err;
+}
+
+
+/**
+ * Reads the next batch of records into the arena.
+ * The batch is placed so that values of its first record (of the length 'first_length',
+ * if known) are aligned; then values of the following records of the same parity of
+ * the length are aligned too and are decoded without copying.
+ */
+static int read_next_batch(mdcint_iter_t *iter, int32_t first_length)
+{
+    size_t val_size = iter->is_real ? sizeof(double) : sizeof(double _Complex);
+
+    while (1) {
+        size_t shift = 0;
+        if (first_length > 0) {
+            int64_t n_integrals = max_integrals_in_record(first_length, iter->int_size, iter->integral_size);
+            uintptr_t values_addr = (uintptr_t) iter->batch_buf + sizeof(int32_t) + (size_t) first_length -
+                                    (size_t) n_integrals * val_size;
+            shift = (sizeof(double) - values_addr % sizeof(double)) % sizeof(double);
+        }
+        if (shift + iter->n_carry >= iter->batch_size) {
+            // no room for the shift in front of the carried bytes: values are copied when decoded
+            shift = 0;
+        }
+
+        errno = 0;
+#ifdef DIRAC_INSPECTOR_STATS
+        double time_batch = abs_time();
+#endif
+        // the end of the batch is fixed: bytes carried over between batches are kept there
+        int n_records = unf_read_batch(iter->file, iter->batch_buf + shift, iter->batch_size - shift,
+                                       &iter->n_carry, MDCINT_BATCH_MAX_RECORDS, iter->rec_offsets,
+                                       iter->rec_lengths);
+#ifdef DIRAC_INSPECTOR_STATS
+        mdcint_stats.time_read += abs_time() - time_batch;
+        mdcint_stats.n_batches++;
+#endif
+
+        if (n_records == 0 && errno == ENOBUFS && !unf_error(iter->file)) {
+            // the next record does not fit into the arena; its beginning is moved to the new buffer
+            size_t new_size = (size_t) iter->rec_lengths[0] + 2 * sizeof(int32_t) + sizeof(double);
+            char *new_buf = (char *) arena_alloc(iter->arena, new_size);
+            if (new_buf == NULL) {
+                snprintf(iter->error, sizeof(iter->error), "error while reading MDCINT file: %s", strerror(ENOMEM));
+                return EXIT_FAILURE;
             }
+            memcpy(new_buf + new_size - iter->n_carry, iter->batch_buf + iter->batch_size - iter->n_carry,
+                   iter->n_carry);
+            arena_release(iter->arena, iter->batch_buf);
+            iter->batch_buf = new_buf;
+            iter->batch_size = new_size;
+            first_length = iter->rec_lengths[0];
+            continue;
+        }
+        if (n_records == 0 || unf_error(iter->file)) {
+            snprintf(iter->error, sizeof(iter->error), "error while reading MDCINT file: %s",
+                     errno ? strerror(errno) : "unexpected end of file");
+            return EXIT_FAILURE;
         }
 
-        if (nread != 5 || unf_error(mdcint)) {
+        for (int i = 0; i < n_records; i++) {
+            iter->rec_offsets[i] += shift;
+        }
+        iter->n_batch = n_records;
+        iter->i_batch = 0;
+
+        return EXIT_SUCCESS;
+    }
+}
+
+
+/**
+ * (Re)allocates buffers for indices and values of the decoded record.
+ */
+static int alloc_record_buffers(mdcint_iter_t *iter, int64_t n_integrals)
+{
+    size_t val_size = iter->is_real ? sizeof(double) : sizeof(double _Complex);
+
+    arena_release(iter->arena, iter->indk);
+    arena_release(iter->arena, iter->indl);
+    arena_release(iter->arena, iter->values);
+    arena_release(iter->arena, iter->ind_buf);
+
+    iter->indk = (int32_t *) arena_alloc(iter->arena, n_integrals * sizeof(int32_t));
+    iter->indl = (int32_t *) arena_alloc(iter->arena, n_integrals * sizeof(int32_t));
+    iter->values = (double *) arena_alloc(iter->arena, n_integrals * val_size);
+    iter->ind_buf = (char *) arena_alloc(iter->arena, n_integrals * 2 * iter->int_size);
+    iter->buf_capacity = n_integrals;
+
+    if (iter->indk == NULL || iter->indl == NULL || iter->values == NULL || iter->ind_buf == NULL) {
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+
+/**
+ * Grows buffers of the decoded record (at least twice) if the record does not fit.
+ */
+static int alloc_record_buffers_for(mdcint_iter_t *iter, int64_t n_integrals)
+{
+    if (n_integrals <= iter->buf_capacity) {
+        return EXIT_SUCCESS;
+    }
+
+    int64_t capacity = n_integrals > 2 * iter->buf_capacity ? n_integrals : 2 * iter->buf_capacity;
+    if (alloc_record_buffers(iter, capacity) == EXIT_FAILURE) {
+        snprintf(iter->error, sizeof(iter->error), "error while reading MDCINT file: %s", strerror(ENOMEM));
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+
+/**
+ * Decodes the record of the MDCINT file:
+ * ikr, jkr, nonzr, (indk(inz), indl(inz), inz = 1, nonzr), (cbuf(inz), inz = 1, nonzr).
+ * Pairs of 4- or 8-byte indices 'ind' (as stored in the file) are split into the indk and
+ * indl arrays of 4-byte integers; real or complex values are already in the values array
+ * and are only byte-swapped if needed.
+ *
+ * 'int_size' and 'is_real' are compile-time constants in each of the specialized
+ * decoders below, so that the loops are compiled for the fixed layout of the record.
+ * On error, the message is stored in the iterator.
+ */
+static inline int decode_record(mdcint_iter_t *iter, char *header_raw, char *ind, double *values,
+                                int64_t n_integrals, mdcint_record_t *out, const int int_size, const int is_real)
+{
+    const size_t val_size = is_real ? sizeof(double) : 2 * sizeof(double);
+    int32_t header[3];
+    int err = UNF_SUCCESS;
 
-            perror(" error while reading MDCINT file");
-            break;
+    if (int_size == 4) {
+        memcpy(header, header_raw, sizeof(header));
+        if (iter->swap_bytes) {
+            unf_byte_swap(header, 3, sizeof(int32_t));
+        }
+    }
+    else {
+        int64_t header_8[3];
+        memcpy(header_8, header_raw, sizeof(header_8));
+        if (iter->swap_bytes) {
+            unf_byte_swap(header_8, 3, sizeof(int64_t));
         }
+        err = unf_narrow_int64(header_8, 3, header);
+    }
+
+    out->ikr = header[0];
+    out->jkr = header[1];
+    out->nonzr = header[2];
+    out->indk = iter->indk;
+    out->indl = iter->indl;
+    out->values = values;
+    out->is_real = is_real;
+
+    if (err == UNF_ERROR) {
+        snprintf(iter->error, sizeof(iter->error),
+                 "error while reading MDCINT file: integer out of the range of 4-byte integers");
+        return EXIT_FAILURE;
+    }
 
-        if (ikr == 0 && jkr == 0) {
-            break;
+    // end of file: only three integers in the record
+    if (out->ikr == 0 && out->jkr == 0) {
+        out->nonzr = 0;
+        if (n_integrals != 0) {
+            snprintf(iter->error, sizeof(iter->error), "error while reading MDCINT file: wrong record length");
+            return EXIT_FAILURE;
         }
+        return EXIT_SUCCESS;
+    }
 
-        count_non_zero += nonzr;
+    int32_t nonzr = out->nonzr;
+    if (nonzr != n_integrals) {
+        snprintf(iter->error, sizeof(iter->error), "error while reading MDCINT file: wrong record length");
+        return EXIT_FAILURE;
     }
 
-    double time_finish = abs_time();
-    printf(" number of non-zero ints    %lld\n", count_non_zero);
-    printf(" time for reading 2e ints   %.2f sec\n\n", time_finish - time_start);
+    if (iter->swap_bytes) {
+        unf_byte_swap(ind, 2 * (size_t) nonzr, int_size);
+        unf_byte_swap(values, (size_t) nonzr * val_size / sizeof(double), sizeof(double));
+    }
 
-    /*
-     * cleanup
-     */
+    if (int_size == 4) {
+        unf_deinterleave_int32(ind, (size_t) nonzr, iter->indk, iter->indl);
+    }
+    else if (unf_deinterleave_narrow_int64(ind, (size_t) nonzr, iter->indk, iter->indl) == UNF_ERROR) {
+        snprintf(iter->error, sizeof(iter->error),
+                 "error while reading MDCINT file: integer out of the range of 4-byte integers");
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+
+static int decode_int4_real(mdcint_iter_t *iter, char *header_raw, char *ind, double *values,
+                            int64_t n_integrals, mdcint_record_t *out)
+{
+    return decode_record(iter, header_raw, ind, values, n_integrals, out, 4, 1);
+}
+
+
+static int decode_int4_complex(mdcint_iter_t *iter, char *header_raw, char *ind, double *values,
+                               int64_t n_integrals, mdcint_record_t *out)
+{
+    return decode_record(iter, header_raw, ind, values, n_integrals, out, 4, 0);
+}
+
+
+static int decode_int8_real(mdcint_iter_t *iter, char *header_raw, char *ind, double *values,
+                            int64_t n_integrals, mdcint_record_t *out)
+{
+    return decode_record(iter, header_raw, ind, values, n_integrals, out, 8, 1);
+}
 
-    unf_close(mdcint);
 
-    free(ind_buf);
-    free(ind_buf_8);
-    free(val_buf_real);
-    free(val_buf_complex);
-    free(kr);
+static int decode_int8_complex(mdcint_iter_t *iter, char *header_raw, char *ind, double *values,
+                               int64_t n_integrals, mdcint_record_t *out)
+{
+    return decode_record(iter, header_raw, ind, values, n_integrals, out, 8, 0);
+}
+
+
+/**
+ * Selects the decoder specialized for the size of integers and the arithmetic of the file.
+ */
+static mdcint_decoder_t select_decoder(int int_size, int is_real)
+{
+    if (int_size == 4) {
+        return is_real ? decode_int4_real : decode_int4_complex;
+    }
+    else {
+        return is_real ? decode_int8_real : decode_int8_complex;
+    }
 }
 
 
 /**
- * Interface to the system-dependent functions for time measurements.
+ * Upper bound for the number of integrals (nonzr) stored in the record of the given length:
+ * the record contains three integers and then pairs of indices and values.
+ */
+static int64_t max_integrals_in_record(int32_t rec_len, int int_size, size_t integral_size)
+{
+    if (rec_len <= 3 * int_size) {
+        return 0;
+    }
+
+    return (rec_len - 3 * int_size) / (int64_t) integral_size;
+}
+
+
+/*
+ * kernels for the largest imaginary part: scalar version and AVX2 version selected at runtime
  */
-double abs_time()
+
+static double max_imag_scalar(const char *values, int64_t n)
 {
-    struct timeval cur_time;
-    gettimeofday(&cur_time, NULL);
-    return (cur_time.tv_sec * 1000000u + cur_time.tv_usec) / 1.e6;
+    // values can be unaligned (records read by batches)
+    double max_imag = 0.0;
+    for (int64_t i = 0; i < n; i++) {
+        double z[2];
+        memcpy(z, values + 2 * sizeof(double) * i, sizeof(z));
+        double im = z[1] < 0.0 ? -z[1] : z[1];
+        if (im > max_imag) {
+            max_imag = im;
+        }
+    }
+    return max_imag;
 }
+
+#ifdef MDCINT_HAVE_AVX2_DISPATCH
+
+__attribute__((target("avx2")))
+static double max_imag_avx2(const char *values, int64_t n)
+{
+    // clears real parts and signs of imaginary parts of (re0 im0 re1 im1)
+    const __m256d mask = _mm256_castsi256_pd(_mm256_setr_epi64x(0, INT64_MAX, 0, INT64_MAX));
+    __m256d acc0 = _mm256_setzero_pd();
+    __m256d acc1 = _mm256_setzero_pd();
+    int64_t i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        const char *p = values + 2 * sizeof(double) * i;
+        // NaN is skipped, as by the scalar kernel
+        acc0 = _mm256_max_pd(_mm256_and_pd(_mm256_loadu_pd((const double *) p), mask), acc0);
+        acc1 = _mm256_max_pd(_mm256_and_pd(_mm256_loadu_pd((const double *) (p + 32)), mask), acc1);
+    }
+
+    double lanes[4];
+    _mm256_storeu_pd(lanes, _mm256_max_pd(acc0, acc1));
+    double max_imag = lanes[1] > lanes[3] ? lanes[1] : lanes[3];
+    double tail = max_imag_scalar(values + 2 * sizeof(double) * i, n - i);
+
+    return tail > max_imag ? tail : max_imag;
+}
+
+#endif // MDCINT_HAVE_AVX2_DISPATCH
+
+
+/**
+ * Largest absolute value of imaginary parts of n complex numbers stored as
+ * (re, im) pairs in the native byte order; values need not be aligned.
+ * NaN values are skipped. The AVX2 version of the kernel is used if supported
+ * by the processor.
+ */
+double mdcint_max_imag(const void *values, int64_t n)
+{
+    if (values == NULL || n <= 0) {
+        return 0.0;
+    }
+
+#ifdef MDCINT_HAVE_AVX2_DISPATCH
+    if (unf_cpu_has_avx2()) {
+        return max_imag_avx2((const char *) values, n);
+    }
+#endif
+
+    return max_imag_scalar((const char *) values, n);
+}
+
+
+/**
+ * Prints decoding counters of the last read_mdcint() call as a JSON object.
+ * The object is empty if compiled without DIRAC_INSPECTOR_STATS.
+ */
+void mdcint_stats_dump(FILE *out)
+{
+    fprintf(out, "{");
+
+#ifdef DIRAC_INSPECTOR_STATS
+    mdcint_stats_t *st = &mdcint_stats;
+
+    fprintf(out, "\"n_batches\": %lld, \"n_records\": %lld, \"time_read\": %.6f, \"time_decode\": %.6f, "
+                 "\"max_record_time\": %.6f,\n  \"blocks\": [",
+            (long long) st->n_batches, (long long) st->n_records, st->time_read, st->time_decode,
+            st->max_record_time);
+    for (int i = 0; i < st->nkr; i++) {
+        fprintf(out, "%s\n    {\"ikr\": %d, \"records\": %lld, \"integrals\": %lld, \"time\": %.6f}",
+                i > 0 ? "," : "", i + 1, (long long) st->records_per_ikr[i],
+                (long long) st->integrals_per_ikr[i], st->time_per_ikr[i]);
+    }
+    fprintf(out, "%s]", st->nkr > 0 ? "\n  " : "");
+#endif
+
+    fprintf(out, "}");
+}
+
+
+#ifdef DIRAC_INSPECTOR_STATS
+
+static void stats_init(int nkr)
+{
+    free(mdcint_stats.records_per_ikr);
+    free(mdcint_stats.integrals_per_ikr);
+    free(mdcint_stats.time_per_ikr);
+    memset(&mdcint_stats, 0, sizeof(mdcint_stats_t));
+
+    mdcint_stats.nkr = nkr;
+    mdcint_stats.records_per_ikr = (int64_t *) calloc(nkr, sizeof(int64_t));
+    mdcint_stats.integrals_per_ikr = (int64_t *) calloc(nkr, sizeof(int64_t));
+    mdcint_stats.time_per_ikr = (double *) calloc(nkr, sizeof(double));
+}
+
+
+static void stats_add_record(int32_t ikr, int32_t nonzr, double time)
+{
+    mdcint_stats.n_records++;
+    mdcint_stats.time_decode += time;
+    if (time > mdcint_stats.max_record_time) {
+        mdcint_stats.max_record_time = time;
+    }
+
+    int i = (ikr > 0 ? ikr : -ikr) - 1;
+    if (i >= 0 && i < mdcint_stats.nkr) {
+        mdcint_stats.records_per_ikr[i]++;
+        mdcint_stats.integrals_per_ikr[i] += nonzr;
+        mdcint_stats.time_per_ikr[i] += time;
+    }
+}
+
+#endif // DIRAC_INSPECTOR_STATS
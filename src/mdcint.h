@@ -7,8 +7,81 @@
 #ifndef DIRAC_INSPECTOR_MDCINT_H
 #define DIRAC_INSPECTOR_MDCINT_H
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+
 #include "mrconee.h"
 
-void read_mdcint(char *path, mrconee_data_t *mrconee_data);
+// complex integrals with imaginary parts not above this value are counted as real ones
+#define MDCINT_IMAG_THRESHOLD 1e-12
+
+/*
+ * header of the MDCINT file: date and time, Kramers pairs of spinors
+ */
+typedef struct {
+    char date_time[19];       // null-terminated
+    int nkr;                  // number of Kramers pairs
+    int32_t *kramers_pairs;   // 2 * nkr spinor indices, pair by pair
+} mdcint_header_t;
+
+/*
+ * record of non-zero two-electron integrals: (ikr, jkr | indk(inz), indl(inz)), inz = 1, nonzr.
+ * Arrays are owned by the iterator and are valid until the next call.
+ */
+typedef struct {
+    int32_t ikr;
+    int32_t jkr;
+    int32_t nonzr;
+    int32_t *indk;
+    int32_t *indl;
+    double *values;           // nonzr real numbers, or nonzr complex numbers as (re, im) pairs
+    int is_real;
+} mdcint_record_t;
+
+/*
+ * summary of the whole file, see read_mdcint()
+ */
+typedef struct {
+    mdcint_header_t header;
+    int64_t num_records;
+    int64_t num_integrals;    // total number of non-zero integrals
+    int is_real;              // real integrals; the fields below are for complex ones only
+    double max_imag;          // largest absolute value of imaginary parts
+    int64_t num_real_records; // records with all imaginary parts not above MDCINT_IMAG_THRESHOLD
+    int64_t num_real_integrals;
+    double read_time;         // seconds
+    const char *error;        // NULL if all records up to the end mark were read
+    arena_t *arena;           // memory for the arrays above
+} mdcint_data_t;
+
+typedef struct mdcint_iter mdcint_iter_t;
+
+mdcint_iter_t *mdcint_iter_open(char *path, mrconee_data_t *mrconee_data);
+
+const mdcint_header_t *mdcint_iter_header(mdcint_iter_t *iter);
+
+int mdcint_iter_next(mdcint_iter_t *iter, mdcint_record_t *rec);
+
+const char *mdcint_iter_error(mdcint_iter_t *iter);
+
+void mdcint_iter_close(mdcint_iter_t *iter);
+
+mdcint_data_t *read_mdcint(char *path, mrconee_data_t *mrconee_data);
+
+void free_mdcint_data(mdcint_data_t *data);
+
+void mdcint_set_batch_size(size_t size);
+
+double mdcint_max_imag(const void *values, int64_t n);
+
+void mdcint_stats_dump(FILE *out);
+
+#ifdef __cplusplus
+}
+#endif
 
 #endif // DIRAC_INSPECTOR_MDCINT_H
@@ -8,163 +8,243 @@
 
 #include <complex.h>
 #include <ctype.h>
+#include <errno.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <math.h>
 
+#include "arena.h"
 #include "libunf.h"
+#include "matrix_analysis.h"
 #include "mrconee.h"
 
-void analyze_complex_matrix(int dim, double _Complex *matrix,
-                            int *re_zero, int *im_zero, int *re_symmetric, int *im_symmetric);
+struct mdprop_iter {
+    unf_file_t *file;
+    arena_t *arena;
+    double _Complex *matrix;
+    int finished;
+    const char *error;
+};
 
-void analyze_nonzero_blocks(int dim, double _Complex *matrix, mrconee_data_t *mrconee_data);
+static void analyze_nonzero_blocks(int dim, double _Complex *matrix, mrconee_data_t *mrconee_data,
+                                   arena_t *arena, mdprop_analysis_t *result);
 
 
-void read_mdprop(char *path, mrconee_data_t *mrconee_data)
+/**
+ * Opens the MDPROP file for reading property operators one by one
+ * (see mdprop_iter_next()).
+ * Returns NULL if the file cannot be opened (errno is set then).
+ */
+mdprop_iter_t *mdprop_iter_open(char *path)
 {
     unf_file_t *file = unf_open(path, "r", UNF_ACCESS_SEQUENTIAL);
     if (file == NULL) {
-        printf(" MDPROP file not found\n");
-        return;
+        return NULL;
     }
 
-    for (int prop_count = 1; unf_next_rec_size(file) != 0; prop_count++) {
-        /*
-         * name of the property
-         */
-        char oper_name[32];
-        int nread = unf_read(file, "c32", oper_name);
-        if (nread != 1 || unf_error(file)) {
-            printf(" error occured while reading MDPROP\n");
-            break;
-        }
-        memmove(oper_name, oper_name + 24, 8);
-        oper_name[8] = '\0';
+    // each property starts with a 32-byte label record
+    unf_detect_byte_order(file, 32);
 
-        if (strcmp(oper_name, "EOFLABEL") == 0) {
-            break;
-        }
+    mdprop_iter_t *iter = (mdprop_iter_t *) calloc(1, sizeof(mdprop_iter_t));
+    if (iter == NULL) {
+        unf_close(file);
+        return NULL;
+    }
 
-        printf("\n[%d]  %s\n\n", prop_count, oper_name);
+    iter->file = file;
+    iter->arena = arena_new();
 
-        /*
-         * get property matrix elements
-         */
-        int record_size = unf_next_rec_size(file);
-        int num_spinors = round(sqrt(record_size / (sizeof(double _Complex))));
-        double _Complex *oper_matrix = (double _Complex *) calloc(num_spinors * num_spinors, sizeof(double _Complex));
-        int n_matrix_elements = num_spinors * num_spinors;
-        nread = unf_read(file, "z8[i4]", oper_matrix, &n_matrix_elements);
-        if (nread != 1 || unf_error(file)) {
-            printf(" error occured while reading MDPROP\n");
-            free(oper_matrix);
-            break;
-        }
+    return iter;
+}
 
-        /*
-         * analysis of a property matrix
-         */
-        int re_zero = 1;
-        int im_zero = 1;
-        int re_symm = 1;
-        int im_symm = 1;
-
-        analyze_complex_matrix(num_spinors, oper_matrix, &re_zero, &im_zero, &re_symm, &im_symm);
-        printf(" real part: ");
-        if (re_zero) {
-            printf("zero\n");
-        }
-        else {
-            printf("non-zero %s\n", re_symm ? "symmetric" : "antisymmetric");
-        }
-        printf(" imag part: ");
-        if (im_zero) {
-            printf("zero\n");
-        }
-        else {
-            printf("non-zero %s\n", im_symm ? "symmetric" : "antisymmetric");
-        }
 
-        if (mrconee_data) {
-            analyze_nonzero_blocks(num_spinors, oper_matrix, mrconee_data);
-        }
+/**
+ * Reads the next property operator: 32-byte label record and the complex matrix.
+ * The matrix is owned by the iterator and is valid until the next call.
+ *
+ * Returns 1 if the operator is read, 0 at the end of the file (EOFLABEL),
+ * -1 on error (see mdprop_iter_error()).
+ */
+int mdprop_iter_next(mdprop_iter_t *iter, mdprop_operator_t *oper)
+{
+    if (iter == NULL || oper == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
 
-        /*
-         * cleanup
-         */
-        free(oper_matrix);
+    if (iter->finished || unf_next_rec_size(iter->file) == 0) {
+        iter->finished = 1;
+        return iter->error ? -1 : 0;
+    }
+
+    arena_release(iter->arena, iter->matrix);
+    iter->matrix = NULL;
+
+    /*
+     * name of the property
+     */
+    char oper_name[32];
+    int nread = unf_read(iter->file, "c32", oper_name);
+    if (nread != 1 || unf_error(iter->file)) {
+        iter->error = "error occured while reading MDPROP";
+        iter->finished = 1;
+        return -1;
+    }
+    memmove(oper_name, oper_name + 24, 8);
+    oper_name[8] = '\0';
+
+    if (strcmp(oper_name, "EOFLABEL") == 0) {
+        iter->finished = 1;
+        return 0;
+    }
+
+    /*
+     * get property matrix elements
+     */
+    int record_size = unf_next_rec_size(iter->file);
+    int num_spinors = round(sqrt(record_size / (sizeof(double _Complex))));
+    iter->matrix = (double _Complex *) arena_alloc(iter->arena, (size_t) num_spinors * num_spinors *
+                                                                sizeof(double _Complex));
+    int n_matrix_elements = num_spinors * num_spinors;
+    nread = unf_read(iter->file, "z8[i4]", iter->matrix, &n_matrix_elements);
+    if (nread != 1 || unf_error(iter->file)) {
+        iter->error = "error occured while reading MDPROP";
+        iter->finished = 1;
+        return -1;
     }
 
-    unf_close(file);
+    strcpy(oper->name, oper_name);
+    oper->dim = num_spinors;
+    oper->matrix = iter->matrix;
 
-    printf("\n");
+    return 1;
 }
 
 
-void analyze_complex_matrix(int dim, double _Complex *matrix,
-                            int *re_zero, int *im_zero, int *re_symmetric, int *im_symmetric)
+/**
+ * Returns the description of the error occurred in mdprop_iter_next(), NULL if none.
+ */
+const char *mdprop_iter_error(mdprop_iter_t *iter)
 {
-    const double zero_thresh = 1e-14;
+    return iter ? iter->error : NULL;
+}
 
-    *re_zero = 1;
-    *im_zero = 1;
-    *re_symmetric = 1;
-    *im_symmetric = 1;
 
-    for (int i = 0; i < dim; i++) {
-        for (int j = i; j < dim; j++) {
-            double _Complex a_ij = matrix[i * dim + j];
-            double _Complex a_ji = matrix[j * dim + i];
+/**
+ * Closes the MDPROP file and releases all buffers of the iterator.
+ */
+void mdprop_iter_close(mdprop_iter_t *iter)
+{
+    if (iter == NULL) {
+        return;
+    }
 
-            if (fabs(creal(a_ij)) > zero_thresh || fabs(creal(a_ji)) > zero_thresh) {
-                *re_zero = 0;
-            }
+    unf_close(iter->file);
+    arena_free(iter->arena);
+    free(iter);
+}
 
-            if (fabs(cimag(a_ij)) > zero_thresh || fabs(cimag(a_ji)) > zero_thresh) {
-                *im_zero = 0;
-            }
 
-            if (fabs(creal(a_ij) - creal(a_ji)) > zero_thresh) {
-                *re_symmetric = 0;
-            }
-            if (fabs(cimag(a_ij) - cimag(a_ji)) > zero_thresh) {
-                *im_symmetric = 0;
+/**
+ * Reads all property operators and analyzes their structure: whether the real
+ * and imaginary parts are zero, symmetric or antisymmetric, and (if MRCONEE data
+ * are available) which blocks of irreps are non-zero.
+ * Returns NULL if the file cannot be opened; errors while reading operators
+ * are reported by the 'error' field.
+ */
+mdprop_data_t *read_mdprop(char *path, mrconee_data_t *mrconee_data)
+{
+    mdprop_iter_t *iter = mdprop_iter_open(path);
+    if (iter == NULL) {
+        return NULL;
+    }
+
+    mdprop_data_t *data = (mdprop_data_t *) calloc(1, sizeof(mdprop_data_t));
+    if (data == NULL) {
+        mdprop_iter_close(iter);
+        return NULL;
+    }
+    data->arena = arena_new();
+
+    int capacity = 0;
+    mdprop_operator_t oper;
+    int status;
+
+    while ((status = mdprop_iter_next(iter, &oper)) == 1) {
+        if (data->num_operators == capacity) {
+            capacity = capacity > 0 ? 2 * capacity : 16;
+            mdprop_analysis_t *operators = (mdprop_analysis_t *) realloc(data->operators,
+                                                                         capacity * sizeof(mdprop_analysis_t));
+            if (operators == NULL) {
+                data->error = "error occured while reading MDPROP";
+                break;
             }
+            data->operators = operators;
+        }
+
+        /*
+         * analysis of a property matrix
+         */
+        mdprop_analysis_t *result = &data->operators[data->num_operators++];
+        strcpy(result->name, oper.name);
+        result->dim = oper.dim;
+
+        analyze_complex_matrix(oper.dim, oper.matrix, &result->re_zero, &result->im_zero,
+                               &result->re_symmetric, &result->im_symmetric);
+
+        result->num_nonzero_blocks = -1;
+        result->nonzero_blocks = NULL;
+        if (mrconee_data) {
+            analyze_nonzero_blocks(oper.dim, oper.matrix, mrconee_data, data->arena, result);
         }
     }
+
+    if (status < 0) {
+        data->error = mdprop_iter_error(iter);
+    }
+
+    mdprop_iter_close(iter);
+
+    return data;
 }
 
 
-void analyze_nonzero_blocks(int dim, double _Complex *matrix, mrconee_data_t *mrconee_data)
+void free_mdprop_data(mdprop_data_t *data)
+{
+    if (data == NULL) {
+        return;
+    }
+
+    free(data->operators);
+    arena_free(data->arena);
+    free(data);
+}
+
+
+static void analyze_nonzero_blocks(int dim, double _Complex *matrix, mrconee_data_t *mrconee_data,
+                                   arena_t *arena, mdprop_analysis_t *result)
 {
     const double zero_thresh = 1e-14;
 
-    printf(" non-zero blocks:\n");
-
-    for (int irep = 0; irep < mrconee_data->num_irreps; irep++) {
-        for (int jrep = irep; jrep < mrconee_data->num_irreps; jrep++) {
-            int non_zero = 0;
-
-            for (int i = 0; i < mrconee_data->num_spinors; i++) {
-                for (int j = 0; j < mrconee_data->num_spinors; j++) {
-                    if (mrconee_data->spinor_irreps[i] != irep) {
-                        continue;
-                    }
-                    if (mrconee_data->spinor_irreps[j] != jrep) {
-                        continue;
-                    }
-
-                    if (cabs(matrix[i * dim + j]) > zero_thresh) {
-                        non_zero = 1;
-                    }
-                }
-            }
+    int num_irreps = mrconee_data->num_irreps;
+    double *block_max = (double *) calloc(num_irreps * num_irreps, sizeof(double));
+
+    matrix_block_max_abs(dim, matrix, mrconee_data->num_spinors, mrconee_data->spinor_irreps, num_irreps, 0,
+                         block_max);
 
-            if (non_zero) {
-                printf(" %s - %s\n", mrconee_data->irrep_names[irep], mrconee_data->irrep_names[jrep]);
+    result->num_nonzero_blocks = 0;
+    result->nonzero_blocks = (int *) arena_alloc(arena, num_irreps * (num_irreps + 1) * sizeof(int));
+
+    for (int irep = 0; irep < num_irreps; irep++) {
+        for (int jrep = irep; jrep < num_irreps; jrep++) {
+            if (block_max[irep * num_irreps + jrep] > zero_thresh) {
+                result->nonzero_blocks[2 * result->num_nonzero_blocks] = irep;
+                result->nonzero_blocks[2 * result->num_nonzero_blocks + 1] = jrep;
+                result->num_nonzero_blocks++;
             }
         }
     }
+
+    free(block_max);
 }
@@ -7,8 +7,60 @@
 #ifndef DIRAC_INSPECTOR_MDPROP_H
 #define DIRAC_INSPECTOR_MDPROP_H
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "arena.h"
 #include "mrconee.h"
 
-void read_mdprop(char *path, mrconee_data_t *mrconee_data);
+/*
+ * property operator: name and the matrix of size dim x dim.
+ * The matrix is owned by the iterator and is valid until the next call.
+ */
+typedef struct {
+    char name[9];                   // null-terminated
+    int dim;
+    double _Complex *matrix;
+} mdprop_operator_t;
+
+/*
+ * results of the analysis of a property operator
+ */
+typedef struct {
+    char name[9];
+    int dim;
+    int re_zero;                    // real part is zero
+    int im_zero;                    // imaginary part is zero
+    int re_symmetric;               // real part is symmetric (antisymmetric otherwise)
+    int im_symmetric;               // imaginary part is symmetric (antisymmetric otherwise)
+    int num_nonzero_blocks;         // -1 if irreps of spinors are not known (no MRCONEE)
+    int *nonzero_blocks;            // pairs of irreps (irep <= jrep) of non-zero blocks
+} mdprop_analysis_t;
+
+typedef struct {
+    int num_operators;
+    mdprop_analysis_t *operators;
+    const char *error;              // NULL if the whole file was read
+    arena_t *arena;                 // memory for the arrays above
+} mdprop_data_t;
+
+typedef struct mdprop_iter mdprop_iter_t;
+
+mdprop_iter_t *mdprop_iter_open(char *path);
+
+int mdprop_iter_next(mdprop_iter_t *iter, mdprop_operator_t *oper);
+
+const char *mdprop_iter_error(mdprop_iter_t *iter);
+
+void mdprop_iter_close(mdprop_iter_t *iter);
+
+mdprop_data_t *read_mdprop(char *path, mrconee_data_t *mrconee_data);
+
+void free_mdprop_data(mdprop_data_t *data);
+
+#ifdef __cplusplus
+}
+#endif
 
 #endif // DIRAC_INSPECTOR_MDPROP_H
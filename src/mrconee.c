@@ -13,6 +13,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <math.h>
 
@@ -30,7 +31,7 @@ int rep_name_exists(int nrep, char **list, char *query);
 
 void rename_irreps_dirac_to_expt(int nsym, char **rep_names);
 
-int test_dirac_integer_size(char *path);
+int test_dirac_integer_size(char *path, unf_byte_order_t *byte_order);
 
 int mrconee_read_header(unf_file_t *file, mrconee_data_t *data);
 
@@ -52,14 +53,20 @@ mrconee_data_t *read_mrconee(char *path)
         return NULL;
     }
 
-    // determine which integers were used in DIRAC: 4-byte or 8-byte
-    int dirac_int_size = test_dirac_integer_size(path);
+    // determine which integers were used in DIRAC: 4-byte or 8-byte,
+    // and the byte order of the file
+    unf_byte_order_t byte_order = UNF_BYTE_ORDER_NATIVE;
+    int dirac_int_size = test_dirac_integer_size(path, &byte_order);
     if (dirac_int_size != DIRAC_INT_4 && dirac_int_size != DIRAC_INT_8) {
+        unf_close(file);
         return NULL; // error
     }
+    unf_set_byte_order(file, byte_order);
 
     mrconee_data_t *data = (mrconee_data_t *) calloc(1, sizeof(mrconee_data_t));
+    data->arena = arena_new();
     data->dirac_int_size = dirac_int_size;
+    data->swap_bytes = (byte_order == UNF_BYTE_ORDER_SWAPPED);
 
     /*
      * record 1
@@ -68,6 +75,7 @@ mrconee_data_t *read_mrconee(char *path)
      */
     int error_code = mrconee_read_header(file, data);
     if (error_code == EXIT_FAILURE) {
+        unf_close(file);
         free_mrconee_data(data);
         return NULL;
     }
@@ -79,6 +87,7 @@ mrconee_data_t *read_mrconee(char *path)
     int fermion_irrep_occs[8];
     error_code = mrconee_read_fermion_irrep_occs(file, data, fermion_irrep_occs);
     if (error_code == EXIT_FAILURE) {
+        unf_close(file);
         free_mrconee_data(data);
         return NULL;
     }
@@ -89,6 +98,7 @@ mrconee_data_t *read_mrconee(char *path)
      */
     error_code = mrconee_read_abelian_irreps(file, data);
     if (error_code == EXIT_FAILURE) {
+        unf_close(file);
         free_mrconee_data(data);
         return NULL;
     }
@@ -99,6 +109,7 @@ mrconee_data_t *read_mrconee(char *path)
      */
     error_code = mrconee_read_multiplication_table(file, data);
     if (error_code == EXIT_FAILURE) {
+        unf_close(file);
         free_mrconee_data(data);
         return NULL;
     }
@@ -109,6 +120,7 @@ mrconee_data_t *read_mrconee(char *path)
      */
     error_code = mrconee_read_spinor_info(file, data, fermion_irrep_occs);
     if (error_code == EXIT_FAILURE) {
+        unf_close(file);
         free_mrconee_data(data);
         return NULL;
     }
@@ -119,10 +131,13 @@ mrconee_data_t *read_mrconee(char *path)
      */
     error_code = mrconee_read_fock(file, data);
     if (error_code == EXIT_FAILURE) {
+        unf_close(file);
         free_mrconee_data(data);
         return NULL;
     }
 
+    unf_close(file);
+
     return data;
 }
 
@@ -157,23 +172,22 @@ int mrconee_read_header(unf_file_t *file, mrconee_data_t *data)
                          &norb_total, &scf_energy);
     }
     else {
-        int64_t num_spinors_8;
-        int64_t breit_8;
-        int64_t invsym_8;
-        int64_t nz_arith_8;
-        int64_t is_spinfree_8;
-        int64_t norb_total_8;
-
-        nread = unf_read(file, "2i8,r8,4i8,r8", &num_spinors_8, &breit_8, &enuc, &invsym_8, &nz_arith_8,
-                         &is_spinfree_8,
-                         &norb_total_8, &scf_energy);
+        // num_spinors, breit, invsym, nz_arith, is_spinfree, norb_total
+        int64_t ints_8[6];
+        int32_t ints[6];
+
+        nread = unf_read(file, "2i8,r8,4i8,r8", &ints_8[0], &ints_8[1], &enuc, &ints_8[2], &ints_8[3],
+                         &ints_8[4], &ints_8[5], &scf_energy);
+        if (nread == 8 && unf_narrow_int64(ints_8, 6, ints) == UNF_ERROR) {
+            return EXIT_FAILURE;
+        }
 
-        num_spinors = (int32_t) num_spinors_8;
-        breit = (int32_t) breit_8;
-        invsym = (int32_t) invsym_8;
-        nz_arith = (int32_t) nz_arith_8;
-        is_spinfree = (int32_t) is_spinfree_8;
-        norb_total = (int32_t) norb_total_8;
+        num_spinors = ints[0];
+        breit = ints[1];
+        invsym = ints[2];
+        nz_arith = ints[3];
+        is_spinfree = ints[4];
+        norb_total = ints[5];
     }
 
     if (nread != 8 || unf_error(file)) {
@@ -229,8 +243,10 @@ int mrconee_read_fermion_irrep_occs(unf_file_t *file, mrconee_data_t *data, int
                          &nsymrp_8, repnames, &nsymrp_8, nactive_8, &nsymrp_8, nstr_8, &invsym, nfrozen_8[0], &invsym,
                          nfrozen_8[1], &invsym, nfrozen_8[2], &invsym, ndelete_8, &invsym);
 
-        for (int i = 0; i < nsymrp_8; i++) {
-            nactive[i] = (int32_t) nactive_8[i];
+        if (nread == 8 && (unf_narrow_int64(&nsymrp_8, 1, &nsymrp) == UNF_ERROR ||
+                           nsymrp < 0 || nsymrp > 8 ||
+                           unf_narrow_int64(nactive_8, nsymrp, nactive) == UNF_ERROR)) {
+            return EXIT_FAILURE;
         }
     }
 
@@ -272,16 +288,18 @@ int mrconee_read_abelian_irreps(unf_file_t *file, mrconee_data_t *data)
         unf_backspace(file);
         nread = unf_read(file, "i8,c4[i4]", &nsymrpa_8, repanames, &size_repanames);
 
-        nsymrpa = (int32_t) nsymrpa_8;
+        if (nread == 2 && unf_narrow_int64(&nsymrpa_8, 1, &nsymrpa) == UNF_ERROR) {
+            return EXIT_FAILURE;
+        }
     }
     if (nread != 2 || unf_error(file)) {
         return EXIT_FAILURE;
     }
 
     data->num_irreps = 2 * nsymrpa;
-    data->irrep_names = (char **) calloc(data->num_irreps, sizeof(char *));
+    data->irrep_names = (char **) arena_alloc(data->arena, data->num_irreps * sizeof(char *));
     for (int i = 0; i < data->num_irreps; i++) {
-        char *name = (char *) calloc(32, sizeof(char));
+        char *name = (char *) arena_calloc(data->arena, 32, sizeof(char));
         name[0] = repanames[4 * i];
         name[1] = repanames[4 * i + 1];
         name[2] = repanames[4 * i + 2];
@@ -290,7 +308,7 @@ int mrconee_read_abelian_irreps(unf_file_t *file, mrconee_data_t *data)
         data->irrep_names[i] = name;
     }
 
-    data->point_group = (char *) calloc(16, sizeof(char));
+    data->point_group = (char *) arena_calloc(data->arena, 32, sizeof(char));
     detect_dirac_point_group(data->irrep_names, data->point_group, &data->totally_sym_irrep);
     rename_irreps_dirac_to_expt(data->num_irreps, data->irrep_names);
 
@@ -314,17 +332,17 @@ int mrconee_read_multiplication_table(unf_file_t *file, mrconee_data_t *data)
     else {
         int64_t multb_8[64 * 64];
         nread = unf_read(file, "i8[i4]", multb_8, &multb_size);
-        for (int i = 0; i < data->num_irreps * data->num_irreps; i++) {
-            multb[i] = (int32_t) multb_8[i];
+        if (nread == 1 && unf_narrow_int64(multb_8, multb_size, multb) == UNF_ERROR) {
+            return EXIT_FAILURE;
         }
     }
     if (nread != 1 || unf_error(file)) {
         return EXIT_FAILURE;
     }
 
-    data->mult_table = (int **) calloc(data->num_irreps, sizeof(int *));
+    data->mult_table = (int **) arena_alloc(data->arena, data->num_irreps * sizeof(int *));
     for (int i = 0; i < data->num_irreps; i++) {
-        data->mult_table[i] = (int *) calloc(data->num_irreps, sizeof(int));
+        data->mult_table[i] = (int *) arena_alloc(data->arena, data->num_irreps * sizeof(int));
         for (int j = 0; j < data->num_irreps; j++) {
             data->mult_table[i][j] = multb[j * data->num_irreps + i];
         }
@@ -344,20 +362,31 @@ int mrconee_read_spinor_info(unf_file_t *file, mrconee_data_t *data, int *fermio
 {
     int num_spinors = data->num_spinors;
 
-    data->occ_numbers = (int *) calloc(data->num_spinors, sizeof(int));
-    data->spinor_irreps = (int *) calloc(data->num_spinors, sizeof(int));
-    data->spinor_energies = (double *) calloc(data->num_spinors, sizeof(double));
+    data->occ_numbers = (int *) arena_calloc(data->arena, data->num_spinors, sizeof(int));
+    data->spinor_irreps = (int *) arena_alloc(data->arena, data->num_spinors * sizeof(int));
+    data->spinor_energies = (double *) arena_alloc(data->arena, data->num_spinors * sizeof(double));
 
     int element_size = 2 * data->dirac_int_size + sizeof(double);
     int32_t buf_size = num_spinors * element_size;
-    char *buf = (char *) calloc(num_spinors, element_size);
+    char *buf = (char *) arena_alloc(data->arena, (size_t) num_spinors * element_size);
 
     int nread = unf_read(file, "c[i4]", buf, &buf_size);
     if (nread != 1 || unf_error(file)) {
-        free(buf);
+        arena_release(data->arena, buf);
         return EXIT_FAILURE;
     }
 
+    // raw bytes are not swapped by unf_read(); do it here field by field
+    if (data->swap_bytes && data->dirac_int_size == DIRAC_INT_8) {
+        unf_byte_swap(buf, 3 * num_spinors, sizeof(int64_t));
+    }
+    else if (data->swap_bytes) {
+        for (int i = 0; i < num_spinors; i++) {
+            unf_byte_swap(buf + element_size * i, 2, sizeof(int32_t));
+            unf_byte_swap(buf + element_size * i + 2 * sizeof(int32_t), 1, sizeof(double));
+        }
+    }
+
     for (int i = 0; i < num_spinors; i++) {
         // decode raw bytes containing irrep numbers and spinor energies
         int irp = 0;
@@ -367,8 +396,13 @@ int mrconee_read_spinor_info(unf_file_t *file, mrconee_data_t *data, int *fermio
             data->spinor_energies[i] = *((double *) (buf + element_size * i + 2 * sizeof(int32_t)));
         }
         else {
-            irp = (int) *((int64_t *) (buf + element_size * i));
-            data->spinor_irreps[i] = (int) *((int64_t *) (buf + element_size * i + sizeof(int64_t))) - 1;
+            int32_t irreps[2];
+            if (unf_narrow_int64(buf + element_size * i, 2, irreps) == UNF_ERROR) {
+                arena_release(data->arena, buf);
+                return EXIT_FAILURE;
+            }
+            irp = irreps[0];
+            data->spinor_irreps[i] = irreps[1] - 1;
             data->spinor_energies[i] = *((double *) (buf + element_size * i + 2 * sizeof(int64_t)));
         }
 
@@ -378,7 +412,7 @@ int mrconee_read_spinor_info(unf_file_t *file, mrconee_data_t *data, int *fermio
         }
     }
 
-    free(buf);
+    arena_release(data->arena, buf);
 
     return EXIT_SUCCESS;
 }
@@ -390,7 +424,9 @@ int mrconee_read_spinor_info(unf_file_t *file, mrconee_data_t *data, int *fermio
  */
 int mrconee_read_fock(unf_file_t *file, mrconee_data_t *data)
 {
-    data->fock = (double _Complex *) calloc(data->num_spinors * data->num_spinors, sizeof(double _Complex));
+    data->fock = (double _Complex *) arena_alloc(data->arena,
+                                                 (size_t) data->num_spinors * data->num_spinors *
+                                                 sizeof(double _Complex));
     int32_t fock_size = data->num_spinors * data->num_spinors;
 
     int nread = unf_read(file, "z8[i4]", data->fock, &fock_size);
@@ -404,46 +440,7 @@ int mrconee_read_fock(unf_file_t *file, mrconee_data_t *data)
 
 void free_mrconee_data(mrconee_data_t *data)
 {
-    if (data->occ_numbers) {
-        free(data->occ_numbers);
-    }
-
-    if (data->spinor_energies) {
-        free(data->spinor_energies);
-    }
-
-    if (data->spinor_irreps) {
-        free(data->spinor_irreps);
-    }
-
-    if (data->irrep_names) {
-        for (int i = 0; i < data->num_irreps; i++) {
-            char *name = data->irrep_names[i];
-            if (name) {
-                free(name);
-            }
-        }
-        free(data->irrep_names);
-    }
-
-    if (data->point_group) {
-        free(data->point_group);
-    }
-
-    if (data->mult_table) {
-        for (int i = 0; i < data->num_irreps; i++) {
-            int *line = data->mult_table[i];
-            if (line) {
-                free(line);
-            }
-        }
-        free(data->mult_table);
-    }
-
-    if (data->fock) {
-        free(data->fock);
-    }
-
+    arena_free(data->arena);
     free(data);
 }
 
@@ -451,68 +448,28 @@ void free_mrconee_data(mrconee_data_t *data)
 /**
  * Determines which version of DIRAC was used to generate molecular integrals,
  * with 4-byte or 8-byte integers.
+ * The size of the first record is known (6 integers + 2 reals), thus it is also
+ * used to detect the byte order of the file.
  */
-int test_dirac_integer_size(char *path)
+int test_dirac_integer_size(char *path, unf_byte_order_t *byte_order)
 {
     unf_file_t *file = unf_open(path, "r", UNF_ACCESS_SEQUENTIAL);
     if (file == NULL) {
         return -1;
     }
-    int rec_size = unf_next_rec_size(file);
-    unf_close(file);
 
-    // size = 6 integers + 2 reals
-    if (rec_size == (6 * sizeof(int32_t) + 2 * sizeof(double))) {
-        return DIRAC_INT_4;
+    int dirac_int_size = -1; // error
+    if (unf_detect_byte_order(file, 6 * sizeof(int32_t) + 2 * sizeof(double)) == UNF_SUCCESS) {
+        dirac_int_size = DIRAC_INT_4;
     }
-    else if (rec_size == (6 * sizeof(int64_t) + 2 * sizeof(double))) {
-        return DIRAC_INT_8;
+    else if (unf_detect_byte_order(file, 6 * sizeof(int64_t) + 2 * sizeof(double)) == UNF_SUCCESS) {
+        dirac_int_size = DIRAC_INT_8;
     }
-    else {
-        return -1; // error
-    }
-}
 
+    *byte_order = unf_get_byte_order(file);
+    unf_close(file);
 
-void print_mrconee_data(FILE *out, mrconee_data_t *data)
-{
-    fprintf(out, "\n");
-    fprintf(out, " size of integers in DIRAC                          %d bytes\n", data->dirac_int_size);
-    fprintf(out, " number of spinors                                  %d\n", data->num_spinors);
-    fprintf(out, " core energy (inactive energy + nuclear repulsion)  %.12f a.u.\n", data->nuc_rep_energy);
-    fprintf(out, " total SCF energy                                   %.12f a.u.\n", data->scf_energy);
-    fprintf(out, " double group type                                  ");
-    if (data->group_arith == 1) {
-        fprintf(out, "real\n");
-    }
-    else if (data->group_arith == 2) {
-        fprintf(out, "complex\n");
-    }
-    else if (data->group_arith == 4) {
-        fprintf(out, "quaternion\n");
-    }
-    else {
-        fprintf(out, "unknown\n");
-    }
-    fprintf(out, " spin-free                                          %s\n", data->is_spinfree ? "yes" : "no");
-    fprintf(out, " Abelian subgroup                                   %s\n",
-            data->point_group ? data->point_group : "n/a");
-    fprintf(out, " totally symmetric irrep                            %s\n",
-            data->irrep_names ? data->irrep_names[data->totally_sym_irrep] : "n/a");
-    fprintf(out, " number of irreps in the Abelian subgroup           %d\n", data->num_irreps);
-    fprintf(out, "\n");
-
-    fprintf(out, " spinors info:\n");
-    fprintf(out, " -----------------------------------------------------\n");
-    fprintf(out, "   no       irrep     occ      one-electron energy    \n");
-    fprintf(out, " -----------------------------------------------------\n");
-    for (int i = 0; i < data->num_spinors; i++) {
-        char *irrep_name = data->irrep_names[data->spinor_irreps[i]];
-        fprintf(out, " %4d%12s%8d%25.8f\n", i + 1, irrep_name, data->occ_numbers[i], data->spinor_energies[i]);
-    }
-    fprintf(out, " -----------------------------------------------------\n");
-
-    fprintf(out, "\n");
+    return dirac_int_size;
 }
 
 
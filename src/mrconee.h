@@ -7,10 +7,15 @@
 #ifndef DIRAC_INSPECTOR_MRCONEE_H
 #define DIRAC_INSPECTOR_MRCONEE_H
 
-#include <stdio.h>
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "arena.h"
 
 typedef struct {
     int dirac_int_size;       // size of integers in DIRAC: 4- or 8-byte
+    int swap_bytes;           // byte order of DIRAC files differs from the native one
     int num_spinors;          // total number of spinors
     double nuc_rep_energy;    // core energy (inactive energy + nuclear repulsion)
     int group_arith;          // group type (1 real, 2 complex, 4 quaternion)
@@ -26,12 +31,15 @@ typedef struct {
     int *spinor_irreps;       // irrep in Abelian subgroup
     double *spinor_energies;  // one-electron energies from SCF
     double _Complex *fock;    // Fock matrix
+    arena_t *arena;           // memory for all the arrays above
 } mrconee_data_t;
 
 mrconee_data_t *read_mrconee(char *path);
 
 void free_mrconee_data(mrconee_data_t *data);
 
-void print_mrconee_data(FILE *out, mrconee_data_t *data);
+#ifdef __cplusplus
+}
+#endif
 
 #endif // DIRAC_INSPECTOR_MRCONEE_H
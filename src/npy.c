@@ -0,0 +1,441 @@
+/*
+ * Inspector of DIRAC files containing transformed molecular integrals.
+ *
+ * Export of arrays to NumPy .npy files.
+ *
+ * 2024 Alexander Oleynichenko
+ */
+
+#include "npy.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "mdcint.h"
+#include "mdprop.h"
+#include "mrconee.h"
+#include "util.h"
+
+/*
+ * Format version 1.0: magic string, version, header length (uint16, little-endian),
+ * header (Python dict literal padded with spaces and terminated by '\n').
+ * The header is always NPY_HEADER_SIZE bytes long, so that the data are aligned
+ * for memory mapping and the shape can be rewritten in place when the number of
+ * elements is known.
+ */
+#define NPY_HEADER_SIZE 128
+#define NPY_MAX_PATH_LEN 1024
+// longest part of a path quoted in error messages (result->error is 256 bytes)
+#define NPY_ERROR_PATH_LEN 192
+
+static size_t npy_element_size(npy_type_t type);
+
+static int write_header(FILE *file, npy_type_t type, int fortran_order, int ndim, const int64_t *shape);
+
+static int make_path(char *path, char *dir, char *name, npy_export_result_t *result);
+
+static int export_mrconee(char *dir, mrconee_data_t *mrconee_data, npy_export_result_t *result);
+
+static int export_mdprop(char *dir, char *mdprop_path, npy_export_result_t *result);
+
+static int export_mdcint(char *dir, mrconee_data_t *mrconee_data, char *mdcint_path, npy_export_result_t *result);
+
+static int write_array(char *dir, char *name, npy_type_t type, int fortran_order, int ndim, const int64_t *shape,
+                       const void *data, npy_export_result_t *result);
+
+
+/**
+ * Writes an array to the .npy file.
+ * fortran_order: the first index runs fastest (column-major storage).
+ * Returns EXIT_SUCCESS or EXIT_FAILURE (errno is set then).
+ */
+int npy_write_array(char *path, npy_type_t type, int fortran_order, int ndim, const int64_t *shape,
+                    const void *data)
+{
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        return EXIT_FAILURE;
+    }
+
+    size_t num_elements = 1;
+    for (int i = 0; i < ndim; i++) {
+        num_elements *= (size_t) shape[i];
+    }
+
+    int status = write_header(file, type, fortran_order, ndim, shape);
+    if (status == EXIT_SUCCESS && num_elements > 0 &&
+        fwrite(data, npy_element_size(type), num_elements, file) != num_elements) {
+        status = EXIT_FAILURE;
+    }
+    if (fclose(file) != 0) {
+        status = EXIT_FAILURE;
+    }
+
+    return status;
+}
+
+
+/**
+ * Opens the .npy file for a one-dimensional array of unknown length.
+ * Elements are appended by npy_stream_write(); the length is written
+ * to the header by npy_stream_close().
+ * Returns NULL on error (errno is set then).
+ */
+npy_stream_t *npy_stream_open(char *path, npy_type_t type)
+{
+    npy_stream_t *stream = (npy_stream_t *) calloc(1, sizeof(npy_stream_t));
+    if (stream == NULL) {
+        return NULL;
+    }
+
+    stream->file = fopen(path, "wb");
+    stream->type = type;
+    int64_t shape = 0;
+    if (stream->file == NULL || write_header(stream->file, type, 0, 1, &shape) == EXIT_FAILURE) {
+        int saved_errno = errno;
+        if (stream->file) {
+            fclose(stream->file);
+        }
+        free(stream);
+        errno = saved_errno;
+        return NULL;
+    }
+
+    return stream;
+}
+
+
+int npy_stream_write(npy_stream_t *stream, const void *data, int64_t num_elements)
+{
+    if (num_elements > 0 &&
+        fwrite(data, npy_element_size(stream->type), num_elements, stream->file) != (size_t) num_elements) {
+        return EXIT_FAILURE;
+    }
+
+    stream->num_elements += num_elements;
+    return EXIT_SUCCESS;
+}
+
+
+/**
+ * Writes the final length to the header and closes the file.
+ */
+int npy_stream_close(npy_stream_t *stream)
+{
+    if (stream == NULL) {
+        return EXIT_SUCCESS;
+    }
+
+    int status = EXIT_SUCCESS;
+    if (fseek(stream->file, 0, SEEK_SET) != 0 ||
+        write_header(stream->file, stream->type, 0, 1, &stream->num_elements) == EXIT_FAILURE) {
+        status = EXIT_FAILURE;
+    }
+    if (fclose(stream->file) != 0) {
+        status = EXIT_FAILURE;
+    }
+    free(stream);
+
+    return status;
+}
+
+
+/**
+ * Writes arrays from the MRCONEE, MDPROP and MDCINT files to the directory dir
+ * (created if it does not exist), one .npy file per array:
+ *
+ *   spinor_energies.npy   float64 [num_spinors]
+ *   occ_numbers.npy       int32   [num_spinors]
+ *   spinor_irreps.npy     int32   [num_spinors], 0-based
+ *   fock.npy              complex128 [num_spinors, num_spinors]
+ *   mdprop_NNN_NAME.npy   complex128 [dim, dim] for each property operator
+ *   mdcint_ikr.npy, mdcint_jkr.npy, mdcint_indk.npy, mdcint_indl.npy
+ *                         int32 [num_integrals], Kramers pair indices of each integral
+ *   mdcint_values.npy     float64 or complex128 [num_integrals]
+ *
+ * Matrices are written as they are stored in DIRAC files, i.e. in the Fortran order,
+ * so that np.load(..., mmap_mode='r') maps them without copying.
+ * A missing MDPROP or MDCINT file is skipped (mdprop_path or mdcint_path may be NULL).
+ *
+ * Returns EXIT_SUCCESS or EXIT_FAILURE (with the message in result->error).
+ */
+int write_npy_export(char *dir, mrconee_data_t *mrconee_data, char *mdprop_path, char *mdcint_path,
+                     npy_export_result_t *result)
+{
+    memset(result, 0, sizeof(npy_export_result_t));
+    double time_start = abs_time();
+
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+        snprintf(result->error, sizeof(result->error), "cannot create directory %s: %s", dir, strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    int status = export_mrconee(dir, mrconee_data, result);
+    if (status == EXIT_SUCCESS && mdprop_path) {
+        status = export_mdprop(dir, mdprop_path, result);
+    }
+    if (status == EXIT_SUCCESS && mdcint_path) {
+        status = export_mdcint(dir, mrconee_data, mdcint_path, result);
+    }
+
+    result->time = abs_time() - time_start;
+
+    return status;
+}
+
+
+static size_t npy_element_size(npy_type_t type)
+{
+    if (type == NPY_INT32) {
+        return sizeof(int32_t);
+    }
+    else if (type == NPY_FLOAT64) {
+        return sizeof(double);
+    }
+    return 2 * sizeof(double);
+}
+
+
+static int write_header(FILE *file, npy_type_t type, int fortran_order, int ndim, const int64_t *shape)
+{
+    char header[NPY_HEADER_SIZE + 1];
+    const char *type_code = type == NPY_INT32 ? "i4" : type == NPY_FLOAT64 ? "f8" : "c16";
+
+    memcpy(header, "\x93NUMPY\x01\x00", 8);
+    header[8] = (char) ((NPY_HEADER_SIZE - 10) & 0xFF);
+    header[9] = (char) ((NPY_HEADER_SIZE - 10) >> 8);
+
+    size_t len = 10;
+    len += snprintf(header + len, sizeof(header) - len, "{'descr': '%c%s', 'fortran_order': %s, 'shape': (",
+                    is_native_little_endian() ? '<' : '>', type_code, fortran_order ? "True" : "False");
+    for (int i = 0; i < ndim && len < sizeof(header); i++) {
+        len += snprintf(header + len, sizeof(header) - len, "%lld,%s", (long long) shape[i],
+                        i + 1 < ndim ? " " : "");
+    }
+    if (len < sizeof(header)) {
+        len += snprintf(header + len, sizeof(header) - len, "), }");
+    }
+    if (len >= NPY_HEADER_SIZE) {
+        errno = EOVERFLOW;
+        return EXIT_FAILURE;
+    }
+
+    memset(header + len, ' ', NPY_HEADER_SIZE - len);
+    header[NPY_HEADER_SIZE - 1] = '\n';
+
+    if (fwrite(header, 1, NPY_HEADER_SIZE, file) != NPY_HEADER_SIZE) {
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+
+static int make_path(char *path, char *dir, char *name, npy_export_result_t *result)
+{
+    int len = snprintf(path, NPY_MAX_PATH_LEN, "%s/%s", dir, name);
+    if (len >= NPY_MAX_PATH_LEN) {
+        snprintf(result->error, sizeof(result->error), "path is too long: %s/%s", dir, name);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+
+static int write_array(char *dir, char *name, npy_type_t type, int fortran_order, int ndim, const int64_t *shape,
+                       const void *data, npy_export_result_t *result)
+{
+    char path[NPY_MAX_PATH_LEN];
+    if (make_path(path, dir, name, result) == EXIT_FAILURE) {
+        return EXIT_FAILURE;
+    }
+
+    if (npy_write_array(path, type, fortran_order, ndim, shape, data) == EXIT_FAILURE) {
+        snprintf(result->error, sizeof(result->error), "error while writing %.*s: %s",
+                 NPY_ERROR_PATH_LEN, path, strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    int64_t num_elements = 1;
+    for (int i = 0; i < ndim; i++) {
+        num_elements *= shape[i];
+    }
+    result->num_files++;
+    result->bytes_written += NPY_HEADER_SIZE + num_elements * (int64_t) npy_element_size(type);
+
+    return EXIT_SUCCESS;
+}
+
+
+static int export_mrconee(char *dir, mrconee_data_t *mrconee_data, npy_export_result_t *result)
+{
+    int64_t n = mrconee_data->num_spinors;
+    int64_t shape[2] = {n, n};
+
+    int32_t *occ_numbers = (int32_t *) malloc(n * sizeof(int32_t));
+    int32_t *spinor_irreps = (int32_t *) malloc(n * sizeof(int32_t));
+    if (occ_numbers == NULL || spinor_irreps == NULL) {
+        free(occ_numbers);
+        free(spinor_irreps);
+        snprintf(result->error, sizeof(result->error), "%s", strerror(ENOMEM));
+        return EXIT_FAILURE;
+    }
+    for (int64_t i = 0; i < n; i++) {
+        occ_numbers[i] = mrconee_data->occ_numbers[i];
+        spinor_irreps[i] = mrconee_data->spinor_irreps[i];
+    }
+
+    int status = write_array(dir, "spinor_energies.npy", NPY_FLOAT64, 0, 1, &n, mrconee_data->spinor_energies, result);
+    if (status == EXIT_SUCCESS) {
+        status = write_array(dir, "occ_numbers.npy", NPY_INT32, 0, 1, &n, occ_numbers, result);
+    }
+    if (status == EXIT_SUCCESS) {
+        status = write_array(dir, "spinor_irreps.npy", NPY_INT32, 0, 1, &n, spinor_irreps, result);
+    }
+    if (status == EXIT_SUCCESS && mrconee_data->fock) {
+        status = write_array(dir, "fock.npy", NPY_COMPLEX128, 1, 2, shape, mrconee_data->fock, result);
+    }
+
+    free(occ_numbers);
+    free(spinor_irreps);
+
+    return status;
+}
+
+
+/*
+ * operators are numbered from 1 in the order of the MDPROP file;
+ * characters of names other than letters and digits are replaced with '_'
+ */
+static int export_mdprop(char *dir, char *mdprop_path, npy_export_result_t *result)
+{
+    mdprop_iter_t *iter = mdprop_iter_open(mdprop_path);
+    if (iter == NULL) {
+        return EXIT_SUCCESS;
+    }
+
+    mdprop_operator_t oper;
+    int status;
+    while ((status = mdprop_iter_next(iter, &oper)) == 1) {
+        char name[64];
+        int len = snprintf(name, sizeof(name), "mdprop_%03d_", result->num_operators + 1);
+        for (char *p = oper.name; *p && *p != ' '; p++) {
+            name[len++] = isalnum((unsigned char) *p) ? *p : '_';
+        }
+        strcpy(name + len, ".npy");
+
+        int64_t shape[2] = {oper.dim, oper.dim};
+        if (write_array(dir, name, NPY_COMPLEX128, 1, 2, shape, oper.matrix, result) == EXIT_FAILURE) {
+            mdprop_iter_close(iter);
+            return EXIT_FAILURE;
+        }
+        result->num_operators++;
+    }
+
+    if (status < 0) {
+        snprintf(result->error, sizeof(result->error), "%s", mdprop_iter_error(iter));
+    }
+    mdprop_iter_close(iter);
+
+    return status < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+
+/*
+ * columns of integrals are streamed record by record
+ */
+static int export_mdcint(char *dir, mrconee_data_t *mrconee_data, char *mdcint_path, npy_export_result_t *result)
+{
+    const int num_columns = 5;
+    char *names[] = {"mdcint_ikr.npy", "mdcint_jkr.npy", "mdcint_indk.npy", "mdcint_indl.npy", "mdcint_values.npy"};
+
+    mdcint_iter_t *iter = mdcint_iter_open(mdcint_path, mrconee_data);
+    if (iter == NULL && errno == ENOENT) {
+        return EXIT_SUCCESS;
+    }
+    if (iter == NULL) {
+        snprintf(result->error, sizeof(result->error), "error while reading MDCINT file: %s", strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    int is_real = mrconee_data->group_arith == 1 || mrconee_data->is_spinfree == 1;
+    npy_stream_t *columns[5] = {NULL, NULL, NULL, NULL, NULL};
+    int status = EXIT_SUCCESS;
+
+    for (int i = 0; i < num_columns && status == EXIT_SUCCESS; i++) {
+        char path[NPY_MAX_PATH_LEN];
+        npy_type_t type = i < 4 ? NPY_INT32 : is_real ? NPY_FLOAT64 : NPY_COMPLEX128;
+        status = make_path(path, dir, names[i], result);
+        if (status == EXIT_SUCCESS && (columns[i] = npy_stream_open(path, type)) == NULL) {
+            snprintf(result->error, sizeof(result->error), "error while writing %.*s: %s",
+                     NPY_ERROR_PATH_LEN, path, strerror(errno));
+            status = EXIT_FAILURE;
+        }
+    }
+
+    // ikr and jkr repeated for each integral of the record
+    int32_t *ikr = NULL;
+    int32_t *jkr = NULL;
+    int64_t capacity = 0;
+
+    mdcint_record_t rec;
+    int iter_status = 0;
+    while (status == EXIT_SUCCESS && (iter_status = mdcint_iter_next(iter, &rec)) == 1) {
+        if (rec.nonzr > capacity) {
+            free(ikr);
+            free(jkr);
+            capacity = rec.nonzr;
+            ikr = (int32_t *) malloc(capacity * sizeof(int32_t));
+            jkr = (int32_t *) malloc(capacity * sizeof(int32_t));
+            if (ikr == NULL || jkr == NULL) {
+                snprintf(result->error, sizeof(result->error), "%s", strerror(ENOMEM));
+                status = EXIT_FAILURE;
+                break;
+            }
+        }
+        for (int32_t i = 0; i < rec.nonzr; i++) {
+            ikr[i] = rec.ikr;
+            jkr[i] = rec.jkr;
+        }
+
+        const void *data[5] = {ikr, jkr, rec.indk, rec.indl, rec.values};
+        for (int i = 0; i < num_columns; i++) {
+            if (npy_stream_write(columns[i], data[i], rec.nonzr) == EXIT_FAILURE) {
+                snprintf(result->error, sizeof(result->error), "error while writing %s/%s: %s", dir, names[i],
+                         strerror(errno));
+                status = EXIT_FAILURE;
+                break;
+            }
+        }
+        result->num_integrals += rec.nonzr;
+    }
+
+    if (status == EXIT_SUCCESS && iter_status < 0) {
+        snprintf(result->error, sizeof(result->error), "%s", mdcint_iter_error(iter));
+        status = EXIT_FAILURE;
+    }
+
+    for (int i = 0; i < num_columns; i++) {
+        if (columns[i] == NULL) {
+            continue;
+        }
+        result->num_files++;
+        result->bytes_written += NPY_HEADER_SIZE + columns[i]->num_elements * (int64_t) npy_element_size(columns[i]->type);
+        if (npy_stream_close(columns[i]) == EXIT_FAILURE && status == EXIT_SUCCESS) {
+            snprintf(result->error, sizeof(result->error), "error while writing %s/%s: %s", dir, names[i],
+                     strerror(errno));
+            status = EXIT_FAILURE;
+        }
+    }
+
+    free(ikr);
+    free(jkr);
+    mdcint_iter_close(iter);
+
+    return status;
+}
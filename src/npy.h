@@ -0,0 +1,65 @@
+/*
+ * Inspector of DIRAC files containing transformed molecular integrals.
+ *
+ * 2024 Alexander Oleynichenko
+ */
+
+#ifndef DIRAC_INSPECTOR_NPY_H
+#define DIRAC_INSPECTOR_NPY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "mrconee.h"
+
+/*
+ * element types of arrays
+ */
+typedef enum {
+    NPY_INT32,
+    NPY_FLOAT64,
+    NPY_COMPLEX128
+} npy_type_t;
+
+/*
+ * one-dimensional array written element by element, see npy_stream_open()
+ */
+typedef struct {
+    FILE *file;
+    npy_type_t type;
+    int64_t num_elements;
+} npy_stream_t;
+
+int npy_write_array(char *path, npy_type_t type, int fortran_order, int ndim, const int64_t *shape,
+                    const void *data);
+
+npy_stream_t *npy_stream_open(char *path, npy_type_t type);
+
+int npy_stream_write(npy_stream_t *stream, const void *data, int64_t num_elements);
+
+int npy_stream_close(npy_stream_t *stream);
+
+/*
+ * summary of the export, see write_npy_export()
+ */
+typedef struct {
+    int num_files;
+    int num_operators;          // number of MDPROP operators written
+    int64_t num_integrals;      // number of two-electron integrals written
+    int64_t bytes_written;
+    double time;                // seconds
+    char error[256];            // empty string if the export succeeded
+} npy_export_result_t;
+
+int write_npy_export(char *dir, mrconee_data_t *mrconee_data, char *mdprop_path, char *mdcint_path,
+                     npy_export_result_t *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DIRAC_INSPECTOR_NPY_H
@@ -0,0 +1,386 @@
+/*
+ * Inspector of DIRAC files containing transformed molecular integrals.
+ *
+ * Text and JSON reports printed by the command-line tool.
+ *
+ * 2024 Alexander Oleynichenko
+ */
+
+#include "report.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "util.h"
+
+static const char *group_arith_name(int group_arith);
+
+static const char *symmetry_name(int is_zero, int is_symmetric);
+
+
+void print_mrconee_data(FILE *out, mrconee_data_t *data)
+{
+    fprintf(out, "\n");
+    fprintf(out, " size of integers in DIRAC                          %d bytes\n", data->dirac_int_size);
+    fprintf(out, " byte order                                         %s\n",
+            is_native_little_endian() != data->swap_bytes ? "little-endian" : "big-endian");
+    fprintf(out, " number of spinors                                  %d\n", data->num_spinors);
+    fprintf(out, " core energy (inactive energy + nuclear repulsion)  %.12f a.u.\n", data->nuc_rep_energy);
+    fprintf(out, " total SCF energy                                   %.12f a.u.\n", data->scf_energy);
+    fprintf(out, " double group type                                  %s\n", group_arith_name(data->group_arith));
+    fprintf(out, " spin-free                                          %s\n", data->is_spinfree ? "yes" : "no");
+    fprintf(out, " Abelian subgroup                                   %s\n",
+            data->point_group ? data->point_group : "n/a");
+    fprintf(out, " totally symmetric irrep                            %s\n",
+            data->irrep_names ? data->irrep_names[data->totally_sym_irrep] : "n/a");
+    fprintf(out, " number of irreps in the Abelian subgroup           %d\n", data->num_irreps);
+    fprintf(out, "\n");
+
+    fprintf(out, " spinors info:\n");
+    fprintf(out, " -----------------------------------------------------\n");
+    fprintf(out, "   no       irrep     occ      one-electron energy    \n");
+    fprintf(out, " -----------------------------------------------------\n");
+    for (int i = 0; i < data->num_spinors; i++) {
+        char *irrep_name = data->irrep_names[data->spinor_irreps[i]];
+        fprintf(out, " %4d%12s%8d%25.8f\n", i + 1, irrep_name, data->occ_numbers[i], data->spinor_energies[i]);
+    }
+    fprintf(out, " -----------------------------------------------------\n");
+
+    fprintf(out, "\n");
+}
+
+
+void print_fock_analysis(FILE *out, mrconee_data_t *mrconee_data, fock_analysis_t *analysis)
+{
+    int dim = analysis->dim;
+    int num_irreps = analysis->num_irreps;
+
+    fprintf(out, " Fock matrix analysis:\n");
+    fprintf(out, " max deviation from hermiticity                     %.3e\n", analysis->hermiticity_deviation);
+    fprintf(out, " max off-diagonal element                           %.3e\n", analysis->max_off_diag);
+    fprintf(out, " norm of the off-diagonal part                      %.3e\n", analysis->off_diag_norm);
+    fprintf(out, " max |Re F_ii - spinor energy|                      %.3e\n", analysis->max_diag_deviation);
+    fprintf(out, " max |Im F_ii|                                      %.3e\n", analysis->max_diag_imag);
+    fprintf(out, " rows without diagonal dominance                    %d of %d (max ratio %.3e)\n",
+            analysis->num_non_dominant_rows, dim, analysis->max_row_ratio);
+    fprintf(out, " canonical orbitals                                 %s\n",
+            analysis->is_canonical ? "yes" : "no");
+    fprintf(out, "\n");
+
+    fprintf(out, " max off-diagonal element in irrep blocks:\n");
+    for (int irep = 0; irep < num_irreps; irep++) {
+        for (int jrep = irep; jrep < num_irreps; jrep++) {
+            double max_abs = analysis->block_max[irep * num_irreps + jrep];
+            if (max_abs > 0.0) {
+                fprintf(out, " %8s - %-8s%12.3e\n", mrconee_data->irrep_names[irep],
+                        mrconee_data->irrep_names[jrep], max_abs);
+            }
+        }
+    }
+    fprintf(out, "\n");
+
+    fprintf(out, " sparsity profile:\n");
+    double n_elements = (double) dim * dim;
+    for (int bin = 0; bin < MATRIX_SPARSITY_NUM_BINS; bin++) {
+        int64_t count = analysis->sparsity[bin];
+        if (count == 0) {
+            continue;
+        }
+        if (bin == 0) {
+            fprintf(out, "            |F_ij| < %.0e", matrix_sparsity_bin_lower_bound(1));
+        }
+        else if (bin == MATRIX_SPARSITY_NUM_BINS - 1) {
+            fprintf(out, "   %.0e <= |F_ij|        ", matrix_sparsity_bin_lower_bound(bin));
+        }
+        else {
+            fprintf(out, "   %.0e <= |F_ij| < %.0e", matrix_sparsity_bin_lower_bound(bin),
+                    matrix_sparsity_bin_lower_bound(bin + 1));
+        }
+        fprintf(out, "%14lld  (%5.1f%%)\n", (long long) count, 100.0 * count / n_elements);
+    }
+    fprintf(out, "\n");
+}
+
+
+void print_mdprop_data(FILE *out, mrconee_data_t *mrconee_data, mdprop_data_t *data)
+{
+    for (int i = 0; i < data->num_operators; i++) {
+        mdprop_analysis_t *oper = &data->operators[i];
+
+        fprintf(out, "\n[%d]  %s\n\n", i + 1, oper->name);
+
+        fprintf(out, " real part: %s%s\n", oper->re_zero ? "" : "non-zero ",
+                symmetry_name(oper->re_zero, oper->re_symmetric));
+        fprintf(out, " imag part: %s%s\n", oper->im_zero ? "" : "non-zero ",
+                symmetry_name(oper->im_zero, oper->im_symmetric));
+
+        if (oper->num_nonzero_blocks >= 0 && mrconee_data) {
+            fprintf(out, " non-zero blocks:\n");
+            for (int ib = 0; ib < oper->num_nonzero_blocks; ib++) {
+                fprintf(out, " %s - %s\n", mrconee_data->irrep_names[oper->nonzero_blocks[2 * ib]],
+                        mrconee_data->irrep_names[oper->nonzero_blocks[2 * ib + 1]]);
+            }
+        }
+    }
+
+    if (data->error) {
+        fprintf(out, " %s\n", data->error);
+    }
+
+    fprintf(out, "\n");
+}
+
+
+void print_mdcint_data(FILE *out, mdcint_data_t *data)
+{
+    fprintf(out, " two-electron integrals file\n");
+    fprintf(out, " date and time              %s\n", data->header.date_time);
+    fprintf(out, " number of Kramers pairs    %d\n", data->header.nkr);
+    for (int i = 0; i < data->header.nkr; i++) {
+        fprintf(out, "%4d%4d\n", data->header.kramers_pairs[2*i], data->header.kramers_pairs[2*i + 1]);
+    }
+
+    if (data->error) {
+        fprintf(out, " %s\n", data->error);
+    }
+
+    fprintf(out, " number of non-zero ints    %lld\n", (long long) data->num_integrals);
+    if (!data->is_real) {
+        fprintf(out, " max |Im| of integrals      %.3e\n", data->max_imag);
+        fprintf(out, " records with real ints     %lld of %lld (%lld ints, |Im| <= %g)\n",
+                (long long) data->num_real_records, (long long) data->num_records,
+                (long long) data->num_real_integrals, MDCINT_IMAG_THRESHOLD);
+    }
+    fprintf(out, " time for reading 2e ints   %.2f sec\n\n", data->read_time);
+}
+
+
+void json_mrconee_data(json_writer_t *w, mrconee_data_t *data)
+{
+    json_begin_object(w);
+    json_key(w, "dirac_int_size");
+    json_int(w, data->dirac_int_size);
+    json_key(w, "byte_order");
+    json_string(w, is_native_little_endian() != data->swap_bytes ? "little-endian" : "big-endian");
+    json_key(w, "num_spinors");
+    json_int(w, data->num_spinors);
+    json_key(w, "core_energy");
+    json_double(w, data->nuc_rep_energy);
+    json_key(w, "scf_energy");
+    json_double(w, data->scf_energy);
+    json_key(w, "group_arith");
+    json_string(w, group_arith_name(data->group_arith));
+    json_key(w, "spinfree");
+    json_bool(w, data->is_spinfree);
+    json_key(w, "point_group");
+    json_string(w, data->point_group);
+    json_key(w, "totally_symmetric_irrep");
+    json_string(w, data->irrep_names ? data->irrep_names[data->totally_sym_irrep] : NULL);
+    json_key(w, "num_irreps");
+    json_int(w, data->num_irreps);
+
+    json_key(w, "irreps");
+    json_begin_array(w);
+    for (int i = 0; data->irrep_names && i < data->num_irreps; i++) {
+        json_string(w, data->irrep_names[i]);
+    }
+    json_end_array(w);
+
+    json_key(w, "spinors");
+    json_begin_array(w);
+    for (int i = 0; i < data->num_spinors; i++) {
+        json_begin_object(w);
+        json_key(w, "index");
+        json_int(w, i + 1);
+        json_key(w, "irrep");
+        json_string(w, data->irrep_names[data->spinor_irreps[i]]);
+        json_key(w, "occ");
+        json_int(w, data->occ_numbers[i]);
+        json_key(w, "energy");
+        json_double(w, data->spinor_energies[i]);
+        json_end_object(w);
+    }
+    json_end_array(w);
+    json_end_object(w);
+}
+
+
+void json_fock_analysis(json_writer_t *w, mrconee_data_t *mrconee_data, fock_analysis_t *analysis)
+{
+    int num_irreps = analysis->num_irreps;
+
+    json_begin_object(w);
+    json_key(w, "hermiticity_deviation");
+    json_double(w, analysis->hermiticity_deviation);
+    json_key(w, "max_off_diag");
+    json_double(w, analysis->max_off_diag);
+    json_key(w, "off_diag_norm");
+    json_double(w, analysis->off_diag_norm);
+    json_key(w, "max_diag_deviation");
+    json_double(w, analysis->max_diag_deviation);
+    json_key(w, "max_diag_imag");
+    json_double(w, analysis->max_diag_imag);
+    json_key(w, "num_non_dominant_rows");
+    json_int(w, analysis->num_non_dominant_rows);
+    json_key(w, "max_row_ratio");
+    json_double(w, analysis->max_row_ratio);
+    json_key(w, "canonical");
+    json_bool(w, analysis->is_canonical);
+
+    json_key(w, "block_max");
+    json_begin_array(w);
+    for (int irep = 0; irep < num_irreps; irep++) {
+        for (int jrep = irep; jrep < num_irreps; jrep++) {
+            double max_abs = analysis->block_max[irep * num_irreps + jrep];
+            if (max_abs > 0.0) {
+                json_begin_object(w);
+                json_key(w, "irreps");
+                json_begin_array(w);
+                json_string(w, mrconee_data->irrep_names[irep]);
+                json_string(w, mrconee_data->irrep_names[jrep]);
+                json_end_array(w);
+                json_key(w, "max");
+                json_double(w, max_abs);
+                json_end_object(w);
+            }
+        }
+    }
+    json_end_array(w);
+
+    json_key(w, "sparsity");
+    json_begin_array(w);
+    for (int bin = 0; bin < MATRIX_SPARSITY_NUM_BINS; bin++) {
+        json_begin_object(w);
+        json_key(w, "lower");
+        if (bin == 0) {
+            json_double(w, 0.0);
+        }
+        else {
+            json_double(w, matrix_sparsity_bin_lower_bound(bin));
+        }
+        json_key(w, "upper");
+        if (bin == MATRIX_SPARSITY_NUM_BINS - 1) {
+            json_null(w);
+        }
+        else {
+            json_double(w, matrix_sparsity_bin_lower_bound(bin + 1));
+        }
+        json_key(w, "count");
+        json_int(w, analysis->sparsity[bin]);
+        json_end_object(w);
+    }
+    json_end_array(w);
+    json_end_object(w);
+}
+
+
+void json_mdprop_data(json_writer_t *w, mrconee_data_t *mrconee_data, mdprop_data_t *data)
+{
+    json_begin_object(w);
+    json_key(w, "operators");
+    json_begin_array(w);
+    for (int i = 0; i < data->num_operators; i++) {
+        mdprop_analysis_t *oper = &data->operators[i];
+
+        json_begin_object(w);
+        json_key(w, "name");
+        json_string(w, oper->name);
+        json_key(w, "dim");
+        json_int(w, oper->dim);
+        json_key(w, "real_part");
+        json_string(w, symmetry_name(oper->re_zero, oper->re_symmetric));
+        json_key(w, "imag_part");
+        json_string(w, symmetry_name(oper->im_zero, oper->im_symmetric));
+        json_key(w, "nonzero_blocks");
+        if (oper->num_nonzero_blocks >= 0 && mrconee_data) {
+            json_begin_array(w);
+            for (int ib = 0; ib < oper->num_nonzero_blocks; ib++) {
+                json_begin_array(w);
+                json_string(w, mrconee_data->irrep_names[oper->nonzero_blocks[2 * ib]]);
+                json_string(w, mrconee_data->irrep_names[oper->nonzero_blocks[2 * ib + 1]]);
+                json_end_array(w);
+            }
+            json_end_array(w);
+        }
+        else {
+            json_null(w);
+        }
+        json_end_object(w);
+    }
+    json_end_array(w);
+    json_key(w, "error");
+    json_string(w, data->error);
+    json_end_object(w);
+}
+
+
+void json_mdcint_data(json_writer_t *w, mdcint_data_t *data)
+{
+    json_begin_object(w);
+    json_key(w, "date_time");
+    json_string(w, data->header.date_time);
+    json_key(w, "nkr");
+    json_int(w, data->header.nkr);
+    json_key(w, "kramers_pairs");
+    json_begin_array(w);
+    for (int i = 0; i < data->header.nkr; i++) {
+        json_begin_array(w);
+        json_int(w, data->header.kramers_pairs[2*i]);
+        json_int(w, data->header.kramers_pairs[2*i + 1]);
+        json_end_array(w);
+    }
+    json_end_array(w);
+    json_key(w, "num_records");
+    json_int(w, data->num_records);
+    json_key(w, "num_integrals");
+    json_int(w, data->num_integrals);
+    if (!data->is_real) {
+        json_key(w, "max_imag");
+        json_double(w, data->max_imag);
+        json_key(w, "num_real_records");
+        json_int(w, data->num_real_records);
+        json_key(w, "num_real_integrals");
+        json_int(w, data->num_real_integrals);
+    }
+    json_key(w, "read_time");
+    json_double(w, data->read_time);
+    json_key(w, "error");
+    json_string(w, data->error);
+    json_end_object(w);
+}
+
+
+/*
+ * stands for a report that could not be produced
+ */
+void json_error(json_writer_t *w, const char *message)
+{
+    json_begin_object(w);
+    json_key(w, "error");
+    json_string(w, message);
+    json_end_object(w);
+}
+
+
+static const char *group_arith_name(int group_arith)
+{
+    if (group_arith == 1) {
+        return "real";
+    }
+    else if (group_arith == 2) {
+        return "complex";
+    }
+    else if (group_arith == 4) {
+        return "quaternion";
+    }
+    return "unknown";
+}
+
+
+static const char *symmetry_name(int is_zero, int is_symmetric)
+{
+    if (is_zero) {
+        return "zero";
+    }
+    return is_symmetric ? "symmetric" : "antisymmetric";
+}
@@ -0,0 +1,42 @@
+/*
+ * Inspector of DIRAC files containing transformed molecular integrals.
+ *
+ * Text and JSON reports printed by the command-line tool.
+ *
+ * 2024 Alexander Oleynichenko
+ */
+
+#ifndef DIRAC_INSPECTOR_REPORT_H
+#define DIRAC_INSPECTOR_REPORT_H
+
+#include <stdio.h>
+
+#include "fock_analysis.h"
+#include "json_writer.h"
+#include "mdcint.h"
+#include "mdprop.h"
+#include "mrconee.h"
+
+void print_mrconee_data(FILE *out, mrconee_data_t *data);
+
+void print_fock_analysis(FILE *out, mrconee_data_t *mrconee_data, fock_analysis_t *analysis);
+
+void print_mdprop_data(FILE *out, mrconee_data_t *mrconee_data, mdprop_data_t *data);
+
+void print_mdcint_data(FILE *out, mdcint_data_t *data);
+
+/*
+ * JSON reports: each function writes a single value (an object),
+ * which is expected to follow a key of the enclosing object
+ */
+void json_mrconee_data(json_writer_t *w, mrconee_data_t *data);
+
+void json_fock_analysis(json_writer_t *w, mrconee_data_t *mrconee_data, fock_analysis_t *analysis);
+
+void json_mdprop_data(json_writer_t *w, mrconee_data_t *mrconee_data, mdprop_data_t *data);
+
+void json_mdcint_data(json_writer_t *w, mdcint_data_t *data);
+
+void json_error(json_writer_t *w, const char *message);
+
+#endif // DIRAC_INSPECTOR_REPORT_H
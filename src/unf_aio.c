@@ -0,0 +1,676 @@
+/**
+ * LIBUNF - tools for accessing Fortran binary unformatted files from projects
+ * written in the C programming language
+ *
+ * Asynchronous read engine: read-ahead via io_uring with the pread() fallback.
+ *
+ * 2024 Alexander Oleynichenko
+ * alexvoleynichenko@gmail.com
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef UNF_HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+#include "unf_aio.h"
+
+enum {
+    CHUNK_FREE,      // does not hold any data
+    CHUNK_PENDING,   // to be read by pread() when needed
+    CHUNK_INFLIGHT,  // read request is submitted to io_uring
+    CHUNK_READY
+};
+
+typedef struct {
+    int state;
+    off_t offset;    // position in the file
+    size_t length;   // number of bytes requested
+    size_t n_valid;  // number of bytes actually read
+    int error;
+    char *data;
+} aio_chunk_t;
+
+#ifdef UNF_HAVE_IO_URING
+
+/*
+ * io_uring instance accessed via raw system calls (liburing is not required)
+ */
+typedef struct {
+    int fd;
+    unsigned entries;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sq_ring;
+    size_t sq_ring_size;
+    void *cq_ring;
+    size_t cq_ring_size;
+    size_t sqes_size;
+    unsigned to_submit;
+} aio_ring_t;
+
+// user_data of the request issued by unf_aio_pread()
+#define AIO_SYNC_TAG UINT64_MAX
+
+#endif // UNF_HAVE_IO_URING
+
+struct unf_aio {
+    int fd;
+    off_t file_size;
+    off_t pos;            // current position
+    off_t base;           // offset of the chunk number 0 of the read-ahead window
+    int64_t lo;           // lowest chunk number kept in memory
+    int64_t next;         // next chunk number to be requested
+    int queue_depth;
+    size_t chunk_size;
+    aio_chunk_t *chunks;  // chunk number c is kept in chunks[c % queue_depth]
+    char *data;
+    int eof_flag;
+    int error_flag;
+    int use_uring;        // new requests are submitted via io_uring
+#ifdef UNF_HAVE_IO_URING
+    int ring_tried;       // io_uring instance is created on the first request
+    int ring_ready;
+    aio_ring_t ring;
+    int sync_done;
+    int sync_res;
+#endif
+};
+
+
+static size_t pread_full(int fd, char *buf, size_t n_bytes, off_t offset, int *error)
+{
+    size_t n_done = 0;
+
+    while (n_done < n_bytes) {
+        ssize_t n = pread(fd, buf + n_done, n_bytes - n_done, offset + (off_t) n_done);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            *error = errno;
+            break;
+        }
+        if (n == 0) {
+            break;
+        }
+        n_done += (size_t) n;
+    }
+
+    return n_done;
+}
+
+
+#ifdef UNF_HAVE_IO_URING
+
+static int ring_init(aio_ring_t *ring, unsigned entries)
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    memset(ring, 0, sizeof(aio_ring_t));
+
+    ring->fd = (int) syscall(__NR_io_uring_setup, entries, &params);
+    if (ring->fd < 0) {
+        return -1;
+    }
+
+    ring->entries = params.sq_entries;
+    ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+    int single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap) {
+        size_t size = ring->sq_ring_size > ring->cq_ring_size ? ring->sq_ring_size : ring->cq_ring_size;
+        ring->sq_ring_size = size;
+        ring->cq_ring_size = size;
+    }
+
+    ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ring == MAP_FAILED) {
+        close(ring->fd);
+        return -1;
+    }
+
+    if (single_mmap) {
+        ring->cq_ring = ring->sq_ring;
+    }
+    else {
+        ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE,
+                             MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ring == MAP_FAILED) {
+            munmap(ring->sq_ring, ring->sq_ring_size);
+            close(ring->fd);
+            return -1;
+        }
+    }
+
+    ring->sqes = (struct io_uring_sqe *) mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+                                              MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        if (!single_mmap) {
+            munmap(ring->cq_ring, ring->cq_ring_size);
+        }
+        munmap(ring->sq_ring, ring->sq_ring_size);
+        close(ring->fd);
+        return -1;
+    }
+
+    char *sq = (char *) ring->sq_ring;
+    char *cq = (char *) ring->cq_ring;
+    ring->sq_head = (unsigned *) (sq + params.sq_off.head);
+    ring->sq_tail = (unsigned *) (sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned *) (sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned *) (sq + params.sq_off.array);
+    ring->cq_head = (unsigned *) (cq + params.cq_off.head);
+    ring->cq_tail = (unsigned *) (cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned *) (cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *) (cq + params.cq_off.cqes);
+
+    return 0;
+}
+
+
+static void ring_destroy(aio_ring_t *ring)
+{
+    munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_ring != ring->sq_ring) {
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    }
+    munmap(ring->sq_ring, ring->sq_ring_size);
+    close(ring->fd);
+}
+
+
+static int ring_enter(aio_ring_t *ring, unsigned min_complete)
+{
+    unsigned flags = min_complete > 0 ? IORING_ENTER_GETEVENTS : 0;
+
+    for (;;) {
+        long ret = syscall(__NR_io_uring_enter, ring->fd, ring->to_submit, min_complete, flags, NULL, 0);
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ret < 0) {
+            return -1;
+        }
+        ring->to_submit -= (unsigned) ret;
+        return 0;
+    }
+}
+
+
+static int ring_push_read(aio_ring_t *ring, int fd, void *buf, size_t length, off_t offset, uint64_t user_data)
+{
+    unsigned tail = *ring->sq_tail;
+    unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+
+    // submission queue is full
+    if (tail - head >= ring->entries) {
+        if (ring_enter(ring, 0) != 0) {
+            return -1;
+        }
+        head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+        if (tail - head >= ring->entries) {
+            return -1;
+        }
+    }
+
+    unsigned index = tail & *ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t) (uintptr_t) buf;
+    sqe->len = (uint32_t) length;
+    sqe->off = (uint64_t) offset;
+    sqe->user_data = user_data;
+
+    ring->sq_array[index] = index;
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ring->to_submit++;
+
+    return 0;
+}
+
+
+/*
+ * Handles completion of the chunk read.
+ * Short reads and failed requests (for example, IORING_OP_READ is not supported by
+ * the kernel) are completed synchronously by pread().
+ */
+static void complete_chunk(unf_aio_t *aio, aio_chunk_t *chunk, int res)
+{
+    if (res < 0) {
+        aio->use_uring = 0;
+        res = 0;
+    }
+
+    chunk->n_valid = (size_t) res;
+    if (chunk->n_valid < chunk->length) {
+        chunk->n_valid += pread_full(aio->fd, chunk->data + chunk->n_valid, chunk->length - chunk->n_valid,
+                                     chunk->offset + (off_t) chunk->n_valid, &chunk->error);
+    }
+
+    chunk->state = CHUNK_READY;
+}
+
+
+/*
+ * Waits for at least one completion and processes all completions available.
+ */
+static int ring_reap(unf_aio_t *aio)
+{
+    aio_ring_t *ring = &aio->ring;
+
+    unsigned head = *ring->cq_head;
+    unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    if (head == tail) {
+        if (ring_enter(ring, 1) != 0) {
+            return -1;
+        }
+        tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    }
+
+    for (; head != tail; head++) {
+        struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+        if (cqe->user_data == AIO_SYNC_TAG) {
+            aio->sync_res = cqe->res;
+            aio->sync_done = 1;
+        }
+        else {
+            complete_chunk(aio, &aio->chunks[cqe->user_data], cqe->res);
+        }
+    }
+    __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+#endif // UNF_HAVE_IO_URING
+
+
+/*
+ * Creates the io_uring instance (once); pread() is used if it is not possible.
+ */
+static void start_ring(unf_aio_t *aio)
+{
+#ifdef UNF_HAVE_IO_URING
+    if (!aio->ring_tried) {
+        aio->ring_tried = 1;
+        // one more entry for requests issued by unf_aio_pread()
+        aio->ring_ready = (ring_init(&aio->ring, (unsigned) aio->queue_depth + 1) == 0);
+        aio->use_uring = aio->ring_ready;
+    }
+#else
+    (void) aio;
+#endif
+}
+
+
+/*
+ * Makes the chunk available: waits for the asynchronous request
+ * or reads it synchronously.
+ */
+static int wait_chunk(unf_aio_t *aio, aio_chunk_t *chunk)
+{
+#ifdef UNF_HAVE_IO_URING
+    while (chunk->state == CHUNK_INFLIGHT) {
+        if (ring_reap(aio) != 0) {
+            return -1;
+        }
+    }
+#endif
+
+    if (chunk->state == CHUNK_PENDING) {
+        chunk->n_valid = pread_full(aio->fd, chunk->data, chunk->length, chunk->offset, &chunk->error);
+        chunk->state = CHUNK_READY;
+    }
+
+    return chunk->error ? -1 : 0;
+}
+
+
+static void request_chunk(unf_aio_t *aio, int64_t chunk_number)
+{
+    aio_chunk_t *chunk = &aio->chunks[chunk_number % aio->queue_depth];
+
+    // the buffer is still in use by the kernel
+    if (chunk->state == CHUNK_INFLIGHT) {
+        wait_chunk(aio, chunk);
+    }
+
+    chunk->offset = aio->base + chunk_number * (off_t) aio->chunk_size;
+    chunk->length = aio->chunk_size;
+    if (chunk->offset + (off_t) chunk->length > aio->file_size) {
+        chunk->length = (size_t) (aio->file_size - chunk->offset);
+    }
+    chunk->n_valid = 0;
+    chunk->error = 0;
+    chunk->state = CHUNK_PENDING;
+
+#ifdef UNF_HAVE_IO_URING
+    if (aio->use_uring &&
+        ring_push_read(&aio->ring, aio->fd, chunk->data, chunk->length, chunk->offset,
+                       (uint64_t) (chunk_number % aio->queue_depth)) == 0) {
+        chunk->state = CHUNK_INFLIGHT;
+    }
+#endif
+}
+
+
+/*
+ * Requests chunks ahead of the current position until the queue is full.
+ */
+static void fill_queue(unf_aio_t *aio)
+{
+    while (aio->next - aio->lo < aio->queue_depth &&
+           aio->base + aio->next * (off_t) aio->chunk_size < aio->file_size) {
+        request_chunk(aio, aio->next);
+        aio->next++;
+    }
+
+#ifdef UNF_HAVE_IO_URING
+    if (aio->use_uring && aio->ring.to_submit > 0) {
+        ring_enter(&aio->ring, 0);
+    }
+#endif
+}
+
+
+/*
+ * Drops all chunks and starts reading at the position 'pos'.
+ * After a backward jump (backspacing) only one chunk ending shortly after 'pos'
+ * is requested, so that the following backward steps hit the same chunk;
+ * read-ahead is resumed as soon as reading proceeds forward.
+ */
+static void restart(unf_aio_t *aio, off_t pos, int backward)
+{
+    start_ring(aio);
+
+    for (int i = 0; i < aio->queue_depth; i++) {
+        if (aio->chunks[i].state == CHUNK_INFLIGHT) {
+            wait_chunk(aio, &aio->chunks[i]);
+        }
+        aio->chunks[i].state = CHUNK_FREE;
+    }
+
+    aio->lo = 0;
+    aio->next = 0;
+
+    if (backward && aio->queue_depth > 1 && aio->chunk_size > 4096) {
+        aio->base = pos + 4096 - (off_t) aio->chunk_size;
+        aio->base = aio->base < 0 ? 0 : aio->base;
+        request_chunk(aio, 0);
+        aio->next = 1;
+#ifdef UNF_HAVE_IO_URING
+        if (aio->use_uring) {
+            ring_enter(&aio->ring, 0);
+        }
+#endif
+    }
+    else {
+        aio->base = pos;
+        fill_queue(aio);
+    }
+}
+
+
+/**
+ * Creates the read engine for the file descriptor 'fd' opened for reading.
+ * Reading starts at the position 'pos'.
+ * Returns NULL on error.
+ */
+unf_aio_t *unf_aio_new(int fd, off_t pos, int queue_depth, size_t chunk_size)
+{
+    struct stat st;
+    if (fd < 0 || queue_depth < 1 || chunk_size == 0 || fstat(fd, &st) != 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    unf_aio_t *aio = (unf_aio_t *) calloc(1, sizeof(unf_aio_t));
+    if (aio == NULL) {
+        return NULL;
+    }
+
+    aio->fd = fd;
+    aio->file_size = st.st_size;
+    aio->pos = pos;
+    aio->queue_depth = queue_depth;
+    aio->chunk_size = chunk_size;
+    aio->chunks = (aio_chunk_t *) calloc(queue_depth, sizeof(aio_chunk_t));
+    if (aio->chunks == NULL ||
+        posix_memalign((void **) &aio->data, 4096, (size_t) queue_depth * chunk_size) != 0) {
+        free(aio->chunks);
+        free(aio);
+        return NULL;
+    }
+
+    for (int i = 0; i < queue_depth; i++) {
+        aio->chunks[i].state = CHUNK_FREE;
+        aio->chunks[i].data = aio->data + (size_t) i * chunk_size;
+    }
+
+    // nothing is read until the first request
+    aio->base = pos;
+    aio->lo = 0;
+    aio->next = 0;
+
+    return aio;
+}
+
+
+/**
+ * Waits for all requests in flight and destroys the read engine.
+ * The file descriptor is not closed.
+ */
+void unf_aio_free(unf_aio_t *aio)
+{
+    if (aio == NULL) {
+        return;
+    }
+
+    for (int i = 0; i < aio->queue_depth; i++) {
+        if (aio->chunks[i].state == CHUNK_INFLIGHT) {
+            wait_chunk(aio, &aio->chunks[i]);
+        }
+    }
+
+#ifdef UNF_HAVE_IO_URING
+    if (aio->ring_ready) {
+        ring_destroy(&aio->ring);
+    }
+#endif
+
+    free(aio->data);
+    free(aio->chunks);
+    free(aio);
+}
+
+
+/**
+ * Reads n_bytes at the current position; the position is advanced.
+ * Returns the number of bytes read, which is less than n_bytes at the end
+ * of the file or on error (see unf_aio_eof() and unf_aio_error()).
+ */
+size_t unf_aio_read(unf_aio_t *aio, void *buf, size_t n_bytes)
+{
+    char *dest = (char *) buf;
+    size_t n_done = 0;
+
+    while (n_done < n_bytes) {
+        if (aio->pos >= aio->file_size) {
+            aio->eof_flag = 1;
+            break;
+        }
+
+        // position is out of the window
+        off_t window_begin = aio->base + aio->lo * (off_t) aio->chunk_size;
+        off_t window_end = aio->base + aio->next * (off_t) aio->chunk_size;
+        if (aio->pos < window_begin || aio->pos >= window_end) {
+            restart(aio, aio->pos, aio->pos < window_begin);
+        }
+
+        // chunks behind the current position are not needed anymore
+        int64_t chunk_number = (aio->pos - aio->base) / (off_t) aio->chunk_size;
+        if (aio->lo < chunk_number) {
+            aio->lo = chunk_number;
+            fill_queue(aio);
+        }
+
+        aio_chunk_t *chunk = &aio->chunks[chunk_number % aio->queue_depth];
+        if (wait_chunk(aio, chunk) != 0) {
+            errno = chunk->error;
+            aio->error_flag = 1;
+            break;
+        }
+
+        size_t chunk_pos = (size_t) (aio->pos - chunk->offset);
+        if (chunk_pos >= chunk->n_valid) {
+            // the file was truncated after the engine was started
+            aio->eof_flag = 1;
+            break;
+        }
+
+        size_t n_copy = chunk->n_valid - chunk_pos;
+        if (n_copy > n_bytes - n_done) {
+            n_copy = n_bytes - n_done;
+        }
+        memcpy(dest + n_done, chunk->data + chunk_pos, n_copy);
+        n_done += n_copy;
+        aio->pos += (off_t) n_copy;
+    }
+
+    return n_done;
+}
+
+
+/**
+ * Reads n_bytes at the given offset without read-ahead (direct-access records).
+ * The current position is not changed.
+ * Returns the number of bytes read.
+ */
+size_t unf_aio_pread(unf_aio_t *aio, void *buf, size_t n_bytes, off_t offset)
+{
+    int error = 0;
+
+    start_ring(aio);
+
+#ifdef UNF_HAVE_IO_URING
+    if (aio->use_uring && n_bytes <= UINT32_MAX) {
+        aio->sync_done = 0;
+        if (ring_push_read(&aio->ring, aio->fd, buf, n_bytes, offset, AIO_SYNC_TAG) == 0) {
+            while (!aio->sync_done) {
+                if (ring_reap(aio) != 0) {
+                    aio->error_flag = 1;
+                    return 0;
+                }
+            }
+            if (aio->sync_res >= 0) {
+                size_t n_done = (size_t) aio->sync_res;
+                if (n_done < n_bytes) {
+                    n_done += pread_full(aio->fd, (char *) buf + n_done, n_bytes - n_done,
+                                         offset + (off_t) n_done, &error);
+                }
+                if (error) {
+                    errno = error;
+                    aio->error_flag = 1;
+                }
+                return n_done;
+            }
+            aio->use_uring = 0;
+        }
+    }
+#endif
+
+    size_t n_done = pread_full(aio->fd, (char *) buf, n_bytes, offset, &error);
+    if (error) {
+        errno = error;
+        aio->error_flag = 1;
+    }
+
+    return n_done;
+}
+
+
+/**
+ * Sets the current position, 'whence' is SEEK_SET, SEEK_CUR or SEEK_END.
+ * Clears the end-of-file flag.
+ * Returns 0 upon success, -1 otherwise.
+ */
+int unf_aio_seek(unf_aio_t *aio, off_t offset, int whence)
+{
+    off_t new_pos;
+
+    if (whence == SEEK_SET) {
+        new_pos = offset;
+    }
+    else if (whence == SEEK_CUR) {
+        new_pos = aio->pos + offset;
+    }
+    else if (whence == SEEK_END) {
+        new_pos = aio->file_size + offset;
+    }
+    else {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (new_pos < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    aio->pos = new_pos;
+    aio->eof_flag = 0;
+
+    return 0;
+}
+
+
+off_t unf_aio_tell(unf_aio_t *aio)
+{
+    return aio->pos;
+}
+
+
+int unf_aio_eof(unf_aio_t *aio)
+{
+    return aio->eof_flag;
+}
+
+
+int unf_aio_error(unf_aio_t *aio)
+{
+    return aio->error_flag;
+}
+
+
+/**
+ * Returns the name of the backend actually used: "io_uring" or "pread".
+ */
+const char *unf_aio_backend(unf_aio_t *aio)
+{
+    start_ring(aio);
+
+    return aio->use_uring ? "io_uring" : "pread";
+}
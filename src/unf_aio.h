@@ -0,0 +1,51 @@
+/**
+ * LIBUNF - tools for accessing Fortran binary unformatted files from projects
+ * written in the C programming language
+ *
+ * Asynchronous read engine.
+ *
+ * 2024 Alexander Oleynichenko
+ * alexvoleynichenko@gmail.com
+ */
+
+#ifndef LIBUNF_AIO_H_INCLUDED
+#define LIBUNF_AIO_H_INCLUDED
+
+#include <stddef.h>
+#include <sys/types.h>
+
+/*
+ * The reader keeps 'queue_depth' chunks of the file in flight ahead of the current
+ * position. On Linux, reads are submitted via io_uring (if libunf is compiled
+ * with UNF_HAVE_IO_URING and the kernel allows it); otherwise chunks are read
+ * synchronously by pread() when they are needed.
+ *
+ * The reader emulates the stream interface: read at the current position, seek,
+ * eof and error flags. Seeking inside the chunks already read is free;
+ * any other seek restarts read-ahead at the new position.
+ */
+
+#define UNF_AIO_CHUNK_SIZE (1024 * 1024)
+#define UNF_AIO_QUEUE_DEPTH 8
+
+typedef struct unf_aio unf_aio_t;
+
+unf_aio_t *unf_aio_new(int fd, off_t pos, int queue_depth, size_t chunk_size);
+
+void unf_aio_free(unf_aio_t *aio);
+
+size_t unf_aio_read(unf_aio_t *aio, void *buf, size_t n_bytes);
+
+size_t unf_aio_pread(unf_aio_t *aio, void *buf, size_t n_bytes, off_t offset);
+
+int unf_aio_seek(unf_aio_t *aio, off_t offset, int whence);
+
+off_t unf_aio_tell(unf_aio_t *aio);
+
+int unf_aio_eof(unf_aio_t *aio);
+
+int unf_aio_error(unf_aio_t *aio);
+
+const char *unf_aio_backend(unf_aio_t *aio);
+
+#endif // LIBUNF_AIO_H_INCLUDED
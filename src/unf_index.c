@@ -0,0 +1,551 @@
+/**
+ * LIBUNF - tools for accessing Fortran binary unformatted files from projects
+ * written in the C programming language
+ *
+ * Parallel discovery of record boundaries of sequential files.
+ *
+ * 2024 Alexander Oleynichenko
+ * alexvoleynichenko@gmail.com
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "libunf.h"
+#include "unf_aio.h"
+
+/*
+ * The file is split into byte ranges, one per thread. Each thread looks for
+ * the first position in its range where a plausible record starts (the leading
+ * and the trailing markers coincide for several consecutive records) and then
+ * walks the chain of records until it leaves the range.
+ * Chains are stitched serially: the true chain starting at offset 0 is followed
+ * into the next range until it meets a boundary found there; from this point
+ * both chains coincide. If a thread synchronized at a wrong position, the gap is
+ * walked serially, so the result is always the same as that of a serial walk.
+ */
+
+// markers are read through two windows of this size
+#define INDEX_WINDOW_SIZE (4 * 1024)
+// ranges are not made smaller than this
+#define INDEX_MIN_RANGE_SIZE (64 * 1024 * 1024)
+// number of consecutive records confirming the synchronization point
+#define INDEX_SYNC_RECORDS 3
+// synchronization point is looked for only within this distance from the beginning of the range
+#define INDEX_MAX_SYNC_SCAN (256 * 1024)
+
+/*
+ * Markers are read through two windows: leading markers and trailing markers
+ * of large records are far apart, and the least recently used window is moved
+ * on a miss. Large records thus cost a single small read each.
+ */
+typedef struct {
+    char *data;
+    off_t offset;
+    size_t len;
+} index_window_t;
+
+typedef struct {
+    int fd;
+    int swap_bytes;
+    off_t file_size;
+    index_window_t windows[2];
+    int last_used;
+    int error;
+} index_reader_t;
+
+typedef struct {
+    off_t lo;            // range of positions where chain records may start
+    off_t hi;
+    off_t chain_end;     // position after the last record of the chain (-1 if not synchronized)
+    int broken;          // the chain ends by a malformed record
+    int64_t n_records;
+    int64_t capacity;
+    int64_t *offsets;
+    int32_t *lengths;
+} index_range_t;
+
+static int reader_init(index_reader_t *reader, unf_file_t *file, off_t file_size);
+
+static void reader_free(index_reader_t *reader);
+
+static int read_marker_at(index_reader_t *reader, off_t offset, int32_t *marker);
+
+static int valid_record_at(index_reader_t *reader, off_t offset, int32_t *length);
+
+static off_t find_sync_point(index_reader_t *reader, off_t lo, off_t hi);
+
+static int append_record(index_range_t *range, off_t offset, int32_t length);
+
+static void walk_chain(index_reader_t *reader, index_range_t *range, off_t start);
+
+static int64_t find_offset(index_range_t *range, off_t offset);
+
+
+/**
+ * Builds the index of records of the sequential file: offsets of the leading
+ * markers and lengths of all records, from the beginning to the end of the file.
+ * Byte ranges of the file are scanned by num_threads threads in parallel
+ * (num_threads <= 0: the default number of OpenMP threads); without OpenMP
+ * the ranges are scanned one after another. The file position is not changed.
+ *
+ * Returns NULL on error or if the file is not a valid sequential file
+ * (the error flag of the file is set then).
+ */
+unf_rec_index_t *unf_build_index(unf_file_t *file, int num_threads)
+{
+    if (file == NULL ||
+        file->access != UNF_ACCESS_SEQUENTIAL) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    fflush(file->file_ptr);
+
+    struct stat st;
+    if (fstat(fileno(file->file_ptr), &st) != 0) {
+        file->error_flag = 1;
+        return NULL;
+    }
+    off_t file_size = st.st_size;
+
+    if (num_threads <= 0) {
+#ifdef _OPENMP
+        num_threads = omp_get_max_threads();
+#else
+        num_threads = 1;
+#endif
+    }
+
+    int n_ranges = (int) (file_size / INDEX_MIN_RANGE_SIZE);
+    n_ranges = n_ranges < 1 ? 1 : n_ranges;
+    n_ranges = n_ranges > num_threads ? num_threads : n_ranges;
+
+    index_range_t *ranges = (index_range_t *) calloc(n_ranges, sizeof(index_range_t));
+    if (ranges == NULL) {
+        file->error_flag = 1;
+        return NULL;
+    }
+
+    off_t range_size = file_size / n_ranges;
+    for (int i = 0; i < n_ranges; i++) {
+        ranges[i].lo = range_size * i;
+        ranges[i].hi = (i == n_ranges - 1) ? file_size : range_size * (i + 1);
+        ranges[i].chain_end = -1;
+    }
+
+    /*
+     * parallel phase: synchronize and walk the chain in each range
+     */
+    int error = 0;
+
+    #pragma omp parallel for schedule(static, 1) num_threads(n_ranges) reduction(|:error)
+    for (int i = 0; i < n_ranges; i++) {
+        index_reader_t reader;
+        if (reader_init(&reader, file, file_size) == UNF_ERROR) {
+            error = 1;
+            continue;
+        }
+
+        // the first range starts by a record for sure
+        off_t start = (i == 0) ? 0 : find_sync_point(&reader, ranges[i].lo, ranges[i].hi);
+        if (start >= 0) {
+            walk_chain(&reader, &ranges[i], start);
+        }
+
+        error |= reader.error;
+        reader_free(&reader);
+    }
+
+    /*
+     * serial phase: follow the true chain through the ranges
+     */
+    unf_rec_index_t *index = (unf_rec_index_t *) calloc(1, sizeof(unf_rec_index_t));
+    index_range_t result = {0};
+    index_reader_t reader;
+    int reader_ready = 0;
+
+    if (index == NULL || error) {
+        goto failure;
+    }
+
+    off_t pos = 0;
+    for (int i = 0; i < n_ranges && pos < file_size; i++) {
+        index_range_t *range = &ranges[i];
+        if (pos >= range->hi) {
+            continue;
+        }
+
+        // walk until the true chain joins the chain found in this range
+        int64_t k = find_offset(range, pos);
+        while (k < 0 && pos < range->hi) {
+            if (!reader_ready) {
+                if (reader_init(&reader, file, file_size) == UNF_ERROR) {
+                    goto failure;
+                }
+                reader_ready = 1;
+            }
+            int32_t length = 0;
+            if (valid_record_at(&reader, pos, &length) != UNF_SUCCESS ||
+                append_record(&result, pos, length) == UNF_ERROR) {
+                goto failure;
+            }
+            pos += 2 * (off_t) sizeof(int32_t) + length;
+            k = find_offset(range, pos);
+        }
+
+        if (k < 0) {
+            continue;
+        }
+
+        // from here both chains coincide
+        if (range->broken) {
+            goto failure;
+        }
+        for (; k < range->n_records; k++) {
+            if (append_record(&result, range->offsets[k], range->lengths[k]) == UNF_ERROR) {
+                goto failure;
+            }
+        }
+        pos = range->chain_end;
+    }
+
+    if (pos != file_size) {
+        goto failure;
+    }
+
+    index->num_records = result.n_records;
+    index->offsets = result.offsets;
+    index->lengths = result.lengths;
+
+    if (reader_ready) {
+        reader_free(&reader);
+    }
+    for (int i = 0; i < n_ranges; i++) {
+        free(ranges[i].offsets);
+        free(ranges[i].lengths);
+    }
+    free(ranges);
+
+    return index;
+
+failure:
+    if (reader_ready) {
+        reader_free(&reader);
+    }
+    for (int i = 0; i < n_ranges; i++) {
+        free(ranges[i].offsets);
+        free(ranges[i].lengths);
+    }
+    free(ranges);
+    free(result.offsets);
+    free(result.lengths);
+    free(index);
+    file->error_flag = 1;
+
+    return NULL;
+}
+
+
+/**
+ * Frees the index of records.
+ */
+void unf_free_index(unf_rec_index_t *index)
+{
+    if (index == NULL) {
+        return;
+    }
+
+    free(index->offsets);
+    free(index->lengths);
+    free(index);
+}
+
+
+/**
+ * Positions the sequential file to the beginning of the record number 'rec'
+ * (counting from 0) using the index built by unf_build_index().
+ * Unlike unf_seek(), no records are walked.
+ *
+ * Returns UNF_SUCCESS upon success, UNF_ERROR otherwise.
+ */
+int unf_seek_index(unf_file_t *file, unf_rec_index_t *index, int64_t rec)
+{
+    if (file == NULL || index == NULL ||
+        file->access != UNF_ACCESS_SEQUENTIAL ||
+        rec < 0 || rec > index->num_records) {
+        errno = EINVAL;
+        return UNF_ERROR;
+    }
+
+    // rec == num_records: the end of the file
+    if (rec == index->num_records) {
+        return unf_seek(file, UNF_POS_END, 0);
+    }
+
+    off_t offset = (off_t) index->offsets[rec];
+    int err = file->aio ? unf_aio_seek(file->aio, offset, SEEK_SET) : fseeko(file->file_ptr, offset, SEEK_SET);
+    if (err != 0) {
+        return UNF_ERROR;
+    }
+
+    return UNF_SUCCESS;
+}
+
+
+/*
+ *
+ * auxiliary functions
+ *
+ */
+
+
+static int reader_init(index_reader_t *reader, unf_file_t *file, off_t file_size)
+{
+    reader->fd = fileno(file->file_ptr);
+    reader->swap_bytes = file->swap_bytes;
+    reader->file_size = file_size;
+    reader->last_used = 0;
+    reader->error = 0;
+    for (int i = 0; i < 2; i++) {
+        reader->windows[i].data = (char *) malloc(INDEX_WINDOW_SIZE);
+        reader->windows[i].offset = 0;
+        reader->windows[i].len = 0;
+    }
+
+    if (reader->windows[0].data == NULL || reader->windows[1].data == NULL) {
+        reader_free(reader);
+        return UNF_ERROR;
+    }
+
+    return UNF_SUCCESS;
+}
+
+
+static void reader_free(index_reader_t *reader)
+{
+    for (int i = 0; i < 2; i++) {
+        free(reader->windows[i].data);
+        reader->windows[i].data = NULL;
+    }
+}
+
+
+/*
+ * Reads the 4-byte marker at the given offset. If the marker is in neither
+ * window, the least recently used one is moved to start at the offset.
+ */
+static int read_marker_at(index_reader_t *reader, off_t offset, int32_t *marker)
+{
+    if (offset < 0 || offset + (off_t) sizeof(int32_t) > reader->file_size) {
+        return UNF_ERROR;
+    }
+
+    index_window_t *window = NULL;
+    for (int i = 0; i < 2; i++) {
+        index_window_t *w = &reader->windows[i];
+        if (offset >= w->offset && offset + sizeof(int32_t) <= w->offset + w->len) {
+            window = w;
+            reader->last_used = i;
+            break;
+        }
+    }
+
+    if (window == NULL) {
+        reader->last_used = 1 - reader->last_used;
+        window = &reader->windows[reader->last_used];
+
+        size_t n_bytes = INDEX_WINDOW_SIZE;
+        if ((off_t) n_bytes > reader->file_size - offset) {
+            n_bytes = (size_t) (reader->file_size - offset);
+        }
+
+        size_t n_done = 0;
+        while (n_done < n_bytes) {
+            ssize_t n = pread(reader->fd, window->data + n_done, n_bytes - n_done, offset + (off_t) n_done);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                break;
+            }
+            n_done += (size_t) n;
+        }
+
+        window->offset = offset;
+        window->len = n_done;
+        if (n_done < sizeof(int32_t)) {
+            reader->error = 1;
+            return UNF_ERROR;
+        }
+    }
+
+    memcpy(marker, window->data + (offset - window->offset), sizeof(int32_t));
+    if (reader->swap_bytes) {
+        unf_byte_swap(marker, 1, sizeof(int32_t));
+    }
+
+    return UNF_SUCCESS;
+}
+
+
+/*
+ * Checks whether a record starts at the given offset: its length is
+ * non-negative, it fits into the file and the trailing marker is the same.
+ */
+static int valid_record_at(index_reader_t *reader, off_t offset, int32_t *length)
+{
+    int32_t marker_1 = 0;
+    int32_t marker_2 = 0;
+
+    if (read_marker_at(reader, offset, &marker_1) == UNF_ERROR || marker_1 < 0) {
+        return UNF_ERROR;
+    }
+
+    off_t trailer = offset + (off_t) sizeof(int32_t) + marker_1;
+    if (trailer + (off_t) sizeof(int32_t) > reader->file_size) {
+        return UNF_ERROR;
+    }
+
+    if (read_marker_at(reader, trailer, &marker_2) == UNF_ERROR || marker_1 != marker_2) {
+        return UNF_ERROR;
+    }
+
+    *length = marker_1;
+
+    return UNF_SUCCESS;
+}
+
+
+/*
+ * Returns the first position in [lo, hi) where a chain of INDEX_SYNC_RECORDS
+ * valid records (or a shorter chain ending exactly at the end of the file) starts.
+ * Empty records are not accepted as the synchronization point: runs of zero bytes
+ * are too common in the data. Returns -1 if there is no such position.
+ *
+ * Candidates are tested byte by byte, and inside a large record each of them may
+ * cost a read of a random trailer; the scan therefore gives up after
+ * INDEX_MAX_SYNC_SCAN bytes. Such a range holds few records, and they are walked
+ * serially when the chains are stitched.
+ */
+static off_t find_sync_point(index_reader_t *reader, off_t lo, off_t hi)
+{
+    if (hi - lo > INDEX_MAX_SYNC_SCAN) {
+        hi = lo + INDEX_MAX_SYNC_SCAN;
+    }
+
+    for (off_t p = lo < 4 ? 4 : lo; p < hi; p++) {
+        // cheap test first: the preceding 4 bytes must look like a trailing marker
+        int32_t prev_length = 0;
+        if (read_marker_at(reader, p - (off_t) sizeof(int32_t), &prev_length) == UNF_ERROR ||
+            prev_length < 0 || p - 2 * (off_t) sizeof(int32_t) - prev_length < 0) {
+            continue;
+        }
+
+        int32_t length = 0;
+        if (valid_record_at(reader, p, &length) != UNF_SUCCESS || length == 0) {
+            continue;
+        }
+
+        off_t q = p;
+        int n_confirmed = 0;
+        while (n_confirmed < INDEX_SYNC_RECORDS && q < reader->file_size) {
+            if (valid_record_at(reader, q, &length) != UNF_SUCCESS) {
+                break;
+            }
+            q += 2 * (off_t) sizeof(int32_t) + length;
+            n_confirmed++;
+        }
+
+        if (n_confirmed == INDEX_SYNC_RECORDS || q == reader->file_size) {
+            return p;
+        }
+    }
+
+    return -1;
+}
+
+
+static int append_record(index_range_t *range, off_t offset, int32_t length)
+{
+    if (range->n_records == range->capacity) {
+        int64_t new_capacity = range->capacity > 0 ? 2 * range->capacity : 1024;
+        int64_t *new_offsets = (int64_t *) realloc(range->offsets, new_capacity * sizeof(int64_t));
+        if (new_offsets == NULL) {
+            return UNF_ERROR;
+        }
+        range->offsets = new_offsets;
+        int32_t *new_lengths = (int32_t *) realloc(range->lengths, new_capacity * sizeof(int32_t));
+        if (new_lengths == NULL) {
+            return UNF_ERROR;
+        }
+        range->lengths = new_lengths;
+        range->capacity = new_capacity;
+    }
+
+    range->offsets[range->n_records] = (int64_t) offset;
+    range->lengths[range->n_records] = length;
+    range->n_records++;
+
+    return UNF_SUCCESS;
+}
+
+
+/*
+ * Walks records starting at 'start' while they begin inside the range.
+ */
+static void walk_chain(index_reader_t *reader, index_range_t *range, off_t start)
+{
+    off_t pos = start;
+
+    while (pos < range->hi) {
+        int32_t length = 0;
+        if (valid_record_at(reader, pos, &length) != UNF_SUCCESS) {
+            range->broken = 1;
+            break;
+        }
+        if (append_record(range, pos, length) == UNF_ERROR) {
+            reader->error = 1;
+            break;
+        }
+        pos += 2 * (off_t) sizeof(int32_t) + length;
+    }
+
+    range->chain_end = pos;
+}
+
+
+/*
+ * Binary search of the record starting at 'offset' in the chain of the range.
+ * Returns its number in the chain or -1 if not found.
+ */
+static int64_t find_offset(index_range_t *range, off_t offset)
+{
+    int64_t lo = 0;
+    int64_t hi = range->n_records - 1;
+
+    while (lo <= hi) {
+        int64_t mid = lo + (hi - lo) / 2;
+        if (range->offsets[mid] == (int64_t) offset) {
+            return mid;
+        }
+        else if (range->offsets[mid] < (int64_t) offset) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid - 1;
+        }
+    }
+
+    return -1;
+}
@@ -0,0 +1,32 @@
+/*
+ * Inspector of DIRAC files containing transformed molecular integrals.
+ *
+ * 2024 Alexander Oleynichenko
+ */
+
+#include "util.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/time.h>
+
+
+/**
+ * Interface to the system-dependent functions for time measurements.
+ */
+double abs_time()
+{
+    struct timeval cur_time;
+    gettimeofday(&cur_time, NULL);
+    return (cur_time.tv_sec * 1000000u + cur_time.tv_usec) / 1.e6;
+}
+
+
+/**
+ * Returns 1 if the machine is little-endian, 0 otherwise.
+ */
+int is_native_little_endian()
+{
+    const uint16_t one = 1;
+    return *((const uint8_t *) &one) == 1;
+}
@@ -0,0 +1,25 @@
+/*
+ * Inspector of DIRAC files containing transformed molecular integrals.
+ *
+ * Small helpers shared by the readers, exporters and executables;
+ * not a part of the public interface.
+ *
+ * 2024 Alexander Oleynichenko
+ */
+
+#ifndef DIRAC_INSPECTOR_UTIL_H
+#define DIRAC_INSPECTOR_UTIL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+double abs_time();
+
+int is_native_little_endian();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DIRAC_INSPECTOR_UTIL_H